@@ -33,6 +33,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "oval_adt.h"
 #include "oval_collection_impl.h"
@@ -42,17 +43,29 @@
 /* Variable definitions
  * */
 
-typedef struct _oval_collection_item_frame {
-	struct _oval_collection_item_frame *next;
-	void *item;
-} _oval_collection_item_frame_t;
+#define OVAL_COLLECTION_MIN_CAPACITY 4
 
+/*
+ * The items are stored in an array in the order they were added, the
+ * array is doubled when it gets full.
+ */
 typedef struct oval_collection {
-	struct _oval_collection_item_frame *item_collection_frame;
+	void **items;
+	size_t count;
+	size_t capacity;
 } oval_collection_t;
 
+/*
+ * The iterator owns a copy of the items, so the collection can be
+ * modified or freed while it's iterated. The items which haven't been
+ * returned yet are items[first] .. items[end - 1]. Items added to the
+ * iterator by oval_collection_iterator_add() are returned first.
+ */
 typedef struct oval_iterator {
-	struct _oval_collection_item_frame *item_iterator_frame;
+	void **items;
+	size_t first;
+	size_t end;
+	size_t capacity;
 } oval_iterator_t;
 
 /* End of variable definitions
@@ -65,7 +78,9 @@ struct oval_collection *oval_collection_new()
 	if (collection == NULL)
 		return NULL;
 
-	collection->item_collection_frame = NULL;
+	collection->items = NULL;
+	collection->count = 0;
+	collection->capacity = 0;
 	return collection;
 }
 
@@ -77,19 +92,14 @@ void oval_collection_free(struct oval_collection *collection)
 void oval_collection_free_items(struct oval_collection *collection, oscap_destruct_func free_func)
 {
 	if (collection) {
-		struct _oval_collection_item_frame *frame = collection->item_collection_frame;
-		while (frame != NULL) {
-			if (free_func != NULL) {
-				void *item = frame->item;
+		if (free_func != NULL) {
+			for (size_t i = 0; i < collection->count; ++i) {
+				void *item = collection->items[i];
 				if (item)
 					(*free_func) (item);
-				frame->item = NULL;
 			}
-			struct _oval_collection_item_frame *temp = frame;
-			frame = frame->next;
-			temp->next = NULL;
-			free(temp);
 		}
+		free(collection->items);
 		free(collection);
 	}
 }
@@ -97,41 +107,41 @@ void oval_collection_free_items(struct oval_collection *collection, oscap_destru
 int oval_collection_is_empty(struct oval_collection *collection)
 {
 	__attribute__nonnull__(collection);
-	return collection->item_collection_frame == NULL;
+	return collection->count == 0;
 }
 
 void oval_collection_add(struct oval_collection *collection, void *item)
 {
 	__attribute__nonnull__(collection);
 
-	struct _oval_collection_item_frame *next = malloc(sizeof(_oval_collection_item_frame_t));
-	if (next == NULL)
-		return;
+	if (collection->count == collection->capacity) {
+		size_t capacity = collection->capacity ? collection->capacity * 2 : OVAL_COLLECTION_MIN_CAPACITY;
+		void **items = realloc(collection->items, capacity * sizeof(void *));
+		if (items == NULL)
+			return;
+		collection->items = items;
+		collection->capacity = capacity;
+	}
 
-	next->next = collection->item_collection_frame;
-	collection->item_collection_frame = next;
-	next->item = item;
+	collection->items[collection->count++] = item;
 }
 
 struct oval_iterator *oval_collection_iterator(struct oval_collection *collection)
 {
 	__attribute__nonnull__(collection);
 
-	struct oval_iterator *iterator = (struct oval_iterator *)malloc(sizeof(oval_iterator_t));
+	struct oval_iterator *iterator = oval_collection_iterator_new();
 	if (iterator == NULL)
 		return NULL;
 
-	iterator->item_iterator_frame = NULL;
-	struct _oval_collection_item_frame *collection_frame = collection->item_collection_frame;
-
-	while (collection_frame != NULL) {
-		struct _oval_collection_item_frame *iterator_frame =
-		    (struct _oval_collection_item_frame *)malloc(sizeof(_oval_collection_item_frame_t));
-
-		iterator_frame->next = iterator->item_iterator_frame;
-		iterator_frame->item = collection_frame->item;
-		iterator->item_iterator_frame = iterator_frame;
-		collection_frame = collection_frame->next;
+	if (collection->count > 0) {
+		iterator->items = malloc(collection->count * sizeof(void *));
+		if (iterator->items == NULL) {
+			free(iterator);
+			return NULL;
+		}
+		memcpy(iterator->items, collection->items, collection->count * sizeof(void *));
+		iterator->end = iterator->capacity = collection->count;
 	}
 	return iterator;
 }
@@ -140,53 +150,30 @@ bool oval_collection_iterator_has_more(struct oval_iterator * iterator)
 {
 	__attribute__nonnull__(iterator);
 
-	return iterator->item_iterator_frame != NULL;
+	return iterator->first < iterator->end;
 }
 
 int oval_collection_iterator_remaining(struct oval_iterator *iterator)
 {
 	__attribute__nonnull__(iterator);
 
-	int remaining;
-	struct _oval_collection_item_frame *next = iterator->item_iterator_frame;
-
-	for (remaining = 0; next; remaining++)
-		next = next->next;
-
-	return remaining;
+	return (int)(iterator->end - iterator->first);
 }
 
 void *oval_collection_iterator_next(struct oval_iterator *iterator)
 {
 	__attribute__nonnull__(iterator);
 
-	struct _oval_collection_item_frame *oc_next = iterator->item_iterator_frame;
-	void *next;
-
-	if (oc_next == NULL) {
-		next = NULL;
-	} else {
-		next = oc_next->item;
-		iterator->item_iterator_frame = oc_next->next;
-		oc_next->item = NULL;
-		oc_next->next = NULL;
-		free(oc_next);
-	}
-	return next;
+	if (iterator->first == iterator->end)
+		return NULL;
+
+	return iterator->items[iterator->first++];
 }
 
 void oval_collection_iterator_free(struct oval_iterator *iterator)
 {
 	if (iterator) {		//NOOP if iterator is NULL
-		while (iterator->item_iterator_frame) {
-			struct _oval_collection_item_frame *oc_this;
-			oc_this = iterator->item_iterator_frame;
-			iterator->item_iterator_frame = oc_this->next;
-			oc_this->item = NULL;
-			oc_this->next = NULL;
-			free(oc_this);
-		}
-		iterator->item_iterator_frame = NULL;
+		free(iterator->items);
 		free(iterator);
 	}
 }
@@ -197,7 +184,10 @@ struct oval_iterator *oval_collection_iterator_new()
 	if (iterator == NULL)
 		return NULL;
 
-	iterator->item_iterator_frame = NULL;
+	iterator->items = NULL;
+	iterator->first = 0;
+	iterator->end = 0;
+	iterator->capacity = 0;
 	return iterator;
 }
 
@@ -205,14 +195,23 @@ void oval_collection_iterator_add(struct oval_iterator *iterator, void *item)
 {
 	__attribute__nonnull__(iterator);
 
-	struct _oval_collection_item_frame *newframe =
-	    (struct _oval_collection_item_frame *)malloc(sizeof(_oval_collection_item_frame_t));
-	if (newframe == NULL)	/* We don't have any information that error occured ! */
-		return;
+	if (iterator->first == 0) {
+		/* make room in front of the remaining items */
+		size_t remaining = iterator->end - iterator->first;
+		size_t capacity = iterator->capacity ? iterator->capacity * 2 : OVAL_COLLECTION_MIN_CAPACITY;
+		void **items = malloc(capacity * sizeof(void *));
+		if (items == NULL)	/* We don't have any information that error occured ! */
+			return;
+		if (remaining > 0)
+			memcpy(items + capacity - remaining, iterator->items + iterator->first, remaining * sizeof(void *));
+		free(iterator->items);
+		iterator->items = items;
+		iterator->first = capacity - remaining;
+		iterator->end = capacity;
+		iterator->capacity = capacity;
+	}
 
-	newframe->next = iterator->item_iterator_frame;
-	newframe->item = item;
-	iterator->item_iterator_frame = newframe;
+	iterator->items[--iterator->first] = item;
 }
 
 bool oval_string_iterator_has_more(struct oval_string_iterator * iterator)
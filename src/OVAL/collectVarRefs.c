@@ -28,8 +28,6 @@
 #include "oval_definitions_impl.h"
 #include "adt/oval_string_map_impl.h"
 
-static void _var_collect_var_refs(struct oval_variable *var, struct oval_string_map *vm);
-
 static void _comp_collect_var_refs(struct oval_component *comp, struct oval_string_map *vm)
 {
 	struct oval_object *obj;
@@ -43,17 +41,20 @@ static void _comp_collect_var_refs(struct oval_component *comp, struct oval_stri
 		break;
 	case OVAL_COMPONENT_VARREF:
 		var = oval_component_get_variable(comp);
-		_var_collect_var_refs(var, vm);
+		oval_var_collect_var_refs(var, vm);
 		break;
 	case OVAL_FUNCTION_ARITHMETIC:
 	case OVAL_FUNCTION_BEGIN:
 	case OVAL_FUNCTION_CONCAT:
+	case OVAL_FUNCTION_COUNT:
 	case OVAL_FUNCTION_END:
 	case OVAL_FUNCTION_ESCAPE_REGEX:
+	case OVAL_FUNCTION_GLOB_TO_REGEX:
 	case OVAL_FUNCTION_REGEX_CAPTURE:
 	case OVAL_FUNCTION_SPLIT:
 	case OVAL_FUNCTION_SUBSTRING:
 	case OVAL_FUNCTION_TIMEDIF:
+	case OVAL_FUNCTION_UNIQUE:
 		cmp_itr = oval_component_get_function_components(comp);
 		while (oval_component_iterator_has_more(cmp_itr)) {
 			struct oval_component *cmp;
@@ -68,7 +69,7 @@ static void _comp_collect_var_refs(struct oval_component *comp, struct oval_stri
 	}
 }
 
-static void _var_collect_var_refs(struct oval_variable *var, struct oval_string_map *vm)
+void oval_var_collect_var_refs(struct oval_variable *var, struct oval_string_map *vm)
 {
 	char *var_id;
 
@@ -93,7 +94,7 @@ static void _ent_collect_var_refs(struct oval_entity *ent, struct oval_string_ma
 		struct oval_variable *var;
 
 		var = oval_entity_get_variable(ent);
-		_var_collect_var_refs(var, vm);
+		oval_var_collect_var_refs(var, vm);
 	}
 }
 
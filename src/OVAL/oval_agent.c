@@ -34,6 +34,12 @@
 
 #include <string.h>
 #include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#if defined(OVAL_PROBES_ENABLED)
+# include <pthread.h>
+#endif
 
 #include "oval_agent_api.h"
 #include "oval_definitions_impl.h"
@@ -62,9 +68,22 @@ struct oval_agent_session {
 #if defined(OVAL_PROBES_ENABLED)
 	struct oval_results_model    * res_model;
 	oval_probe_session_t  * psess;
+	unsigned int eval_threads;	///< number of threads evaluating the tests in oval_agent_eval_system
 #endif
 };
 
+#if defined(OVAL_PROBES_ENABLED)
+/**
+ * Queue of result tests evaluated in parallel by oval_agent_eval_system.
+ */
+struct oval_agent_test_queue {
+	struct oval_result_test **tests;
+	size_t count;
+	size_t next;
+	pthread_mutex_t lock;
+};
+#endif
+
 
 /**
  * Specification of structure for transformation of OVAL Result type
@@ -89,6 +108,28 @@ static const struct oval_result_to_xccdf_spec XCCDF_OVAL_RESULTS_MAP[] = {
 	{0, 0, 0}
 };
 
+#if defined(OVAL_PROBES_ENABLED)
+static unsigned int _oval_agent_default_eval_threads(void)
+{
+	const char *str = getenv("OSCAP_OVAL_EVAL_THREADS");
+	char *end;
+	unsigned long value;
+
+	if (str == NULL || *str == '\0')
+		return 1;
+
+	errno = 0;
+	value = strtoul(str, &end, 10);
+
+	if (errno != 0 || *end != '\0' || value == 0 || value > UINT_MAX) {
+		dW("Invalid value of OSCAP_OVAL_EVAL_THREADS: \"%s\", evaluating serially", str);
+		return 1;
+	}
+
+	return (unsigned int) value;
+}
+#endif
+
 oval_agent_session_t * oval_agent_new_session(struct oval_definition_model *model, const char * name) {
 	struct oval_sysinfo *sysinfo;
 	struct oval_generator *generator;
@@ -106,6 +147,7 @@ oval_agent_session_t * oval_agent_new_session(struct oval_definition_model *mode
 	ag_sess->sys_model = oval_syschar_model_new(model);
 #if defined(OVAL_PROBES_ENABLED)
 	ag_sess->psess     = oval_probe_session_new(ag_sess->sys_model);
+	ag_sess->eval_threads = _oval_agent_default_eval_threads();
 #endif
 
 #if defined(OVAL_PROBES_ENABLED)
@@ -270,6 +312,134 @@ int oval_agent_abort_session(oval_agent_session_t *ag_sess)
 #endif
 }
 
+void oval_agent_set_eval_threads(oval_agent_session_t *ag_sess, unsigned int threads)
+{
+	__attribute__nonnull__(ag_sess);
+
+#if defined(OVAL_PROBES_ENABLED)
+	ag_sess->eval_threads = threads > 0 ? threads : 1;
+#endif
+}
+
+#if defined(OVAL_PROBES_ENABLED)
+static void *_oval_agent_test_queue_worker(void *arg)
+{
+	struct oval_agent_test_queue *queue = (struct oval_agent_test_queue *) arg;
+	size_t i;
+
+	for (;;) {
+		pthread_mutex_lock(&queue->lock);
+		i = queue->next++;
+		pthread_mutex_unlock(&queue->lock);
+
+		if (i >= queue->count)
+			break;
+
+		oval_result_test_eval_collected(queue->tests[i]);
+	}
+
+	return NULL;
+}
+
+/**
+ * Evaluate the tests of all the definitions using ag_sess->eval_threads
+ * threads. The definitions themselves are evaluated afterwards by the serial
+ * loop of oval_agent_eval_system, which then only combines the test results.
+ *
+ * The result definitions and tests are created up front in the order of the
+ * definitions, so the results are exported in the same order as in the
+ * serial mode. The objects and variables are collected up front as well,
+ * only the comparison of the collected items against the states runs in
+ * parallel. Each result test is evaluated by exactly one thread.
+ */
+static int _oval_agent_eval_tests_parallel(oval_agent_session_t *ag_sess)
+{
+	struct oval_result_system *rsystem;
+	struct oval_definition_iterator *oval_def_it;
+	struct oval_result_test_iterator *rtest_it;
+	struct oval_agent_test_queue queue;
+	size_t queue_size = 0, threads, started;
+	pthread_t *tids;
+	int ret = 0;
+
+	rsystem = _oval_agent_get_first_result_system(ag_sess);
+	if (rsystem == NULL)
+		return -1;
+
+	oval_def_it = oval_definition_model_get_definitions(ag_sess->def_model);
+	while (oval_definition_iterator_has_more(oval_def_it)) {
+		struct oval_definition *oval_def = oval_definition_iterator_next(oval_def_it);
+
+		if (oval_result_system_prepare_definition(rsystem, oval_definition_get_id(oval_def)) == NULL) {
+			ret = -1;
+			break;
+		}
+	}
+	oval_definition_iterator_free(oval_def_it);
+
+	if (ret != 0)
+		return ret;
+
+	queue.tests = NULL;
+	queue.count = 0;
+	queue.next  = 0;
+
+	rtest_it = oval_result_system_get_tests(rsystem);
+	while (oval_result_test_iterator_has_more(rtest_it)) {
+		struct oval_result_test *rtest = oval_result_test_iterator_next(rtest_it);
+
+		if (oval_result_test_get_result(rtest) != OVAL_RESULT_NOT_EVALUATED)
+			continue;
+
+		/*
+		 * The objects and the variables of all the states are resolved
+		 * here, the workers only compare the items with the states and
+		 * never touch the probe session or the variables. Tests which
+		 * can't be resolved are evaluated right away, so that the errors
+		 * are handled the same way as in the serial mode.
+		 */
+		if (oval_probe_resolve_test(ag_sess->psess, oval_result_test_get_test(rtest)) != 0) {
+			oval_result_test_eval(rtest);
+			continue;
+		}
+
+		if (queue.count == queue_size) {
+			queue_size = queue_size ? queue_size * 2 : 64;
+			queue.tests = realloc(queue.tests, queue_size * sizeof(struct oval_result_test *));
+		}
+		queue.tests[queue.count++] = rtest;
+	}
+	oval_result_test_iterator_free(rtest_it);
+
+	threads = ag_sess->eval_threads < queue.count ? ag_sess->eval_threads : queue.count;
+	dI("Evaluating %zu tests using %zu threads.", queue.count, threads);
+
+	pthread_mutex_init(&queue.lock, NULL);
+	tids = malloc(threads * sizeof(pthread_t));
+
+	for (started = 0; started < threads; ++started) {
+		int err = pthread_create(&tids[started], NULL, _oval_agent_test_queue_worker, &queue);
+
+		if (err != 0) {
+			dW("Can't start evaluation thread: %s", strerror(err));
+			break;
+		}
+	}
+
+	/* Whatever is left is evaluated by this thread. */
+	_oval_agent_test_queue_worker(&queue);
+
+	while (started > 0)
+		pthread_join(tids[--started], NULL);
+
+	free(tids);
+	free(queue.tests);
+	pthread_mutex_destroy(&queue.lock);
+
+	return 0;
+}
+#endif
+
 int oval_agent_eval_system(oval_agent_session_t * ag_sess, agent_reporter cb, void *arg) {
 	struct oval_definition *oval_def;
 	struct oval_definition_iterator *oval_def_it;
@@ -277,6 +447,28 @@ int oval_agent_eval_system(oval_agent_session_t * ag_sess, agent_reporter cb, vo
 	int ret = 0;
 
 	dI("OVAL agent started to evaluate OVAL definitions on your system.");
+#if defined(OVAL_PROBES_ENABLED)
+	/*
+	 * Start collecting the objects of all the definitions up front, so
+	 * that the probes of different object types work in parallel. Objects
+	 * which fail here are collected again by the evaluation below and the
+	 * errors are reported from there.
+	 */
+	oval_def_it = oval_definition_model_get_definitions(ag_sess->def_model);
+	while (oval_definition_iterator_has_more(oval_def_it)) {
+		oval_def = oval_definition_iterator_next(oval_def_it);
+
+		if (oval_probe_prefetch_definition(ag_sess->psess, oval_def) == -1)
+			break;
+	}
+	oval_definition_iterator_free(oval_def_it);
+	oval_probe_prefetch_wait(ag_sess->psess);
+
+	if (ag_sess->eval_threads > 1 && _oval_agent_eval_tests_parallel(ag_sess) != 0) {
+		dI("OVAL agent finished evaluation.");
+		return -1;
+	}
+#endif
 	oval_def_it = oval_definition_model_get_definitions(ag_sess->def_model);
 	while (oval_definition_iterator_has_more(oval_def_it)) {
 		oval_def = oval_definition_iterator_next(oval_def_it);
@@ -420,11 +612,12 @@ static void _oval_agent_resolve_variables_conflict(struct oval_agent_session *se
 	const char *var_name = NULL;
 	struct oscap_stringlist *value_list = NULL;
 	bool conflict = false;
+	struct oval_string_map *changed = oval_string_map_new();
 	struct oscap_htable *dict = _binding_iterator_to_dict(it);
 	struct oscap_htable_iterator *hit = oscap_htable_iterator_new(dict);
 	struct oval_definition_model *def_model =
 			oval_results_model_get_definition_model(oval_agent_get_results_model(session));
-	while (!conflict && oscap_htable_iterator_has_more(hit)) {
+	while (oscap_htable_iterator_has_more(hit)) {
 		oscap_htable_iterator_next_kv(hit, &var_name, (void*) &value_list);
 		struct oval_variable *variable = oval_definition_model_get_variable(def_model, var_name);
 		if (variable != NULL) {
@@ -440,6 +633,7 @@ static void _oval_agent_resolve_variables_conflict(struct oval_agent_session *se
 				// As per OVAL 5.10.1, the Variable Schema does not allow multisets. Therefore,
 				// we will later create new variable model and export multiple variables docs.
 				conflict = true;
+				oval_string_map_put(changed, var_name, variable);
 				// Next, in the results model, there might be already some definitions, tests
 				// states, or objects. These might be dependent on the previous value of the
 				// given variable.
@@ -492,9 +686,17 @@ static void _oval_agent_resolve_variables_conflict(struct oval_agent_session *se
 	oscap_htable_free(dict, (oscap_destruct_func) oscap_stringlist_free);
 
     if (conflict) {
-        /* We have a conflict, clear session and external variables */
-        oval_agent_reset_session(session);
+        /* We have a conflict, clear external variables. Unlike
+         * oval_agent_reset_session() the probes and their caches are kept,
+         * only the objects dependent on the changed variables are collected
+         * again for the new variable instance. */
+        session->cur_var_model = NULL;
+        oval_definition_model_clear_external_variables(def_model);
+#if defined(OVAL_PROBES_ENABLED)
+        oval_probe_hint_variables(session->psess, changed);
+#endif
     }
+    oval_string_map_free(changed, NULL);
 
     if (!session->cur_var_model) {
 	    session->cur_var_model = oval_variable_model_new();
@@ -93,6 +93,18 @@ static void _syschar_add_bindings(struct oval_syschar *sc, struct oval_string_ma
 	oval_collection_iterator_free(var_itr);
 }
 
+static bool _syschar_has_bindings(struct oval_syschar *sc)
+{
+	struct oval_variable_binding_iterator *bind_itr;
+	bool has_bindings;
+
+	bind_itr = oval_syschar_get_variable_bindings(sc);
+	has_bindings = oval_variable_binding_iterator_has_more(bind_itr);
+	oval_variable_binding_iterator_free(bind_itr);
+
+	return has_bindings;
+}
+
 int oval_probe_query_object(oval_probe_session_t *psess, struct oval_object *object, int flags, struct oval_syschar **out_syschar)
 {
 	char *oid;
@@ -151,11 +163,28 @@ int oval_probe_query_object(oval_probe_session_t *psess, struct oval_object *obj
 		return 1;
         }
 
-	if ((ret = oval_probe_ext_handler(type, ph->uptr, PROBE_HANDLER_ACT_EVAL, sysc, flags)) != 0) {
-		return ret;
+	if (flags & OVAL_PDFLAG_ASYNC) {
+		/*
+		 * The variable bindings are added right away, the values
+		 * of the variables were computed when sending the object.
+		 */
+		if ((ret = oval_probe_ext_handler(type, ph->uptr, PROBE_HANDLER_ACT_EVAL_ASYNC, sysc, flags & ~OVAL_PDFLAG_ASYNC)) != 0) {
+			return ret;
+		}
+	} else {
+		if (!(flags & OVAL_PDFLAG_NOREPLY)) {
+			/* the object might be collected by an asynchronous request */
+			if ((ret = oval_probe_ext_wait(psess->pext, sysc)) != 1) {
+				return ret;
+			}
+		}
+
+		if ((ret = oval_probe_ext_handler(type, ph->uptr, PROBE_HANDLER_ACT_EVAL, sysc, flags)) != 0) {
+			return ret;
+		}
 	}
 
-	if (!(flags & OVAL_PDFLAG_NOREPLY)) {
+	if (!(flags & OVAL_PDFLAG_NOREPLY) && !_syschar_has_bindings(sysc)) {
 		vm = oval_string_map_new();
 		oval_obj_collect_var_refs(object, vm);
 		_syschar_add_bindings(sysc, vm);
@@ -270,3 +299,126 @@ int oval_probe_query_test(oval_probe_session_t *sess, struct oval_test *test)
 	return 0;
 }
 
+int oval_probe_resolve_test(oval_probe_session_t *sess, struct oval_test *test)
+{
+	struct oval_object *object;
+	struct oval_syschar *sysc = NULL;
+	struct oval_state_iterator *ste_itr;
+	struct oval_string_map *vm;
+	struct oval_iterator *var_itr;
+	int ret = 0;
+
+	object = oval_test_get_object(test);
+	if (object == NULL || oval_test_get_subtype(test) != oval_object_get_subtype(object))
+		return 1;
+
+	if (oval_probe_query_object(sess, object, 0, &sysc) == -1)
+		return -1;
+	if (sysc == NULL || oval_syschar_get_flag(sysc) == SYSCHAR_FLAG_UNKNOWN)
+		return 1;
+
+	/*
+	 * Unlike oval_probe_query_test(), go through all the states, the
+	 * evaluation computes the variables of every one of them.
+	 */
+	vm = oval_string_map_new();
+	ste_itr = oval_test_get_states(test);
+	while (oval_state_iterator_has_more(ste_itr))
+		oval_ste_collect_var_refs(oval_state_iterator_next(ste_itr), vm);
+	oval_state_iterator_free(ste_itr);
+
+	var_itr = oval_string_map_values(vm);
+	while (oval_collection_iterator_has_more(var_itr)) {
+		struct oval_variable *var = oval_collection_iterator_next(var_itr);
+
+		if (oval_probe_query_variable(sess, var) != 0) {
+			ret = -1;
+			break;
+		}
+		if (oval_variable_get_type(var) == OVAL_VARIABLE_LOCAL &&
+		    oval_variable_get_collection_flag(var) == SYSCHAR_FLAG_UNKNOWN)
+			ret = 1;
+	}
+	oval_collection_iterator_free(var_itr);
+	oval_string_map_free(vm, NULL);
+
+	return ret;
+}
+
+static int oval_probe_prefetch_criteria(oval_probe_session_t *sess, struct oval_criteria_node *cnode);
+
+static int oval_probe_prefetch_object(oval_probe_session_t *sess, struct oval_object *object)
+{
+	int ret;
+
+	/*
+	 * Only one request per probe can be outstanding. If the probe of
+	 * the object is busy, wait for the oldest request (of any probe)
+	 * and try again.
+	 */
+	while ((ret = oval_probe_query_object(sess, object, OVAL_PDFLAG_ASYNC, NULL)) == 2) {
+		if (oval_probe_ext_wait_any(sess->pext, NULL) == -1)
+			return -1;
+	}
+
+	return (ret == -1 ? -1 : 0);
+}
+
+static int oval_probe_prefetch_criteria(oval_probe_session_t *sess, struct oval_criteria_node *cnode)
+{
+	switch (oval_criteria_node_get_type(cnode)) {
+	case OVAL_NODETYPE_CRITERION:{
+		struct oval_test *test = oval_criteria_node_get_test(cnode);
+		if (test == NULL)
+			return 0;
+		struct oval_object *object = oval_test_get_object(test);
+		/* incompatible objects are reported by oval_probe_query_test() */
+		if (object == NULL || oval_test_get_subtype(test) != oval_object_get_subtype(object))
+			return 0;
+		return oval_probe_prefetch_object(sess, object);
+	}
+	case OVAL_NODETYPE_CRITERIA:{
+		struct oval_criteria_node_iterator *cnode_it = oval_criteria_node_get_subnodes(cnode);
+		if (cnode_it == NULL)
+			return 0;
+		int ret = 0;
+		while (ret == 0 && oval_criteria_node_iterator_has_more(cnode_it)) {
+			struct oval_criteria_node *node = oval_criteria_node_iterator_next(cnode_it);
+			ret = oval_probe_prefetch_criteria(sess, node);
+		}
+		oval_criteria_node_iterator_free(cnode_it);
+		return ret;
+	}
+	case OVAL_NODETYPE_EXTENDDEF:{
+		struct oval_definition *oval_def = oval_criteria_node_get_definition(cnode);
+		return oval_probe_prefetch_definition(sess, oval_def);
+	}
+	default:
+		return 0;
+	}
+}
+
+int oval_probe_prefetch_definition(oval_probe_session_t *sess, struct oval_definition *definition)
+{
+	struct oval_criteria_node *cnode;
+
+	if (definition == NULL)
+		return 0;
+	cnode = oval_definition_get_criteria(definition);
+	if (cnode == NULL)
+		return 0;
+
+	return oval_probe_prefetch_criteria(sess, cnode);
+}
+
+int oval_probe_prefetch_wait(oval_probe_session_t *sess)
+{
+	int ret = 0;
+
+	while (sess->pext->preq_cnt > 0) {
+		if (oval_probe_ext_wait_any(sess->pext, NULL) == -1)
+			ret = -1;
+	}
+
+	return ret;
+}
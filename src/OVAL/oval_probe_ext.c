@@ -54,6 +54,8 @@ static oval_pdtbl_t *oval_pdtbl_new(void);
 static void          oval_pdtbl_free(oval_pdtbl_t *table);
 static int           oval_pdtbl_add(oval_pdtbl_t *table, oval_subtype_t type, int sd, const char *uri);
 static oval_pd_t    *oval_pdtbl_get(oval_pdtbl_t *table, oval_subtype_t type);
+static void          oval_preq_drop(oval_pext_t *pext);
+static void          oval_preq_drain(oval_pext_t *pext, oval_pd_t *pd);
 
 /*
  * oval_pext_
@@ -65,12 +67,16 @@ oval_pext_t *oval_pext_new(void)
         pext->do_init = true;
         pthread_mutex_init(&pext->lock, NULL);
         pext->pdtbl     = NULL;
+        pext->preq      = NULL;
+        pext->preq_cnt  = 0;
 
         return(pext);
 }
 
 void oval_pext_free(oval_pext_t *pext)
 {
+        oval_preq_drop(pext);
+
         if (!pext->do_init) {
                 /* free structs */
                 oval_pdtbl_free(pext->pdtbl);
@@ -804,6 +810,7 @@ int oval_probe_ext_handler(oval_subtype_t type, void *ptr, int act, ...)
 
         switch(act) {
         case PROBE_HANDLER_ACT_EVAL:
+        case PROBE_HANDLER_ACT_EVAL_ASYNC:
         {
 		struct oval_object *obj;
 		struct oval_syschar *sys;
@@ -853,6 +860,11 @@ int oval_probe_ext_handler(oval_subtype_t type, void *ptr, int act, ...)
                         }
                 }
 
+		if (act == PROBE_HANDLER_ACT_EVAL_ASYNC) {
+			va_end(ap);
+			return oval_probe_ext_eval_async(pext->pdtbl->ctx, pd, pext, sys, flags);
+		}
+
 		ret = oval_probe_ext_eval(pext->pdtbl->ctx, pd, pext, sys, flags);
 
 		if (ret >= 0)
@@ -860,6 +872,8 @@ int oval_probe_ext_handler(oval_subtype_t type, void *ptr, int act, ...)
 
 		if (ret < 0 && errno == ECONNABORTED) {
 			if (!(flags & OVAL_PDFLAG_SLAVE)) {
+				oval_preq_drop(pext);
+
 				if (!pext->do_init) {
 					oval_pdtbl_free(pext->pdtbl);
 				}
@@ -885,6 +899,13 @@ int oval_probe_ext_handler(oval_subtype_t type, void *ptr, int act, ...)
 	case PROBE_HANDLER_ACT_ABORT:
         {
                 if (type == OVAL_SUBTYPE_ALL) {
+			/*
+			 * Don't let the reset command meet the replies to
+			 * the asynchronous requests.
+			 */
+			if (act == PROBE_HANDLER_ACT_RESET)
+				oval_preq_drain(pext, NULL);
+
                         /*
                          * Iterate thru probe descriptor table and execute the reset operation
                          * for each probe descriptor.
@@ -920,13 +941,43 @@ int oval_probe_ext_handler(oval_subtype_t type, void *ptr, int act, ...)
                         if (pd == NULL) 
                                 return(0);
 
-			if (act == PROBE_HANDLER_ACT_RESET)
+			if (act == PROBE_HANDLER_ACT_RESET) {
+				oval_preq_drain(pext, pd);
 				return oval_probe_ext_reset(pext->pdtbl->ctx, pd, pext);
+			}
 			else
 				return oval_probe_ext_abort(pext->pdtbl->ctx, pd, pext);
                 }
                 break;
         }
+	case PROBE_HANDLER_ACT_INVALIDATE:
+	{
+		SEXP_t *ids = va_arg(ap, SEXP_t *);
+
+		va_end(ap);
+
+		/* Nothing is cached until the first probe is started */
+		if (pext->do_init)
+			return (0);
+
+		/*
+		 * Results of the outstanding asynchronous requests would be
+		 * cached after the invalidation otherwise.
+		 */
+		oval_preq_drain(pext, NULL);
+
+		for (size_t i = 0; i < pext->pdtbl->count; ++i) {
+			pd = pext->pdtbl->memb[i];
+
+			if (pd == NULL)
+				break;
+
+			if ((ret = oval_probe_ext_invalidate(pext->pdtbl->ctx, pd, pext, ids)) != 0)
+				return (ret);
+		}
+
+		return (0);
+	}
         case PROBE_HANDLER_ACT_FREE:
         case PROBE_HANDLER_ACT_CLOSE:
         default:
@@ -975,6 +1026,14 @@ int oval_probe_ext_eval(SEAP_CTX_t *ctx, oval_pd_t *pd, oval_pext_t *pext, struc
 	if (ret != 0)
 		return (1);
 
+	/*
+	 * A reply to an asynchronous request must not be received instead
+	 * of the reply to this one. Requests sent while the asynchronous one
+	 * is being received come from the commands of the probe and are
+	 * replied to before it.
+	 */
+	oval_preq_drain(pext, pd);
+
 	ret = oval_probe_comm(ctx, pd, s_obj, flags, &s_sys);
 	SEXP_free(s_obj);
 
@@ -1011,6 +1070,218 @@ int oval_probe_ext_eval(SEAP_CTX_t *ctx, oval_pd_t *pd, oval_pext_t *pext, struc
 	return (ret);
 }
 
+/*
+ * oval_preq_
+ */
+static oval_preq_t *oval_preq_get(oval_pext_t *pext, oval_pd_t *pd, struct oval_syschar *syschar)
+{
+	for (size_t i = 0; i < pext->preq_cnt; ++i) {
+		if ((pd == NULL || pext->preq[i]->pd == pd) &&
+		    (syschar == NULL || pext->preq[i]->syschar == syschar))
+			return (pext->preq[i]);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Get the oldest request which isn't being received already.
+ */
+static oval_preq_t *oval_preq_next(oval_pext_t *pext, oval_pd_t *pd)
+{
+	for (size_t i = 0; i < pext->preq_cnt; ++i) {
+		if ((pd == NULL || pext->preq[i]->pd == pd) && !pext->preq[i]->waiting)
+			return (pext->preq[i]);
+	}
+
+	return (NULL);
+}
+
+static void oval_preq_del(oval_pext_t *pext, oval_preq_t *req)
+{
+	for (size_t i = 0; i < pext->preq_cnt; ++i) {
+		if (pext->preq[i] == req) {
+			memmove(pext->preq + i, pext->preq + i + 1,
+				sizeof(oval_preq_t *) * (pext->preq_cnt - i - 1));
+			--pext->preq_cnt;
+			break;
+		}
+	}
+
+	free(req);
+}
+
+/*
+ * Forget all the requests without receiving the replies. Used when the
+ * probe connections are being closed.
+ */
+static void oval_preq_drop(oval_pext_t *pext)
+{
+	for (size_t i = 0; i < pext->preq_cnt; ++i)
+		free(pext->preq[i]);
+
+	free(pext->preq);
+	pext->preq     = NULL;
+	pext->preq_cnt = 0;
+}
+
+/*
+ * Receive the reply to the request and update its syschar. Commands sent
+ * by the probe meanwhile are handled by SEAP_recvmsg as usual. Failed
+ * requests leave the syschar untouched so that the object is collected
+ * again synchronously and the error is reported from there.
+ */
+static int oval_preq_recv(oval_pext_t *pext, oval_preq_t *req)
+{
+	SEAP_CTX_t *ctx = pext->pdtbl->ctx;
+	SEAP_msg_t *s_imsg = NULL;
+	SEXP_t     *s_sys;
+	int ret;
+
+	dD("Waiting for reply to the asynchronous request, sd=%d.", req->pd->sd);
+
+	ctx->subtype = req->pd->subtype;
+	req->waiting = true;
+	ret = SEAP_recvmsg(ctx, req->pd->sd, &s_imsg);
+	req->waiting = false;
+
+	if (ret != 0) {
+		protect_errno {
+			dW("Can't receive reply to the asynchronous request: %u, %s.", errno, strerror(errno));
+		}
+
+		if (errno == ECANCELED) {
+			SEAP_err_t *err = NULL;
+
+			if (SEAP_recverr_byid(ctx, req->pd->sd, &err, req->id) == 0)
+				SEAP_error_free(err);
+		}
+
+		SEAP_msg_free(s_imsg);
+		oval_preq_del(pext, req);
+		return (1);
+	}
+
+	s_sys = SEAP_msg_get(s_imsg);
+	SEAP_msg_free(s_imsg);
+
+	ret = oval_sexp_to_sysch(s_sys, req->syschar);
+	SEXP_free(s_sys);
+	oval_preq_del(pext, req);
+
+	return (ret == 0 ? 0 : -1);
+}
+
+/*
+ * Receive the replies to all the requests sent to the probe (or to all
+ * the probes if pd is NULL).
+ */
+static void oval_preq_drain(oval_pext_t *pext, oval_pd_t *pd)
+{
+	oval_preq_t *req;
+
+	while ((req = oval_preq_next(pext, pd)) != NULL)
+		oval_preq_recv(pext, req);
+}
+
+int oval_probe_ext_eval_async(SEAP_CTX_t *ctx, oval_pd_t *pd, oval_pext_t *pext, struct oval_syschar *syschar, int flags)
+{
+	SEXP_t *s_obj;
+	SEAP_msg_t *s_omsg;
+	oval_preq_t *req;
+	struct oval_object *object;
+
+	if (syschar == NULL) {
+		oscap_seterr(OSCAP_EFAMILY_OVAL, "Internal error: syschar == NULL");
+		return (-1);
+	}
+
+	/*
+	 * Keep at most one asynchronous request per probe. Nested requests
+	 * coming from the commands of the probe are received in LIFO order
+	 * and a second outstanding reply could be received by one of them
+	 * instead of the request it belongs to.
+	 */
+	if (oval_preq_get(pext, pd, NULL) != NULL)
+		return (2);
+
+	if (flags & OVAL_PDFLAG_NOREPLY)
+		return (1);
+
+	object = oval_syschar_get_object(syschar);
+
+	if (oval_object_to_sexp(pext->sess_ptr, oval_subtype_to_str(oval_object_get_subtype(object)), syschar, &s_obj) != 0)
+		return (1);
+
+	ctx->subtype = pd->subtype;
+
+	if (pd->sd == -1) {
+		pd->sd = SEAP_connect(ctx);
+
+		if (pd->sd < 0) {
+			protect_errno {
+				dW("Can't connect: %u, %s.", errno, strerror(errno));
+			}
+
+			pd->sd = -1;
+			SEXP_free(s_obj);
+			return (1);
+		}
+	}
+
+	s_omsg = SEAP_msg_new();
+	SEAP_msg_set(s_omsg, s_obj);
+	SEXP_free(s_obj);
+
+	if (SEAP_sendmsg(ctx, pd->sd, s_omsg) != 0) {
+		protect_errno {
+			dW("Can't send message: %u, %s.", errno, strerror(errno));
+		}
+
+		SEAP_msg_free(s_omsg);
+		return (1);
+	}
+
+	req = malloc(sizeof(oval_preq_t));
+	req->pd      = pd;
+	req->id      = SEAP_msg_id(s_omsg);
+	req->syschar = syschar;
+	req->waiting = false;
+	SEAP_msg_free(s_omsg);
+
+	pext->preq = realloc(pext->preq, sizeof(oval_preq_t *) * (pext->preq_cnt + 1));
+	pext->preq[pext->preq_cnt++] = req;
+
+	return (0);
+}
+
+int oval_probe_ext_wait(oval_pext_t *pext, struct oval_syschar *syschar)
+{
+	oval_preq_t *req;
+
+	req = oval_preq_get(pext, NULL, syschar);
+
+	if (req == NULL || req->waiting)
+		return (1);
+
+	return oval_preq_recv(pext, req);
+}
+
+int oval_probe_ext_wait_any(oval_pext_t *pext, struct oval_syschar **out_syschar)
+{
+	oval_preq_t *req;
+
+	req = oval_preq_next(pext, NULL);
+
+	if (req == NULL)
+		return (1);
+
+	if (out_syschar != NULL)
+		*out_syschar = req->syschar;
+
+	return oval_preq_recv(pext, req);
+}
+
 int oval_probe_ext_reset(SEAP_CTX_t *ctx, oval_pd_t *pd, oval_pext_t *pext)
 {
         SEAP_cmd_exec(ctx, pd->sd, SEAP_EXEC_RECV, PROBECMD_RESET, NULL, SEAP_CMDTYPE_SYNC, NULL, NULL);
@@ -1018,6 +1289,13 @@ int oval_probe_ext_reset(SEAP_CTX_t *ctx, oval_pd_t *pd, oval_pext_t *pext)
         return (0);
 }
 
+int oval_probe_ext_invalidate(SEAP_CTX_t *ctx, oval_pd_t *pd, oval_pext_t *pext, SEXP_t *ids)
+{
+	SEAP_cmd_exec(ctx, pd->sd, SEAP_EXEC_RECV, PROBECMD_INVALIDATE, ids, SEAP_CMDTYPE_SYNC, NULL, NULL);
+
+	return (0);
+}
+
 #include <signal.h>
 #include "SEAP/_seap-types.h"
 #include "SEAP/seap-descriptor.h"
@@ -41,6 +41,17 @@ typedef struct {
 	SEAP_CTX_t *ctx;
 } oval_pdtbl_t;
 
+/*
+ * Request sent to a probe by oval_probe_ext_eval_async() whose reply
+ * wasn't received yet. There's at most one such request per probe.
+ */
+typedef struct {
+	oval_pd_t           *pd;
+	SEAP_msgid_t         id;
+	struct oval_syschar *syschar;
+	bool                 waiting; /* the reply is being received */
+} oval_preq_t;
+
 struct oval_pext {
         pthread_mutex_t lock;
         bool            do_init;
@@ -48,6 +59,9 @@ struct oval_pext {
         SEAP_CTX_t   *sctx;
         oval_pdtbl_t *pdtbl;
 
+        oval_preq_t **preq;
+        size_t        preq_cnt;
+
         void *sess_ptr;
         struct oval_syschar_model **model;
 };
@@ -58,9 +72,39 @@ oval_pext_t *oval_pext_new(void);
 void oval_pext_free(oval_pext_t *pext);
 int oval_probe_ext_init(oval_pext_t *pext);
 int oval_probe_ext_eval(SEAP_CTX_t *ctx, oval_pd_t *pd, oval_pext_t *pext, struct oval_syschar *syschar, int flags);
+
+/**
+ * Send the object of the syschar to the probe without waiting for the reply.
+ * The probe collects the object while the caller continues with other work.
+ * @return 0 if the request was sent, 1 if the request can't be sent and
+ *         the object is left to be collected synchronously, 2 if the probe
+ *         is busy with another asynchronous request
+ */
+int oval_probe_ext_eval_async(SEAP_CTX_t *ctx, oval_pd_t *pd, oval_pext_t *pext, struct oval_syschar *syschar, int flags);
+
+/**
+ * Wait for the asynchronous request collecting the given syschar.
+ * @return 0 if the syschar was collected, 1 if there's no such request or
+ *         it failed and the syschar needs to be collected again, -1 on error
+ */
+int oval_probe_ext_wait(oval_pext_t *pext, struct oval_syschar *syschar);
+
+/**
+ * Wait for the oldest of the outstanding asynchronous requests.
+ * @param out_syschar the syschar of the finished request (optional)
+ * @return same as oval_probe_ext_wait(); 1 also if there's nothing to wait for
+ */
+int oval_probe_ext_wait_any(oval_pext_t *pext, struct oval_syschar **out_syschar);
 int oval_probe_ext_reset(SEAP_CTX_t *ctx, oval_pd_t *pd, oval_pext_t *pext);
 int oval_probe_ext_abort(SEAP_CTX_t *ctx, oval_pd_t *pd, oval_pext_t *pext);
 
+/**
+ * Drop the cached results of the given objects and the given states
+ * from the result cache of a probe.
+ * @param ids list of the object and state ids
+ */
+int oval_probe_ext_invalidate(SEAP_CTX_t *ctx, oval_pd_t *pd, oval_pext_t *pext, SEXP_t *ids);
+
 int oval_probe_ext_handler(oval_subtype_t type, void *ptr, int act, ...);
 int oval_probe_sys_handler(oval_subtype_t type, void *ptr, int act, ...);
 
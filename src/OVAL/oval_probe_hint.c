@@ -24,11 +24,16 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include "public/oval_definitions.h"
 #include "public/oval_system_characteristics.h"
 #include "oval_system_characteristics_impl.h"
 #include "oval_probe_impl.h"
 #include "_oval_probe_session.h"
+#include "collectVarRefs_impl.h"
+#include "adt/oval_string_map_impl.h"
+#include "common/debug_priv.h"
 
 static int _oval_probe_hint_criteria(oval_probe_session_t *sess, struct oval_criteria_node *cnode, int variable_instance_hint);
 static int _oval_probe_hint_object(oval_probe_session_t *psess, struct oval_object *object, int variable_instance_hint);
@@ -99,3 +104,99 @@ int _oval_probe_hint_object(oval_probe_session_t *psess, struct oval_object *obj
 	}
 	return 0;
 }
+
+static bool _oval_probe_hint_depends(struct oval_string_map *refs, struct oval_string_map *variables)
+{
+	bool depends = false;
+	struct oval_iterator *var_itr = oval_string_map_keys(variables);
+	while (!depends && oval_collection_iterator_has_more(var_itr)) {
+		const char *var_id = oval_collection_iterator_next(var_itr);
+		depends = oval_string_map_get_value(refs, var_id) != NULL;
+	}
+	oval_collection_iterator_free(var_itr);
+	return depends;
+}
+
+/**
+ * Finds all the objects, states and local variables whose values depend on
+ * any of the given variables, directly or through other local variables, set
+ * objects and filters. The collected objects thereof are marked with the
+ * variable_instance_hint (unless already marked by @ref oval_probe_hint_definition),
+ * the computed values of the local variables are dropped and the objects and
+ * states are removed from the result caches of the probes. Everything else
+ * collected so far stays cached for the next variable instance.
+ * @param variables map of the ids of the changed variables
+ * @returns 0 on success; -1 on error
+ */
+int oval_probe_hint_variables(oval_probe_session_t *sess, struct oval_string_map *variables)
+{
+	struct oval_definition_model *def_model = oval_syschar_model_get_definition_model(sess->sys_model);
+	SEXP_t *ids = SEXP_list_new(NULL);
+	int count = 0;
+
+	struct oval_object_iterator *obj_itr = oval_definition_model_get_objects(def_model);
+	while (oval_object_iterator_has_more(obj_itr)) {
+		struct oval_object *object = oval_object_iterator_next(obj_itr);
+		struct oval_string_map *refs = oval_string_map_new();
+		oval_obj_collect_var_refs(object, refs);
+		if (_oval_probe_hint_depends(refs, variables)) {
+			const char *oid = oval_object_get_id(object);
+			struct oval_syschar *syschar = oval_syschar_model_get_syschar(sess->sys_model, oid);
+			if (syschar != NULL) {
+				int instance = oval_syschar_get_variable_instance(syschar);
+				if (oval_syschar_get_variable_instance_hint(syschar) == instance)
+					oval_syschar_set_variable_instance_hint(syschar, instance + 1);
+			}
+			SEXP_t *id = SEXP_string_new(oid, strlen(oid));
+			SEXP_list_add(ids, id);
+			SEXP_free(id);
+			count++;
+		}
+		oval_string_map_free(refs, NULL);
+	}
+	oval_object_iterator_free(obj_itr);
+
+	struct oval_state_iterator *ste_itr = oval_definition_model_get_states(def_model);
+	while (oval_state_iterator_has_more(ste_itr)) {
+		struct oval_state *state = oval_state_iterator_next(ste_itr);
+		struct oval_string_map *refs = oval_string_map_new();
+		oval_ste_collect_var_refs(state, refs);
+		if (_oval_probe_hint_depends(refs, variables)) {
+			const char *sid = oval_state_get_id(state);
+			SEXP_t *id = SEXP_string_new(sid, strlen(sid));
+			SEXP_list_add(ids, id);
+			SEXP_free(id);
+			count++;
+		}
+		oval_string_map_free(refs, NULL);
+	}
+	oval_state_iterator_free(ste_itr);
+
+	struct oval_variable_iterator *var_itr = oval_definition_model_get_variables(def_model);
+	while (oval_variable_iterator_has_more(var_itr)) {
+		struct oval_variable *variable = oval_variable_iterator_next(var_itr);
+		if (oval_variable_get_type(variable) != OVAL_VARIABLE_LOCAL)
+			continue;
+		struct oval_string_map *refs = oval_string_map_new();
+		oval_var_collect_var_refs(variable, refs);
+		if (_oval_probe_hint_depends(refs, variables))
+			oval_variable_clear_values(variable);
+		oval_string_map_free(refs, NULL);
+	}
+	oval_variable_iterator_free(var_itr);
+
+	dI("Invalidating %d cached objects and states dependent on the changed variables.", count);
+
+	int ret = 0;
+	if (count > 0) {
+		oval_ph_t *ph = oval_probe_handler_get(sess->ph, OVAL_SUBTYPE_ALL);
+		if (ph == NULL) {
+			dE("No probe handler for OVAL_SUBTYPE_ALL");
+			ret = -1;
+		} else {
+			ret = ph->func(OVAL_SUBTYPE_ALL, ph->uptr, PROBE_HANDLER_ACT_INVALIDATE, ids);
+		}
+	}
+	SEXP_free(ids);
+	return ret;
+}
@@ -49,8 +49,24 @@
 
 #define OVAL_PROBE_MAXRETRY 0
 
+/*
+ * Internal flag of oval_probe_query_object(): send the object to the probe
+ * without waiting for the reply. Returns 2 if the probe is busy with another
+ * asynchronous request.
+ */
+#define OVAL_PDFLAG_ASYNC 0x0100
+
 int oval_probe_query_test(oval_probe_session_t *sess, struct oval_test *test);
 
+/**
+ * Collect the object of the test and compute the variables referenced by
+ * all of its states, so that the test can be evaluated by
+ * @ref oval_result_test_eval_collected without touching the session.
+ * @returns 0 if everything is resolved; 1 if the test has to be evaluated
+ * by @ref oval_result_test_eval; -1 on error
+ */
+int oval_probe_resolve_test(oval_probe_session_t *sess, struct oval_test *test);
+
 
 extern probe_ncache_t *OSCAP_GSYM(ncache);
 
@@ -62,7 +78,23 @@ typedef struct {
 void oval_probe_tblinit(void);
 const char *oval_subtype_to_str(oval_subtype_t subtype);
 
+/**
+ * Send the objects referenced by the tests of a definition to the probes
+ * asynchronously, so that objects of different types are collected at the
+ * same time. The replies are received by @ref oval_probe_query_object when
+ * the objects are queried, or by @ref oval_probe_prefetch_wait.
+ * @returns 0 on success; -1 on error
+ */
+int oval_probe_prefetch_definition(oval_probe_session_t *sess, struct oval_definition *definition);
+
+/**
+ * Receive the replies to all the outstanding asynchronous requests.
+ * @returns 0 on success; -1 on error
+ */
+int oval_probe_prefetch_wait(oval_probe_session_t *sess);
+
 int oval_probe_hint_definition(oval_probe_session_t *sess, struct oval_definition *definition, int variable_instance_hint);
+int oval_probe_hint_variables(oval_probe_session_t *sess, struct oval_string_map *variables);
 
 #endif /* OVAL_PROBE_IMPL_H */
 /// @}
@@ -48,6 +48,14 @@
 #include "oval_probe_ext.h"
 #include "probe-table.h"
 #include "oval_types.h"
+#if !defined(OS_WINDOWS)
+#include "probes/oval_fts_cache.h"
+#include "probes/oval_proc_snapshot.h"
+#endif
+#include "probes/oval_spill.h"
+#if defined(OPENSCAP_PROBE_LINUX_SYSTEMDUNITDEPENDENCY) || defined(OPENSCAP_PROBE_LINUX_SYSTEMDUNITPROPERTY)
+#include "probes/unix/linux/systemdcache.h"
+#endif
 
 #if defined(OSCAP_THREAD_SAFE)
 #include <pthread.h>
@@ -117,6 +125,25 @@ static void __init_once(void)
         return;
 }
 
+/**
+ * Forget the filesystem state cached by the file based probes, the
+ * process table snapshot of the process probes, the systemd units
+ * cached by the systemd probes and the segments of the spilled items.
+ * The caches are scoped to a scan, so they're dropped whenever a session
+ * starts, ends or is reset.
+ */
+static void oval_probe_session_drop_caches(void)
+{
+#if !defined(OS_WINDOWS)
+	oval_fts_cache_invalidate();
+	oval_proc_snapshot_invalidate();
+#endif
+	oval_spill_cleanup();
+#if defined(OPENSCAP_PROBE_LINUX_SYSTEMDUNITDEPENDENCY) || defined(OPENSCAP_PROBE_LINUX_SYSTEMDUNITPROPERTY)
+	systemd_cache_invalidate();
+#endif
+}
+
 static void oval_probe_session_init(oval_probe_session_t *sess, struct oval_syschar_model *model)
 {
         sess->ph = oval_phtbl_new();
@@ -127,6 +154,7 @@ static void oval_probe_session_init(oval_probe_session_t *sess, struct oval_sysc
         sess->pext->sess_ptr = sess;
 
         __init_once();
+	oval_probe_session_drop_caches();
 
 	oval_probe_handler_t *probe_handler;
 	int probe_count = probe_table_size();
@@ -159,6 +187,7 @@ static void oval_probe_session_free(oval_probe_session_t *sess)
 
 	oval_phtbl_free(sess->ph);
 	oval_pext_free(sess->pext);
+	oval_probe_session_drop_caches();
 }
 
 void oval_probe_session_reinit(oval_probe_session_t *sess, struct oval_syschar_model *model)
@@ -189,6 +218,8 @@ int oval_probe_session_reset(oval_probe_session_t *sess, struct oval_syschar_mod
         if (sysch != NULL)
                 sess->sys_model = sysch;
 
+	oval_probe_session_drop_caches();
+
         return(0);
 }
 
@@ -402,8 +402,14 @@ int oval_session_export(struct oval_session *session)
 	 * directives to them */
 	if (session->res_model && (session->export.results || session->export.report)) {
 		oval_results_model_set_export_system_characteristics(session->res_model, session->export_sys_chars);
-		result = oval_results_model_export_source(session->res_model, dir_model, NULL);
-		filename = session->export.results;
+		if (session->export.report || (session->validation && session->full_validation)) {
+			result = oval_results_model_export_source(session->res_model, dir_model, NULL);
+			filename = session->export.results;
+		} else {
+			/* Nothing else needs the document, it's written without being built whole */
+			if (oval_results_model_export(session->res_model, dir_model, session->export.results) != 0)
+				goto cleanup;
+		}
 	}
 
 	/* Validate OVAL Results. The 'result' in condition will make sure that there is
@@ -36,6 +36,7 @@
 #include <config.h>
 #endif
 
+#include <errno.h>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,6 +46,8 @@
 #include "oval_probe_impl.h"
 #include "oval_sexp.h"
 #include "probes/public/probe-api.h"
+#include "probes/oval_spill.h"
+#include "probes/probe/icache.h"
 #include "oval_definitions_impl.h"
 #include "oval_system_characteristics_impl.h"
 #include "adt/oval_string_map_impl.h"
@@ -1003,10 +1006,79 @@ static struct oval_sysitem *oval_sexp_to_sysitem(struct oval_syschar_model *mode
 	return sysitem;
 }
 
+static void oval_sexp_add_sysitem(struct oval_syschar *syschar, struct oval_syschar_model *model,
+                                  SEXP_t *item, struct oval_string_map *item_mask_map,
+                                  struct oval_string_map *itm_id_map)
+{
+	struct oval_sysitem *sysitem;
+
+	sysitem = oval_sexp_to_sysitem(model, item, item_mask_map);
+	if (sysitem != NULL) {
+		char *itm_id;
+
+		itm_id = oval_sysitem_get_id(sysitem);
+		if (oval_string_map_get_value(itm_id_map, itm_id) == NULL) {
+			oval_string_map_put(itm_id_map, itm_id, itm_id);
+			oval_syschar_add_sysitem(syschar, sysitem);
+		}
+	}
+}
+
+static void oval_sexp_set_incomplete(struct oval_syschar *syschar, char *text)
+{
+	struct oval_message *omsg;
+
+	omsg = oval_message_new();
+	oval_message_set_level(omsg, OVAL_MESSAGE_LEVEL_WARNING);
+	oval_message_set_text(omsg, text);
+	oval_syschar_add_message(syschar, omsg);
+	oval_syschar_set_flag(syschar, SYSCHAR_FLAG_INCOMPLETE);
+}
+
+/*
+ * Read the items which the probe spilled to a segment file. The items
+ * are converted one by one, so the whole collected object is never in
+ * memory as S-expressions. The converted items stay in the syschar model
+ * though, so the reading stops when the memory limits of the collected
+ * items are reached and the object is flagged as incomplete then.
+ */
+static void oval_sexp_read_spill(const SEXP_t *spill, struct oval_syschar *syschar, struct oval_syschar_model *model,
+                                 struct oval_string_map *item_mask_map, struct oval_string_map *itm_id_map)
+{
+	OVAL_SPILL_READER *reader;
+	SEXP_t *item;
+	char *path;
+	size_t count = 0;
+	int ret;
+
+	path = SEXP_string_cstr(spill);
+	reader = oval_spill_reader_open(path);
+
+	if (reader == NULL) {
+		dE("Can't open the spill segment \"%s\": %s", path, strerror(errno));
+		ret = -1;
+	} else {
+		while ((ret = oval_spill_reader_next(reader, &item)) > 0) {
+			oval_sexp_add_sysitem(syschar, model, item, item_mask_map, itm_id_map);
+			SEXP_free(item);
+
+			if (++count % OVAL_SPILL_READ_INTERVAL == 0 && probe_icache_memcheck() != 0) {
+				oval_sexp_set_incomplete(syschar, "Object is incomplete due to memory constraints.");
+				break;
+			}
+		}
+		oval_spill_reader_close(reader);
+	}
+
+	if (ret < 0)
+		oval_sexp_set_incomplete(syschar, "Object is incomplete, the spilled items can't be read.");
+	free(path);
+}
+
 int oval_sexp_to_sysch(const SEXP_t *cobj, struct oval_syschar *syschar)
 {
 	oval_syschar_collection_flag_t flag;
-	SEXP_t *messages, *msg, *items, *item, *mask;
+	SEXP_t *messages, *msg, *items, *item, *mask, *spill;
 	struct oval_syschar_model *model;
 	struct oval_string_map *itm_id_map;
         struct oval_string_map *item_mask_map;
@@ -1044,20 +1116,15 @@ int oval_sexp_to_sysch(const SEXP_t *cobj, struct oval_syschar *syschar)
             item_mask_map = NULL;
 
 	SEXP_list_foreach(item, items) {
-		struct oval_sysitem *sysitem;
-
-		sysitem = oval_sexp_to_sysitem(model, item, item_mask_map);
-		if (sysitem != NULL) {
-			char *itm_id;
-
-			itm_id = oval_sysitem_get_id(sysitem);
-			if (oval_string_map_get_value(itm_id_map, itm_id) == NULL) {
-				oval_string_map_put(itm_id_map, itm_id, itm_id);
-				oval_syschar_add_sysitem(syschar, sysitem);
-			}
-		}
+		oval_sexp_add_sysitem(syschar, model, item, item_mask_map, itm_id_map);
 	}
 	SEXP_free(items);
+
+	spill = probe_cobj_get_spill(cobj);
+	if (spill != NULL) {
+		oval_sexp_read_spill(spill, syschar, model, item_mask_map, itm_id_map);
+		SEXP_free(spill);
+	}
 	oval_string_map_free(itm_id_map, NULL);
         if (item_mask_map != NULL)
             oval_string_map_free_string(item_mask_map);
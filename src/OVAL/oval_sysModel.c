@@ -306,7 +306,8 @@ struct oval_sysitem *oval_syschar_model_get_new_sysitem(struct oval_syschar_mode
 }
 
 xmlNode *oval_syschar_model_to_dom(struct oval_syschar_model * syschar_model, xmlDocPtr doc, xmlNode * parent, 
-			           oval_syschar_resolver resolver, void *user_arg, bool export_syschar)
+			           oval_syschar_resolver resolver, void *user_arg, bool export_syschar,
+				   struct oscap_xml_stream *stream)
 {
 
 	xmlNodePtr root_node = NULL;
@@ -338,8 +339,10 @@ xmlNode *oval_syschar_model_to_dom(struct oval_syschar_model * syschar_model, xm
 
         /* Report sysinfo */
 	oval_sysinfo_to_dom(oval_syschar_model_get_sysinfo(syschar_model), doc, root_node);
+	oscap_xml_stream_start_element(stream, root_node);
 
 	if (!export_syschar) {
+		oscap_xml_stream_end_element(stream);
 		return root_node;
 	}
 
@@ -360,6 +363,7 @@ xmlNode *oval_syschar_model_to_dom(struct oval_syschar_model * syschar_model, xm
 	struct oval_string_map *sysitem_map = oval_string_map_new();
 	if (oval_syschar_iterator_has_more(syschars)) {
 		xmlNode *tag_objects = xmlNewTextChild(root_node, ns_syschar, BAD_CAST "collected_objects", NULL);
+		oscap_xml_stream_start_element(stream, tag_objects);
 
 		while (oval_syschar_iterator_has_more(syschars)) {
 			struct oval_syschar *syschar = oval_syschar_iterator_next(syschars);
@@ -374,7 +378,9 @@ xmlNode *oval_syschar_model_to_dom(struct oval_syschar_model * syschar_model, xm
 				oval_string_map_put(sysitem_map, oval_sysitem_get_id(sysitem), sysitem);
 			}
 			oval_sysitem_iterator_free(sysitems);
+			oscap_xml_stream_flush(stream);
 		}
+		oscap_xml_stream_end_element(stream);
 	}
 	oval_smc_free0(resolved_smc);
 	oval_syschar_iterator_free(syschars);
@@ -382,15 +388,19 @@ xmlNode *oval_syschar_model_to_dom(struct oval_syschar_model * syschar_model, xm
 	struct oval_iterator *sysitems = oval_string_map_values(sysitem_map);
 	if (oval_collection_iterator_has_more(sysitems)) {
 		xmlNode *tag_items = xmlNewTextChild(root_node, ns_syschar, BAD_CAST "system_data", NULL);
+		oscap_xml_stream_start_element(stream, tag_items);
 		while (oval_collection_iterator_has_more(sysitems)) {
 			struct oval_sysitem *sysitem = (struct oval_sysitem *)
 			    oval_collection_iterator_next(sysitems);
 			oval_sysitem_to_dom(sysitem, doc, tag_items);
+			oscap_xml_stream_flush(stream);
 		}
+		oscap_xml_stream_end_element(stream);
 	}
 	oval_collection_iterator_free(sysitems);
 	oval_string_map_free(sysitem_map, NULL);
 
+	oscap_xml_stream_end_element(stream);
 	return root_node;
 }
 
@@ -407,7 +417,14 @@ int oval_syschar_model_export(struct oval_syschar_model *model, const char *file
 		return -1;
 	}
 
-	oval_syschar_model_to_dom(model, doc, NULL, NULL, NULL, true);
-	return oscap_xml_save_filename_free(file, doc);
+	/* The items are written as they're converted, the document is never complete */
+	struct oscap_xml_stream *stream = oscap_xml_stream_new(file);
+	if (stream == NULL) {
+		xmlFreeDoc(doc);
+		return -1;
+	}
+	oval_syschar_model_to_dom(model, doc, NULL, NULL, NULL, true, stream);
+	xmlFreeDoc(doc);
+	return oscap_xml_stream_close(stream);
 }
 
@@ -872,11 +872,6 @@ void oval_variable_clear_values(struct oval_variable *variable)
 {
 	__attribute__nonnull__(variable);
 
-	if (variable->type != OVAL_VARIABLE_CONSTANT && variable->type != OVAL_VARIABLE_EXTERNAL) {
-		dW("Wrong variable type for this operation: %d.", variable->type);
-		return;
-        }
-
 	switch (variable->type) {
 	case OVAL_VARIABLE_CONSTANT: {
 		oval_variable_CONSTANT_t *cvar;
@@ -899,7 +894,21 @@ void oval_variable_clear_values(struct oval_variable *variable)
 
 		break;
 	}
+	case OVAL_VARIABLE_LOCAL: {
+		oval_variable_LOCAL_t *lvar;
+
+		/* The values are computed again by the next query */
+		lvar = (oval_variable_LOCAL_t *) variable;
+		if (lvar->values) {
+			oval_collection_free_items(lvar->values, (oscap_destruct_func) oval_value_free);
+			lvar->values = NULL;
+		}
+		lvar->flag = SYSCHAR_FLAG_UNKNOWN;
+
+		break;
+	}
 	default:
+		dW("Wrong variable type for this operation: %d.", variable->type);
 		break;
 	}
 }
@@ -39,6 +39,7 @@ typedef uint8_t SEXP_valtype_t;
 #define SEXP_VALTYPE_LIST   3
 
 typedef struct {
+        uint64_t hash; /* hash of a string value, 0 until SEXP_rawval_string_hash() computes it */
         uint32_t refs;
         size_t   size;
 } __attribute__ ((packed)) SEXP_valhdr_t;
@@ -56,9 +57,23 @@ typedef struct {
 #define SEXP_VALP_HDR(p) ((SEXP_valhdr_t *)(((uintptr_t)(p)) & SEXP_VALP_MASK))
 
 int       SEXP_val_new (SEXP_val_t *dst, size_t vmemsize, SEXP_valtype_t type);
+void      SEXP_val_free (SEXP_val_t *dsc);
 void      SEXP_val_dsc (SEXP_val_t *dst, uintptr_t ptr);
 uintptr_t SEXP_val_ptr (SEXP_val_t *dsc);
 
+/*
+ * The hash of a string value is computed on the first call and kept in
+ * the value header, strings aren't modified once they are created. Lists
+ * don't have a cached hash because their members can be changed in place
+ * through soft references (SEXP_listref_*) without the list knowing it.
+ * The hash is only cached if the header is aligned enough for the 64-bit
+ * field to be written at once, threads which race to compute the hash
+ * store the same value.
+ */
+#define SEXP_VALHDR_HASH_CACHED (SEXP_VALP_ALIGN >= sizeof(uint64_t))
+
+uint64_t  SEXP_rawval_string_hash (SEXP_val_t *dsc);
+
 uintptr_t SEXP_rawval_incref (uintptr_t valp);
 int       SEXP_rawval_decref (uintptr_t valp);
 
@@ -118,6 +133,7 @@ void      SEXP_rawval_lblk_free1 (uintptr_t lblkp, void (*func) (SEXP_t *));
 #define SEXP_LBLK_ALIGN (16 > sizeof(void *) ? 16 : sizeof(void *))
 #define SEXP_LBLKP_MASK (UINTPTR_MAX << 4)
 #define SEXP_LBLKS_MASK 0x0f
+#define SEXP_LBLK_SIZE(sz) (sizeof(uintptr_t) + (2 * sizeof(uint16_t)) + (sizeof(SEXP_t) * (1 << (sz))))
 
 #define SEXP_VALP_LBLK(valp) ((struct SEXP_val_lblk *)((uintptr_t)(valp) & SEXP_LBLKP_MASK))
 
@@ -239,6 +239,7 @@ int rbt_i32_del(rbt_t *rbt, int32_t key, void **n)
         }
 
 	if (rbt_node_ptr(rbt->root) == NULL) {
+		rbt_wunlock(rbt);
 		return -1;
 	}
 
@@ -348,6 +349,13 @@ int rbt_i32_del(rbt_t *rbt, int32_t key, void **n)
                  */
 		if (rbt_node_ptr(fake._chld[RBT_NODE_SR]) != h[0]
 				&& rbt_node_getcolor(h[0]) != RBT_NODE_CR) {
+			/*
+			 * The tree might have been rotated already, keep the
+			 * new root.
+			 */
+			rbt->root = fake._chld[RBT_NODE_SR];
+			rbt_node_setcolor(rbt->root, RBT_NODE_CB);
+			rbt_wunlock(rbt);
 			return -1;
 		}
                 if (n != NULL)
@@ -0,0 +1,223 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "spsc_ring.h"
+
+#define ring_load_acquire(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ring_load_relaxed(p)     __atomic_load_n((p), __ATOMIC_RELAXED)
+#define ring_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define ring_store_relaxed(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define ring_exchange(p, v)      __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#define ring_fence()             __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#if defined(__x86_64__) || defined(__i386__)
+# define ring_relax() __builtin_ia32_pause()
+#else
+# define ring_relax() __atomic_signal_fence(__ATOMIC_SEQ_CST)
+#endif
+
+static spsc_ring_seg_t *spsc_ring_seg_new(spsc_ring_t *ring)
+{
+        spsc_ring_seg_t *seg;
+
+        /* Reuse the segment drained by the consumer, if there's one */
+        seg = ring != NULL ? ring_exchange(&ring->spare, NULL) : NULL;
+
+        if (seg == NULL) {
+                seg = malloc(sizeof(spsc_ring_seg_t));
+
+                if (seg == NULL)
+                        return (NULL);
+        }
+
+        seg->next = NULL;
+        seg->tail = 0;
+
+        return (seg);
+}
+
+spsc_ring_t *spsc_ring_new(void)
+{
+        spsc_ring_t *ring;
+
+        if (posix_memalign((void **)&ring, 64, sizeof(spsc_ring_t)) != 0)
+                return (NULL);
+
+        ring->head_seg = spsc_ring_seg_new(NULL);
+
+        if (ring->head_seg == NULL) {
+                free(ring);
+                return (NULL);
+        }
+
+        ring->head     = 0;
+        ring->spin     = SPSC_RING_SPIN_MIN;
+        ring->waiting  = 0;
+        ring->tail_seg = ring->head_seg;
+        ring->spare    = NULL;
+
+        pthread_mutex_init(&ring->wait_mutex, NULL);
+        pthread_cond_init(&ring->wait_cond, NULL);
+
+        return (ring);
+}
+
+int spsc_ring_push(spsc_ring_t *ring, void *ptr)
+{
+        spsc_ring_seg_t *seg = ring->tail_seg;
+        uint32_t tail = seg->tail;
+
+        if (tail < SPSC_RING_SEGSIZE) {
+                seg->slot[tail] = ptr;
+                ring_store_release(&seg->tail, tail + 1);
+        } else {
+                spsc_ring_seg_t *next = spsc_ring_seg_new(ring);
+
+                if (next == NULL)
+                        return (-1);
+
+                next->slot[0] = ptr;
+                next->tail    = 1;
+
+                ring_store_release(&seg->next, next);
+                ring->tail_seg = next;
+        }
+
+        /*
+         * Pairs with the fence in spsc_ring_pop(): either the consumer
+         * sees the new pointer or we see that it's going to sleep.
+         */
+        ring_fence();
+
+        if (ring_load_relaxed(&ring->waiting)) {
+                pthread_mutex_lock(&ring->wait_mutex);
+                ring_store_relaxed(&ring->waiting, 0);
+                pthread_cond_signal(&ring->wait_cond);
+                pthread_mutex_unlock(&ring->wait_mutex);
+        }
+
+        return (0);
+}
+
+void *spsc_ring_trypop(spsc_ring_t *ring)
+{
+        spsc_ring_seg_t *seg = ring->head_seg;
+        spsc_ring_seg_t *next, *old;
+
+        for (;;) {
+                if (ring->head < ring_load_acquire(&seg->tail))
+                        return (seg->slot[ring->head++]);
+
+                if (ring->head < SPSC_RING_SEGSIZE)
+                        return (NULL);
+
+                /* The segment is drained, move on to the next one */
+                next = ring_load_acquire(&seg->next);
+
+                if (next == NULL)
+                        return (NULL);
+
+                ring->head_seg = next;
+                ring->head     = 0;
+
+                old = ring_exchange(&ring->spare, seg);
+                free(old);
+
+                seg = next;
+        }
+}
+
+static void spsc_ring_unlock(void *mutex)
+{
+        pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+void *spsc_ring_pop(spsc_ring_t *ring)
+{
+        void *ptr;
+        uint32_t i;
+
+        if ((ptr = spsc_ring_trypop(ring)) != NULL)
+                return (ptr);
+
+        for (i = 0; i < ring->spin; ++i) {
+                ring_relax();
+
+                if ((ptr = spsc_ring_trypop(ring)) != NULL) {
+                        if (ring->spin < SPSC_RING_SPIN_MAX)
+                                ring->spin *= 2;
+
+                        return (ptr);
+                }
+        }
+
+        /* Polling didn't pay off this time */
+        if (ring->spin > SPSC_RING_SPIN_MIN)
+                ring->spin /= 2;
+
+        pthread_mutex_lock(&ring->wait_mutex);
+        pthread_cleanup_push(spsc_ring_unlock, &ring->wait_mutex);
+
+        for (;;) {
+                ring_store_relaxed(&ring->waiting, 1);
+                ring_fence();
+
+                if ((ptr = spsc_ring_trypop(ring)) != NULL)
+                        break;
+
+                pthread_cond_wait(&ring->wait_cond, &ring->wait_mutex);
+        }
+
+        ring_store_relaxed(&ring->waiting, 0);
+        pthread_cleanup_pop(1);
+
+        return (ptr);
+}
+
+void spsc_ring_free(spsc_ring_t *ring, void (*destructor)(void *))
+{
+        spsc_ring_seg_t *seg, *next;
+        void *ptr;
+
+        if (ring == NULL)
+                return;
+
+        while ((ptr = spsc_ring_trypop(ring)) != NULL) {
+                if (destructor != NULL)
+                        destructor(ptr);
+        }
+
+        for (seg = ring->head_seg; seg != NULL; seg = next) {
+                next = seg->next;
+                free(seg);
+        }
+
+        free(ring->spare);
+
+        pthread_mutex_destroy(&ring->wait_mutex);
+        pthread_cond_destroy(&ring->wait_cond);
+        free(ring);
+}
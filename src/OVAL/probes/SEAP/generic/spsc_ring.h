@@ -0,0 +1,95 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#pragma once
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * Lock-free single-producer/single-consumer queue of pointers.
+ *
+ * The queue is a chain of fixed size segments. The producer fills the
+ * last segment and links a new one when it's full, so pushing never
+ * blocks. The consumer hands the segments it has drained back to the
+ * producer for reuse. There may be more producer (consumer) threads as
+ * long as they are serialized by the caller.
+ *
+ * An empty queue is polled for a while by the consumer before it goes to
+ * sleep. The number of polls adapts to how often the polling succeeds.
+ */
+
+#define SPSC_RING_SEGSIZE     254  /* slots per segment */
+#define SPSC_RING_SPIN_MIN    64   /* polls of an empty queue before sleeping */
+#define SPSC_RING_SPIN_MAX    16384
+
+typedef struct spsc_ring_seg {
+        struct spsc_ring_seg *next;
+        uint32_t              tail; /* slots filled by the producer */
+        void                 *slot[SPSC_RING_SEGSIZE];
+} spsc_ring_seg_t;
+
+typedef struct {
+        /* consumer side */
+        spsc_ring_seg_t *head_seg;
+        uint32_t         head;
+        uint32_t         spin;
+        uint32_t         waiting;
+
+        /* producer side, kept apart from the consumer side */
+        spsc_ring_seg_t *tail_seg __attribute__((aligned(64)));
+        spsc_ring_seg_t *spare;
+
+        pthread_mutex_t  wait_mutex __attribute__((aligned(64)));
+        pthread_cond_t   wait_cond;
+} spsc_ring_t;
+
+/**
+ * Create an empty queue.
+ * @return the queue or NULL if there's not enough memory
+ */
+spsc_ring_t *spsc_ring_new(void);
+
+/**
+ * Append the pointer at the end of the queue. NULL can't be queued.
+ * @return 0 on success, -1 if there's not enough memory
+ */
+int spsc_ring_push(spsc_ring_t *ring, void *ptr);
+
+/**
+ * Remove the pointer from the beginning of the queue, wait for one if the
+ * queue is empty. The function is a cancellation point.
+ */
+void *spsc_ring_pop(spsc_ring_t *ring);
+
+/**
+ * Remove the pointer from the beginning of the queue.
+ * @return the pointer or NULL if the queue is empty
+ */
+void *spsc_ring_trypop(spsc_ring_t *ring);
+
+/**
+ * Free the queue. The destructor, if not NULL, is called for every
+ * pointer left in the queue.
+ */
+void spsc_ring_free(spsc_ring_t *ring, void (*destructor)(void *));
+
+#endif /* SPSC_RING_H */
@@ -537,6 +537,13 @@ OSCAP_API bool SEXP_deepcmp(const SEXP_t *a, const SEXP_t *b);
  */
 OSCAP_API void     SEXP_free (SEXP_t *s_exp);
 
+/**
+ * Get the number of bytes held by the values of all the sexp objects in
+ * the process. The counter is maintained by the allocator, so it's cheap
+ * to query it for every new object.
+ */
+OSCAP_API size_t   SEXP_memusage (void);
+
 /**
  * Get the user data type of a sexp object.
  * @param s_exp the object to be queried
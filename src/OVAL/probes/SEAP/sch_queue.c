@@ -25,6 +25,8 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 
 #include "_sexp-types.h"
 #include "_seap-types.h"
@@ -35,19 +37,65 @@
 #include "oval_definitions.h"
 
 
+SEAP_scheme_t sch_queue_default_scheme(void)
+{
+	const char *str = getenv("OSCAP_SEAP_SCHEME");
+
+	if (str != NULL && strcmp(str, "ring") == 0)
+		return SCH_RING;
+	if (str != NULL && strcmp(str, "queue") != 0)
+		dW("Unknown SEAP scheme \"%s\", using \"queue\".", str);
+
+	return SCH_QUEUE;
+}
+
+/*
+ * The library and the probes run in the same process, so the packets are
+ * passed between them as they are. Converting them to S-expressions and
+ * back is useful only for debugging, the converted packets are logged.
+ */
+static bool sch_queue_default_serialize(void)
+{
+	const char *str = getenv("OSCAP_SEAP_SERIALIZE");
+
+	return str != NULL && strcmp(str, "1") == 0;
+}
+
 int sch_queue_connect(SEAP_desc_t *desc)
 {
 	sch_queuedata_t *data = malloc(sizeof(sch_queuedata_t));
 
-	data->from_probe_queue = oscap_queue_new();
-	data->from_probe_cnt = 0;
-	pthread_cond_init(&data->from_probe_cond, NULL);
-	pthread_mutex_init(&data->from_probe_mutex, NULL);
+	data->scheme = desc->scheme;
+	data->serialize = sch_queue_default_serialize();
+
+	if (data->scheme == SCH_RING) {
+		data->to_probe_ring = spsc_ring_new();
+		data->from_probe_ring = spsc_ring_new();
 
-	data->to_probe_queue = oscap_queue_new();
-	data->to_probe_cnt = 0;
-	pthread_cond_init(&data->to_probe_cond, NULL);
-	pthread_mutex_init(&data->to_probe_mutex, NULL);
+		if (data->to_probe_ring == NULL || data->from_probe_ring == NULL) {
+			dE("Cannot allocate the probe rings");
+			spsc_ring_free(data->to_probe_ring, NULL);
+			spsc_ring_free(data->from_probe_ring, NULL);
+			free(data);
+			return -1;
+		}
+
+		data->to_probe_queue = NULL;
+		data->from_probe_queue = NULL;
+	} else {
+		data->to_probe_ring = NULL;
+		data->from_probe_ring = NULL;
+
+		data->from_probe_queue = oscap_queue_new();
+		data->from_probe_cnt = 0;
+		pthread_cond_init(&data->from_probe_cond, NULL);
+		pthread_mutex_init(&data->from_probe_mutex, NULL);
+
+		data->to_probe_queue = oscap_queue_new();
+		data->to_probe_cnt = 0;
+		pthread_cond_init(&data->to_probe_cond, NULL);
+		pthread_mutex_init(&data->to_probe_mutex, NULL);
+	}
 
 	data->parent_thread_id = pthread_self();
 
@@ -68,13 +116,20 @@ int sch_queue_connect(SEAP_desc_t *desc)
 	return 0;
 }
 
-SEXP_t *sch_queue_recvsexp(SEAP_desc_t *desc)
+static void *sch_queue_pop(SEAP_desc_t *desc)
 {
 	sch_queuedata_t *data = (sch_queuedata_t *)desc->scheme_data;
 	struct oscap_queue *queue;
 	pthread_mutex_t *mutex;
 	pthread_cond_t *cond;
 	int *cnt;
+	if (data->scheme == SCH_RING) {
+		/* Readers are serialized by the descriptor read lock */
+		if (pthread_equal(pthread_self(), data->parent_thread_id))
+			return spsc_ring_pop(data->from_probe_ring);
+		else
+			return spsc_ring_pop(data->to_probe_ring);
+	}
 	if (pthread_equal(pthread_self(), data->parent_thread_id)) {
 		queue = data->from_probe_queue;
 		mutex = &data->from_probe_mutex;
@@ -90,19 +145,30 @@ SEXP_t *sch_queue_recvsexp(SEAP_desc_t *desc)
 	while (*cnt == 0) {
 		pthread_cond_wait(cond, mutex);
 	}
-	SEXP_t *sexp = oscap_queue_remove(queue);
+	void *item = oscap_queue_remove(queue);
 	(*cnt)--;
 	pthread_mutex_unlock(mutex);
-	return sexp;
+	return item;
 }
 
-ssize_t sch_queue_sendsexp(SEAP_desc_t *desc, SEXP_t *sexp, uint32_t flags)
+static int sch_queue_push(SEAP_desc_t *desc, void *item)
 {
 	sch_queuedata_t *data = (sch_queuedata_t *) desc->scheme_data;
 	struct oscap_queue *queue;
 	pthread_mutex_t *mutex;
 	pthread_cond_t *cond;
 	int *cnt;
+	if (data->scheme == SCH_RING) {
+		/* Writers are serialized by the descriptor write lock */
+		spsc_ring_t *ring = pthread_equal(pthread_self(), data->parent_thread_id) ?
+			data->to_probe_ring : data->from_probe_ring;
+
+		if (spsc_ring_push(ring, item) != 0) {
+			errno = ENOMEM;
+			return -1;
+		}
+		return 0;
+	}
 	if (pthread_equal(pthread_self(), data->parent_thread_id)) {
 		queue = data->to_probe_queue;
 		mutex = &data->to_probe_mutex;
@@ -114,16 +180,47 @@ ssize_t sch_queue_sendsexp(SEAP_desc_t *desc, SEXP_t *sexp, uint32_t flags)
 		cond = &data->from_probe_cond;
 		cnt = &data->from_probe_cnt;
 	}
-	/* We want to send a SEXP, but the receiver expects a list of SEXPs. */
-	SEXP_t *sexp_list = SEXP_list_new(sexp, NULL);
 	pthread_mutex_lock(mutex);
-	oscap_queue_add(queue, (void *) sexp_list);
+	oscap_queue_add(queue, item);
 	(*cnt)++;
 	pthread_cond_broadcast(cond);
 	pthread_mutex_unlock(mutex);
 	return 0;
 }
 
+SEXP_t *sch_queue_recvsexp(SEAP_desc_t *desc)
+{
+	return (SEXP_t *) sch_queue_pop(desc);
+}
+
+ssize_t sch_queue_sendsexp(SEAP_desc_t *desc, SEXP_t *sexp, uint32_t flags)
+{
+	/* We want to send a SEXP, but the receiver expects a list of SEXPs. */
+	SEXP_t *sexp_list = SEXP_list_new(sexp, NULL);
+
+	if (sch_queue_push(desc, (void *) sexp_list) != 0) {
+		SEXP_free(sexp_list);
+		return -1;
+	}
+	return 0;
+}
+
+bool sch_queue_serialize(SEAP_desc_t *desc)
+{
+	sch_queuedata_t *data = (sch_queuedata_t *) desc->scheme_data;
+	return data->serialize;
+}
+
+SEAP_packet_t *sch_queue_recvpacket(SEAP_desc_t *desc)
+{
+	return (SEAP_packet_t *) sch_queue_pop(desc);
+}
+
+int sch_queue_sendpacket(SEAP_desc_t *desc, SEAP_packet_t *packet)
+{
+	return sch_queue_push(desc, (void *) packet);
+}
+
 int sch_queue_close(SEAP_desc_t *desc, uint32_t flags)
 {
 	int ret = 0;
@@ -138,7 +235,12 @@ int sch_queue_close(SEAP_desc_t *desc, uint32_t flags)
 	if (ret != 0) {
 		dE("Return code of %s_probe main thread is %d.", subtype_str, ret);
 	}
-	oscap_queue_free(data->to_probe_queue, NULL);
-	oscap_queue_free(data->from_probe_queue, NULL);
+	if (data->scheme == SCH_RING) {
+		spsc_ring_free(data->to_probe_ring, NULL);
+		spsc_ring_free(data->from_probe_ring, NULL);
+	} else {
+		oscap_queue_free(data->to_probe_queue, NULL);
+		oscap_queue_free(data->from_probe_queue, NULL);
+	}
 	return ret;
 }
@@ -23,11 +23,26 @@
 #ifndef OPENSCAP_SCH_QUEUE_H
 #define OPENSCAP_SCH_QUEUE_H
 
+#include <stdbool.h>
 #include "util.h"
 #include "oscap_queue.h"
 #include "seap-descriptor.h"
+#include "public/seap-packet.h"
+#include "generic/spsc_ring.h"
+
+/*
+ * SEAP schemes used between the library and the probe threads:
+ * SCH_QUEUE passes the messages through mutex protected queues,
+ * SCH_RING through lock-free single-producer/single-consumer rings.
+ * The scheme is selected by the OSCAP_SEAP_SCHEME environment variable
+ * ("queue" or "ring"), SCH_QUEUE is the default.
+ */
+#define SCH_QUEUE 4
+#define SCH_RING  5
 
 typedef struct {
+	SEAP_scheme_t scheme;
+	bool serialize; ///< pass the packets as S-expressions
 	pthread_t probe_thread_id;
 	pthread_t parent_thread_id;
 	struct oscap_queue *to_probe_queue;
@@ -38,11 +53,22 @@ typedef struct {
 	pthread_mutex_t from_probe_mutex;
 	int to_probe_cnt;
 	int from_probe_cnt;
+	spsc_ring_t *to_probe_ring;
+	spsc_ring_t *from_probe_ring;
 } sch_queuedata_t;
 
+SEAP_scheme_t sch_queue_default_scheme(void);
+
 int sch_queue_connect(SEAP_desc_t *desc);
 ssize_t sch_queue_sendsexp(SEAP_desc_t *desc, SEXP_t *sexp, uint32_t flags);
 SEXP_t *sch_queue_recvsexp(SEAP_desc_t *desc);
 int sch_queue_close(SEAP_desc_t *desc, uint32_t flags);
 
+/*
+ * Direct packet passing, the receiver takes over the packet.
+ */
+bool sch_queue_serialize(SEAP_desc_t *desc);
+int sch_queue_sendpacket(SEAP_desc_t *desc, SEAP_packet_t *packet);
+SEAP_packet_t *sch_queue_recvpacket(SEAP_desc_t *desc);
+
 #endif /* OPENSCAP_SCH_QUEUE_H */
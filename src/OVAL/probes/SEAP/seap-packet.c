@@ -599,6 +599,91 @@ static SEXP_t *SEAP_packet2sexp (SEAP_packet_t *packet)
         return (sexp);
 }
 
+/*
+ * Copy the packet for the receiver in the same process. The copy looks
+ * like the packet obtained by converting it to an S-expression and back:
+ * the S-expressions are shared, message data are never NULL and only the
+ * command flags carried by the S-expression are kept.
+ */
+static SEAP_packet_t *SEAP_packet_clone (SEAP_packet_t *packet)
+{
+        SEAP_packet_t *clone;
+        uint16_t i;
+
+        clone = SEAP_packet_new ();
+        clone->type = packet->type;
+
+        switch (packet->type) {
+        case SEAP_PACKET_MSG:
+        {
+                SEAP_msg_t *src = SEAP_packet_msg (packet);
+                SEAP_msg_t *dst = SEAP_packet_msg (clone);
+
+                dst->id        = src->id;
+                dst->attrs_cnt = src->attrs_cnt;
+                dst->attrs     = malloc (sizeof (SEAP_attr_t) * src->attrs_cnt);
+
+                for (i = 0; i < src->attrs_cnt; ++i) {
+                        dst->attrs[i].name  = strdup (src->attrs[i].name);
+                        dst->attrs[i].value = src->attrs[i].value != NULL ?
+                                SEXP_ref (src->attrs[i].value) : NULL;
+                }
+
+                dst->sexp = src->sexp != NULL ? SEXP_ref (src->sexp) : SEXP_list_new (NULL);
+                break;
+        }
+        case SEAP_PACKET_CMD:
+        {
+                SEAP_cmd_t *src = SEAP_packet_cmd (packet);
+                SEAP_cmd_t *dst = SEAP_packet_cmd (clone);
+
+                memcpy (dst, src, sizeof (SEAP_cmd_t));
+                dst->flags &= (SEAP_CMDFLAG_REPLY | SEAP_CMDFLAG_SYNC);
+                dst->args   = src->args != NULL ? SEXP_ref (src->args) : NULL;
+                break;
+        }
+        case SEAP_PACKET_ERR:
+        {
+                SEAP_err_t *src = SEAP_packet_err (packet);
+                SEAP_err_t *dst = SEAP_packet_err (clone);
+
+                memcpy (dst, src, sizeof (SEAP_err_t));
+                dst->data = src->data != NULL ? SEXP_ref (src->data) : NULL;
+                break;
+        }
+        default:
+                SEAP_packet_free (clone);
+                errno = EINVAL;
+                return (NULL);
+        }
+
+        return (clone);
+}
+
+static void SEAP_packet_clone_free (SEAP_packet_t *clone)
+{
+        uint16_t i;
+
+        switch (clone->type) {
+        case SEAP_PACKET_MSG:
+                for (i = 0; i < clone->data.msg.attrs_cnt; ++i) {
+                        free (clone->data.msg.attrs[i].name);
+                        SEXP_free (clone->data.msg.attrs[i].value);
+                }
+                free (clone->data.msg.attrs);
+                SEXP_free (clone->data.msg.sexp);
+                break;
+        case SEAP_PACKET_CMD:
+                SEXP_free (clone->data.cmd.args);
+                break;
+        case SEAP_PACKET_ERR:
+                SEXP_free (clone->data.err.data);
+                break;
+        }
+
+        SEAP_packet_free (clone);
+}
+
 int SEAP_packet_recv (SEAP_CTX_t *ctx, int sd, SEAP_packet_t **packet)
 {
         SEAP_desc_t *dsc;
@@ -661,6 +746,11 @@ int SEAP_packet_recv (SEAP_CTX_t *ctx, int sd, SEAP_packet_t **packet)
         }
 eloop_exit:
 
+	if (!sch_queue_serialize(dsc)) {
+		*packet = sch_queue_recvpacket(dsc);
+		return (0);
+	}
+
 	sexp_buffer = sch_queue_recvsexp(dsc);
 	SEXP_VALIDATE(sexp_buffer);
 
@@ -857,6 +947,35 @@ int SEAP_packet_send (SEAP_CTX_t *ctx, int sd, SEAP_packet_t *packet)
         if (dsc == NULL)
                 return (-1);
 
+        if (!sch_queue_serialize(dsc)) {
+                SEAP_packet_t *clone = SEAP_packet_clone (packet);
+
+                if (clone == NULL)
+                        return (-1);
+
+                if (DESC_WLOCK (dsc)) {
+                        ret = 0;
+
+                        if (sch_queue_sendpacket(dsc, clone) != 0) {
+                                ret = -1;
+
+                                protect_errno {
+                                        dI("FAIL: errno=%u, %s.", errno, strerror (errno));
+                                }
+                        }
+
+                        DESC_WUNLOCK(dsc);
+                }
+
+                if (ret != 0) {
+                        protect_errno {
+                                SEAP_packet_clone_free (clone);
+                        }
+                }
+
+                return (ret);
+        }
+
         packet_sexp = SEAP_packet2sexp (packet);
 
         if (packet_sexp == NULL) {
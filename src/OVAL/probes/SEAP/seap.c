@@ -42,8 +42,6 @@
 #include "seap-descriptor.h"
 #include "debug_priv.h"
 
-#define SCH_QUEUE 4
-
 static void SEAP_CTX_initdefault (SEAP_CTX_t *ctx)
 {
         _A(ctx != NULL);
@@ -93,7 +91,7 @@ int SEAP_connect(SEAP_CTX_t *ctx)
         int sd;
 
 
-	sd = SEAP_desc_add(ctx->sd_table, SCH_QUEUE, NULL);
+	sd = SEAP_desc_add(ctx->sd_table, sch_queue_default_scheme(), NULL);
 
         if (sd < 0) {
                 dI("Can't create/add new SEAP descriptor");
@@ -154,7 +152,7 @@ int SEAP_openfd2 (SEAP_CTX_t *ctx, int ifd, int ofd, uint32_t flags)
 
 int SEAP_add_probe (SEAP_CTX_t *ctx, sch_queuedata_t *data)
 {
-	int sd = SEAP_desc_add(ctx->sd_table, SCH_QUEUE, data);
+	int sd = SEAP_desc_add(ctx->sd_table, data->scheme, data);
 	dI("SEAP_add_probe");
 	if (sd < 0) {
 		dI("Can't create/add new SEAP descriptor");
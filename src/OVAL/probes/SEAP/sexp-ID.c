@@ -45,7 +45,7 @@
 #include "_sexp-rawptr.h"
 #include "_sexp-ID.h"
 
-#include "MurmurHash3.h"
+#include "common/MurmurHash3.h"
 
 static SEXP_ID_t SEXP_ID_hash(void *buf, size_t len, SEXP_ID_t seed, int part)
 {
@@ -75,9 +75,16 @@ static int SEXP_ID_v_callback(const SEXP_t *sexp, __IDres_pair *pair)
 
         switch (v_dsc.type) {
         case SEXP_VALTYPE_NUMBER:
-        case SEXP_VALTYPE_STRING:
                 pair->hash = SEXP_ID_hash(v_dsc.mem, v_dsc.hdr->size, pair->hash, pair->part);
                 break;
+        case SEXP_VALTYPE_STRING:
+        {
+                /* strings are hashed once, then only their cached hash is mixed in */
+                uint64_t str_hash = SEXP_rawval_string_hash(&v_dsc);
+
+                pair->hash = SEXP_ID_hash(&str_hash, sizeof str_hash, pair->hash, pair->part);
+                break;
+        }
         case SEXP_VALTYPE_LIST:
         {
                 SEXP_rawval_lblk_cb ((uintptr_t)SEXP_LCASTP(v_dsc.mem)->b_addr,
@@ -61,6 +61,11 @@ bool SEXP_atomic_cas_u32 (volatile uint32_t *ptr, uint32_t old, uint32_t new)
         return ((bool) __sync_bool_compare_and_swap (ptr, old, new));
 }
 
+intptr_t SEXP_atomic_add_iptr (volatile intptr_t *ptr, intptr_t delta)
+{
+        return (__sync_add_and_fetch (ptr, delta));
+}
+
 #ifdef SEXP_ATOMIC_64BITS
 uint64_t SEXP_atomic_dec_u64 (volatile uint64_t *ptr)
 {
@@ -210,6 +215,19 @@ bool SEXP_atomic_cas_u32 (volatile uint32_t *ptr, uint32_t old, uint32_t new)
         return (r);
 }
 
+intptr_t SEXP_atomic_add_iptr (volatile intptr_t *ptr, intptr_t delta)
+{
+        intptr_t r;
+
+        SEXP_atomic_once();
+        SEXP_atomic_lock((uintptr_t)ptr);
+        r = *ptr + delta;
+        *ptr = r;
+        SEXP_atomic_unlock((uintptr_t)ptr);
+
+        return (r);
+}
+
 #ifdef SEXP_ATOMIC_64BITS
 uint64_t SEXP_atomic_dec_u64 (volatile uint64_t *ptr)
 {
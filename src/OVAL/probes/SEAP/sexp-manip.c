@@ -1632,16 +1632,16 @@ SEXP_t *SEXP_unref (SEXP_t *s_exp_o)
 
                         switch (v_dsc.type) {
                         case SEXP_VALTYPE_STRING:
-				oscap_aligned_free(v_dsc.hdr);
+				SEXP_val_free(&v_dsc);
                                 break;
                         case SEXP_VALTYPE_NUMBER:
-				oscap_aligned_free(v_dsc.hdr);
+				SEXP_val_free(&v_dsc);
                                 break;
                         case SEXP_VALTYPE_LIST:
                                 if (SEXP_LCASTP(v_dsc.mem)->b_addr != NULL)
                                         SEXP_rawval_lblk_free ((uintptr_t)SEXP_LCASTP(v_dsc.mem)->b_addr, SEXP_free_lmemb);
 
-				oscap_aligned_free(v_dsc.hdr);
+				SEXP_val_free(&v_dsc);
                                 break;
                         default:
                                 abort ();
@@ -1743,13 +1743,29 @@ bool SEXP_deepcmp(const SEXP_t *a, const SEXP_t *b)
 
         if (a == NULL || b == NULL)
                 return (a == b);
+        /* a shared value is equal to itself */
+        if (a->s_valp == b->s_valp)
+                return (true);
         if ((type = SEXP_typeof(a)) != SEXP_typeof(b))
                 return (false);
         if (!SEXP_listp(a)) {
                 /* compare simple objects */
                 switch(type) {
-                case SEXP_VALTYPE_STRING:
-                        return (SEXP_string_cmp(a, b) == 0);
+                case SEXP_VALTYPE_STRING: {
+                        SEXP_val_t v_a, v_b;
+
+                        SEXP_val_dsc(&v_a, a->s_valp);
+                        SEXP_val_dsc(&v_b, b->s_valp);
+
+                        if (v_a.hdr->size != v_b.hdr->size)
+                                return (false);
+                        /* don't hash the strings just for the comparison */
+                        if (v_a.hdr->hash != 0 && v_b.hdr->hash != 0 &&
+                            v_a.hdr->hash != v_b.hdr->hash)
+                                return (false);
+
+                        return (memcmp(v_a.mem, v_b.mem, v_a.hdr->size) == 0);
+                }
                 case SEXP_VALTYPE_NUMBER: {
                         SEXP_numtype_t ntype_a, ntype_b;
 
@@ -1827,16 +1843,16 @@ static void SEXP_free_lmemb (SEXP_t *s_exp)
                 if (SEXP_rawval_decref (s_exp->s_valp)) {
                         switch (v_dsc.type) {
                         case SEXP_VALTYPE_STRING:
-				oscap_aligned_free(v_dsc.hdr);
+				SEXP_val_free(&v_dsc);
                                 break;
                         case SEXP_VALTYPE_NUMBER:
-				oscap_aligned_free(v_dsc.hdr);
+				SEXP_val_free(&v_dsc);
                                 break;
                         case SEXP_VALTYPE_LIST:
                                 if (SEXP_LCASTP(v_dsc.mem)->b_addr != NULL)
                                         SEXP_rawval_lblk_free ((uintptr_t)SEXP_LCASTP(v_dsc.mem)->b_addr, SEXP_free_lmemb);
 
-				oscap_aligned_free(v_dsc.hdr);
+				SEXP_val_free(&v_dsc);
                                 break;
                         default:
                                 abort ();
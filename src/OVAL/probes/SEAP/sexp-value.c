@@ -29,14 +29,45 @@
 
 #include "_sexp-atomic.h"
 #include "_sexp-value.h"
+#include "common/MurmurHash3.h"
 #include "debug_priv.h"
 
+/*
+ * Bytes held by the values and the list blocks. The counter is split into
+ * stripes picked by the address of the memory, so that the threads which
+ * allocate at the same time don't fight for one cache line.
+ */
+#define SEXP_MEMUSAGE_STRIPES 16
+
+static struct {
+	volatile intptr_t bytes;
+	uint8_t pad[64 - sizeof(intptr_t)];
+} SEXP_memusage_stripe[SEXP_MEMUSAGE_STRIPES];
+
+static inline void SEXP_memusage_add (const void *mem, intptr_t bytes)
+{
+	SEXP_atomic_add_iptr(&SEXP_memusage_stripe[((uintptr_t)mem >> 6) % SEXP_MEMUSAGE_STRIPES].bytes, bytes);
+}
+
+size_t SEXP_memusage (void)
+{
+	intptr_t bytes = 0;
+
+	for (int i = 0; i < SEXP_MEMUSAGE_STRIPES; ++i)
+		bytes += SEXP_memusage_stripe[i].bytes;
+
+	return (bytes > 0 ? (size_t)bytes : 0);
+}
+
 int SEXP_val_new (SEXP_val_t *dst, size_t vmemsize, SEXP_type_t type)
 {
 	void *s_val = oscap_aligned_malloc(sizeof(SEXP_valhdr_t) + vmemsize, SEXP_VALP_ALIGN);
 
+	SEXP_memusage_add(s_val, sizeof(SEXP_valhdr_t) + vmemsize);
+
         SEXP_val_dsc (dst, (uintptr_t) s_val);
 
+        dst->hdr->hash = 0;
         dst->hdr->refs = 1;
         dst->hdr->size = vmemsize;
         dst->type      = type;
@@ -48,6 +79,12 @@ int SEXP_val_new (SEXP_val_t *dst, size_t vmemsize, SEXP_type_t type)
         return (0);
 }
 
+void SEXP_val_free (SEXP_val_t *dsc)
+{
+	SEXP_memusage_add(dsc->hdr, -(intptr_t)(sizeof(SEXP_valhdr_t) + dsc->hdr->size));
+	oscap_aligned_free(dsc->hdr);
+}
+
 void SEXP_val_dsc (SEXP_val_t *dst, uintptr_t ptr)
 {
         dst->ptr  = ptr;
@@ -61,6 +98,24 @@ uintptr_t SEXP_val_ptr (SEXP_val_t *dsc)
         return ((dsc->ptr & SEXP_VALP_MASK) | (dsc->type & SEXP_VALT_MASK));
 }
 
+uint64_t SEXP_rawval_string_hash (SEXP_val_t *dsc)
+{
+        uint64_t h[2];
+
+        if (SEXP_VALHDR_HASH_CACHED && dsc->hdr->hash != 0)
+                return (dsc->hdr->hash);
+
+        MurmurHash3_x64_128(dsc->mem, (int)dsc->hdr->size, 0x5EA95EED, h);
+
+        /* 0 means "not computed" */
+        if (h[0] == 0)
+                h[0] = 1;
+        if (SEXP_VALHDR_HASH_CACHED)
+                dsc->hdr->hash = h[0];
+
+        return (h[0]);
+}
+
 /*
  * Return values:
  *  (uintptr_t)NULL - empty value
@@ -106,10 +161,9 @@ uintptr_t SEXP_rawval_lblk_new (uint8_t sz)
 {
         _A(sz < 16);
 
-	struct SEXP_val_lblk *lblk = oscap_aligned_malloc(
-		sizeof(uintptr_t) + (2 * sizeof(uint16_t)) + (sizeof(SEXP_t) * (1 << sz)),
-		SEXP_LBLK_ALIGN
-	);
+	struct SEXP_val_lblk *lblk = oscap_aligned_malloc(SEXP_LBLK_SIZE(sz), SEXP_LBLK_ALIGN);
+
+	SEXP_memusage_add(lblk, SEXP_LBLK_SIZE(sz));
 
         lblk->nxsz = ((uintptr_t)(NULL) & SEXP_LBLKP_MASK) | ((uintptr_t)sz & SEXP_LBLKS_MASK);
         lblk->refs = 1;
@@ -519,6 +573,7 @@ void SEXP_rawval_lblk_free (uintptr_t lblkp, void (*func) (SEXP_t *))
                         func (lblk->memb + lblk->real);
                 }
 
+		SEXP_memusage_add(lblk, -(intptr_t)SEXP_LBLK_SIZE(lblk->nxsz & SEXP_LBLKS_MASK));
 		oscap_aligned_free(lblk);
 
                 if (next != NULL)
@@ -540,6 +595,7 @@ void SEXP_rawval_lblk_free1 (uintptr_t lblkp, void (*func) (SEXP_t *))
                         func (lblk->memb + lblk->real);
                 }
 
+		SEXP_memusage_add(lblk, -(intptr_t)SEXP_LBLK_SIZE(lblk->nxsz & SEXP_LBLKS_MASK));
 		oscap_aligned_free(lblk);
         }
 
@@ -31,6 +31,8 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #include "crapi.h"
 #include "digest.h"
@@ -71,117 +73,145 @@ int crapi_digest_fd (int fd, crapi_alg_t alg, void *dst, size_t *size)
         return (-1);
 }
 
-int crapi_mdigest_fd (int fd, int num, ... /* crapi_alg_t alg, void *dst, size_t *size, ...*/)
+static int crapi_mdigest_ctbl (struct digest_ctbl_t *ctbl, crapi_alg_t alg)
+{
+        switch (alg) {
+        case CRAPI_DIGEST_MD5:
+                ctbl->init   = &crapi_md5_init;
+                ctbl->update = &crapi_md5_update;
+                ctbl->fini   = &crapi_md5_fini;
+                ctbl->free   = &crapi_md5_free;
+                break;
+        case CRAPI_DIGEST_SHA1:
+                ctbl->init   = &crapi_sha1_init;
+                ctbl->update = &crapi_sha1_update;
+                ctbl->fini   = &crapi_sha1_fini;
+                ctbl->free   = &crapi_sha1_free;
+                break;
+        case CRAPI_DIGEST_SHA224:
+                ctbl->init   = &crapi_sha224_init;
+                ctbl->update = &crapi_sha224_update;
+                ctbl->fini   = &crapi_sha224_fini;
+                ctbl->free   = &crapi_sha224_free;
+                break;
+        case CRAPI_DIGEST_SHA256:
+                ctbl->init   = &crapi_sha256_init;
+                ctbl->update = &crapi_sha256_update;
+                ctbl->fini   = &crapi_sha256_fini;
+                ctbl->free   = &crapi_sha256_free;
+                break;
+        case CRAPI_DIGEST_SHA384:
+                ctbl->init   = &crapi_sha384_init;
+                ctbl->update = &crapi_sha384_update;
+                ctbl->fini   = &crapi_sha384_fini;
+                ctbl->free   = &crapi_sha384_free;
+                break;
+        case CRAPI_DIGEST_SHA512:
+                ctbl->init   = &crapi_sha512_init;
+                ctbl->update = &crapi_sha512_update;
+                ctbl->fini   = &crapi_sha512_fini;
+                ctbl->free   = &crapi_sha512_free;
+                break;
+        case CRAPI_DIGEST_RMD160:
+                ctbl->init   = &crapi_rmd160_init;
+                ctbl->update = &crapi_rmd160_update;
+                ctbl->fini   = &crapi_rmd160_fini;
+                ctbl->free   = &crapi_rmd160_free;
+                break;
+        default:
+                errno = EINVAL;
+                return (-1);
+        }
+
+        return (0);
+}
+
+static int crapi_mdigest_update (struct digest_ctbl_t *ctbl, int num, void *buf, size_t len)
 {
         register int i;
-        va_list ap;
-        struct digest_ctbl_t *ctbl = malloc(num * sizeof(struct digest_ctbl_t));
 
-        crapi_alg_t alg;
-        void       *dst;
-        size_t     *size;
+        for (i = 0; i < num; ++i) {
+                if (ctbl[i].ctx == NULL)
+                        continue;
+                if (ctbl[i].update (ctbl[i].ctx, buf, len) != 0)
+                        return (-1);
+        }
 
-        uint8_t fd_buf[CRAPI_IO_BUFSZ];
-        ssize_t ret;
+        return (0);
+}
 
-	if (num <= 0 || fd <= 0) {
+/*
+ * Feed the file to all the contexts at once. The file is read into a large
+ * aligned buffer, which is hashed in chunks small enough to stay in the
+ * cache while each of the contexts consumes them. The file isn't mapped
+ * into memory, a file truncated meanwhile (e.g. a log file being rotated)
+ * would raise SIGBUS and kill the whole process.
+ */
+static int crapi_mdigest_data (int fd, struct digest_ctbl_t *ctbl, int num)
+{
+        uint8_t    *buf;
+        ssize_t     ret;
+        size_t      off, n;
+
+        if (posix_memalign ((void **)&buf, CRAPI_MDIGEST_ALIGN, CRAPI_MDIGEST_BUFSZ) != 0)
+                return (-1);
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        for (;;) {
+                ret = read (fd, buf, CRAPI_MDIGEST_BUFSZ);
+
+                if (ret == 0)
+                        break;
+                if (ret < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        free (buf);
+                        return (-1);
+                }
+                for (off = 0; off < (size_t)ret; off += n) {
+                        n = (size_t)ret - off < CRAPI_MDIGEST_CHUNK ? (size_t)ret - off : CRAPI_MDIGEST_CHUNK;
+
+                        if (crapi_mdigest_update (ctbl, num, buf + off, n) != 0) {
+                                free (buf);
+                                return (-1);
+                        }
+                }
+        }
+
+        free (buf);
+        return (0);
+}
+
+int crapi_mdigest_fdv (int fd, int num, struct crapi_mdigest_t *digests)
+{
+        register int i;
+        struct digest_ctbl_t *ctbl;
+
+	if (num <= 0 || fd <= 0 || digests == NULL) {
 		errno = EINVAL;
-		free(ctbl);
 		return -1;
 	}
+
+        ctbl = malloc(num * sizeof(struct digest_ctbl_t));
+
+        if (ctbl == NULL)
+                return (-1);
+
         for (i = 0; i < num; ++i)
                 ctbl[i].ctx = NULL;
 
-        va_start (ap, num);
-
         for (i = 0; i < num; ++i) {
-                alg  = va_arg (ap, crapi_alg_t);
-                dst  = va_arg (ap, void *);
-                size = va_arg (ap, size_t *);
-
-                switch (alg) {
-                case CRAPI_DIGEST_MD5:
-                        ctbl[i].init   = &crapi_md5_init;
-                        ctbl[i].update = &crapi_md5_update;
-                        ctbl[i].fini   = &crapi_md5_fini;
-                        ctbl[i].free   = &crapi_md5_free;
-                        break;
-                case CRAPI_DIGEST_SHA1:
-                        ctbl[i].init   = &crapi_sha1_init;
-                        ctbl[i].update = &crapi_sha1_update;
-                        ctbl[i].fini   = &crapi_sha1_fini;
-                        ctbl[i].free   = &crapi_sha1_free;
-                        break;
-                case CRAPI_DIGEST_SHA224:
-                        ctbl[i].init   = &crapi_sha224_init;
-                        ctbl[i].update = &crapi_sha224_update;
-                        ctbl[i].fini   = &crapi_sha224_fini;
-                        ctbl[i].free   = &crapi_sha224_free;
-                        break;
-                case CRAPI_DIGEST_SHA256:
-                        ctbl[i].init   = &crapi_sha256_init;
-                        ctbl[i].update = &crapi_sha256_update;
-                        ctbl[i].fini   = &crapi_sha256_fini;
-                        ctbl[i].free   = &crapi_sha256_free;
-                        break;
-                case CRAPI_DIGEST_SHA384:
-                        ctbl[i].init   = &crapi_sha384_init;
-                        ctbl[i].update = &crapi_sha384_update;
-                        ctbl[i].fini   = &crapi_sha384_fini;
-                        ctbl[i].free   = &crapi_sha384_free;
-                        break;
-                case CRAPI_DIGEST_SHA512:
-                        ctbl[i].init   = &crapi_sha512_init;
-                        ctbl[i].update = &crapi_sha512_update;
-                        ctbl[i].fini   = &crapi_sha512_fini;
-                        ctbl[i].free   = &crapi_sha512_free;
-                        break;
-                case CRAPI_DIGEST_RMD160:
-                        ctbl[i].init   = &crapi_rmd160_init;
-                        ctbl[i].update = &crapi_rmd160_update;
-                        ctbl[i].fini   = &crapi_rmd160_fini;
-                        ctbl[i].free   = &crapi_rmd160_free;
-                        break;
-                default:
-                        va_end (ap);
+                if (crapi_mdigest_ctbl (&ctbl[i], digests[i].alg) != 0)
                         goto fail;
-                }
 
-                if ((ctbl[i].ctx = ctbl[i].init (dst, size)) == NULL)
-			*size = 0;
+                if ((ctbl[i].ctx = ctbl[i].init (digests[i].dst, &digests[i].size)) == NULL)
+			digests[i].size = 0;
         }
 
-        va_end (ap);
-
-        while ((ret = read (fd, fd_buf, sizeof fd_buf)) == sizeof fd_buf) {
-                for (i = 0; i < num; ++i) {
-			if (ctbl[i].ctx == NULL)
-				continue;
-                        if (ctbl[i].update (ctbl[i].ctx, fd_buf, sizeof fd_buf) != 0) {
-                                goto fail;
-                        }
-                }
-        }
-
-        switch (ret) {
-        case 0:
-                break;
-        case -1:
+        if (crapi_mdigest_data (fd, ctbl, num) != 0)
                 goto fail;
-        default:
-		if (ret <= 0) {
-			free(ctbl);
-			return -1;
-		}
-
-                for (i = 0; i < num; ++i) {
-			if (ctbl[i].ctx == NULL)
-				continue;
-                        if (ctbl[i].update (ctbl[i].ctx, fd_buf, (size_t)ret) != 0) {
-                                goto fail;
-                        }
-                }
-        }
 
         for (i = 0; i < num; ++i) {
 		if (ctbl[i].ctx == NULL)
@@ -198,3 +228,48 @@ fail:
         free(ctbl);
         return (-1);
 }
+
+int crapi_mdigest_fd (int fd, int num, ... /* crapi_alg_t alg, void *dst, size_t *size, ...*/)
+{
+        register int i;
+        va_list ap;
+        struct crapi_mdigest_t *digests;
+        size_t **sizes;
+        int ret;
+
+	if (num <= 0 || fd <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+        digests = malloc(num * sizeof(struct crapi_mdigest_t));
+        sizes   = malloc(num * sizeof(size_t *));
+
+        if (digests == NULL || sizes == NULL) {
+                free(digests);
+                free(sizes);
+                return (-1);
+        }
+
+        va_start (ap, num);
+
+        for (i = 0; i < num; ++i) {
+                digests[i].alg  = va_arg (ap, crapi_alg_t);
+                digests[i].dst  = va_arg (ap, void *);
+                sizes[i]        = va_arg (ap, size_t *);
+                digests[i].size = *sizes[i];
+        }
+
+        va_end (ap);
+
+        ret = crapi_mdigest_fdv (fd, num, digests);
+
+        if (ret == 0) {
+                for (i = 0; i < num; ++i)
+                        *sizes[i] = digests[i].size;
+        }
+
+        free(digests);
+        free(sizes);
+        return (ret);
+}
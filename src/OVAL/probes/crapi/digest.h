@@ -55,4 +55,23 @@ struct digest_ctbl_t {
 
 int crapi_mdigest_fd (int fd, int num, ... /*crapi_alg_t alg, void *dst, size_t *size, ...*/);
 
+/*
+ * Files are read using an aligned buffer of CRAPI_MDIGEST_BUFSZ bytes,
+ * which is passed to the digest contexts in chunks of CRAPI_MDIGEST_CHUNK.
+ */
+#define CRAPI_MDIGEST_CHUNK  (256 * 1024)
+#define CRAPI_MDIGEST_BUFSZ  (4 * 1024 * 1024)
+#define CRAPI_MDIGEST_ALIGN  4096
+
+struct crapi_mdigest_t {
+        crapi_alg_t alg;
+        void       *dst;
+        size_t      size; /* size of dst on input, digest length on output */
+};
+
+/*
+ * Compute all the digests in a single pass over the file.
+ */
+int crapi_mdigest_fdv (int fd, int num, struct crapi_mdigest_t *digests);
+
 #endif /* CRAPI_DIGEST_H */
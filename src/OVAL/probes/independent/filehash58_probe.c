@@ -102,16 +102,20 @@ static int mem2hex (uint8_t *mem, size_t mlen, char *str, size_t slen)
 	return (0);
 }
 
-static int filehash58_cb(const char *prefix, const char *p, const char *f, const char *h, probe_ctx *ctx)
+/*
+ * Compute all the requested hash types of the file in a single pass and
+ * create one item per hash type.
+ */
+static int filehash58_cb(const char *prefix, const char *p, const char *f, const struct oscap_string_map **algs, int num, probe_ctx *ctx)
 {
 	SEXP_t *itm;
 
 	char   pbuf[PATH_MAX+1];
 	size_t plen, flen;
 
-	int fd;
+	int fd, i;
 
-	if (f == NULL)
+	if (f == NULL || num == 0)
 		return (0);
 
 	/*
@@ -145,61 +149,69 @@ static int filehash58_cb(const char *prefix, const char *p, const char *f, const
 	}
 
 	if (fd < 0) {
-		strerror_r (errno, pbuf, PATH_MAX);
+		int open_errno = errno;
+
+		strerror_r (open_errno, pbuf, PATH_MAX);
 		pbuf[PATH_MAX] = '\0';
 
-		itm = probe_item_create (OVAL_INDEPENDENT_FILE_HASH58, NULL,
-					"filepath", OVAL_DATATYPE_STRING, pbuf,
-					"path",     OVAL_DATATYPE_STRING, p,
-					"filename", OVAL_DATATYPE_STRING, f,
-					"hash_type",OVAL_DATATYPE_STRING, h,
-					NULL);
-		probe_item_add_msg(itm, OVAL_MESSAGE_LEVEL_ERROR,
-			"Can't open \"%s\": errno=%d, %s.", pbuf, errno, strerror (errno));
-		probe_item_setstatus(itm, SYSCHAR_STATUS_ERROR);
+		for (i = 0; i < num; ++i) {
+			itm = probe_item_create (OVAL_INDEPENDENT_FILE_HASH58, NULL,
+						"filepath", OVAL_DATATYPE_STRING, pbuf,
+						"path",     OVAL_DATATYPE_STRING, p,
+						"filename", OVAL_DATATYPE_STRING, f,
+						"hash_type",OVAL_DATATYPE_STRING, algs[i]->string,
+						NULL);
+			probe_item_add_msg(itm, OVAL_MESSAGE_LEVEL_ERROR,
+				"Can't open \"%s\": errno=%d, %s.", pbuf, open_errno, strerror (open_errno));
+			probe_item_setstatus(itm, SYSCHAR_STATUS_ERROR);
+			probe_item_collect(ctx, itm);
+		}
 	} else {
-		uint8_t hash_dst[1025];
-		size_t  hash_dstlen = sizeof hash_dst;
-		char    hash_str[2051];
-
-		crapi_alg_t hash_type;
-
-		hash_type = oscap_string_to_enum(CRAPI_ALG_MAP, h);
-		hash_dstlen = oscap_string_to_enum(CRAPI_ALG_MAP_SIZE, h);
+		uint8_t hash_dst[CRAPI_DIGEST_CNT][64];
+		struct crapi_mdigest_t digests[CRAPI_DIGEST_CNT];
+		char    hash_str[129];
+
+		for (i = 0; i < num; ++i) {
+			digests[i].alg  = algs[i]->value;
+			digests[i].dst  = hash_dst[i];
+			digests[i].size = oscap_string_to_enum(CRAPI_ALG_MAP_SIZE, algs[i]->string);
+		}
 
 		/*
-		 * Compute hash value
+		 * Compute the hash values
 		 */
-		if (crapi_mdigest_fd (fd, 1, hash_type, hash_dst, &hash_dstlen) != 0) {
+		if (crapi_mdigest_fdv (fd, num, digests) != 0) {
 			close (fd);
 			return (-1);
 		}
 
 		close (fd);
 
-		hash_str[0] = '\0';
-		mem2hex (hash_dst, hash_dstlen, hash_str, sizeof hash_str);
+		for (i = 0; i < num; ++i) {
+			hash_str[0] = '\0';
+			mem2hex (hash_dst[i], digests[i].size, hash_str, sizeof hash_str);
+
+			/*
+			 * Create and add the item
+			 */
+			itm = probe_item_create(OVAL_INDEPENDENT_FILE_HASH58, NULL,
+						"filepath", OVAL_DATATYPE_STRING, pbuf,
+						"path",     OVAL_DATATYPE_STRING, p,
+						"filename", OVAL_DATATYPE_STRING, f,
+						"hash_type",OVAL_DATATYPE_STRING, algs[i]->string,
+						"hash",     OVAL_DATATYPE_STRING, hash_str,
+						NULL);
+
+			if (digests[i].size == 0) {
+				probe_item_add_msg(itm, OVAL_MESSAGE_LEVEL_ERROR,
+						   "Unable to compute %s hash value of \"%s\".", algs[i]->string, pbuf);
+				probe_item_setstatus(itm, SYSCHAR_STATUS_ERROR);
+			}
 
-		/*
-		 * Create and add the item
-		 */
-		itm = probe_item_create(OVAL_INDEPENDENT_FILE_HASH58, NULL,
-					"filepath", OVAL_DATATYPE_STRING, pbuf,
-					"path",     OVAL_DATATYPE_STRING, p,
-					"filename", OVAL_DATATYPE_STRING, f,
-					"hash_type",OVAL_DATATYPE_STRING, h,
-					"hash",     OVAL_DATATYPE_STRING, hash_str,
-					NULL);
-
-		if (hash_dstlen == 0) {
-			probe_item_add_msg(itm, OVAL_MESSAGE_LEVEL_ERROR,
-					   "Unable to compute %s hash value of \"%s\".", h, pbuf);
-			probe_item_setstatus(itm, SYSCHAR_STATUS_ERROR);
+			probe_item_collect(ctx, itm);
 		}
 	}
 
-	probe_item_collect(ctx, itm);
-
 	return (0);
 }
 
@@ -246,6 +258,8 @@ int filehash58_probe_main(probe_ctx *ctx, void *arg)
 	SEXP_t *probe_in;
 	SEXP_t *path, *filename, *behaviors, *filepath, *hash_type;
 	char hash_type_str[128];
+	const struct oscap_string_map *algs[CRAPI_DIGEST_CNT];
+	int algs_cnt = 0;
 	int err = 0;
 
 	OVAL_FTS    *ofts;
@@ -288,20 +302,21 @@ int filehash58_probe_main(probe_ctx *ctx, void *arg)
 		goto cleanup;
 	}
 
+	/* find hash types to compare with entity, think "not satisfy" */
+	const struct oscap_string_map *p = CRAPI_ALG_MAP;
+	while (p->value != CRAPI_INVALID) {
+		SEXP_t *crapi_hash_type_sexp = SEXP_string_new(p->string, strlen(p->string));
+		if (probe_entobj_cmp(hash_type, crapi_hash_type_sexp) == OVAL_RESULT_TRUE)
+			algs[algs_cnt++] = p;
+
+		SEXP_free(crapi_hash_type_sexp);
+		p++;
+	}
+
 	const char *prefix = getenv("OSCAP_PROBE_ROOT");
 	if ((ofts = oval_fts_open_prefixed(prefix, path, filename, filepath, behaviors, probe_ctx_getresult(ctx))) != NULL) {
 		while ((ofts_ent = oval_fts_read(ofts)) != NULL) {
-			/* find hash types to compare with entity, think "not satisfy" */
-			const struct oscap_string_map *p = CRAPI_ALG_MAP;
-			while (p->value != CRAPI_INVALID) {
-				SEXP_t *crapi_hash_type_sexp = SEXP_string_new(p->string, strlen(p->string));
-				if (probe_entobj_cmp(hash_type, crapi_hash_type_sexp) == OVAL_RESULT_TRUE) {
-					filehash58_cb(prefix, ofts_ent->path, ofts_ent->file, p->string, ctx);
-				}
-
-				SEXP_free(crapi_hash_type_sexp);
-				p++;
-			}
+			filehash58_cb(prefix, ofts_ent->path, ofts_ent->file, algs, algs_cnt, ctx);
 			oval_ftsent_free(ofts_ent);
 		}
 
@@ -36,6 +36,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/stat.h>
@@ -56,7 +57,13 @@
 
 #define FILE_SEPARATOR '/'
 
-static int get_substrings(char *str, int *ofs, pcre *re, int want_substrs, char ***substrings) {
+/*
+ * Files are read through a window which only holds the unmatched data,
+ * it grows by this size.
+ */
+#define TFC54_STREAM_CHUNK  (1024 * 1024)
+
+static int get_substrings(const char *str, int len, int *ofs, int search_ofs, pcre *re, int flags, int want_substrs, char ***substrings) {
 	int i, ret, rc;
 	int ovector[60], ovector_len = sizeof (ovector) / sizeof (ovector[0]);
 	char **substrs;
@@ -67,20 +74,23 @@ static int get_substrings(char *str, int *ofs, pcre *re, int want_substrs, char
 		ovector[i] = -1;
 
 #if defined(OS_SOLARIS)
-	rc = pcre_exec(re, NULL, str, strlen(str), *ofs, PCRE_NO_UTF8_CHECK, ovector, ovector_len);
-#else
-	rc = pcre_exec(re, NULL, str, strlen(str), *ofs, 0, ovector, ovector_len);
+	flags |= PCRE_NO_UTF8_CHECK;
 #endif
+	rc = pcre_exec(re, NULL, str, len, *ofs, flags, ovector, ovector_len);
 
-	if (rc < -1) {
-		dE("Function pcre_exec() failed to match a regular expression with return code %d on string '%s'.", rc, str);
+	if (rc == PCRE_ERROR_PARTIAL) {
+		/* the match might continue past the end of the buffer */
+		*ofs = ovector[0];
+		return rc;
+	} else if (rc < -1) {
+		dE("Function pcre_exec() failed to match a regular expression with return code %d.", rc);
 		return rc;
 	} else if (rc == -1) {
 		/* no match */
 		return 0;
 	}
 
-	*ofs = (*ofs == ovector[1]) ? ovector[1] + 1 : ovector[1];
+	*ofs = (search_ofs == ovector[1]) ? ovector[1] + 1 : ovector[1];
 
 	if (!want_substrs) {
 		/* just report successful match */
@@ -96,15 +106,15 @@ static int get_substrings(char *str, int *ofs, pcre *re, int want_substrs, char
 
 	substrs = malloc(rc * sizeof (char *));
 	for (i = 0; i < rc; ++i) {
-		int len;
+		int sublen;
 		char *buf;
 
 		if (ovector[2 * i] == -1)
 			continue;
-		len = ovector[2 * i + 1] - ovector[2 * i];
-		buf = malloc(len + 1);
-		memcpy(buf, str + ovector[2 * i], len);
-		buf[len] = '\0';
+		sublen = ovector[2 * i + 1] - ovector[2 * i];
+		buf = malloc(sublen + 1);
+		memcpy(buf, str + ovector[2 * i], sublen);
+		buf[sublen] = '\0';
 		substrs[ret] = buf;
 		++ret;
 	}
@@ -173,13 +183,246 @@ struct pfdata {
 	pcre *compiled_regex;
 };
 
+static void report_error(struct pfdata *pfd, SEXP_t *msg)
+{
+	probe_cobj_add_msg(probe_ctx_getresult(pfd->ctx), msg);
+	SEXP_free(msg);
+	probe_cobj_set_flag(probe_ctx_getresult(pfd->ctx), SYSCHAR_FLAG_ERROR);
+}
+
+/*
+ * The subject is checked for valid UTF-8 by the first pcre_exec() call,
+ * later calls on the same data can skip the check unless they start in
+ * the middle of a character.
+ */
+static int utf8_check_flags(const char *buf, int len, int ofs, bool checked)
+{
+	if (checked && (ofs >= len || (buf[ofs] & 0xC0) != 0x80))
+		return PCRE_NO_UTF8_CHECK;
+	return 0;
+}
+
+/*
+ * Find the next match in the buffer and collect the item if the instance
+ * was asked for. The search starts at *ofs, search_ofs is the offset where
+ * the search would have started if the whole file was matched at once.
+ * Returns the number of substrings, 0 if there's no match,
+ * PCRE_ERROR_PARTIAL if more data is needed or a negative error code.
+ */
+static int collect_next_match(struct pfdata *pfd, const char *path, const char *file,
+			      const char *buf, int len, int *ofs, int search_ofs, int flags,
+			      int *cur_inst, oval_schema_version_t over)
+{
+	char **substrs;
+	int substr_cnt, want_instance;
+	SEXP_t *next_inst;
+
+	next_inst = SEXP_number_newi_32(*cur_inst + 1);
+
+	if (probe_entobj_cmp(pfd->instance_ent, next_inst) == OVAL_RESULT_TRUE)
+		want_instance = 1;
+	else
+		want_instance = 0;
+
+	SEXP_free(next_inst);
+	substr_cnt = get_substrings(buf, len, ofs, search_ofs, pfd->compiled_regex, flags, want_instance, &substrs);
+
+	if (substr_cnt > 0) {
+		++(*cur_inst);
+
+		if (want_instance) {
+			int k;
+			SEXP_t *item;
+
+			item = create_item(path, file, pfd->pattern,
+					*cur_inst, substrs, substr_cnt, over);
+
+			probe_item_collect(pfd->ctx, item);
+
+			for (k = 0; k < substr_cnt; ++k)
+				free(substrs[k]);
+			free(substrs);
+		}
+	}
+
+	return substr_cnt;
+}
+
+/* Length of the buffer without an incomplete UTF-8 character at its end */
+static size_t utf8_complete_len(const char *buf, size_t len)
+{
+	size_t i, need;
+
+	for (i = len; i > 0 && len - i < 4; --i) {
+		unsigned char c = buf[i - 1];
+
+		if ((c & 0xC0) == 0x80)
+			continue;
+
+		if ((c & 0xE0) == 0xC0)
+			need = 2;
+		else if ((c & 0xF0) == 0xE0)
+			need = 3;
+		else if ((c & 0xF8) == 0xF0)
+			need = 4;
+		else
+			need = 1;
+
+		return len - (i - 1) < need ? i - 1 : len;
+	}
+
+	return len;
+}
+
+/*
+ * Match the file in windows. A window is matched with PCRE_PARTIAL_HARD
+ * unless it ends at the end of the file, so any match which could continue
+ * past the window is retried once more data is read. Data before the
+ * current offset are dropped, except for the context needed by lookbehind
+ * assertions, so the memory use doesn't depend on the size of the file
+ * unless a single match spans most of it.
+ */
+static int process_stream(struct pfdata *pfd, const char *path, const char *file, const char *whole_path,
+			  int fd, oval_schema_version_t over)
+{
+	int ret = 0, ofs = 0, search_ofs, len, cur_inst = 0, substr_cnt, flags, lookbehind = 255;
+	unsigned long options = 0;
+	size_t size = 0, used = 0;
+	bool eof = false, checked = false, notbol = false, refill = true, skipped = false;
+	char *buf = NULL;
+
+#if defined(PCRE_INFO_MAXLOOKBEHIND)
+	pcre_fullinfo(pfd->compiled_regex, NULL, PCRE_INFO_MAXLOOKBEHIND, &lookbehind);
+#endif
+	pcre_fullinfo(pfd->compiled_regex, NULL, PCRE_INFO_OPTIONS, &options);
+
+	for (;;) {
+		if (refill) {
+			size_t keep, old_used;
+			ssize_t r = 0;
+
+			/* drop the data which won't be looked at again */
+			keep = ofs > lookbehind + 1 ? ofs - lookbehind - 1 : 0;
+			while (keep > 0 && (buf[keep] & 0xC0) == 0x80)
+				--keep;
+			if (keep > 0) {
+				memmove(buf, buf + keep, used - keep);
+				used -= keep;
+				ofs -= keep;
+				notbol = true;
+			}
+
+			if (size - used < TFC54_STREAM_CHUNK) {
+				char *nbuf;
+
+				if (used > INT_MAX - TFC54_STREAM_CHUNK) {
+					report_error(pfd, probe_msg_creatf(OVAL_MESSAGE_LEVEL_ERROR,
+					"read(): '%s' %s.", whole_path, strerror(EFBIG)));
+					ret = -2;
+					break;
+				}
+				size = used + TFC54_STREAM_CHUNK;
+				nbuf = realloc(buf, size);
+				if (nbuf == NULL) {
+					report_error(pfd, probe_msg_creatf(OVAL_MESSAGE_LEVEL_ERROR,
+					"read(): '%s' %s.", whole_path, strerror(ENOMEM)));
+					ret = -2;
+					break;
+				}
+				buf = nbuf;
+			}
+
+			old_used = used;
+			while (used < size) {
+				r = read(fd, buf + used, size - used);
+				if (r == -1) {
+					if (errno == EINTR)
+						continue;
+					break;
+				}
+				if (r == 0) {
+					eof = true;
+					break;
+				}
+				used += r;
+			}
+			if (r == -1) {
+				report_error(pfd, probe_msg_creatf(OVAL_MESSAGE_LEVEL_ERROR,
+					"read(): '%s' %s.", whole_path, strerror(errno)));
+				ret = -2;
+				break;
+			}
+
+			/* the content is matched up to the first NUL byte */
+			char *nul = memchr(buf + old_used, '\0', used - old_used);
+			if (nul != NULL) {
+				used = nul - buf;
+				eof = true;
+			}
+
+			checked = false;
+			refill = false;
+		}
+
+		len = eof ? (int) used : (int) utf8_complete_len(buf, used);
+		if (!eof && ofs >= len) {
+			refill = true;
+			continue;
+		}
+
+		flags = utf8_check_flags(buf, len, ofs, checked);
+		if (!eof)
+			flags |= PCRE_PARTIAL_HARD;
+		if (notbol)
+			flags |= PCRE_NOTBOL;
+
+		/*
+		 * Once the offset was moved forward over the data which can't
+		 * match, the search started before it in the whole file.
+		 */
+		search_ofs = ofs;
+		substr_cnt = collect_next_match(pfd, path, file, buf, len, &ofs,
+				skipped ? -1 : ofs, flags, &cur_inst, over);
+
+		if (substr_cnt == PCRE_ERROR_PARTIAL) {
+			skipped = skipped || ofs != search_ofs;
+			refill = true;
+			continue;
+		}
+		if (substr_cnt < 0) {
+			report_error(pfd, probe_msg_creatf(OVAL_MESSAGE_LEVEL_ERROR,
+				"Regular expression pattern match failed in file %s with error %d.",
+				whole_path, substr_cnt));
+			ret = -3;
+			break;
+		}
+		checked = true;
+
+		if (substr_cnt == 0) {
+			/* no match can start anywhere in the rest of the window */
+			if (eof || (options & PCRE_ANCHORED))
+				break;
+			skipped = skipped || ofs != len;
+			ofs = len;
+			refill = true;
+			continue;
+		}
+		skipped = false;
+
+		if (eof && ofs > len)
+			break;
+	}
+
+	free(buf);
+
+	return ret;
+}
+
 static int process_file(const char *prefix, const char *path, const char *file, void *arg, oval_schema_version_t over)
 {
 	struct pfdata *pfd = (struct pfdata *) arg;
-	int ret = 0, path_len, file_len, cur_inst = 0, fd = -1, substr_cnt,
-		buf_size = 0, buf_used = 0, ofs = 0, buf_inc = 4096;
-	char *whole_path = NULL, *whole_path_with_prefix = NULL, *buf = NULL;
-	SEXP_t *next_inst = NULL;
+	int ret = 0, path_len, file_len, fd = -1;
+	char *whole_path = NULL, *whole_path_with_prefix = NULL;
 	struct stat st;
 
 	if (file == NULL)
@@ -208,93 +451,24 @@ static int process_file(const char *prefix, const char *path, const char *file,
 	 * be determined with stat().
 	 */
 	whole_path_with_prefix = oscap_path_join(prefix, whole_path);
-	if (stat(whole_path_with_prefix, &st) == -1)
+	if (oval_fts_cache_stat(whole_path_with_prefix, &st) == -1)
 		goto cleanup;
 	if (!S_ISREG(st.st_mode))
 		goto cleanup;
 
 	fd = open(whole_path_with_prefix, O_RDONLY);
 	if (fd == -1) {
-		SEXP_t *msg;
-
-		msg = probe_msg_creatf(OVAL_MESSAGE_LEVEL_ERROR, "open(): '%s' %s.", whole_path, strerror(errno));
-		probe_cobj_add_msg(probe_ctx_getresult(pfd->ctx), msg);
-		SEXP_free(msg);
-		probe_cobj_set_flag(probe_ctx_getresult(pfd->ctx), SYSCHAR_FLAG_ERROR);
+		report_error(pfd, probe_msg_creatf(OVAL_MESSAGE_LEVEL_ERROR,
+			"open(): '%s' %s.", whole_path, strerror(errno)));
 		ret = -1;
 		goto cleanup;
 	}
 
-	do {
-		buf_size += buf_inc;
-		buf = realloc(buf, buf_size);
-		ret = read(fd, buf + buf_used, buf_inc);
-		if (ret == -1) {
-			SEXP_t *msg;
-
-			msg = probe_msg_creatf(OVAL_MESSAGE_LEVEL_ERROR, "read(): '%s' %s.", whole_path, strerror(errno));
-			probe_cobj_add_msg(probe_ctx_getresult(pfd->ctx), msg);
-			SEXP_free(msg);
-			probe_cobj_set_flag(probe_ctx_getresult(pfd->ctx), SYSCHAR_FLAG_ERROR);
-			ret = -2;
-			goto cleanup;
-		}
-		buf_used += ret;
-	} while (ret == buf_inc);
-
-	if (buf_used == buf_size)
-		buf = realloc(buf, ++buf_size);
-	buf[buf_used++] = '\0';
-
-	do {
-		char **substrs;
-		int want_instance;
-
-		next_inst = SEXP_number_newi_32(cur_inst + 1);
-
-		if (probe_entobj_cmp(pfd->instance_ent, next_inst) == OVAL_RESULT_TRUE)
-			want_instance = 1;
-		else
-			want_instance = 0;
-
-		SEXP_free(next_inst);
-		substr_cnt = get_substrings(buf, &ofs, pfd->compiled_regex, want_instance, &substrs);
-
-		if (substr_cnt < 0) {
-			SEXP_t *msg;
-			msg = probe_msg_creatf(OVAL_MESSAGE_LEVEL_ERROR,
-				"Regular expression pattern match failed in file %s with error %d.",
-				whole_path, substr_cnt);
-			probe_cobj_add_msg(probe_ctx_getresult(pfd->ctx), msg);
-			SEXP_free(msg);
-			probe_cobj_set_flag(probe_ctx_getresult(pfd->ctx), SYSCHAR_FLAG_ERROR);
-			ret = -3;
-			goto cleanup;
-		}
-
-		if (substr_cnt > 0) {
-			++cur_inst;
-
-			if (want_instance) {
-				int k;
-				SEXP_t *item;
-
-				item = create_item(path, file, pfd->pattern,
-						cur_inst, substrs, substr_cnt, over);
-
-                                probe_item_collect(pfd->ctx, item);
-
-				for (k = 0; k < substr_cnt; ++k)
-					free(substrs[k]);
-				free(substrs);
-			}
-		}
-	} while (substr_cnt > 0 && ofs < buf_used);
+	ret = process_stream(pfd, path, file, whole_path, fd, over);
 
  cleanup:
 	if (fd != -1)
 		close(fd);
-	free(buf);
 	if (whole_path != NULL)
 		free(whole_path);
 	free(whole_path_with_prefix);
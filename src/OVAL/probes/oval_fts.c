@@ -67,9 +67,9 @@ static OVAL_FTS *OVAL_FTS_new()
 static void OVAL_FTS_free(OVAL_FTS *ofts)
 {
 	if (ofts->ofts_match_path_fts != NULL)
-		fts_close(ofts->ofts_match_path_fts);
+		oval_fts_walk_close(ofts->ofts_match_path_fts);
 	if (ofts->ofts_recurse_path_fts != NULL)
-		fts_close(ofts->ofts_recurse_path_fts);
+		oval_fts_walk_close(ofts->ofts_recurse_path_fts);
 
 	free(ofts);
 	return;
@@ -90,7 +90,7 @@ static int pathlen_from_ftse(int fts_pathlen, int fts_namelen)
 	return pathlen;
 }
 
-static OVAL_FTSENT *OVAL_FTSENT_new(OVAL_FTS *ofts, FTSENT *fts_ent)
+static OVAL_FTSENT *OVAL_FTSENT_new(OVAL_FTS *ofts, OVAL_FTS_WALKENT *fts_ent)
 {
 	OVAL_FTSENT *ofts_ent = calloc(1, sizeof(OVAL_FTSENT));
 
@@ -838,7 +838,7 @@ OVAL_FTS *oval_fts_open_prefixed(const char *prefix, SEXP_t *path, SEXP_t *filen
 	dI("Opening file '%s'.", paths[0]);
 	/* Fail if the provided path doensn't actually exist. Symlinks
 	   without targets are accepted. */
-	if (lstat(paths[0], &st) == -1) {
+	if (oval_fts_cache_lstat(paths[0], &st) == -1) {
 		if (errno) {
 			dD("lstat() failed: errno: %d, '%s'.",
 			   errno, strerror(errno));
@@ -850,14 +850,10 @@ OVAL_FTS *oval_fts_open_prefixed(const char *prefix, SEXP_t *path, SEXP_t *filen
 	ofts = OVAL_FTS_new();
 	ofts->prefix = prefix;
 
-	/* reset errno as fts_open() doesn't do it itself. */
-	errno = 0;
-	ofts->ofts_match_path_fts = fts_open((char * const *) paths, mtc_fts_options, NULL);
+	ofts->ofts_match_path_fts = oval_fts_walk_open(paths[0], mtc_fts_options);
 	free((void *) paths[0]);
-	/* fts_open() doesn't return NULL for all errors (e.g. nonexistent paths),
-	   so check errno to detect it. Far from being perfect. */
-	if (ofts->ofts_match_path_fts == NULL || errno != 0) {
-		dE("fts_open() failed, errno: %d \"%s\".", errno, strerror(errno));
+	if (ofts->ofts_match_path_fts == NULL) {
+		dE("oval_fts_walk_open() failed, errno: %d \"%s\".", errno, strerror(errno));
 		OVAL_FTS_free(ofts);
 		return (NULL);
 	}
@@ -878,22 +874,18 @@ OVAL_FTS *oval_fts_open_prefixed(const char *prefix, SEXP_t *path, SEXP_t *filen
 		ofts->localdevs = fsdev_init(NULL, 0);
 		if (ofts->localdevs == NULL) {
 			dE("fsdev_init() failed.");
-			/* One dummy read to get rid of an uninitialized
-			 * value in the FTS data before calling
-			 * fts_close() on it. */
-			fts_read(ofts->ofts_match_path_fts);
 			oval_fts_close(ofts);
 			return (NULL);
 		}
 #endif
 	} else if (filesystem == OVAL_RECURSE_FS_DEFINED) {
 		/* store the device id for future comparison */
-		FTSENT *fts_ent;
+		OVAL_FTS_WALKENT *fts_ent;
 
-		fts_ent = fts_read(ofts->ofts_match_path_fts);
+		fts_ent = oval_fts_walk_read(ofts->ofts_match_path_fts);
 		if (fts_ent != NULL) {
 			ofts->ofts_recurse_path_devid = fts_ent->fts_statp->st_dev;
-			fts_set(ofts->ofts_match_path_fts, fts_ent, FTS_AGAIN);
+			oval_fts_walk_set(fts_ent, FTS_AGAIN);
 		}
 	}
 
@@ -923,7 +915,7 @@ OVAL_FTS *oval_fts_open_prefixed(const char *prefix, SEXP_t *path, SEXP_t *filen
 	return (ofts);
 }
 
-static inline int _oval_fts_is_local(OVAL_FTS *ofts, FTSENT *fts_ent) {
+static inline int _oval_fts_is_local(OVAL_FTS *ofts, OVAL_FTS_WALKENT *fts_ent) {
 # if defined(OS_SOLARIS)
 	/* pseudo filesystems will be skipped */
 	/* don't recurse into remote fs if local is specified */
@@ -942,15 +934,15 @@ static inline int _oval_fts_is_local(OVAL_FTS *ofts, FTSENT *fts_ent) {
 }
 
 /* find the first matching path or filepath */
-static FTSENT *oval_fts_read_match_path(OVAL_FTS *ofts)
+static OVAL_FTS_WALKENT *oval_fts_read_match_path(OVAL_FTS *ofts)
 {
-	FTSENT *fts_ent = NULL;
+	OVAL_FTS_WALKENT *fts_ent = NULL;
 	SEXP_t *stmp;
 	oval_result_t ores;
 
 	/* iterate until a match is found or all elements have been traversed */
 	for (;;) {
-		fts_ent = fts_read(ofts->ofts_match_path_fts);
+		fts_ent = oval_fts_walk_read(ofts->ofts_match_path_fts);
 		if (fts_ent == NULL)
 			return NULL;
 		switch (fts_ent->fts_info) {
@@ -958,7 +950,7 @@ static FTSENT *oval_fts_read_match_path(OVAL_FTS *ofts)
 			continue;
 		case FTS_DC:
 			dW("Filesystem tree cycle detected at '%s'.", fts_ent->fts_path);
-			fts_set(ofts->ofts_match_path_fts, fts_ent, FTS_SKIP);
+			oval_fts_walk_set(fts_ent, FTS_SKIP);
 			continue;
 		}
 
@@ -973,19 +965,19 @@ static FTSENT *oval_fts_read_match_path(OVAL_FTS *ofts)
 #if defined(OSCAP_FTS_DEBUG)
 			dI("Only the target of a symlink gets reported, skipping '%s'.", fts_ent->fts_path, fts_ent->fts_name);
 #endif
-			fts_set(ofts->ofts_match_path_fts, fts_ent, FTS_FOLLOW);
+			oval_fts_walk_set(fts_ent, FTS_FOLLOW);
 			continue;
 		}
 		if (_oval_fts_is_local(ofts, fts_ent)) {
 			dI("Don't recurse into non-local filesystems, skipping '%s'.", fts_ent->fts_path);
-			fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_SKIP);
+			oval_fts_walk_set(fts_ent, FTS_SKIP);
 			continue;
 		}
 		/* don't recurse beyond the initial filesystem */
 		if (ofts->filesystem == OVAL_RECURSE_FS_DEFINED
 		    && (fts_ent->fts_info == FTS_D || fts_ent->fts_info == FTS_SL)
 		    && ofts->ofts_recurse_path_devid != fts_ent->fts_statp->st_dev) {
-			fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_SKIP);
+			oval_fts_walk_set(fts_ent, FTS_SKIP);
 			continue;
 		}
 
@@ -1000,7 +992,7 @@ static FTSENT *oval_fts_read_match_path(OVAL_FTS *ofts)
 				switch (ret) {
 				case PCRE_ERROR_NOMATCH:
 					dD("Partial match optimization: PCRE_ERROR_NOMATCH, skipping.");
-					fts_set(ofts->ofts_match_path_fts, fts_ent, FTS_SKIP);
+					oval_fts_walk_set(fts_ent, FTS_SKIP);
 					continue;
 				case PCRE_ERROR_PARTIAL:
 					dD("Partial match optimization: PCRE_ERROR_PARTIAL, continuing.");
@@ -1041,16 +1033,16 @@ static FTSENT *oval_fts_read_match_path(OVAL_FTS *ofts)
 	    ofts->ofts_sfilename == NULL &&
 	    ofts->ofts_sfilepath == NULL)
 	{
-		fts_set(ofts->ofts_match_path_fts, fts_ent, FTS_SKIP);
+		oval_fts_walk_set(fts_ent, FTS_SKIP);
 	}
 
 	return fts_ent;
 }
 
 /* find the first matching file or directory */
-static FTSENT *oval_fts_read_recurse_path(OVAL_FTS *ofts)
+static OVAL_FTS_WALKENT *oval_fts_read_recurse_path(OVAL_FTS *ofts)
 {
-	FTSENT *out_fts_ent = NULL;
+	OVAL_FTS_WALKENT *out_fts_ent = NULL;
 	/* the condition below is correct because ofts_sfilepath is NULL here */
 	bool collect_dirs = (ofts->ofts_sfilename == NULL);
 
@@ -1068,41 +1060,32 @@ static FTSENT *oval_fts_read_recurse_path(OVAL_FTS *ofts)
 
 		/* initialize separate fts for recursion */
 		if (ofts->ofts_recurse_path_fts == NULL) {
-			char * const paths[2] = { ofts->ofts_match_path_fts_ent->fts_path, NULL };
+			const char *path = ofts->ofts_match_path_fts_ent->fts_path;
 
 #if defined(OSCAP_FTS_DEBUG)
-			dI("fts_open args: path: \"%s\", options: %d.",
-				paths[0], ofts->ofts_recurse_path_fts_opts);
+			dI("oval_fts_walk_open args: path: \"%s\", options: %d.",
+				path, ofts->ofts_recurse_path_fts_opts);
 #endif
-			/* reset errno as fts_open() doesn't do it itself. */
-			errno = 0;
-			ofts->ofts_recurse_path_fts = fts_open(paths,
-				ofts->ofts_recurse_path_fts_opts, NULL);
-			/* fts_open() doesn't return NULL for all errors
-			   (e.g. nonexistent paths), so check errno to detect it.
-			   Far from being perfect. */
-			if (ofts->ofts_recurse_path_fts == NULL || errno != 0) {
-				dE("fts_open() failed, errno: %d \"%s\".",
+			ofts->ofts_recurse_path_fts = oval_fts_walk_open(path,
+				ofts->ofts_recurse_path_fts_opts);
+			if (ofts->ofts_recurse_path_fts == NULL) {
+				dE("oval_fts_walk_open() failed, errno: %d \"%s\".",
 					errno, strerror(errno));
 #if !defined(OSCAP_FTS_DEBUG)
-				dE("fts_open args: path: \"%s\", options: %d.",
-					paths[0], ofts->ofts_recurse_path_fts_opts);
+				dE("oval_fts_walk_open args: path: \"%s\", options: %d.",
+					path, ofts->ofts_recurse_path_fts_opts);
 #endif
-				if (ofts->ofts_recurse_path_fts != NULL) {
-					fts_close(ofts->ofts_recurse_path_fts);
-					ofts->ofts_recurse_path_fts = NULL;
-				}
 				return (NULL);
 			}
 		}
 
 		/* iterate until a match is found or all elements have been traversed */
 		while (out_fts_ent == NULL) {
-			FTSENT *fts_ent;
+			OVAL_FTS_WALKENT *fts_ent;
 
-			fts_ent = fts_read(ofts->ofts_recurse_path_fts);
+			fts_ent = oval_fts_walk_read(ofts->ofts_recurse_path_fts);
 			if (fts_ent == NULL) {
-				fts_close(ofts->ofts_recurse_path_fts);
+				oval_fts_walk_close(ofts->ofts_recurse_path_fts);
 				ofts->ofts_recurse_path_fts = NULL;
 
 				return NULL;
@@ -1113,7 +1096,7 @@ static FTSENT *oval_fts_read_recurse_path(OVAL_FTS *ofts)
 				continue;
 			case FTS_DC:
 				dW("Filesystem tree cycle detected at '%s'.", fts_ent->fts_path);
-				fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_SKIP);
+				oval_fts_walk_set(fts_ent, FTS_SKIP);
 				continue;
 			}
 
@@ -1156,7 +1139,7 @@ static FTSENT *oval_fts_read_recurse_path(OVAL_FTS *ofts)
 				/* limit recursion depth */
 				if (ofts->direction == OVAL_RECURSE_DIRECTION_NONE
 				    || (ofts->max_depth != -1 && fts_ent->fts_level > ofts->max_depth)) {
-					fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_SKIP);
+					oval_fts_walk_set(fts_ent, FTS_SKIP);
 					continue;
 				}
 
@@ -1164,30 +1147,30 @@ static FTSENT *oval_fts_read_recurse_path(OVAL_FTS *ofts)
 				switch (fts_ent->fts_info) {
 				case FTS_D:
 					if (!(ofts->recurse & OVAL_RECURSE_DIRS)) {
-						fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_SKIP);
+						oval_fts_walk_set(fts_ent, FTS_SKIP);
 						continue;
 					}
 					break;
 				case FTS_SL:
 					if (!(ofts->recurse & OVAL_RECURSE_SYMLINKS)) {
-						fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_SKIP);
+						oval_fts_walk_set(fts_ent, FTS_SKIP);
 						continue;
 					}
-					fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_FOLLOW);
+					oval_fts_walk_set(fts_ent, FTS_FOLLOW);
 					break;
 				default:
 					continue;
 				}
 			}
 			if (_oval_fts_is_local(ofts, fts_ent)) {
-				fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_SKIP);
+				oval_fts_walk_set(fts_ent, FTS_SKIP);
 				continue;
 			}
 			/* don't recurse beyond the initial filesystem */
 			if (ofts->filesystem == OVAL_RECURSE_FS_DEFINED
 			    && (fts_ent->fts_info == FTS_D || fts_ent->fts_info == FTS_SL)
 			    && ofts->ofts_recurse_path_devid != fts_ent->fts_statp->st_dev) {
-				fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_SKIP);
+				oval_fts_walk_set(fts_ent, FTS_SKIP);
 				continue;
 			}
 		}
@@ -1203,39 +1186,30 @@ static FTSENT *oval_fts_read_recurse_path(OVAL_FTS *ofts)
 		while (ofts->max_depth == -1 || ofts->ofts_recurse_path_curdepth <= ofts->max_depth) {
 			/* initialize separate fts for recursion */
 			if (ofts->ofts_recurse_path_fts == NULL) {
-				char * const paths[2] = { ofts->ofts_recurse_path_curpth, NULL };
+				const char *path = ofts->ofts_recurse_path_curpth;
 
 #if defined(OSCAP_FTS_DEBUG)
-				dI("fts_open args: path: \"%s\", options: %d.",
-					paths[0], ofts->ofts_recurse_path_fts_opts);
+				dI("oval_fts_walk_open args: path: \"%s\", options: %d.",
+					path, ofts->ofts_recurse_path_fts_opts);
 #endif
-				/* reset errno as fts_open() doesn't do it itself. */
-				errno = 0;
-				/* fts_open() doesn't return NULL for all errors
-				   (e.g. nonexistent paths), so check errno to
-				   detect it. Far from being perfect. */
-				ofts->ofts_recurse_path_fts = fts_open(paths,
-					ofts->ofts_recurse_path_fts_opts, NULL);
-				if (ofts->ofts_recurse_path_fts == NULL || errno != 0) {
-					dE("fts_open() failed, errno: %d \"%s\".",
+				ofts->ofts_recurse_path_fts = oval_fts_walk_open(path,
+					ofts->ofts_recurse_path_fts_opts);
+				if (ofts->ofts_recurse_path_fts == NULL) {
+					dE("oval_fts_walk_open() failed, errno: %d \"%s\".",
 						errno, strerror(errno));
 #if !defined(OSCAP_FTS_DEBUG)
-					dE("fts_open args: path: \"%s\", options: %d.",
-						paths[0], ofts->ofts_recurse_path_fts_opts);
+					dE("oval_fts_walk_open args: path: \"%s\", options: %d.",
+						path, ofts->ofts_recurse_path_fts_opts);
 #endif
-					if (ofts->ofts_recurse_path_fts != NULL) {
-						fts_close(ofts->ofts_recurse_path_fts);
-						ofts->ofts_recurse_path_fts = NULL;
-					}
 					return (NULL);
 				}
 			}
 
 			/* iterate until a match is found or all elements have been traversed */
 			while (out_fts_ent == NULL) {
-				FTSENT *fts_ent;
+				OVAL_FTS_WALKENT *fts_ent;
 
-				fts_ent = fts_read(ofts->ofts_recurse_path_fts);
+				fts_ent = oval_fts_walk_read(ofts->ofts_recurse_path_fts);
 				if (fts_ent == NULL)
 					break;
 
@@ -1269,7 +1243,7 @@ static FTSENT *oval_fts_read_recurse_path(OVAL_FTS *ofts)
 					/* only fts root is collected */
 					if (fts_ent->fts_level == 0 && fts_ent->fts_info == FTS_D) {
 						out_fts_ent = fts_ent;
-						fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_SKIP);
+						oval_fts_walk_set(fts_ent, FTS_SKIP);
 						break;
 					}
 				} else {
@@ -1284,16 +1258,16 @@ static FTSENT *oval_fts_read_recurse_path(OVAL_FTS *ofts)
 				}
 
 				if (fts_ent->fts_info == FTS_SL)
-					fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_FOLLOW);
+					oval_fts_walk_set(fts_ent, FTS_FOLLOW);
 				/* limit recursion only to fts root */
 				else if (fts_ent->fts_level > 0)
-					fts_set(ofts->ofts_recurse_path_fts, fts_ent, FTS_SKIP);
+					oval_fts_walk_set(fts_ent, FTS_SKIP);
 			}
 
 			if (out_fts_ent != NULL)
 				break;
 
-			fts_close(ofts->ofts_recurse_path_fts);
+			oval_fts_walk_close(ofts->ofts_recurse_path_fts);
 			ofts->ofts_recurse_path_fts = NULL;
 
 			if (!strcmp(ofts->ofts_recurse_path_curpth, "/"))
@@ -1316,7 +1290,7 @@ static FTSENT *oval_fts_read_recurse_path(OVAL_FTS *ofts)
 
 OVAL_FTSENT *oval_fts_read(OVAL_FTS *ofts)
 {
-	FTSENT *fts_ent;
+	OVAL_FTS_WALKENT *fts_ent;
 
 #if defined(OSCAP_FTS_DEBUG)
 	dI("ofts: %p.", ofts);
@@ -32,6 +32,7 @@
 #endif
 #include <pcre.h>
 #include "fsdev.h"
+#include "oval_fts_cache.h"
 
 #define ENT_GET_AREF(ent, dst, attr_name, mandatory)			\
 	do {								\
@@ -68,10 +69,10 @@
 
 typedef struct {
 	/* oval_fts_read_match_path() state */
-	FTS *ofts_match_path_fts;
-	FTSENT *ofts_match_path_fts_ent;
+	OVAL_FTS_WALK *ofts_match_path_fts;
+	OVAL_FTS_WALKENT *ofts_match_path_fts_ent;
 	/* oval_fts_read_recurse_path() state */
-	FTS *ofts_recurse_path_fts;
+	OVAL_FTS_WALK *ofts_recurse_path_fts;
 	int ofts_recurse_path_fts_opts;
 	int ofts_recurse_path_curdepth;
 	char *ofts_recurse_path_pthcpy;
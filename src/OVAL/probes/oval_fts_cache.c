@@ -0,0 +1,793 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include "debug_priv.h"
+#include "oval_fts_cache.h"
+
+#define OVAL_FTS_CACHE_BUCKETS 8191
+
+struct oval_fts_cdirent {
+	char *name;
+	int err;		///< lstat() errno, 0 on success
+	struct stat st;		///< lstat() result
+};
+
+/*
+ * Directory listing. Walks hold a reference while they iterate over
+ * the listing, the cache holds one while the listing is cached.
+ */
+struct oval_fts_cdir {
+	char *path;
+	uint32_t hash;
+	unsigned int refs;
+	struct oval_fts_cdir *next;
+
+	int err;		///< opendir() errno, 0 on success
+	size_t count;
+	struct oval_fts_cdirent *ents;		///< in readdir() order
+	struct oval_fts_cdirent **sorted;	///< sorted by name
+};
+
+struct oval_fts_cstat {
+	char *path;
+	uint32_t hash;
+	struct oval_fts_cstat *next;
+
+	bool have_stat;
+	bool have_lstat;
+	int stat_err;
+	int lstat_err;
+	struct stat st;
+	struct stat lst;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct oval_fts_cdir **dirs;
+	struct oval_fts_cstat **stats;
+	size_t count;
+} fts_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static pthread_once_t fts_cache_once = PTHREAD_ONCE_INIT;
+
+struct oval_fts_frame {
+	OVAL_FTS_WALKENT *dir;
+	struct oval_fts_cdir *list;
+	size_t next;
+};
+
+struct oval_fts_walk {
+	int options;
+	dev_t rootdev;
+	OVAL_FTS_WALKENT *root;	///< root entry until it's returned
+	OVAL_FTS_WALKENT *cur;	///< last returned entry, never on the stack
+
+	struct oval_fts_frame *stack;
+	size_t depth;
+	size_t size;
+};
+
+static uint32_t oval_fts_cache_hash(const char *path)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261u;
+
+	for (; *path != '\0'; ++path) {
+		h ^= (unsigned char) *path;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+static void oval_fts_cdir_free(struct oval_fts_cdir *list)
+{
+	for (size_t i = 0; i < list->count; ++i)
+		free(list->ents[i].name);
+	free(list->ents);
+	free(list->sorted);
+	free(list->path);
+	free(list);
+}
+
+static void oval_fts_cdir_release(struct oval_fts_cdir *list)
+{
+	pthread_mutex_lock(&fts_cache.lock);
+	if (--list->refs == 0)
+		oval_fts_cdir_free(list);
+	pthread_mutex_unlock(&fts_cache.lock);
+}
+
+/* The cache lock has to be held */
+static void oval_fts_cache_clear(void)
+{
+	if (fts_cache.dirs != NULL) {
+		for (size_t b = 0; b < OVAL_FTS_CACHE_BUCKETS; ++b) {
+			struct oval_fts_cdir *list = fts_cache.dirs[b], *next;
+
+			for (; list != NULL; list = next) {
+				next = list->next;
+				list->next = NULL;
+				if (--list->refs == 0)
+					oval_fts_cdir_free(list);
+			}
+			fts_cache.dirs[b] = NULL;
+		}
+	}
+
+	if (fts_cache.stats != NULL) {
+		for (size_t b = 0; b < OVAL_FTS_CACHE_BUCKETS; ++b) {
+			struct oval_fts_cstat *cst = fts_cache.stats[b], *next;
+
+			for (; cst != NULL; cst = next) {
+				next = cst->next;
+				free(cst->path);
+				free(cst);
+			}
+			fts_cache.stats[b] = NULL;
+		}
+	}
+
+	fts_cache.count = 0;
+}
+
+static void oval_fts_cache_free(void)
+{
+	pthread_mutex_lock(&fts_cache.lock);
+	oval_fts_cache_clear();
+	free(fts_cache.dirs);
+	free(fts_cache.stats);
+	fts_cache.dirs = NULL;
+	fts_cache.stats = NULL;
+	pthread_mutex_unlock(&fts_cache.lock);
+}
+
+static void oval_fts_cache_init(void)
+{
+	fts_cache.dirs = calloc(OVAL_FTS_CACHE_BUCKETS, sizeof(struct oval_fts_cdir *));
+	fts_cache.stats = calloc(OVAL_FTS_CACHE_BUCKETS, sizeof(struct oval_fts_cstat *));
+	atexit(oval_fts_cache_free);
+}
+
+static bool oval_fts_cache_ready(void)
+{
+	pthread_once(&fts_cache_once, oval_fts_cache_init);
+	return fts_cache.dirs != NULL && fts_cache.stats != NULL;
+}
+
+void oval_fts_cache_invalidate(void)
+{
+	pthread_once(&fts_cache_once, oval_fts_cache_init);
+
+	pthread_mutex_lock(&fts_cache.lock);
+	dD("Dropping %zu cached filesystem entries.", fts_cache.count);
+	oval_fts_cache_clear();
+	pthread_mutex_unlock(&fts_cache.lock);
+}
+
+/* The cache lock has to be held */
+static struct oval_fts_cdir *oval_fts_cache_find_dir(const char *path, uint32_t hash)
+{
+	struct oval_fts_cdir *list;
+
+	for (list = fts_cache.dirs[hash % OVAL_FTS_CACHE_BUCKETS]; list != NULL; list = list->next) {
+		if (list->hash == hash && strcmp(list->path, path) == 0)
+			return list;
+	}
+
+	return NULL;
+}
+
+/* The cache lock has to be held */
+static struct oval_fts_cstat *oval_fts_cache_find_stat(const char *path, uint32_t hash)
+{
+	struct oval_fts_cstat *cst;
+
+	for (cst = fts_cache.stats[hash % OVAL_FTS_CACHE_BUCKETS]; cst != NULL; cst = cst->next) {
+		if (cst->hash == hash && strcmp(cst->path, path) == 0)
+			return cst;
+	}
+
+	return NULL;
+}
+
+static int oval_fts_cdirent_cmp(const void *a, const void *b)
+{
+	const struct oval_fts_cdirent *ea = *(const struct oval_fts_cdirent **) a;
+	const struct oval_fts_cdirent *eb = *(const struct oval_fts_cdirent **) b;
+
+	return strcmp(ea->name, eb->name);
+}
+
+static struct oval_fts_cdir *oval_fts_cdir_read(const char *path, uint32_t hash)
+{
+	struct oval_fts_cdir *list;
+	struct dirent *dent;
+	size_t size = 0;
+	DIR *dir;
+	int dfd;
+
+	list = calloc(1, sizeof(struct oval_fts_cdir));
+	if (list == NULL)
+		return NULL;
+
+	list->path = strdup(path);
+	list->hash = hash;
+	list->refs = 1;
+
+	dir = opendir(path);
+	if (dir == NULL) {
+		list->err = errno;
+		return list;
+	}
+	dfd = dirfd(dir);
+
+	while ((dent = readdir(dir)) != NULL) {
+		struct oval_fts_cdirent *ent;
+
+		if (dent->d_name[0] == '.' && (dent->d_name[1] == '\0'
+		    || (dent->d_name[1] == '.' && dent->d_name[2] == '\0')))
+			continue;
+
+		if (list->count == size) {
+			void *ents;
+
+			size = size == 0 ? 16 : size * 2;
+			ents = realloc(list->ents, size * sizeof(struct oval_fts_cdirent));
+			if (ents == NULL) {
+				list->err = ENOMEM;
+				break;
+			}
+			list->ents = ents;
+		}
+
+		ent = &list->ents[list->count++];
+		ent->name = strdup(dent->d_name);
+		/* relative to the open directory, saves the path lookup */
+		if (fstatat(dfd, dent->d_name, &ent->st, AT_SYMLINK_NOFOLLOW) == -1)
+			ent->err = errno;
+		else
+			ent->err = 0;
+	}
+	closedir(dir);
+
+	if (list->count > 0) {
+		list->sorted = malloc(list->count * sizeof(struct oval_fts_cdirent *));
+		if (list->sorted != NULL) {
+			for (size_t i = 0; i < list->count; ++i)
+				list->sorted[i] = &list->ents[i];
+			qsort(list->sorted, list->count, sizeof(struct oval_fts_cdirent *), oval_fts_cdirent_cmp);
+		}
+	}
+
+	return list;
+}
+
+/*
+ * Get the listing of the directory, read it if it isn't cached yet.
+ * The listing has to be released using oval_fts_cdir_release().
+ */
+static struct oval_fts_cdir *oval_fts_cache_readdir(const char *path)
+{
+	struct oval_fts_cdir *list, *cached;
+	uint32_t hash;
+	bool ready;
+
+	ready = oval_fts_cache_ready();
+	hash = oval_fts_cache_hash(path);
+
+	if (ready) {
+		pthread_mutex_lock(&fts_cache.lock);
+		list = oval_fts_cache_find_dir(path, hash);
+		if (list != NULL) {
+			++list->refs;
+			pthread_mutex_unlock(&fts_cache.lock);
+			return list;
+		}
+		pthread_mutex_unlock(&fts_cache.lock);
+	}
+
+	/* Read the directory outside of the lock */
+	list = oval_fts_cdir_read(path, hash);
+	if (list == NULL || !ready)
+		return list;
+
+	pthread_mutex_lock(&fts_cache.lock);
+
+	/* Another walk might have read the same directory meanwhile */
+	cached = oval_fts_cache_find_dir(path, hash);
+	if (cached != NULL) {
+		++cached->refs;
+		pthread_mutex_unlock(&fts_cache.lock);
+		oval_fts_cdir_free(list);
+		return cached;
+	}
+
+	if (list->err != ENOMEM && fts_cache.count + list->count + 1 <= OVAL_FTS_CACHE_MAX_ENTRIES) {
+		size_t bucket = hash % OVAL_FTS_CACHE_BUCKETS;
+
+		list->next = fts_cache.dirs[bucket];
+		fts_cache.dirs[bucket] = list;
+		fts_cache.count += list->count + 1;
+		++list->refs;
+	}
+
+	pthread_mutex_unlock(&fts_cache.lock);
+
+	return list;
+}
+
+/* The cache lock has to be held */
+static bool oval_fts_cache_lookup_lstat(const char *path, struct stat *st, int *err)
+{
+	const char *slash, *name;
+	struct oval_fts_cdirent key, *keyp, **found;
+	struct oval_fts_cdir *list;
+	struct oval_fts_cstat *cst;
+	char dpath[PATH_MAX];
+	size_t dlen;
+
+	cst = oval_fts_cache_find_stat(path, oval_fts_cache_hash(path));
+	if (cst != NULL && cst->have_lstat) {
+		*st = cst->lst;
+		*err = cst->lstat_err;
+		return true;
+	}
+
+	/* Look the entry up in the listing of the parent directory */
+	slash = strrchr(path, '/');
+	if (slash == NULL || slash[1] == '\0')
+		return false;
+
+	name = slash + 1;
+	dlen = slash == path ? 1 : (size_t) (slash - path);
+	if (dlen >= sizeof dpath)
+		return false;
+
+	memcpy(dpath, path, dlen);
+	dpath[dlen] = '\0';
+
+	list = oval_fts_cache_find_dir(dpath, oval_fts_cache_hash(dpath));
+	if (list == NULL || list->sorted == NULL)
+		return false;
+
+	key.name = (char *) name;
+	keyp = &key;
+	found = bsearch(&keyp, list->sorted, list->count, sizeof(struct oval_fts_cdirent *), oval_fts_cdirent_cmp);
+	if (found == NULL) {
+		if (list->err != 0)
+			return false;
+		/* The directory was read successfully, the entry doesn't exist */
+		*err = ENOENT;
+		return true;
+	}
+
+	*st = (*found)->st;
+	*err = (*found)->err;
+
+	return true;
+}
+
+/* The cache lock has to be held */
+static void oval_fts_cache_store_stat(const char *path, const struct stat *st, int err, bool follow)
+{
+	struct oval_fts_cstat *cst;
+	uint32_t hash;
+
+	hash = oval_fts_cache_hash(path);
+	cst = oval_fts_cache_find_stat(path, hash);
+
+	if (cst == NULL) {
+		size_t bucket = hash % OVAL_FTS_CACHE_BUCKETS;
+
+		if (fts_cache.count >= OVAL_FTS_CACHE_MAX_ENTRIES)
+			return;
+
+		cst = calloc(1, sizeof(struct oval_fts_cstat));
+		if (cst == NULL)
+			return;
+
+		cst->path = strdup(path);
+		cst->hash = hash;
+		cst->next = fts_cache.stats[bucket];
+		fts_cache.stats[bucket] = cst;
+		++fts_cache.count;
+	}
+
+	if (follow) {
+		cst->st = *st;
+		cst->stat_err = err;
+		cst->have_stat = true;
+	} else {
+		cst->lst = *st;
+		cst->lstat_err = err;
+		cst->have_lstat = true;
+	}
+}
+
+int oval_fts_cache_lstat(const char *path, struct stat *st)
+{
+	int err;
+
+	if (!oval_fts_cache_ready())
+		return lstat(path, st);
+
+	pthread_mutex_lock(&fts_cache.lock);
+	if (oval_fts_cache_lookup_lstat(path, st, &err)) {
+		pthread_mutex_unlock(&fts_cache.lock);
+		if (err != 0) {
+			errno = err;
+			return -1;
+		}
+		return 0;
+	}
+	pthread_mutex_unlock(&fts_cache.lock);
+
+	err = lstat(path, st) == -1 ? errno : 0;
+
+	pthread_mutex_lock(&fts_cache.lock);
+	oval_fts_cache_store_stat(path, st, err, false);
+	pthread_mutex_unlock(&fts_cache.lock);
+
+	if (err != 0) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+int oval_fts_cache_stat(const char *path, struct stat *st)
+{
+	struct oval_fts_cstat *cst;
+	int err;
+
+	if (!oval_fts_cache_ready())
+		return stat(path, st);
+
+	pthread_mutex_lock(&fts_cache.lock);
+	cst = oval_fts_cache_find_stat(path, oval_fts_cache_hash(path));
+	if (cst != NULL && cst->have_stat) {
+		*st = cst->st;
+		err = cst->stat_err;
+		pthread_mutex_unlock(&fts_cache.lock);
+		goto out;
+	}
+
+	/* stat() and lstat() give the same result unless the path is a symlink */
+	if (oval_fts_cache_lookup_lstat(path, st, &err)
+	    && (err == ENOENT || (err == 0 && !S_ISLNK(st->st_mode)))) {
+		pthread_mutex_unlock(&fts_cache.lock);
+		goto out;
+	}
+	pthread_mutex_unlock(&fts_cache.lock);
+
+	err = stat(path, st) == -1 ? errno : 0;
+
+	pthread_mutex_lock(&fts_cache.lock);
+	oval_fts_cache_store_stat(path, st, err, true);
+	pthread_mutex_unlock(&fts_cache.lock);
+out:
+	if (err != 0) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+static int oval_fts_info(const struct stat *st)
+{
+	if (S_ISDIR(st->st_mode))
+		return FTS_D;
+	if (S_ISLNK(st->st_mode))
+		return FTS_SL;
+	if (S_ISREG(st->st_mode))
+		return FTS_F;
+	return FTS_DEFAULT;
+}
+
+/* A directory which is also one of its ancestors is a cycle */
+static bool oval_fts_walk_cycle(OVAL_FTS_WALK *walk, const struct stat *st)
+{
+	for (size_t i = 0; i < walk->depth; ++i) {
+		const struct stat *ast = walk->stack[i].dir->fts_statp;
+
+		if (ast->st_ino == st->st_ino && ast->st_dev == st->st_dev)
+			return true;
+	}
+
+	return false;
+}
+
+static OVAL_FTS_WALKENT *oval_fts_walkent_new(const char *dir, const char *name)
+{
+	OVAL_FTS_WALKENT *ent;
+	size_t dlen, nlen;
+
+	ent = calloc(1, sizeof(OVAL_FTS_WALKENT));
+	if (ent == NULL)
+		return NULL;
+
+	nlen = strlen(name);
+	if (dir == NULL) {
+		const char *base = strrchr(name, '/');
+
+		ent->fts_path = strdup(name);
+		ent->fts_pathlen = nlen;
+		/* fts(3) names the root after the last path component */
+		if (ent->fts_path != NULL && base != NULL && nlen > 1) {
+			ent->fts_name = ent->fts_path + (base - name) + 1;
+			nlen -= (base - name) + 1;
+		} else {
+			ent->fts_name = ent->fts_path;
+		}
+	} else {
+		dlen = strlen(dir);
+		/* Avoid 2 slashes */
+		if (dlen > 0 && dir[dlen - 1] == '/')
+			--dlen;
+
+		ent->fts_path = malloc(dlen + nlen + 2);
+		if (ent->fts_path != NULL) {
+			memcpy(ent->fts_path, dir, dlen);
+			ent->fts_path[dlen] = '/';
+			memcpy(ent->fts_path + dlen + 1, name, nlen + 1);
+		}
+		ent->fts_pathlen = dlen + nlen + 1;
+		ent->fts_name = ent->fts_path + dlen + 1;
+	}
+
+	if (ent->fts_path == NULL) {
+		free(ent);
+		return NULL;
+	}
+
+	ent->fts_namelen = nlen;
+	ent->fts_statp = &ent->fts_stat;
+
+	return ent;
+}
+
+static void oval_fts_walkent_free(OVAL_FTS_WALKENT *ent)
+{
+	if (ent == NULL)
+		return;
+	free(ent->fts_path);
+	free(ent);
+}
+
+/* Follow the symlink, the entry keeps the lstat() result if it's dangling */
+static void oval_fts_walk_follow(OVAL_FTS_WALK *walk, OVAL_FTS_WALKENT *ent)
+{
+	struct stat st;
+
+	if (oval_fts_cache_stat(ent->fts_path, &st) == 0) {
+		ent->fts_stat = st;
+		ent->fts_info = oval_fts_info(&st);
+		if (ent->fts_info == FTS_D && oval_fts_walk_cycle(walk, &st))
+			ent->fts_info = FTS_DC;
+	} else {
+		ent->fts_errno = errno;
+		ent->fts_info = FTS_SLNONE;
+	}
+}
+
+OVAL_FTS_WALK *oval_fts_walk_open(const char *path, int options)
+{
+	OVAL_FTS_WALK *walk;
+	OVAL_FTS_WALKENT *root;
+
+	root = oval_fts_walkent_new(NULL, path);
+	if (root == NULL)
+		return NULL;
+
+	if (options & FTS_COMFOLLOW) {
+		if (oval_fts_cache_stat(path, &root->fts_stat) == 0) {
+			root->fts_info = oval_fts_info(&root->fts_stat);
+		} else if (errno == ENOENT && oval_fts_cache_lstat(path, &root->fts_stat) == 0) {
+			root->fts_info = FTS_SLNONE;
+		} else {
+			int err = errno;
+
+			oval_fts_walkent_free(root);
+			errno = err;
+			return NULL;
+		}
+	} else {
+		if (oval_fts_cache_lstat(path, &root->fts_stat) == -1) {
+			int err = errno;
+
+			oval_fts_walkent_free(root);
+			errno = err;
+			return NULL;
+		}
+		root->fts_info = oval_fts_info(&root->fts_stat);
+	}
+
+	walk = calloc(1, sizeof(OVAL_FTS_WALK));
+	if (walk == NULL) {
+		oval_fts_walkent_free(root);
+		return NULL;
+	}
+
+	walk->options = options;
+	walk->rootdev = root->fts_stat.st_dev;
+	walk->root = root;
+
+	return walk;
+}
+
+void oval_fts_walk_set(OVAL_FTS_WALKENT *ent, int instr)
+{
+	if (ent != NULL)
+		ent->fts_instr = instr;
+}
+
+static bool oval_fts_walk_push(OVAL_FTS_WALK *walk, OVAL_FTS_WALKENT *dir, struct oval_fts_cdir *list)
+{
+	if (walk->depth == walk->size) {
+		size_t size = walk->size == 0 ? 16 : walk->size * 2;
+		void *stack = realloc(walk->stack, size * sizeof(struct oval_fts_frame));
+
+		if (stack == NULL)
+			return false;
+		walk->stack = stack;
+		walk->size = size;
+	}
+
+	walk->stack[walk->depth].dir = dir;
+	walk->stack[walk->depth].list = list;
+	walk->stack[walk->depth].next = 0;
+	++walk->depth;
+
+	return true;
+}
+
+OVAL_FTS_WALKENT *oval_fts_walk_read(OVAL_FTS_WALK *walk)
+{
+	OVAL_FTS_WALKENT *ent;
+
+	if (walk->root != NULL) {
+		walk->cur = walk->root;
+		walk->root = NULL;
+		return walk->cur;
+	}
+
+	ent = walk->cur;
+	if (ent == NULL && walk->depth == 0)
+		return NULL;
+
+	if (ent != NULL) {
+		int instr = ent->fts_instr;
+
+		ent->fts_instr = 0;
+
+		switch (instr) {
+		case FTS_AGAIN:
+			return ent;
+		case FTS_FOLLOW:
+			if (ent->fts_info == FTS_SL || ent->fts_info == FTS_SLNONE) {
+				oval_fts_walk_follow(walk, ent);
+				return ent;
+			}
+			break;
+		}
+
+		if (ent->fts_info == FTS_D) {
+			struct oval_fts_cdir *list;
+
+			if (instr == FTS_SKIP
+			    || ((walk->options & FTS_XDEV) && ent->fts_stat.st_dev != walk->rootdev)) {
+				ent->fts_info = FTS_DP;
+				return ent;
+			}
+
+			list = oval_fts_cache_readdir(ent->fts_path);
+			if (list == NULL || (list->err != 0 && list->count == 0)) {
+				ent->fts_errno = list != NULL ? list->err : ENOMEM;
+				ent->fts_info = FTS_DNR;
+				if (list != NULL)
+					oval_fts_cdir_release(list);
+				return ent;
+			}
+			if (list->count == 0) {
+				oval_fts_cdir_release(list);
+				ent->fts_info = FTS_DP;
+				return ent;
+			}
+			if (!oval_fts_walk_push(walk, ent, list)) {
+				oval_fts_cdir_release(list);
+				ent->fts_errno = ENOMEM;
+				ent->fts_info = FTS_DNR;
+				return ent;
+			}
+		} else {
+			oval_fts_walkent_free(ent);
+		}
+		walk->cur = NULL;
+	}
+
+	while (walk->depth > 0) {
+		struct oval_fts_frame *frame = &walk->stack[walk->depth - 1];
+
+		if (frame->next < frame->list->count) {
+			struct oval_fts_cdirent *cent = &frame->list->ents[frame->next++];
+
+			ent = oval_fts_walkent_new(frame->dir->fts_path, cent->name);
+			if (ent == NULL)
+				return NULL;
+
+			ent->fts_level = frame->dir->fts_level + 1;
+			if (cent->err != 0) {
+				ent->fts_errno = cent->err;
+				ent->fts_info = FTS_NS;
+			} else {
+				ent->fts_stat = cent->st;
+				ent->fts_info = oval_fts_info(&cent->st);
+				if (ent->fts_info == FTS_D && oval_fts_walk_cycle(walk, &cent->st))
+					ent->fts_info = FTS_DC;
+			}
+
+			walk->cur = ent;
+			return ent;
+		}
+
+		/* All the children were returned, the directory goes in postorder */
+		oval_fts_cdir_release(frame->list);
+		--walk->depth;
+
+		ent = frame->dir;
+		ent->fts_info = FTS_DP;
+		walk->cur = ent;
+		return ent;
+	}
+
+	return NULL;
+}
+
+void oval_fts_walk_close(OVAL_FTS_WALK *walk)
+{
+	if (walk == NULL)
+		return;
+
+	while (walk->depth > 0) {
+		--walk->depth;
+		oval_fts_cdir_release(walk->stack[walk->depth].list);
+		oval_fts_walkent_free(walk->stack[walk->depth].dir);
+	}
+
+	oval_fts_walkent_free(walk->root);
+	oval_fts_walkent_free(walk->cur);
+	free(walk->stack);
+	free(walk);
+}
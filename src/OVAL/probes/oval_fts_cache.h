@@ -0,0 +1,103 @@
+/**
+ * @file oval_fts_cache.h
+ * @brief Directory entry and stat cache shared by the file based probes
+ */
+
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef OVAL_FTS_CACHE_H
+#define OVAL_FTS_CACHE_H
+
+#include "oscap_platforms.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(OS_SOLARIS) || defined(OS_AIX)
+#include "fts_sun.h"
+#else
+#include <fts.h>
+#endif
+
+/*
+ * Maximum number of directory entries and stat results kept in the
+ * cache. Directories read after the limit is reached are walked
+ * without being cached.
+ */
+#define OVAL_FTS_CACHE_MAX_ENTRIES 131072
+
+/*
+ * The walk emulates fts(3) opened with FTS_PHYSICAL|FTS_NOCHDIR over
+ * a single root. FTS_COMFOLLOW and FTS_XDEV options are honored and
+ * the entries carry the usual fts_info values. The same directory
+ * listings and stat results are served to all the walks in the process
+ * until the cache is invalidated.
+ */
+typedef struct oval_fts_walk OVAL_FTS_WALK;
+
+typedef struct {
+	char *fts_path;
+	size_t fts_pathlen;
+	char *fts_name;		///< points into fts_path
+	size_t fts_namelen;
+	int fts_info;
+	int fts_errno;
+	int fts_level;
+	struct stat *fts_statp;
+
+	/* walk private */
+	struct stat fts_stat;
+	int fts_instr;
+} OVAL_FTS_WALKENT;
+
+/**
+ * Start a walk at the path.
+ * @return the walk or NULL with errno set if the path can't be stat'ed
+ */
+OVAL_FTS_WALK *oval_fts_walk_open(const char *path, int options);
+
+/**
+ * Get the next entry of the walk. The entry is valid until the next call
+ * on the same walk.
+ * @return the entry or NULL at the end of the walk
+ */
+OVAL_FTS_WALKENT *oval_fts_walk_read(OVAL_FTS_WALK *walk);
+
+/**
+ * Set FTS_AGAIN, FTS_FOLLOW or FTS_SKIP instruction for the next read.
+ */
+void oval_fts_walk_set(OVAL_FTS_WALKENT *ent, int instr);
+
+void oval_fts_walk_close(OVAL_FTS_WALK *walk);
+
+/**
+ * stat(2) and lstat(2) served from the cache, if possible.
+ */
+int oval_fts_cache_stat(const char *path, struct stat *st);
+int oval_fts_cache_lstat(const char *path, struct stat *st);
+
+/**
+ * Drop everything cached so far. Walks in progress keep the listings
+ * they have already read.
+ */
+void oval_fts_cache_invalidate(void);
+
+#endif /* OVAL_FTS_CACHE_H */
@@ -0,0 +1,714 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "debug_priv.h"
+#include "oval_proc_snapshot.h"
+
+#if defined(OS_LINUX)
+
+#ifdef HAVE_STDIO_EXT_H
+# include <stdio_ext.h>
+#endif
+#include <dirent.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <limits.h>
+
+#ifdef SELINUX_FOUND
+#include <selinux/selinux.h>
+#include <selinux/context.h>
+#endif
+
+#include "common/oscap_buffer.h"
+
+#define PROC_LOADED_CMDLINE     0x01
+#define PROC_LOADED_UIDS        0x02
+#define PROC_LOADED_EXEC_SHIELD 0x04
+#define PROC_LOADED_SELINUX     0x08
+#define PROC_LOADED_SCHED       0x10
+
+#define CHUNK_SIZE 1024
+
+struct oval_proc_snapshot {
+	pthread_mutex_t lock;	///< serializes the on demand loading
+	unsigned int refs;	///< protected by proc_snapshot.lock
+
+	unsigned long boot;
+	unsigned long ticks;
+
+	OVAL_PROC_ENTRY *procs;
+	size_t count;
+
+	/* socket inode -> owner index, built on demand */
+	bool have_sockets;
+	bool fd_denied;
+	struct oval_proc_socket *sockets;
+	size_t socket_mask;
+};
+
+struct oval_proc_socket {
+	unsigned long inode;	///< 0 for an empty slot
+	OVAL_PROC_ENTRY *owner;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	OVAL_PROC_SNAPSHOT *snap;
+} proc_snapshot = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static unsigned long get_boot_time(void)
+{
+	char buf[100];
+	FILE *sf;
+	int line;
+	unsigned long boot = 0;
+
+	sf = fopen("/proc/stat", "rt");
+	if (sf == NULL)
+		return 0;
+
+	line = 0;
+	__fsetlocking(sf, FSETLOCKING_BYCALLER);
+	while (fgets(buf, sizeof(buf), sf)) {
+		if (line == 0) {
+			line++;
+			continue;
+		}
+		if (memcmp(buf, "btime", 5) == 0) {
+			sscanf(buf, "btime %lu", &boot);
+			break;
+		}
+	}
+	fclose(sf);
+
+	return boot;
+}
+
+static void oval_proc_snapshot_free(OVAL_PROC_SNAPSHOT *snap)
+{
+	for (size_t i = 0; i < snap->count; ++i) {
+		free(snap->procs[i].cmdline);
+		free(snap->procs[i].selinux_label);
+	}
+	free(snap->procs);
+	free(snap->sockets);
+	pthread_mutex_destroy(&snap->lock);
+	free(snap);
+}
+
+/* Parse up the stat file of the process */
+static int read_stat(int pid, OVAL_PROC_ENTRY *ent)
+{
+	int fd, len;
+	char buf[256];
+	char *tmp;
+	int pgrp, tpgid;
+	unsigned flags;
+	unsigned long minflt, cminflt, majflt, cmajflt;
+	long cutime, cstime, cnice, nthreads, itrealvalue;
+
+	snprintf(buf, 32, "/proc/%d/stat", pid);
+	fd = open(buf, O_RDONLY, 0);
+	if (fd < 0)
+		return -1;
+	len = read(fd, buf, sizeof buf - 1);
+	close(fd);
+	if (len < 40)
+		return -1;
+	buf[len] = 0;
+	tmp = strrchr(buf, ')');
+	if (tmp)
+		*tmp = 0;
+	else
+		return -1;
+
+	memset(ent, 0, sizeof(OVAL_PROC_ENTRY));
+	ent->pid = pid;
+	sscanf(buf, "%*d (%15c", ent->comm);
+	sscanf(tmp+2,	"%c %d %d %d %d %d "
+			"%u %lu %lu %lu %lu "
+			"%lu %lu %lu %ld %ld "
+			"%ld %ld %ld %llu",
+		&ent->state, &ent->ppid, &pgrp, &ent->session, &ent->tty_nr, &tpgid,
+		&flags, &minflt, &cminflt, &majflt, &cmajflt,
+		&ent->utime, &ent->stime, &cutime, &cstime, &ent->priority,
+		&cnice, &nthreads, &itrealvalue, &ent->start
+	);
+
+	return 0;
+}
+
+static OVAL_PROC_SNAPSHOT *oval_proc_snapshot_new(void)
+{
+	OVAL_PROC_SNAPSHOT *snap;
+	OVAL_PROC_ENTRY *procs;
+	size_t size = 0;
+	DIR *d;
+	struct dirent *ent;
+
+	d = opendir("/proc");
+	if (d == NULL) {
+		dE("Can't open /proc: %s", strerror(errno));
+		return NULL;
+	}
+
+	snap = calloc(1, sizeof(OVAL_PROC_SNAPSHOT));
+	if (snap == NULL) {
+		closedir(d);
+		return NULL;
+	}
+
+	pthread_mutex_init(&snap->lock, NULL);
+	snap->refs = 1;
+	// Get the time tick hertz
+	snap->ticks = (unsigned long)sysconf(_SC_CLK_TCK);
+	snap->boot = get_boot_time();
+
+	// Scan the directories
+	while (( ent = readdir(d) )) {
+		int pid;
+
+		// Skip non-process dir entries
+		if(*ent->d_name<'0' || *ent->d_name>'9')
+			continue;
+		errno = 0;
+		pid = strtol(ent->d_name, NULL, 10);
+		if (errno || pid == 2) // skip err & kthreads
+			continue;
+
+		if (snap->count == size) {
+			size = size > 0 ? size * 2 : 256;
+			procs = realloc(snap->procs, size * sizeof(OVAL_PROC_ENTRY));
+			if (procs == NULL) {
+				closedir(d);
+				oval_proc_snapshot_free(snap);
+				return NULL;
+			}
+			snap->procs = procs;
+		}
+
+		if (read_stat(pid, &snap->procs[snap->count]) != 0)
+			continue;
+
+		// Skip kthreads
+		if (snap->procs[snap->count].ppid == 2)
+			continue;
+
+		++snap->count;
+	}
+	closedir(d);
+
+	dD("Process snapshot: %zu processes.", snap->count);
+
+	return snap;
+}
+
+OVAL_PROC_SNAPSHOT *oval_proc_snapshot_get(void)
+{
+	OVAL_PROC_SNAPSHOT *snap;
+
+	pthread_mutex_lock(&proc_snapshot.lock);
+	if (proc_snapshot.snap == NULL) {
+		/* the sweep is done under the lock so that it's done only once */
+		proc_snapshot.snap = oval_proc_snapshot_new();
+	}
+	snap = proc_snapshot.snap;
+	if (snap != NULL)
+		++snap->refs;
+	pthread_mutex_unlock(&proc_snapshot.lock);
+
+	return snap;
+}
+
+void oval_proc_snapshot_release(OVAL_PROC_SNAPSHOT *snap)
+{
+	if (snap == NULL)
+		return;
+
+	pthread_mutex_lock(&proc_snapshot.lock);
+	if (--snap->refs == 0)
+		oval_proc_snapshot_free(snap);
+	pthread_mutex_unlock(&proc_snapshot.lock);
+}
+
+void oval_proc_snapshot_invalidate(void)
+{
+	OVAL_PROC_SNAPSHOT *snap;
+
+	pthread_mutex_lock(&proc_snapshot.lock);
+	snap = proc_snapshot.snap;
+	proc_snapshot.snap = NULL;
+	if (snap != NULL && --snap->refs == 0)
+		oval_proc_snapshot_free(snap);
+	pthread_mutex_unlock(&proc_snapshot.lock);
+}
+
+size_t oval_proc_snapshot_count(const OVAL_PROC_SNAPSHOT *snap)
+{
+	return snap->count;
+}
+
+OVAL_PROC_ENTRY *oval_proc_snapshot_at(OVAL_PROC_SNAPSHOT *snap, size_t i)
+{
+	return i < snap->count ? &snap->procs[i] : NULL;
+}
+
+unsigned long oval_proc_snapshot_boot(const OVAL_PROC_SNAPSHOT *snap)
+{
+	return snap->boot;
+}
+
+unsigned long oval_proc_snapshot_ticks(const OVAL_PROC_SNAPSHOT *snap)
+{
+	return snap->ticks;
+}
+
+/**
+ * Parse /proc/%d/cmdline file
+ * @return ps-like command info or NULL
+ */
+static char *read_cmdline(int pid)
+{
+	char filepath[32];
+	struct oscap_buffer *buffer;
+	int fd;
+
+	snprintf(filepath, sizeof filepath, "/proc/%d/cmdline", pid);
+	fd = open(filepath, O_RDONLY, 0);
+
+	if (fd < 0) {
+		return NULL;
+	}
+
+	buffer = oscap_buffer_new();
+
+	for(;;) {
+		char chunk[CHUNK_SIZE];
+		// Read data, store to buffer
+		ssize_t read_size = read(fd, chunk, CHUNK_SIZE);
+		if (read_size < 0) {
+			close(fd);
+			oscap_buffer_free(buffer);
+			return NULL;
+		}
+		oscap_buffer_append_binary_data(buffer, chunk, read_size);
+
+		// If reach end of file, then end the loop
+		if (CHUNK_SIZE != read_size) {
+			break;
+		}
+	}
+
+	close(fd);
+
+	int length = oscap_buffer_get_length(buffer);
+	char* buffer_mem = oscap_buffer_get_raw(buffer);
+
+	if ( length == 0 ) { // empty file
+		oscap_buffer_free(buffer);
+		return NULL;
+	}
+
+	// Skip multiple trailing zeros
+	int i = length - 1;
+	while ( (i > 0) && (buffer_mem[i] == '\0') ) {
+		--i;
+	}
+
+	// Program and args are separated by '\0'
+	// Replace them with spaces ' '
+	while( i >= 0 ){
+		char chr = buffer_mem[i];
+		if ( ( chr == '\0') || ( chr == '\n' ) ) {
+			buffer_mem[i] = ' ';
+		} else if ( !isprint(chr) ) { // "ps" replace non-printable characters with '.' (LC_ALL=C)
+			buffer_mem[i] = '.';
+		}
+		--i;
+	}
+
+	return oscap_buffer_bequeath(buffer);
+}
+
+const char *oval_proc_entry_cmdline(OVAL_PROC_SNAPSHOT *snap, OVAL_PROC_ENTRY *ent)
+{
+	pthread_mutex_lock(&snap->lock);
+	if (!(ent->loaded & PROC_LOADED_CMDLINE)) {
+		ent->cmdline = read_cmdline(ent->pid);
+		ent->loaded |= PROC_LOADED_CMDLINE;
+	}
+	pthread_mutex_unlock(&snap->lock);
+
+	return ent->cmdline;
+}
+
+static void read_uids(OVAL_PROC_ENTRY *ent)
+{
+	char buf[100];
+	FILE *sf;
+
+	ent->ruid = -1;
+	ent->euid = -1;
+	ent->loginuid = -1;
+
+	snprintf(buf, sizeof(buf), "/proc/%d/status", ent->pid);
+	sf = fopen(buf, "rt");
+	if (sf) {
+		int line = 0;
+		__fsetlocking(sf, FSETLOCKING_BYCALLER);
+		while (fgets(buf, sizeof(buf), sf)) {
+			if (line == 0) {
+				line++;
+				continue;
+			}
+			if (memcmp(buf, "Uid:", 4) == 0) {
+				sscanf(buf, "Uid: %d %d", &ent->ruid, &ent->euid);
+				break;
+			}
+		}
+		fclose(sf);
+	}
+
+	snprintf(buf, sizeof(buf), "/proc/%d/loginuid", ent->pid);
+	sf = fopen(buf, "rt");
+	if (sf) {
+		if (fscanf(sf, "%u", &ent->loginuid) < 1) {
+			dW("fscanf failed from %s", buf);
+		}
+		fclose(sf);
+	}
+}
+
+void oval_proc_entry_uids(OVAL_PROC_SNAPSHOT *snap, OVAL_PROC_ENTRY *ent)
+{
+	pthread_mutex_lock(&snap->lock);
+	if (!(ent->loaded & PROC_LOADED_UIDS)) {
+		read_uids(ent);
+		ent->loaded |= PROC_LOADED_UIDS;
+	}
+	pthread_mutex_unlock(&snap->lock);
+}
+
+static int read_exec_shield_status(int pid)
+{
+	char buf[501];
+	FILE *sf;
+	long unsigned low, high, inode;
+	long long unsigned offset;
+	int dev_min, dev_maj;
+	char perm[3], trim;
+	int ret = -1, read_items;
+
+	snprintf(buf, sizeof(buf), "/proc/%d/maps", pid);
+	sf = fopen(buf, "rt");
+	if (sf) {
+		while (fgets(buf, 500, sf)) {
+			read_items = sscanf(
+				buf, "%lx-%lx rw%s %llx %x:%x %lu %c\n",
+				&low, &high, perm, &offset, &dev_min,
+				&dev_maj, &inode, &trim
+			);
+			if (read_items == 7) {
+				if (perm[0] == 'x' && offset != 0) {
+					ret = 0;
+				}
+				else {
+					ret = 1;
+				}
+			}
+		}
+		fclose(sf);
+	}
+
+	return ret;
+}
+
+int oval_proc_entry_exec_shield(OVAL_PROC_SNAPSHOT *snap, OVAL_PROC_ENTRY *ent)
+{
+	int ret;
+
+	pthread_mutex_lock(&snap->lock);
+	if (!(ent->loaded & PROC_LOADED_EXEC_SHIELD)) {
+		ent->exec_shield = read_exec_shield_status(ent->pid);
+		ent->loaded |= PROC_LOADED_EXEC_SHIELD;
+	}
+	ret = ent->exec_shield;
+	pthread_mutex_unlock(&snap->lock);
+
+	return ret;
+}
+
+#ifdef SELINUX_FOUND
+static char *read_selinux_label(int pid) {
+	char *selinux_label;
+	security_context_t pid_context;
+	context_t context;
+
+	if (is_selinux_enabled() == 1) {
+		if (getpidcon(pid, &pid_context) == -1) {
+			/* error getting pid selinux context */
+			dW("Can't get selinux context for process %d", pid);
+			return NULL;
+		}
+		context = context_new(pid_context);
+		if (context == NULL) {
+			// There must be 3 or 4 colon-separated components and no
+			// whitespace in any component other than the MLS
+			// component.
+			freecon(pid_context);
+			return NULL;
+		}
+		selinux_label = strdup(context_type_get(context));
+		context_free(context);
+		freecon(pid_context);
+		return selinux_label;
+	} else {
+		return NULL;
+	}
+}
+#else
+static char *read_selinux_label(int pid) {
+	return NULL;
+}
+#endif /* SELINUX_FOUND */
+
+const char *oval_proc_entry_selinux_label(OVAL_PROC_SNAPSHOT *snap, OVAL_PROC_ENTRY *ent)
+{
+	pthread_mutex_lock(&snap->lock);
+	if (!(ent->loaded & PROC_LOADED_SELINUX)) {
+		ent->selinux_label = read_selinux_label(ent->pid);
+		ent->loaded |= PROC_LOADED_SELINUX;
+	}
+	pthread_mutex_unlock(&snap->lock);
+
+	return ent->selinux_label;
+}
+
+static const char *read_sched_class(int pid)
+{
+	switch (sched_getscheduler(pid)) {
+		case SCHED_OTHER:
+			return "TS";
+		case SCHED_BATCH:
+			return "B";
+#ifdef SCHED_IDLE
+		case SCHED_IDLE:
+			return "#5";
+#endif
+		case SCHED_FIFO:
+			return "FF";
+		case SCHED_RR:
+			return "RR";
+		default:
+			return "?";
+	}
+}
+
+const char *oval_proc_entry_sched_class(OVAL_PROC_SNAPSHOT *snap, OVAL_PROC_ENTRY *ent)
+{
+	pthread_mutex_lock(&snap->lock);
+	if (!(ent->loaded & PROC_LOADED_SCHED)) {
+		ent->sched_class = read_sched_class(ent->pid);
+		ent->loaded |= PROC_LOADED_SCHED;
+	}
+	pthread_mutex_unlock(&snap->lock);
+
+	return ent->sched_class;
+}
+
+static int read_socket_inodes(OVAL_PROC_ENTRY *proc, struct oval_proc_socket **socks, size_t *count, size_t *size, bool *denied)
+{
+	DIR *f;
+	struct dirent *ent;
+	char buf[32];
+
+	// Now lets get the inodes each process has open
+	snprintf(buf, sizeof buf, "/proc/%d/fd", proc->pid);
+	f = opendir(buf);
+	if (f == NULL) {
+		if (errno == EACCES) {
+			/* Need DAC_OVERRIDE permission */
+			*denied = true;
+		}
+		// Process might have ended or something - ignore it
+		return 0;
+	}
+	// For each file in the fd dir...
+	while (( ent = readdir(f) )) {
+		char line[PATH_MAX], *s, *e;
+		unsigned long inode;
+		int lnlen;
+
+		if (ent->d_name[0] == '.')
+			continue;
+		if ((lnlen = readlinkat(dirfd(f), ent->d_name, line, sizeof(line)-1)) < 0)
+			continue;
+		line[lnlen] = 0;
+
+		// Only look at the socket entries
+		if (memcmp(line, "socket:", 7) == 0) {
+			// Type 1 sockets
+			s = strchr(line+7, '[');
+			if (s == NULL)
+				continue;
+			s++;
+			e = strchr(s, ']');
+			if (e == NULL)
+				continue;
+			*e = 0;
+		} else if (memcmp(line, "[0000]:", 7) == 0) {
+			// Type 2 sockets
+			s = line + 8;
+		} else
+			continue;
+		errno = 0;
+		inode = strtoul(s, NULL, 10);
+		if (errno || inode == 0)
+			continue;
+
+		if (*count == *size) {
+			struct oval_proc_socket *tmp;
+
+			*size = *size > 0 ? *size * 2 : 1024;
+			tmp = realloc(*socks, *size * sizeof(struct oval_proc_socket));
+			if (tmp == NULL) {
+				closedir(f);
+				return -1;
+			}
+			*socks = tmp;
+		}
+		(*socks)[*count].inode = inode;
+		(*socks)[*count].owner = proc;
+		++(*count);
+	}
+	closedir(f);
+
+	return 0;
+}
+
+/* The snapshot lock has to be held */
+static void build_socket_index(OVAL_PROC_SNAPSHOT *snap)
+{
+	struct oval_proc_socket *socks = NULL;
+	size_t count = 0, size = 0, i, slots;
+
+	snap->have_sockets = true;
+
+	for (i = 0; i < snap->count; ++i) {
+		if (read_socket_inodes(&snap->procs[i], &socks, &count, &size, &snap->fd_denied) != 0) {
+			dE("Can't index the socket inodes: %s", strerror(errno));
+			free(socks);
+			return;
+		}
+	}
+
+	for (slots = 64; slots < count * 2; slots *= 2)
+		;
+
+	snap->sockets = calloc(slots, sizeof(struct oval_proc_socket));
+	if (snap->sockets == NULL) {
+		free(socks);
+		return;
+	}
+	snap->socket_mask = slots - 1;
+
+	for (i = 0; i < count; ++i) {
+		unsigned long inode = socks[i].inode;
+		size_t b = inode & snap->socket_mask;
+
+		/* linear probing, the first process found owns the socket */
+		while (snap->sockets[b].inode != 0 && snap->sockets[b].inode != inode)
+			b = (b + 1) & snap->socket_mask;
+
+		if (snap->sockets[b].inode == 0)
+			snap->sockets[b] = socks[i];
+	}
+	free(socks);
+
+	dD("Socket index: %zu descriptors.", count);
+}
+
+OVAL_PROC_ENTRY *oval_proc_snapshot_socket_owner(OVAL_PROC_SNAPSHOT *snap, unsigned long inode)
+{
+	OVAL_PROC_ENTRY *owner = NULL;
+
+	pthread_mutex_lock(&snap->lock);
+	if (!snap->have_sockets)
+		build_socket_index(snap);
+
+	if (snap->sockets != NULL && inode != 0) {
+		size_t b = inode & snap->socket_mask;
+
+		while (snap->sockets[b].inode != 0) {
+			if (snap->sockets[b].inode == inode) {
+				owner = snap->sockets[b].owner;
+				break;
+			}
+			b = (b + 1) & snap->socket_mask;
+		}
+	}
+	pthread_mutex_unlock(&snap->lock);
+
+	return owner;
+}
+
+bool oval_proc_snapshot_fd_denied(OVAL_PROC_SNAPSHOT *snap)
+{
+	bool denied;
+
+	pthread_mutex_lock(&snap->lock);
+	if (!snap->have_sockets)
+		build_socket_index(snap);
+	denied = snap->fd_denied;
+	pthread_mutex_unlock(&snap->lock);
+
+	return denied;
+}
+
+#else /* OS_LINUX */
+
+OVAL_PROC_SNAPSHOT *oval_proc_snapshot_get(void)
+{
+	return NULL;
+}
+
+void oval_proc_snapshot_release(OVAL_PROC_SNAPSHOT *snap)
+{
+}
+
+void oval_proc_snapshot_invalidate(void)
+{
+}
+
+#endif /* OS_LINUX */
@@ -0,0 +1,133 @@
+/**
+ * @file oval_proc_snapshot.h
+ * @brief Process table snapshot shared by the process probes
+ */
+
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef OVAL_PROC_SNAPSHOT_H
+#define OVAL_PROC_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * The /proc directory is swept once per scan. The fields of
+ * /proc/<pid>/stat are parsed by the sweep, everything else is read
+ * when it's asked for the first time and kept for the rest of the scan.
+ */
+typedef struct oval_proc_snapshot OVAL_PROC_SNAPSHOT;
+
+typedef struct {
+	int pid;
+	int ppid;
+	int session;
+	int tty_nr;
+	char state;
+	long priority;
+	unsigned long utime;	///< in clock ticks
+	unsigned long stime;	///< in clock ticks
+	unsigned long long start;	///< in clock ticks since boot
+	char comm[16];
+
+	/* loaded on demand, see the accessors below */
+	unsigned int loaded;
+	char *cmdline;
+	int ruid;
+	int euid;
+	unsigned int loginuid;
+	int exec_shield;
+	char *selinux_label;
+	const char *sched_class;
+} OVAL_PROC_ENTRY;
+
+/**
+ * Get the snapshot of the current scan, sweep /proc if there's none.
+ * The snapshot has to be released by oval_proc_snapshot_release().
+ * @return the snapshot or NULL if /proc can't be read
+ */
+OVAL_PROC_SNAPSHOT *oval_proc_snapshot_get(void);
+
+void oval_proc_snapshot_release(OVAL_PROC_SNAPSHOT *snap);
+
+/**
+ * Number of processes in the snapshot. Kernel threads are left out.
+ */
+size_t oval_proc_snapshot_count(const OVAL_PROC_SNAPSHOT *snap);
+
+OVAL_PROC_ENTRY *oval_proc_snapshot_at(OVAL_PROC_SNAPSHOT *snap, size_t i);
+
+/**
+ * Boot time in seconds since the epoch and the clock ticks per second
+ * at the time of the sweep.
+ */
+unsigned long oval_proc_snapshot_boot(const OVAL_PROC_SNAPSHOT *snap);
+unsigned long oval_proc_snapshot_ticks(const OVAL_PROC_SNAPSHOT *snap);
+
+/**
+ * The command line with the arguments separated by spaces and
+ * the non-printable characters replaced by dots, as ps(1) shows it.
+ * @return the command line or NULL if it's empty (kernel threads,
+ * zombies) or can't be read
+ */
+const char *oval_proc_entry_cmdline(OVAL_PROC_SNAPSHOT *snap, OVAL_PROC_ENTRY *ent);
+
+/**
+ * Fill in the ruid, euid and loginuid fields of the entry. The fields
+ * which can't be read are set to -1.
+ */
+void oval_proc_entry_uids(OVAL_PROC_SNAPSHOT *snap, OVAL_PROC_ENTRY *ent);
+
+/**
+ * Exec shield status according to http://people.redhat.com/sgrubb/files/lsexec
+ * @return -1 - not detected, 0 - disabled, 1 - enabled
+ */
+int oval_proc_entry_exec_shield(OVAL_PROC_SNAPSHOT *snap, OVAL_PROC_ENTRY *ent);
+
+/**
+ * @return the SELinux domain of the process or NULL if SELinux is
+ * disabled or the context can't be read
+ */
+const char *oval_proc_entry_selinux_label(OVAL_PROC_SNAPSHOT *snap, OVAL_PROC_ENTRY *ent);
+
+/**
+ * @return the scheduling class abbreviated as by ps(1)
+ */
+const char *oval_proc_entry_sched_class(OVAL_PROC_SNAPSHOT *snap, OVAL_PROC_ENTRY *ent);
+
+/**
+ * Find the process which has the socket open. The descriptors of all the
+ * processes are read when the function is called for the first time.
+ * @return the first process found or NULL
+ */
+OVAL_PROC_ENTRY *oval_proc_snapshot_socket_owner(OVAL_PROC_SNAPSHOT *snap, unsigned long inode);
+
+/**
+ * @return true if the descriptors of some process couldn't be read
+ * because of missing permissions
+ */
+bool oval_proc_snapshot_fd_denied(OVAL_PROC_SNAPSHOT *snap);
+
+/**
+ * Drop the snapshot. Probes holding it keep their reference.
+ */
+void oval_proc_snapshot_invalidate(void);
+
+#endif /* OVAL_PROC_SNAPSHOT_H */
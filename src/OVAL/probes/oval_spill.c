@@ -0,0 +1,569 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "debug_priv.h"
+#include "oval_spill.h"
+
+#if !defined(OS_WINDOWS)
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * Segment format: the magic followed by the items. Each node of an item
+ * starts with a tag byte, optionally followed by the datatype name, and
+ * then by its value:
+ *
+ *   string: uint32 length, bytes
+ *   number: uint8 number type, 8 bytes of the value
+ *   list:   uint32 member count, members
+ *
+ * The segments are read back by the same process, so the native byte
+ * order is used.
+ */
+#define OVAL_SPILL_MAGIC     "OSP1"
+#define OVAL_SPILL_MAGIC_LEN 4
+
+#define OVAL_SPILL_TAG_STRING   0x01
+#define OVAL_SPILL_TAG_NUMBER   0x02
+#define OVAL_SPILL_TAG_LIST     0x03
+#define OVAL_SPILL_TAG_DATATYPE 0x80
+
+#define OVAL_SPILL_MAX_DEPTH    64
+#define OVAL_SPILL_BUFSIZE      (64 * 1024)
+
+struct oval_spill {
+	FILE *fp;
+	char *path;
+	size_t count;
+	char *buf;      ///< buffer for the string values
+	size_t buflen;
+	bool failed;
+};
+
+struct oval_spill_reader {
+	FILE *fp;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	char *dir;
+} spill_dir = { PTHREAD_MUTEX_INITIALIZER, NULL };
+
+static int oval_spill_reserve(char **buf, size_t *buflen, size_t len)
+{
+	char *nbuf;
+	size_t nlen;
+
+	if (len <= *buflen)
+		return 0;
+
+	for (nlen = *buflen > 0 ? *buflen : 256; nlen < len; nlen *= 2);
+
+	nbuf = realloc(*buf, nlen);
+	if (nbuf == NULL)
+		return -1;
+
+	*buf = nbuf;
+	*buflen = nlen;
+
+	return 0;
+}
+
+/* Get the directory of the segments, create it if this is the first segment */
+static char *oval_spill_dir_path(const char *base)
+{
+	char *path;
+	size_t len;
+
+	if (spill_dir.dir != NULL)
+		return spill_dir.dir;
+
+	len = strlen(base) + sizeof "/oscap-spill.XXXXXX";
+	path = malloc(len);
+	if (path == NULL)
+		return NULL;
+
+	snprintf(path, len, "%s/oscap-spill.XXXXXX", base);
+
+	if (mkdtemp(path) == NULL) {
+		dW("Can't create the spill directory under \"%s\": %s", base, strerror(errno));
+		free(path);
+		return NULL;
+	}
+
+	dI("Collected items will be spilled to \"%s\"", path);
+	spill_dir.dir = path;
+
+	return path;
+}
+
+OVAL_SPILL *oval_spill_new(void)
+{
+	const char *base;
+	char *dir, *path;
+	size_t len;
+	int fd;
+	FILE *fp;
+	OVAL_SPILL *spill;
+
+	base = getenv("OSCAP_PROBE_SPILL_DIR");
+	if (base == NULL || *base == '\0') {
+		errno = ENOTSUP;
+		return NULL;
+	}
+
+	pthread_mutex_lock(&spill_dir.lock);
+
+	dir = oval_spill_dir_path(base);
+	if (dir == NULL) {
+		pthread_mutex_unlock(&spill_dir.lock);
+		return NULL;
+	}
+
+	len = strlen(dir) + sizeof "/segment.XXXXXX";
+	path = malloc(len);
+	if (path == NULL) {
+		pthread_mutex_unlock(&spill_dir.lock);
+		return NULL;
+	}
+	snprintf(path, len, "%s/segment.XXXXXX", dir);
+
+	fd = mkstemp(path);
+	pthread_mutex_unlock(&spill_dir.lock);
+
+	if (fd < 0) {
+		dW("Can't create a spill segment in \"%s\": %s", dir, strerror(errno));
+		free(path);
+		return NULL;
+	}
+
+	fp = fdopen(fd, "w");
+	if (fp == NULL) {
+		dW("Can't open the spill segment \"%s\": %s", path, strerror(errno));
+		close(fd);
+		unlink(path);
+		free(path);
+		return NULL;
+	}
+	setvbuf(fp, NULL, _IOFBF, OVAL_SPILL_BUFSIZE);
+
+	if (fwrite(OVAL_SPILL_MAGIC, OVAL_SPILL_MAGIC_LEN, 1, fp) != 1) {
+		dW("Can't write to the spill segment \"%s\": %s", path, strerror(errno));
+		fclose(fp);
+		unlink(path);
+		free(path);
+		return NULL;
+	}
+
+	spill = calloc(1, sizeof(OVAL_SPILL));
+	if (spill == NULL) {
+		fclose(fp);
+		unlink(path);
+		free(path);
+		return NULL;
+	}
+	spill->fp = fp;
+	spill->path = path;
+
+	return spill;
+}
+
+static int oval_spill_write_node(OVAL_SPILL *spill, const SEXP_t *sexp)
+{
+	const char *datatype;
+	uint8_t tag;
+	FILE *fp = spill->fp;
+
+	switch (SEXP_typeof(sexp)) {
+	case SEXP_TYPE_STRING:
+		tag = OVAL_SPILL_TAG_STRING;
+		break;
+	case SEXP_TYPE_NUMBER:
+		tag = OVAL_SPILL_TAG_NUMBER;
+		break;
+	case SEXP_TYPE_LIST:
+		tag = OVAL_SPILL_TAG_LIST;
+		break;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+
+	datatype = SEXP_datatype(sexp);
+	if (datatype != NULL)
+		tag |= OVAL_SPILL_TAG_DATATYPE;
+
+	if (fwrite(&tag, sizeof tag, 1, fp) != 1)
+		return -1;
+
+	if (datatype != NULL) {
+		uint16_t dlen = strlen(datatype);
+
+		if (fwrite(&dlen, sizeof dlen, 1, fp) != 1 ||
+		    fwrite(datatype, dlen, 1, fp) != 1)
+			return -1;
+	}
+
+	switch (tag & ~OVAL_SPILL_TAG_DATATYPE) {
+	case OVAL_SPILL_TAG_STRING: {
+		size_t len = SEXP_string_length(sexp);
+		uint32_t slen = len;
+
+		if (len > UINT32_MAX || oval_spill_reserve(&spill->buf, &spill->buflen, len + 1) != 0)
+			return -1;
+
+		SEXP_string_cstr_r(sexp, spill->buf, spill->buflen);
+
+		if (fwrite(&slen, sizeof slen, 1, fp) != 1 ||
+		    (slen > 0 && fwrite(spill->buf, slen, 1, fp) != 1))
+			return -1;
+		break;
+	}
+	case OVAL_SPILL_TAG_NUMBER: {
+		SEXP_numtype_t type = SEXP_number_type(sexp);
+		union {
+			int64_t i;
+			double  f;
+		} val;
+
+		/* The integers are stored sign extended and truncated back when read */
+		if (type == SEXP_NUM_DOUBLE)
+			val.f = SEXP_number_getf(sexp);
+		else
+			val.i = SEXP_number_geti_64(sexp);
+
+		if (fwrite(&type, sizeof type, 1, fp) != 1 ||
+		    fwrite(&val, sizeof val, 1, fp) != 1)
+			return -1;
+		break;
+	}
+	case OVAL_SPILL_TAG_LIST: {
+		SEXP_t *memb;
+		uint32_t count = SEXP_list_length(sexp);
+
+		if (fwrite(&count, sizeof count, 1, fp) != 1)
+			return -1;
+
+		SEXP_list_foreach(memb, sexp) {
+			if (oval_spill_write_node(spill, memb) != 0) {
+				SEXP_free(memb);
+				return -1;
+			}
+		}
+		break;
+	}
+	}
+
+	return 0;
+}
+
+int oval_spill_append(OVAL_SPILL *spill, const SEXP_t *item)
+{
+	if (spill->failed)
+		return -1;
+
+	if (oval_spill_write_node(spill, item) != 0) {
+		dW("Can't write to the spill segment \"%s\": %s", spill->path, strerror(errno));
+		/* The segment may end with a partial item, it isn't written to anymore */
+		spill->failed = true;
+		return -1;
+	}
+	++spill->count;
+
+	return 0;
+}
+
+size_t oval_spill_count(const OVAL_SPILL *spill)
+{
+	return spill->count;
+}
+
+const char *oval_spill_path(const OVAL_SPILL *spill)
+{
+	return spill->path;
+}
+
+int oval_spill_close(OVAL_SPILL *spill)
+{
+	int ret = spill->failed ? -1 : 0;
+
+	if (fclose(spill->fp) != 0) {
+		dW("Can't close the spill segment \"%s\": %s", spill->path, strerror(errno));
+		ret = -1;
+	}
+	dI("Spilled %zu items to \"%s\"", spill->count, spill->path);
+
+	free(spill->buf);
+	free(spill->path);
+	free(spill);
+
+	return ret;
+}
+
+OVAL_SPILL_READER *oval_spill_reader_open(const char *path)
+{
+	OVAL_SPILL_READER *reader;
+	char magic[OVAL_SPILL_MAGIC_LEN];
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return NULL;
+	setvbuf(fp, NULL, _IOFBF, OVAL_SPILL_BUFSIZE);
+
+	if (fread(magic, sizeof magic, 1, fp) != 1 ||
+	    memcmp(magic, OVAL_SPILL_MAGIC, OVAL_SPILL_MAGIC_LEN) != 0) {
+		fclose(fp);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	reader = calloc(1, sizeof(OVAL_SPILL_READER));
+	if (reader == NULL) {
+		fclose(fp);
+		return NULL;
+	}
+	reader->fp = fp;
+
+	return reader;
+}
+
+static SEXP_t *oval_spill_read_node(OVAL_SPILL_READER *reader, int depth)
+{
+	FILE *fp = reader->fp;
+	SEXP_t *sexp = NULL;
+	char *datatype = NULL;
+	uint8_t tag;
+
+	if (depth > OVAL_SPILL_MAX_DEPTH || fread(&tag, sizeof tag, 1, fp) != 1)
+		return NULL;
+
+	if (tag & OVAL_SPILL_TAG_DATATYPE) {
+		uint16_t dlen;
+
+		if (fread(&dlen, sizeof dlen, 1, fp) != 1 ||
+		    (datatype = malloc((size_t)dlen + 1)) == NULL)
+			return NULL;
+
+		if (dlen > 0 && fread(datatype, dlen, 1, fp) != 1)
+			goto fail;
+		datatype[dlen] = '\0';
+	}
+
+	switch (tag & ~OVAL_SPILL_TAG_DATATYPE) {
+	case OVAL_SPILL_TAG_STRING: {
+		uint32_t slen;
+		char *str;
+
+		if (fread(&slen, sizeof slen, 1, fp) != 1)
+			goto fail;
+
+		str = malloc((size_t)slen + 1);
+		if (str == NULL)
+			goto fail;
+
+		if (slen > 0 && fread(str, slen, 1, fp) != 1) {
+			free(str);
+			goto fail;
+		}
+		sexp = SEXP_string_new(str, slen);
+		free(str);
+		break;
+	}
+	case OVAL_SPILL_TAG_NUMBER: {
+		SEXP_numtype_t type;
+		union {
+			int64_t i;
+			double  f;
+		} val;
+
+		if (fread(&type, sizeof type, 1, fp) != 1 ||
+		    fread(&val, sizeof val, 1, fp) != 1)
+			goto fail;
+
+		switch (type) {
+		case SEXP_NUM_BOOL:   sexp = SEXP_number_newb(val.i != 0); break;
+		case SEXP_NUM_INT8:   sexp = SEXP_number_newi_8((int8_t)val.i); break;
+		case SEXP_NUM_UINT8:  sexp = SEXP_number_newu_8((uint8_t)val.i); break;
+		case SEXP_NUM_INT16:  sexp = SEXP_number_newi_16((int16_t)val.i); break;
+		case SEXP_NUM_UINT16: sexp = SEXP_number_newu_16((uint16_t)val.i); break;
+		case SEXP_NUM_INT32:  sexp = SEXP_number_newi_32((int32_t)val.i); break;
+		case SEXP_NUM_UINT32: sexp = SEXP_number_newu_32((uint32_t)val.i); break;
+		case SEXP_NUM_INT64:  sexp = SEXP_number_newi_64(val.i); break;
+		case SEXP_NUM_UINT64: sexp = SEXP_number_newu_64((uint64_t)val.i); break;
+		case SEXP_NUM_DOUBLE: sexp = SEXP_number_newf(val.f); break;
+		default:
+			goto fail;
+		}
+		break;
+	}
+	case OVAL_SPILL_TAG_LIST: {
+		uint32_t count, i;
+
+		if (fread(&count, sizeof count, 1, fp) != 1)
+			goto fail;
+
+		sexp = SEXP_list_new(NULL);
+
+		for (i = 0; i < count; ++i) {
+			SEXP_t *memb = oval_spill_read_node(reader, depth + 1);
+
+			if (memb == NULL)
+				goto fail;
+			SEXP_list_add(sexp, memb);
+			SEXP_free(memb);
+		}
+		break;
+	}
+	default:
+		goto fail;
+	}
+
+	if (datatype != NULL) {
+		SEXP_datatype_set(sexp, datatype);
+		free(datatype);
+	}
+
+	return sexp;
+fail:
+	SEXP_free(sexp);
+	free(datatype);
+	return NULL;
+}
+
+int oval_spill_reader_next(OVAL_SPILL_READER *reader, SEXP_t **item)
+{
+	int c;
+
+	c = getc(reader->fp);
+	if (c == EOF)
+		return 0;
+	ungetc(c, reader->fp);
+
+	*item = oval_spill_read_node(reader, 0);
+	if (*item == NULL) {
+		dW("The spill segment is damaged or truncated");
+		return -1;
+	}
+
+	return 1;
+}
+
+void oval_spill_reader_close(OVAL_SPILL_READER *reader)
+{
+	if (reader == NULL)
+		return;
+
+	fclose(reader->fp);
+	free(reader);
+}
+
+void oval_spill_cleanup(void)
+{
+	char *dir;
+	DIR *d;
+	struct dirent *ent;
+
+	pthread_mutex_lock(&spill_dir.lock);
+	dir = spill_dir.dir;
+	spill_dir.dir = NULL;
+	pthread_mutex_unlock(&spill_dir.lock);
+
+	if (dir == NULL)
+		return;
+
+	d = opendir(dir);
+	if (d != NULL) {
+		while ((ent = readdir(d)) != NULL) {
+			if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+				continue;
+			if (unlinkat(dirfd(d), ent->d_name, 0) != 0)
+				dW("Can't remove the spill segment \"%s/%s\": %s", dir, ent->d_name, strerror(errno));
+		}
+		closedir(d);
+	}
+
+	if (rmdir(dir) != 0)
+		dW("Can't remove the spill directory \"%s\": %s", dir, strerror(errno));
+
+	free(dir);
+}
+
+#else
+
+OVAL_SPILL *oval_spill_new(void)
+{
+	errno = ENOTSUP;
+	return NULL;
+}
+
+int oval_spill_append(OVAL_SPILL *spill, const SEXP_t *item)
+{
+	return -1;
+}
+
+size_t oval_spill_count(const OVAL_SPILL *spill)
+{
+	return 0;
+}
+
+const char *oval_spill_path(const OVAL_SPILL *spill)
+{
+	return NULL;
+}
+
+int oval_spill_close(OVAL_SPILL *spill)
+{
+	return -1;
+}
+
+OVAL_SPILL_READER *oval_spill_reader_open(const char *path)
+{
+	errno = ENOTSUP;
+	return NULL;
+}
+
+int oval_spill_reader_next(OVAL_SPILL_READER *reader, SEXP_t **item)
+{
+	return -1;
+}
+
+void oval_spill_reader_close(OVAL_SPILL_READER *reader)
+{
+}
+
+void oval_spill_cleanup(void)
+{
+}
+
+#endif /* OS_WINDOWS */
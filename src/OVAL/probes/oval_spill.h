@@ -0,0 +1,101 @@
+/**
+ * @file oval_spill.h
+ * @brief On-disk segments of the collected items
+ */
+
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef OVAL_SPILL_H
+#define OVAL_SPILL_H
+
+#include <stddef.h>
+#include <seap.h>
+
+/*
+ * When the collected items of an object don't fit into the memory limit
+ * of the probes, the rest of the items can be appended to a segment file
+ * instead. The segments are created in a private directory under
+ * OSCAP_PROBE_SPILL_DIR and the library reads the items back one by one
+ * when it converts the collected object. The segments live until the
+ * directory is removed by oval_spill_cleanup().
+ */
+typedef struct oval_spill OVAL_SPILL;
+typedef struct oval_spill_reader OVAL_SPILL_READER;
+
+/**
+ * Create a new segment.
+ * @return the segment or NULL if spilling isn't enabled or the segment
+ *         can't be created
+ */
+OVAL_SPILL *oval_spill_new(void);
+
+/**
+ * Append an item to the segment. The item isn't consumed.
+ * @return 0 on success, -1 on a write error
+ */
+int oval_spill_append(OVAL_SPILL *spill, const SEXP_t *item);
+
+/**
+ * Get the number of items appended to the segment.
+ */
+size_t oval_spill_count(const OVAL_SPILL *spill);
+
+/**
+ * Get the path of the segment, valid until the segment is closed.
+ */
+const char *oval_spill_path(const OVAL_SPILL *spill);
+
+/**
+ * Flush and close the segment and free the handle.
+ * @return 0 on success, -1 if some of the items couldn't be written
+ */
+int oval_spill_close(OVAL_SPILL *spill);
+
+/**
+ * Open a segment for reading.
+ * @return the reader or NULL with errno set
+ */
+OVAL_SPILL_READER *oval_spill_reader_open(const char *path);
+
+/**
+ * Read the next item of the segment.
+ * @return 1 if an item was stored in *item, 0 at the end of the segment,
+ *         -1 if the segment is damaged
+ */
+int oval_spill_reader_next(OVAL_SPILL_READER *reader, SEXP_t **item);
+
+void oval_spill_reader_close(OVAL_SPILL_READER *reader);
+
+/*
+ * The items read back become system characteristics items of the library,
+ * so they're limited by the memory budget of the collected items, see
+ * probe_icache_memcheck(). The reader of the segment checks the limits
+ * every OVAL_SPILL_READ_INTERVAL items and flags the object as incomplete
+ * if they're reached.
+ */
+#define OVAL_SPILL_READ_INTERVAL   4096 /* items */
+
+/**
+ * Remove the segment directory of the process together with all
+ * the segments in it.
+ */
+void oval_spill_cleanup(void);
+
+#endif /* OVAL_SPILL_H */
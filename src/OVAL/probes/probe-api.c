@@ -114,7 +114,7 @@ SEXP_t *probe_item_new(const char *name, SEXP_t * attrs)
 
         /*
          * Allocate space for the ID which will be generated
-         * in the icache worker
+         * by the item cache
          */
 	sid  = SEXP_string_new("", 0);
 	attr = probe_attr_creat("id", sid, NULL);
@@ -679,6 +679,25 @@ SEXP_t *probe_cobj_get_items(const SEXP_t *cobj)
 	return SEXP_list_nth(cobj, 3);
 }
 
+int probe_cobj_set_spill(SEXP_t *cobj, const char *path)
+{
+	SEXP_t *spath;
+
+	if (SEXP_list_length(cobj) > 4)
+		return -1;
+
+	spath = SEXP_string_newf("%s", path);
+	SEXP_list_add(cobj, spath);
+	SEXP_free(spath);
+
+	return 0;
+}
+
+SEXP_t *probe_cobj_get_spill(const SEXP_t *cobj)
+{
+	return SEXP_list_nth(cobj, 5);
+}
+
 void probe_cobj_set_flag(SEXP_t *cobj, oval_syschar_collection_flag_t flag)
 {
 	SEXP_t *sflag, *old_sflag;
@@ -30,8 +30,9 @@
 #include <string.h>
 #include <inttypes.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
 
-#include "../SEAP/generic/rbt/rbt.h"
 #include "probe-api.h"
 #include "common/debug_priv.h"
 #include "common/memusage.h"
@@ -87,433 +88,360 @@ static void probe_icache_item_setID(SEXP_t *item, SEXP_ID_t item_ID)
         return;
 }
 
-static int icache_lookup(rbt_t *tree, int64_t item_id, probe_iqpair_t *pair) {
+#define PROBE_ICACHE_SHARD_INDEX(id) ((size_t)((id) >> 32) & (PROBE_ICACHE_SHARDS - 1))
 
-	probe_citem_t *cached = NULL;
+static int probe_icache_shard_init(probe_icache_shard_t *shard)
+{
+        shard->bucket = calloc(PROBE_ICACHE_SHARD_INITSIZE, sizeof(probe_icache_entry_t *));
 
-	if (rbt_i64_get(tree, item_id, (void**)&cached) != 0) {
-		return -1;
-	}
+        if (shard->bucket == NULL)
+                return (-1);
 
-	/*
-	* Maybe a cache HIT
-	*/
-	dI("cache HIT #1");
-
-	register uint16_t i;
-	for (i = 0; i < cached->count; ++i) {
-		SEXP_t rest1;
-		SEXP_t* rest_r1 = SEXP_list_rest_r(&rest1, pair->p.item);
-
-		SEXP_t rest2;
-		SEXP_t* rest_r2 = SEXP_list_rest_r(&rest2, cached->item[i]);
-
-		if (SEXP_deepcmp(rest_r1, rest_r2)) {
-			SEXP_free_r(&rest1);
-			SEXP_free_r(&rest2);
-			break;
-		}
+        shard->bucket_cnt = PROBE_ICACHE_SHARD_INITSIZE;
+        shard->item_cnt   = 0;
 
-		SEXP_free_r(&rest1);
-		SEXP_free_r(&rest2);
-	}
+        if (pthread_mutex_init(&shard->lock, NULL) != 0) {
+                dE("Can't initialize icache mutex: %u, %s", errno, strerror(errno));
+                free(shard->bucket);
+                return (-1);
+        }
 
-	if (i == cached->count) {
-		/*
-		* Cache MISS
-		*/
-		dI("cache MISS");
-
-		cached->item = realloc(cached->item, sizeof(SEXP_t *) * ++cached->count);
-		cached->item[cached->count - 1] = pair->p.item;
-
-		/* Assign an unique item ID */
-		probe_icache_item_setID(pair->p.item, item_id);
-	} else {
-		/*
-		* Cache HIT
-		*/
-		dI("cache HIT #2 -> real HIT");
-		SEXP_free(pair->p.item);
-		pair->p.item = cached->item[i];
-	}
-	return 0;
+        return (0);
 }
 
-static void icache_add_to_tree(rbt_t *tree, int64_t item_id, probe_iqpair_t *pair) {
-
-	probe_citem_t *cached = malloc(sizeof(probe_citem_t));
-	cached->item = malloc(sizeof(SEXP_t *));
-	cached->item[0] = pair->p.item;
-	cached->count = 1;
-
-	/* Assign an unique item ID */
-	probe_icache_item_setID(pair->p.item, item_id);
-
-	if (rbt_i64_add(tree, (int64_t)item_id, (void **)cached, NULL) != 0) {
-		dE("Can't add item (k=%"PRIi64" to the cache (%p)", item_id, tree);
-
-		free(cached->item);
-		free(cached);
+static void probe_icache_shard_free(probe_icache_shard_t *shard)
+{
+        probe_icache_entry_t *entry, *next;
+        size_t i;
+
+        for (i = 0; i < shard->bucket_cnt; ++i) {
+                for (entry = shard->bucket[i]; entry != NULL; entry = next) {
+                        next = entry->next;
+                        SEXP_free(entry->item);
+                        free(entry);
+                }
+        }
 
-		/* now what? */
-		abort();
-	}
+        free(shard->bucket);
+        pthread_mutex_destroy(&shard->lock);
 }
 
-static void *probe_icache_worker(void *arg)
+/*
+ * Find an item with the same content. Items with the same ID are
+ * compared without the item name and attributes because the cached
+ * ones already have the unique id attribute set.
+ */
+static SEXP_t *probe_icache_shard_lookup(probe_icache_shard_t *shard, SEXP_ID_t item_ID, SEXP_t *item)
 {
-        probe_icache_t *cache = (probe_icache_t *)(arg);
-        probe_iqpair_t *pair, pair_mem;
-        SEXP_ID_t       item_ID;
+        probe_icache_entry_t *entry;
+        SEXP_t rest1, rest2, *rest_r1, *rest_r2;
+        bool match;
 
-	if (cache == NULL) {
-		return NULL;
-	}
+        entry = shard->bucket[item_ID & (shard->bucket_cnt - 1)];
 
-#if defined(HAVE_PTHREAD_SETNAME_NP)
-# if defined(OS_APPLE)
-	pthread_setname_np("icache_worker");
-# else
-	pthread_setname_np(pthread_self(), "icache_worker");
-# endif
-#endif
+        for (; entry != NULL; entry = entry->next) {
+                if (entry->id != item_ID)
+                        continue;
 
-        if (pthread_mutex_lock(&cache->queue_mutex) != 0) {
-                dE("An error ocured while locking the queue mutex: %u, %s",
-                   errno, strerror(errno));
-                return (NULL);
-        }
+                dI("cache HIT #1");
 
-	pair = &pair_mem;
-        dD("icache worker ready");
-
-        switch (errno = pthread_barrier_wait(&OSCAP_GSYM(th_barrier)))
-        {
-        case 0:
-        case PTHREAD_BARRIER_SERIAL_THREAD:
-	        break;
-        default:
-	        dE("pthread_barrier_wait: %d, %s.",
-	           errno, strerror(errno));
-	        pthread_mutex_unlock(&cache->queue_mutex);
-	        return (NULL);
-        }
+                rest_r1 = SEXP_list_rest_r(&rest1, item);
+                rest_r2 = SEXP_list_rest_r(&rest2, entry->item);
+                match   = SEXP_deepcmp(rest_r1, rest_r2);
 
-        while(pthread_cond_wait(&cache->queue_notempty, &cache->queue_mutex) == 0) {
-			if (cache->queue_cnt <= 0) {
-				return NULL;
-			}
-        do {
-                dI("Extracting item from the cache queue: cnt=%"PRIu16", beg=%"PRIu16"", cache->queue_cnt, cache->queue_beg);
-                /*
-                 * Extract an item from the queue and update queue beg, end & cnt
-                 */
-                pair_mem = cache->queue[cache->queue_beg];
-#ifndef NDEBUG
-		memset(cache->queue + cache->queue_beg, 0, sizeof(probe_iqpair_t));
-#endif
-                --cache->queue_cnt;
-		++cache->queue_beg;
+                SEXP_free_r(&rest1);
+                SEXP_free_r(&rest2);
 
-		if (cache->queue_beg == cache->queue_max)
-			cache->queue_beg = 0;
-
-		if (cache->queue_cnt == 0 ?
-			cache->queue_end != cache->queue_beg :
-			cache->queue_end == cache->queue_beg) {
-			return NULL;
-		}
+                if (match)
+                        return (entry->item);
+        }
 
+        return (NULL);
+}
 
-                dD("Signaling `notfull'");
+static void probe_icache_shard_grow(probe_icache_shard_t *shard)
+{
+        probe_icache_entry_t **bucket, *entry, *next;
+        size_t bucket_cnt, i;
 
-                if (pthread_cond_signal(&cache->queue_notfull) != 0) {
-                        dE("An error ocured while signaling the `notfull' condition: %u, %s",
-                           errno, strerror(errno));
-                        abort();
-                }
-                /*
-                 * Release the mutex
-                 */
-                if (pthread_mutex_unlock(&cache->queue_mutex) != 0) {
-                        dE("An error ocured while unlocking the queue mutex: %u, %s",
-                           errno, strerror(errno));
-                        abort();
-                }
+        bucket_cnt = shard->bucket_cnt * 2;
+        bucket     = calloc(bucket_cnt, sizeof(probe_icache_entry_t *));
 
-                if (pair->cobj == NULL) {
-                        /*
-                         * Handle NOP case (synchronization)
-                         */
-					if (pair->p.cond == NULL) {
-						return NULL;
-					}
-
-                        dD("Handling NOP");
-
-                        if (pthread_cond_signal(pair->p.cond) != 0) {
-                                dE("An error ocured while signaling NOP condition: %u, %s",
-                                   errno, strerror(errno));
-                                abort();
-                        }
-                } else {
-
-                        dD("Handling cache request");
-
-                        /*
-                         * Compute item ID
-                         */
-			dD("pair address: %"PRIu64, (uint64_t) pair);
-			dD("item address: %"PRIu64, (uint64_t) pair->p.item);
-                        item_ID = SEXP_ID_v(pair->p.item);
-                        dD("item ID=%"PRIu64"", item_ID);
-
-                        if (icache_lookup(cache->tree, item_ID, pair) != 0) {
-                                /*
-                                 * Cache MISS
-                                 */
-                                dI("cache MISS");
-                                icache_add_to_tree(cache->tree, item_ID, pair);
-                        }
-
-                        if (probe_cobj_add_item(pair->cobj, pair->p.item) != 0) {
-                            dW("An error ocured while adding the item to the collected object");
-                        }
-                }
+        /* Keep the old table if there's not enough memory, it still works */
+        if (bucket == NULL)
+                return;
 
-                if (pthread_mutex_lock(&cache->queue_mutex) != 0) {
-                        dE("An error ocured while re-locking the queue mutex: %u, %s",
-                           errno, strerror(errno));
-                        abort();
+        for (i = 0; i < shard->bucket_cnt; ++i) {
+                for (entry = shard->bucket[i]; entry != NULL; entry = next) {
+                        next = entry->next;
+                        entry->next = bucket[entry->id & (bucket_cnt - 1)];
+                        bucket[entry->id & (bucket_cnt - 1)] = entry;
                 }
-
-                } while (cache->queue_cnt > 0);
         }
 
-        return (NULL);
+        free(shard->bucket);
+        shard->bucket     = bucket;
+        shard->bucket_cnt = bucket_cnt;
 }
 
-probe_icache_t *probe_icache_new(void)
+static int probe_icache_shard_insert(probe_icache_shard_t *shard, SEXP_ID_t item_ID, SEXP_t *item)
 {
-        probe_icache_t *cache = malloc(sizeof(probe_icache_t));
-        cache->tree = rbt_i64_new();
+        probe_icache_entry_t *entry;
+        size_t i;
 
-        if (pthread_mutex_init(&cache->queue_mutex, NULL) != 0) {
-                dE("Can't initialize icache mutex: %u, %s", errno, strerror(errno));
-                goto fail;
-        }
+        entry = malloc(sizeof(probe_icache_entry_t));
 
-        cache->queue_beg = 0;
-        cache->queue_end = 0;
-        cache->queue_cnt = 0;
-        cache->queue_max = PROBE_IQUEUE_CAPACITY;
+        if (entry == NULL)
+                return (-1);
 
-        if (pthread_cond_init(&cache->queue_notempty, NULL) != 0) {
-                dE("Can't initialize icache queue condition variable (notempty): %u, %s",
-                   errno, strerror(errno));
-                goto fail;
-        }
+        if (shard->item_cnt >= shard->bucket_cnt * PROBE_ICACHE_SHARD_MAXLOAD)
+                probe_icache_shard_grow(shard);
 
-        if (pthread_cond_init(&cache->queue_notfull, NULL) != 0) {
-                dE("Can't initialize icache queue condition variable (notfull): %u, %s",
-                   errno, strerror(errno));
-                goto fail;
-        }
+        i = item_ID & (shard->bucket_cnt - 1);
 
-        if (pthread_create(&cache->thid, NULL,
-                           probe_icache_worker, (void *)cache) != 0)
-        {
-                dE("Can't start the icache worker: %u, %s", errno, strerror(errno));
-                goto fail;
-        }
+        entry->id   = item_ID;
+        entry->item = item;
+        entry->next = shard->bucket[i];
 
-        return (cache);
-fail:
-        if (cache->tree != NULL)
-                rbt_i64_free(cache->tree);
-
-        pthread_mutex_destroy(&cache->queue_mutex);
-        pthread_cond_destroy(&cache->queue_notempty);
-        free(cache);
+        shard->bucket[i] = entry;
+        ++shard->item_cnt;
 
-        return (NULL);
+        return (0);
 }
 
-static int __probe_icache_add_nolock(probe_icache_t *cache, SEXP_t *cobj, SEXP_t *item, pthread_cond_t *cond)
+probe_icache_t *probe_icache_new(void)
 {
-	if (!((cond == NULL) ^ (item == NULL))) {
-		return -1;
-	}
-retry:
-        if (cache->queue_cnt < cache->queue_max) {
-                cache->queue[cache->queue_end].cobj = cobj;
-
-                if (item != NULL) {
-					if (cobj == NULL) {
-						return -1;
-					}
-                        cache->queue[cache->queue_end].p.item = item;
-                } else {
-					if (item != NULL || cobj != NULL) {
-						return -1;
-					}
-                        cache->queue[cache->queue_end].p.cond = cond;
-		}
+        probe_icache_t *cache = malloc(sizeof(probe_icache_t));
+        size_t i;
 
-                ++cache->queue_cnt;
-		++cache->queue_end;
+        if (cache == NULL)
+                return (NULL);
 
-                if (cache->queue_end == cache->queue_max)
-                        cache->queue_end = 0;
-        } else {
-                /*
-                 * The queue is full, we have to wait
-                 */
-                if (pthread_cond_wait(&cache->queue_notfull, &cache->queue_mutex) == 0)
-                        goto retry;
-                else {
-                        dE("An error ocured while waiting for the `notfull' queue condition: %u, %s",
-                           errno, strerror(errno));
-                        return (-1);
+        for (i = 0; i < PROBE_ICACHE_SHARDS; ++i) {
+                if (probe_icache_shard_init(&cache->shard[i]) != 0) {
+                        while (i-- > 0)
+                                probe_icache_shard_free(&cache->shard[i]);
+                        free(cache);
+                        return (NULL);
                 }
         }
 
-        return (0);
+        return (cache);
 }
 
+/*
+ * Replace the item with an already cached item of the same content or
+ * cache it and assign it an unique ID, then add the item to the collected
+ * object. Runs in the thread which collected the item, only the shard
+ * selected by the item ID is locked.
+ */
 int probe_icache_add(probe_icache_t *cache, SEXP_t *cobj, SEXP_t *item)
 {
-        int ret;
+        probe_icache_shard_t *shard;
+        SEXP_t   *cached;
+        SEXP_ID_t item_ID;
 
         if (cache == NULL || cobj == NULL || item == NULL)
                 return (-1); /* XXX: EFAULT */
 
-        if (pthread_mutex_lock(&cache->queue_mutex) != 0) {
-                dE("An error ocured while locking the queue mutex: %u, %s",
+        /*
+         * Compute item ID
+         */
+        item_ID = SEXP_ID_v(item);
+        dD("item ID=%"PRIu64"", item_ID);
+
+        shard = &cache->shard[PROBE_ICACHE_SHARD_INDEX(item_ID)];
+
+        if (pthread_mutex_lock(&shard->lock) != 0) {
+                dE("An error ocured while locking the icache mutex: %u, %s",
                    errno, strerror(errno));
                 return (-1);
         }
 
-        ret = __probe_icache_add_nolock(cache, cobj, item, NULL);
+        cached = probe_icache_shard_lookup(shard, item_ID, item);
 
-        if (pthread_cond_signal(&cache->queue_notempty) != 0) {
-                dE("An error ocured while signaling the `notempty' condition: %u, %s",
-                   errno, strerror(errno));
-                return (-1);
+        if (cached == NULL) {
+                /*
+                 * Cache MISS
+                 */
+                dI("cache MISS");
+
+                if (probe_icache_shard_insert(shard, item_ID, item) != 0) {
+                        pthread_mutex_unlock(&shard->lock);
+                        return (-1);
+                }
+
+                /* Assign an unique item ID */
+                probe_icache_item_setID(item, item_ID);
+                cached = item;
+                item   = NULL;
+        } else {
+                /*
+                 * Cache HIT
+                 */
+                dI("cache HIT #2 -> real HIT");
         }
 
-        if (pthread_mutex_unlock(&cache->queue_mutex) != 0) {
-                dE("An error ocured while unlocking the queue mutex: %u, %s",
+        if (pthread_mutex_unlock(&shard->lock) != 0) {
+                dE("An error ocured while unlocking the icache mutex: %u, %s",
                    errno, strerror(errno));
                 abort();
         }
 
-        if (ret != 0)
-                return (-1);
+        SEXP_free(item);
+
+        if (probe_cobj_add_item(cobj, cached) != 0) {
+                dW("An error ocured while adding the item to the collected object");
+        }
 
         return (0);
 }
 
-int probe_icache_nop(probe_icache_t *cache)
+#define PROBE_RESULT_MEMCHECK_CTRESHOLD  32768  /* item count */
+#define PROBE_RESULT_MEMCHECK_MINFREEMEM 512    /* MiB */
+#define PROBE_RESULT_MEMCHECK_MAXRATIO   0.8   /* default limit - ratio of the total memory */
+#define PROBE_RESULT_MEMCHECK_INTERVAL   1      /* s, how often is the free memory sampled */
+
+/*
+ * The memory held by the collected items is the memory of the sexp values,
+ * which is counted by the sexp allocator. The free memory of the system
+ * can only be read from procfs, so it's sampled at most once per interval
+ * by the thread which finds the sample out of date.
+ */
+static pthread_once_t  probe_memcheck_once = PTHREAD_ONCE_INIT;
+static size_t          probe_memcheck_limit; /* bytes, 0 - no limit */
+static pthread_mutex_t probe_memcheck_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile time_t probe_memcheck_sampled;
+static volatile bool   probe_memcheck_lowmem;
+
+static void probe_memcheck_init(void)
 {
-        pthread_cond_t cond;
+	const char *str = getenv("OSCAP_PROBE_MEMORY_LIMIT");
+	struct sys_memusage mu_sys;
 
-        dD("NOP");
+	if (str != NULL && *str != '\0') {
+		char *end;
+		unsigned long long value;
 
-        if (pthread_mutex_lock(&cache->queue_mutex) != 0) {
-                dE("An error ocured while locking the queue mutex: %u, %s",
-                   errno, strerror(errno));
-                return (-1);
-        }
+		errno = 0;
+		value = strtoull(str, &end, 10);
 
-        if (pthread_cond_init(&cond, NULL) != 0) {
-                dE("Can't initialize icache queue condition variable (NOP): %u, %s",
-                   errno, strerror(errno));
-                return (-1);
-        }
+		if (errno == 0 && *end == '\0' && value <= SIZE_MAX / (1024 * 1024)) {
+			probe_memcheck_limit = (size_t)value * 1024 * 1024;
+			dI("Memory limit of the collected items: %zu MiB", (size_t)value);
+			return;
+		}
+		dW("Invalid value of OSCAP_PROBE_MEMORY_LIMIT: \"%s\", using the default", str);
+	}
 
-        if (__probe_icache_add_nolock(cache, NULL, NULL, &cond) != 0) {
-                if (pthread_mutex_unlock(&cache->queue_mutex) != 0) {
-                        dE("An error ocured while unlocking the queue mutex: %u, %s",
-                           errno, strerror(errno));
-                        abort();
-                }
+	if (oscap_sys_memusage(&mu_sys) != 0) {
+		dW("Can't read the size of the memory, the collected items aren't limited");
+		return;
+	}
+	probe_memcheck_limit = (size_t)(PROBE_RESULT_MEMCHECK_MAXRATIO * mu_sys.mu_total) * 1024;
+	dI("Memory limit of the collected items: %zu MiB", probe_memcheck_limit / (1024 * 1024));
+}
 
-                pthread_cond_destroy(&cond);
-                return (-1);
-        }
+static void probe_memcheck_sample(void)
+{
+	struct timespec now;
+	struct sys_memusage mu_sys;
 
-        dD("Signaling `notempty'");
+	if (clock_gettime(CLOCK_MONOTONIC, &now) != 0 ||
+	    now.tv_sec - probe_memcheck_sampled < PROBE_RESULT_MEMCHECK_INTERVAL)
+		return;
 
-        if (pthread_cond_signal(&cache->queue_notempty) != 0) {
-                dE("An error ocured while signaling the `notempty' condition: %u, %s",
-                   errno, strerror(errno));
+	/* Somebody else is already sampling */
+	if (pthread_mutex_trylock(&probe_memcheck_mutex) != 0)
+		return;
 
-                pthread_cond_destroy(&cond);
-                return (-1);
-        }
+	if (now.tv_sec - probe_memcheck_sampled >= PROBE_RESULT_MEMCHECK_INTERVAL) {
+		if (oscap_sys_memusage(&mu_sys) == 0)
+			probe_memcheck_lowmem = (mu_sys.mu_realfree / 1024) < PROBE_RESULT_MEMCHECK_MINFREEMEM;
+		probe_memcheck_sampled = now.tv_sec;
+	}
 
-        dD("Waiting for icache worker to handle the NOP");
+	pthread_mutex_unlock(&probe_memcheck_mutex);
+}
 
-        if (pthread_cond_wait(&cond, &cache->queue_mutex) != 0) {
-                dE("An error ocured while waiting for the `NOP' queue condition: %u, %s",
-                   errno, strerror(errno));
-                return (-1);
-        }
+int probe_icache_memcheck(void)
+{
+	size_t usage;
 
-        dD("Sync");
+	(void) pthread_once(&probe_memcheck_once, probe_memcheck_init);
 
-        if (pthread_mutex_unlock(&cache->queue_mutex) != 0) {
-                dE("An error ocured while unlocking the queue mutex: %u, %s",
-                   errno, strerror(errno));
-                abort();
-        }
+	if (probe_memcheck_limit == 0)
+		return (0);
 
-        pthread_cond_destroy(&cond);
+	usage = SEXP_memusage();
 
-        return (0);
-}
+	if (usage > probe_memcheck_limit) {
+		dW("Memory limit of the collected items reached! limit=%zu MiB, current=%zu MiB",
+		   probe_memcheck_limit / (1024 * 1024), usage / (1024 * 1024));
+		errno = ENOMEM;
+		return (1);
+	}
 
-#define PROBE_RESULT_MEMCHECK_CTRESHOLD  32768  /* item count */
-#define PROBE_RESULT_MEMCHECK_MINFREEMEM 512    /* MiB */
-#define PROBE_RESULT_MEMCHECK_MAXRATIO   0.8   /* max. memory usage ratio - used/total */
+	probe_memcheck_sample();
+
+	if (probe_memcheck_lowmem) {
+		dW("Minimum free memory limit reached! limit=%d MiB",
+		   PROBE_RESULT_MEMCHECK_MINFREEMEM);
+		errno = ENOMEM;
+		return (1);
+	}
+
+	return (0);
+}
 
 /**
  * Returns 0 if the memory constraints are not reached. Otherwise, 1 is returned.
- * In case of an error, -1 is returned.
  */
 static int probe_cobj_memcheck(size_t item_cnt)
 {
-	if (item_cnt > PROBE_RESULT_MEMCHECK_CTRESHOLD) {
-		struct proc_memusage mu_proc;
-		struct sys_memusage  mu_sys;
-		double c_ratio;
+	if (item_cnt > PROBE_RESULT_MEMCHECK_CTRESHOLD)
+		return probe_icache_memcheck();
 
-		if (oscap_proc_memusage (&mu_proc) != 0)
-			return (-1);
+	return (0);
+}
 
-		if (oscap_sys_memusage (&mu_sys) != 0)
-			return (-1);
+static void probe_cobj_set_incomplete(SEXP_t *cobj, const char *reason)
+{
+	SEXP_t *msg;
 
-		c_ratio = (double)mu_proc.mu_rss/(double)(mu_sys.mu_total);
+	/*
+	 * Don't set the message again if the collected object is
+	 * already flagged as incomplete.
+	 */
+	if (probe_cobj_get_flag(cobj) == SYSCHAR_FLAG_INCOMPLETE)
+		return;
 
-		if (c_ratio > PROBE_RESULT_MEMCHECK_MAXRATIO) {
-			dW("Memory usage ratio limit reached! limit=%f, current=%f",
-			   PROBE_RESULT_MEMCHECK_MAXRATIO, c_ratio);
-			errno = ENOMEM;
-			return (1);
-		}
+	msg = probe_msg_creatf(OVAL_MESSAGE_LEVEL_WARNING, "Object is incomplete due to %s.", reason);
+	probe_cobj_add_msg(cobj, msg);
+	probe_cobj_set_flag(cobj, SYSCHAR_FLAG_INCOMPLETE);
+	SEXP_free(msg);
+}
 
-		if ((mu_sys.mu_realfree / 1024) < PROBE_RESULT_MEMCHECK_MINFREEMEM) {
-			dW("Minimum free memory limit reached! limit=%zu, current=%zu",
-			   PROBE_RESULT_MEMCHECK_MINFREEMEM, mu_sys.mu_realfree / 1024);
-			errno = ENOMEM;
-			return (1);
-		}
+/*
+ * Items over the memory limit are appended to the spill segment if the
+ * collected object allows it. Once the segment exists, all the following
+ * items go there too.
+ */
+static bool probe_item_spilling(struct probe_ctx *ctx)
+{
+	if (ctx->spill != NULL)
+		return true;
+
+	if (!ctx->spill_allowed)
+		return false;
+
+	ctx->spill = oval_spill_new();
+	if (ctx->spill == NULL) {
+		ctx->spill_allowed = false;
+		return false;
 	}
 
-	return (0);
+	return true;
 }
 
 /**
@@ -529,46 +457,22 @@ static int probe_cobj_memcheck(size_t item_cnt)
  *-1 ... unexpected/internal error
  *
  * The caller must not free the item, it's freed automatically
- * by this function or by the icache worker thread.
+ * by this function or by the item cache.
  */
 int probe_item_collect(struct probe_ctx *ctx, SEXP_t *item)
 {
-	SEXP_t *cobj_content;
-	size_t  cobj_itemcnt;
+	bool spill = false;
 
 	if (ctx == NULL || ctx->probe_out == NULL || item == NULL) {
 		return -1;
 	}
 
-	cobj_content = SEXP_listref_nth(ctx->probe_out, 3);
-	cobj_itemcnt = SEXP_list_length(cobj_content);
-	SEXP_free(cobj_content);
-
-	if (probe_cobj_memcheck(cobj_itemcnt) != 0) {
-
-		/*
-		 * Don't set the message again if the collected object is
-		 * already flagged as incomplete.
-		 */
-		if (probe_cobj_get_flag(ctx->probe_out) != SYSCHAR_FLAG_INCOMPLETE) {
-			SEXP_t *msg;
-			/*
-			 * Sync with the icache thread before modifying the
-			 * collected object.
-			 */
-			if (probe_icache_nop(ctx->icache) != 0)
-				return -1;
-
-			msg = probe_msg_creat(OVAL_MESSAGE_LEVEL_WARNING,
-			                      "Object is incomplete due to memory constraints.");
-
-			probe_cobj_add_msg(ctx->probe_out, msg);
-			probe_cobj_set_flag(ctx->probe_out, SYSCHAR_FLAG_INCOMPLETE);
-
-			SEXP_free(msg);
+	if (ctx->spill != NULL || probe_cobj_memcheck(ctx->item_count) != 0) {
+		if (!probe_item_spilling(ctx)) {
+			probe_cobj_set_incomplete(ctx->probe_out, "memory constraints");
+			return 2;
 		}
-
-		return 2;
+		spill = true;
 	}
 
         if (ctx->filters != NULL && probe_item_filtered(item, ctx->filters)) {
@@ -576,39 +480,46 @@ int probe_item_collect(struct probe_ctx *ctx, SEXP_t *item)
 		return (1);
         }
 
+	/*
+	 * The spilled items bypass the item cache. Items with other status
+	 * than "exists" are rare and they're kept in memory, because the flag
+	 * of the collected object is computed from them.
+	 */
+	if (spill && probe_ent_getstatus(item) == SYSCHAR_STATUS_EXISTS) {
+		probe_icache_item_setID(item, 0);
+
+		if (oval_spill_append(ctx->spill, item) != 0) {
+			SEXP_free(item);
+			probe_cobj_set_incomplete(ctx->probe_out, "an error of the spill segment");
+			return 2;
+		}
+
+		SEXP_free(item);
+		++ctx->item_count;
+
+		return (0);
+	}
+
         if (probe_icache_add(ctx->icache, ctx->probe_out, item) != 0) {
                 dE("Can't add item (%p) to the item cache (%p)", item, ctx->icache);
                 SEXP_free(item);
                 return (-1);
         }
+	++ctx->item_count;
 
         return (0);
 }
 
-static void probe_icache_free_node(struct rbt_i64_node *n)
-{
-        probe_citem_t *ci = (probe_citem_t *)n->data;
-
-	for ( ; ci->count > 0 ; --ci->count ) {
-		SEXP_free(ci->item[ci->count - 1]);
-	}
-
-        free(ci->item);
-        free(ci);
-        return;
-}
-
 void probe_icache_free(probe_icache_t *cache)
 {
-        void *ret = NULL;
+        size_t i;
+
+        if (cache == NULL)
+                return;
 
-        pthread_cancel(cache->thid);
-        pthread_join(cache->thid, &ret);
-        pthread_mutex_destroy(&cache->queue_mutex);
-        pthread_cond_destroy(&cache->queue_notempty);
-        pthread_cond_destroy(&cache->queue_notfull);
+        for (i = 0; i < PROBE_ICACHE_SHARDS; ++i)
+                probe_icache_shard_free(&cache->shard[i]);
 
-        rbt_i64_free_cb(cache->tree, &probe_icache_free_node);
         free(cache);
         return;
 }
@@ -23,44 +23,50 @@
 #define ICACHE_H
 
 #include <stddef.h>
+#include <pthread.h>
 #include <sexp.h>
-#include "../SEAP/generic/rbt/rbt.h"
 
-#ifndef PROBE_IQUEUE_CAPACITY
-#define PROBE_IQUEUE_CAPACITY 1024
+/*
+ * The cache is split into shards, each of them protected by its own lock,
+ * so that items collected by different threads rarely contend. The shard
+ * is selected by the upper bits of the item ID (structural hash of the
+ * item), the bucket in the shard by the lower bits.
+ */
+#ifndef PROBE_ICACHE_SHARDS
+#define PROBE_ICACHE_SHARDS 64 /* must be a power of 2 */
 #endif
 
-typedef struct {
-        SEXP_t *cobj;
-        union {
-                SEXP_t         *item;
-                pthread_cond_t *cond;
-        } p;
-} probe_iqpair_t;
-
-typedef struct {
-        rbt_t    *tree; /* XXX: rewrite to extensible or linear hashing */
-        pthread_t thid;
+#define PROBE_ICACHE_SHARD_INITSIZE 64   /* initial bucket count of a shard */
+#define PROBE_ICACHE_SHARD_MAXLOAD  2    /* max. average chain length before growing */
 
-        pthread_mutex_t queue_mutex;
-        pthread_cond_t  queue_notempty;
-        pthread_cond_t  queue_notfull;
+typedef struct probe_icache_entry {
+        SEXP_ID_t                  id;
+        SEXP_t                    *item;
+        struct probe_icache_entry *next;
+} probe_icache_entry_t;
 
-        probe_iqpair_t  queue[PROBE_IQUEUE_CAPACITY];
-        uint16_t        queue_beg;
-        uint16_t        queue_end;
-        uint16_t        queue_cnt;
-        uint16_t        queue_max;
-} probe_icache_t;
+typedef struct {
+        pthread_mutex_t        lock;
+        probe_icache_entry_t **bucket;
+        size_t                 bucket_cnt; /* power of 2 */
+        size_t                 item_cnt;
+} probe_icache_shard_t;
 
 typedef struct {
-        SEXP_t  **item;
-        uint16_t  count;
-} probe_citem_t;
+        probe_icache_shard_t shard[PROBE_ICACHE_SHARDS];
+} probe_icache_t;
 
 probe_icache_t *probe_icache_new(void);
 int probe_icache_add(probe_icache_t *cache, SEXP_t *cobj, SEXP_t *item);
-int probe_icache_nop(probe_icache_t *cache);
 void probe_icache_free(probe_icache_t *cache);
 
+/**
+ * Check the memory limits of the collected items, i.e. the memory held by
+ * the sexp values against OSCAP_PROBE_MEMORY_LIMIT and the free memory of
+ * the system. The items of the spilled objects are read back within the
+ * same limits.
+ * @return 0 if more items can be collected, 1 if the limits are reached
+ */
+int probe_icache_memcheck(void);
+
 #endif /* ICACHE_H */
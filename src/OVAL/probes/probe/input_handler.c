@@ -40,13 +40,14 @@
 
 /*
  * The input handler waits for incomming eval requests and either returns
- * a result immediately if it is found in the result cache or spawns a new
- * worker thread which takes care of evaluating the request, caching the
- * result and sending it to the requestee.
+ * a result immediately if it is found in the result cache or hands the
+ * request over to the worker pool which takes care of evaluating the
+ * request, caching the result and sending it to the requestee. When all
+ * the workers are busy and the pool queue is full, the input handler is
+ * blocked and stops receiving further requests.
  */
 void *probe_input_handler(void *arg)
 {
-        pthread_attr_t pth_attr;
         probe_t       *probe = (probe_t *)arg;
 
         int probe_ret, cstate; /* XXX */
@@ -66,16 +67,6 @@ void *probe_input_handler(void *arg)
 
         TH_CANCEL_OFF;
 
-        if (pthread_attr_init(&pth_attr))
-                return (NULL);
-
-        if (pthread_attr_setdetachstate(&pth_attr, PTHREAD_CREATE_JOINABLE)) {
-                pthread_attr_destroy(&pth_attr);
-                return (NULL);
-        }
-
-        pthread_cleanup_push((void(*)(void *))pthread_attr_destroy, (void *)&pth_attr);
-        
         switch (errno = pthread_barrier_wait(&OSCAP_GSYM(th_barrier)))
         {
         case 0:
@@ -183,14 +174,14 @@ void *probe_input_handler(void *arg)
 						} else {
 							/* OK */
 
-							if (pthread_create(&pair->pth->tid, &pth_attr, &probe_worker_runfn, pair))
+							if (probe_wpool_submit(probe->wpool, pair) != 0)
 							{
-								dE("Cannot start a new worker thread: %d, %s.", errno, strerror(errno));
+								dE("Cannot hand over the request (ID=%u) to the worker pool.", pair->pth->sid);
 
 								if (rbt_i32_del(probe->workers, pair->pth->sid, NULL) != 0)
 									dE("rbt_i32_del: failed to remove worker thread (ID=%u)", pair->pth->sid);
 
-								SEAP_msg_free(pair->pth->msg);
+								/* seap_request is released after sending the error reply */
 								free(pair->pth);
 								free(pair);
 
@@ -254,6 +245,5 @@ void *probe_input_handler(void *arg)
 		SEAP_msg_free(seap_request);
 	} /* main loop */
 
-        pthread_cleanup_pop(1);
         return (NULL);
 }
@@ -32,14 +32,17 @@
 #endif
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include <stdarg.h>
 #include <pthread.h>
 #include <seap.h>
 #include "ncache.h"
 #include "rcache.h"
 #include "icache.h"
+#include "worker_pool.h"
 #include "probe-common.h"
 #include "option.h"
+#include "oval_spill.h"
 #include "common/util.h"
 #include "common/compat_pthread_barrier.h"
 
@@ -60,6 +63,7 @@ typedef struct {
 	pthread_t th_signal;
 
         rbt_t    *workers;
+        probe_wpool_t *wpool; /**< worker thread pool */
         uint32_t  max_threads;
         uint32_t  max_chdepth;
 
@@ -84,6 +88,9 @@ struct probe_ctx {
         SEXP_t         *filters;   /**< object filters (OVAL 5.8 and higher) */
         probe_icache_t *icache;    /**< item cache */
 	int offline_mode;
+	size_t          item_count; /**< number of items collected into probe_out */
+	bool            spill_allowed; /**< items over the memory limit may be spilled to disk */
+	OVAL_SPILL     *spill;     /**< segment of the spilled items */
 };
 
 typedef enum {
@@ -39,6 +39,7 @@
 #include "rcache.h"
 #include "icache.h"
 #include "worker.h"
+#include "worker_pool.h"
 #include "input_handler.h"
 #include "probe-api.h"
 #include "option.h"
@@ -91,6 +92,27 @@ static SEXP_t *probe_reset(SEXP_t *arg0, void *arg1)
         return(NULL);
 }
 
+/*
+ * Drop the cached results of the objects and the cached states whose
+ * ids are listed in arg0. The rest of the cache stays intact.
+ */
+static SEXP_t *probe_invalidate(SEXP_t *arg0, void *arg1)
+{
+	probe_t *probe = (probe_t *)arg1;
+	SEXP_t *id;
+
+	SEXP_list_foreach(id, arg0) {
+		char id_cstr[128];
+
+		if (probe_rcache_sexp_del(probe->rcache, id) == 0) {
+			SEXP_string_cstr_r(id, id_cstr, sizeof id_cstr);
+			dD("Dropped the cached result: id=%s", id_cstr);
+		}
+	}
+
+	return(NULL);
+}
+
 static int probe_opthandler_varref(int option, int op, va_list args)
 {
 	bool  o_switch;
@@ -151,6 +173,9 @@ static void probe_common_main_cleanup(void *arg)
 	dD("probe_common_main_cleanup started");
 
 	probe_t *probe = (probe_t *)arg;
+	/* Release the input handler if it waits for a slot in the worker queue */
+	probe_wpool_shutdown(probe->wpool);
+
 	/* Cancel probe_input_handler thread */
 	if (pthread_cancel(probe->th_input) != 0) {
 		dE("Cannot cancel the probe input thread.");
@@ -169,6 +194,7 @@ static void probe_common_main_cleanup(void *arg)
 		fini_function(probe->probe_arg);
 	}
 
+	probe_wpool_free(probe->wpool);
 	probe_rcache_free(probe->rcache);
 	probe_icache_free(probe->icache);
 	rbt_i32_free(probe->workers);
@@ -201,7 +227,7 @@ void *probe_common_main(void *arg)
 
 	dI("probe_common_main started");
 
-	const unsigned thread_count = 2; // input and icache threads
+	const unsigned thread_count = 1; // input thread
 	if ((errno = pthread_barrier_init(&OSCAP_GSYM(th_barrier), NULL, thread_count)) != 0) {
 		fail(errno, "pthread_barrier_init", __LINE__ - 6);
 	}
@@ -225,6 +251,10 @@ void *probe_common_main(void *arg)
 	if (SEAP_cmd_register(probe.SEAP_ctx, PROBECMD_RESET, 0, &probe_reset) != 0)
 		fail(errno, "SEAP_cmd_register", __LINE__ - 1);
 
+	if (SEAP_cmd_register(probe.SEAP_ctx, PROBECMD_INVALIDATE, SEAP_CMDREG_USEARG,
+			      &probe_invalidate, &probe) != 0)
+		fail(errno, "SEAP_cmd_register", __LINE__ - 2);
+
 	/*
 	 * Initialize result & name caching
 	 */
@@ -302,6 +332,12 @@ void *probe_common_main(void *arg)
 	 * Create input handler (detached)
 	 */
         probe.workers   = rbt_i32_new();
+	probe.max_threads = probe_wpool_max_threads(PROBE_WORKER_DEFAULT_MAX_THREADS);
+	probe.max_chdepth = PROBE_WORKER_DEFAULT_MAX_CHDEPTH;
+	probe.wpool = probe_wpool_new(probe.max_threads, PROBE_WPOOL_QUEUE_CAPACITY);
+
+	if (probe.wpool == NULL)
+		fail(errno, "probe_wpool_new", __LINE__ - 3);
 
 	probe_init_function_t init_function = probe_table_get_init_function(probe.subtype);
 	if (init_function != NULL) {
@@ -49,13 +49,6 @@ void *probe_worker_runfn(void *arg)
 	SEXP_t *probe_res, *obj, *oid;
 	int     probe_ret;
 
-#if defined(HAVE_PTHREAD_SETNAME_NP)
-# if defined(OS_APPLE)
-	pthread_setname_np("probe_worker");
-# else
-	pthread_setname_np(pthread_self(), "probe_worker");
-# endif
-#endif
 	dD("handling SEAP message ID %u", pair->pth->sid);
 	//
 	probe_ret = -1;
@@ -139,7 +132,6 @@ void *probe_worker_runfn(void *arg)
         SEAP_msg_free(pair->pth->msg);
         free(pair->pth);
 	free(pair);
-	pthread_detach(pthread_self());
 
 	dD("probe_worker_runfn has finished");
 	return (NULL);
@@ -344,7 +336,9 @@ static SEXP_t *probe_ste_fetch(probe_t *probe, SEXP_t *id_list)
 	if (i_len == 0)
 		return SEXP_list_new(NULL);
 
+	probe_wpool_block_enter(probe->wpool);
 	res = SEAP_cmd_exec(probe->SEAP_ctx, probe->sd, 0, PROBECMD_STE_FETCH, id_list, SEAP_CMDTYPE_SYNC, NULL, NULL);
+	probe_wpool_block_leave(probe->wpool);
 
 	r_len = SEXP_list_length(res);
 
@@ -380,8 +374,8 @@ static SEXP_t *probe_ste_fetch(probe_t *probe, SEXP_t *id_list)
  * Evaluate an OVAL object identified by its id. Using a remote
  * synchronous SEAP command, this function executes evaluation of an
  * OVAL object which results weren't found in the probe cache. This
- * indirectly spawns a new thread in the probe process which evaluates
- * the object and stores the result in the probe cache. That result is
+ * indirectly submits a new request to the worker pool of the probe
+ * which evaluates the object and stores the result in the probe cache. That result is
  * not send to the library because it doesn't know how to handle
  * it. Instead, the result is fetched by this function from the cache
  * and returned to the caller.
@@ -392,7 +386,13 @@ static SEXP_t *probe_obj_eval(probe_t *probe, SEXP_t *id)
 {
 	SEXP_t *res, *rid;
 
+	/*
+	 * The library may send the object back to us for evaluation. Let
+	 * the pool know that this worker can't serve the request.
+	 */
+	probe_wpool_block_enter(probe->wpool);
 	res = SEAP_cmd_exec(probe->SEAP_ctx, probe->sd, 0, PROBECMD_OBJ_EVAL, id, SEAP_CMDTYPE_SYNC, NULL, NULL);
+	probe_wpool_block_leave(probe->wpool);
 
 	rid = SEXP_list_first(res);
 	if (SEXP_string_cmp(id, rid) != 0) {
@@ -447,6 +447,58 @@ static SEXP_t *probe_prepare_filters(probe_t *probe, SEXP_t *obj)
 	return filters;
 }
 
+/*
+ * Close the spill segment of the collected object and store its path
+ * in the object, so that the library can read the spilled items.
+ */
+static void probe_cobj_finish_spill(SEXP_t *cobj, OVAL_SPILL *spill)
+{
+	probe_cobj_set_spill(cobj, oval_spill_path(spill));
+
+	if (oval_spill_close(spill) != 0) {
+		SEXP_t *msg;
+
+		msg = probe_msg_creat(OVAL_MESSAGE_LEVEL_WARNING,
+		                      "Object is incomplete, some of the spilled items were not stored.");
+		probe_cobj_add_msg(cobj, msg);
+		probe_cobj_set_flag(cobj, SYSCHAR_FLAG_INCOMPLETE);
+		SEXP_free(msg);
+	}
+}
+
+/*
+ * The set operations compare the items by reference, which works only
+ * for the items deduplicated by the item cache. Spilled items bypass
+ * the cache, so the set operations are done on the items in memory and
+ * the referenced object is flagged as incomplete.
+ */
+static SEXP_t *probe_set_unspill(SEXP_t *cobj)
+{
+	SEXP_t *spill, *msgs, *items, *mask, *msg, *res;
+
+	spill = probe_cobj_get_spill(cobj);
+	if (spill == NULL)
+		return cobj;
+	SEXP_free(spill);
+
+	msgs  = probe_cobj_get_msgs(cobj);
+	items = probe_cobj_get_items(cobj);
+	mask  = probe_cobj_get_mask(cobj);
+
+	res = probe_cobj_new(SYSCHAR_FLAG_INCOMPLETE, msgs, items, mask);
+	msg = probe_msg_creat(OVAL_MESSAGE_LEVEL_WARNING,
+	                      "Object is incomplete, the spilled items can't be used in set operations.");
+	probe_cobj_add_msg(res, msg);
+
+	SEXP_free(msg);
+	SEXP_free(msgs);
+	SEXP_free(items);
+	SEXP_free(mask);
+	SEXP_free(cobj);
+
+	return res;
+}
+
 /**
  * Combine two collections of items using an operation.
  * @param cobj1 item collection
@@ -778,6 +830,7 @@ static SEXP_t *probe_set_eval(probe_t *probe, SEXP_t *set, size_t depth)
 			}
 
 			SEXP_free(OID);
+			objres = probe_set_unspill(objres);
 
 			if (o_subset_i < 2) {
 				o_subset[o_subset_i] = objres;
@@ -994,6 +1047,9 @@ SEXP_t *probe_worker(probe_t *probe, SEAP_msg_t *msg_in, int *ret)
 			
                         pctx.probe_in  = probe_in;
                         pctx.probe_out = probe_out;
+                        pctx.item_count = 0;
+                        pctx.spill_allowed = true;
+                        pctx.spill = NULL;
 
                         /*
                          * Run the main function of the probe implementation. Set thread
@@ -1010,10 +1066,8 @@ SEXP_t *probe_worker(probe_t *probe, SEAP_msg_t *msg_in, int *ret)
 
 			pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, &__unused_oldstate);
 
-                        /*
-                         * Synchronize
-                         */
-                        probe_icache_nop(probe->icache);
+			if (pctx.spill != NULL)
+				probe_cobj_finish_spill(probe_out, pctx.spill);
 
 			probe_cobj_compute_flag(probe_out);
 		} else {
@@ -1045,17 +1099,16 @@ SEXP_t *probe_worker(probe_t *probe, SEAP_msg_t *msg_in, int *ret)
 
                                 pctx.probe_in  = ctx->pi2;
                                 pctx.probe_out = cobj;
+                                pctx.item_count = 0;
+                                /* The results are combined in memory */
+                                pctx.spill_allowed = false;
+                                pctx.spill = NULL;
                                 /*
                                  * Run the main function of the probe implementation
                                  */
 			dI("I will run %s_probe_main:", subtype_str);
 			*ret = probe_main_function(&pctx, probe->probe_arg);
 
-                                /*
-                                 * Synchronize
-                                 */
-                                probe_icache_nop(probe->icache);
-
 				probe_cobj_compute_flag(cobj);
 				r0 = probe_out;
 				probe_out = probe_set_combine(r0, cobj, OVAL_SET_OPERATION_UNION);
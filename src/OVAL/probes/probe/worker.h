@@ -42,7 +42,7 @@ typedef struct {
 	SEAP_msg_t  *msg; /**< the message being handled */
 } probe_worker_t;
 
-typedef struct {
+typedef struct probe_pwpair {
 	probe_t        *probe;
 	probe_worker_t *pth;
 } probe_pwpair_t;
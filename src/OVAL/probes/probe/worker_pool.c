@@ -0,0 +1,311 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/debug_priv.h"
+#include "worker.h"
+#include "worker_pool.h"
+
+struct probe_wpool {
+	pthread_mutex_t mutex;
+	pthread_cond_t  notempty; /* a request was queued or the pool is shutting down */
+	pthread_cond_t  notfull;  /* a slot was freed or a worker got blocked */
+
+	probe_pwpair_t **queue;
+	uint32_t queue_beg;
+	uint32_t queue_cnt;
+	uint32_t queue_max;
+
+	uint32_t max_threads;
+	uint32_t nthreads; /* number of started worker threads */
+	uint32_t nidle;    /* number of workers waiting for a request */
+	uint32_t nblocked; /* number of workers waiting for the library */
+	bool     shutdown;
+	bool     released; /* probe_wpool_free() was called, the last worker destroys the pool */
+};
+
+static void probe_wpool_destroy(probe_wpool_t *pool)
+{
+	pthread_cond_destroy(&pool->notfull);
+	pthread_cond_destroy(&pool->notempty);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->queue);
+	free(pool);
+}
+
+/*
+ * Check whether the queued requests need a new worker thread.
+ * Must be called with the pool mutex locked.
+ */
+static bool wpool_need_worker(const probe_wpool_t *pool)
+{
+	if (pool->queue_cnt <= pool->nidle)
+		return false;
+	/*
+	 * Above the limit only if nobody else is able to pick up the
+	 * requests, i.e. all workers are waiting for the library.
+	 */
+	return pool->nthreads < pool->max_threads || pool->nthreads == pool->nblocked;
+}
+
+static probe_pwpair_t *wpool_dequeue(probe_wpool_t *pool)
+{
+	probe_pwpair_t *pair = pool->queue[pool->queue_beg];
+
+	pool->queue[pool->queue_beg] = NULL;
+	pool->queue_beg = (pool->queue_beg + 1) % pool->queue_max;
+	--pool->queue_cnt;
+
+	return (pair);
+}
+
+static void *probe_wpool_worker(void *arg)
+{
+	probe_wpool_t  *pool = (probe_wpool_t *)arg;
+	probe_pwpair_t *pair;
+
+#if defined(HAVE_PTHREAD_SETNAME_NP)
+# if defined(OS_APPLE)
+	pthread_setname_np("probe_worker");
+# else
+	pthread_setname_np(pthread_self(), "probe_worker");
+# endif
+#endif
+	pthread_mutex_lock(&pool->mutex);
+
+	for (;;) {
+		while (pool->queue_cnt == 0 && !pool->shutdown) {
+			++pool->nidle;
+			pthread_cond_wait(&pool->notempty, &pool->mutex);
+			--pool->nidle;
+		}
+
+		if (pool->shutdown)
+			break; /* queued requests are dropped by probe_wpool_free() */
+
+		pair = wpool_dequeue(pool);
+		pthread_cond_signal(&pool->notfull);
+		pthread_mutex_unlock(&pool->mutex);
+
+		pair->pth->tid = pthread_self();
+		probe_worker_runfn(pair);
+
+		pthread_mutex_lock(&pool->mutex);
+		/*
+		 * Workers started above the limit are terminated as soon as
+		 * they aren't the only ones able to serve the queue.
+		 */
+		if (pool->nthreads > pool->max_threads &&
+		    (pool->queue_cnt == 0 || pool->nthreads - pool->nblocked > 1))
+			break;
+	}
+
+	if (--pool->nthreads == 0 && pool->released) {
+		pthread_mutex_unlock(&pool->mutex);
+		probe_wpool_destroy(pool);
+	} else {
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Must be called with the pool mutex locked.
+ */
+static int wpool_spawn(probe_wpool_t *pool)
+{
+	pthread_attr_t attr;
+	pthread_t      tid;
+	int            ret;
+
+	if (pthread_attr_init(&attr) != 0)
+		return (-1);
+
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&tid, &attr, &probe_wpool_worker, pool);
+	pthread_attr_destroy(&attr);
+
+	if (ret != 0) {
+		dE("Cannot start a new worker thread: %d, %s.", ret, strerror(ret));
+		return (-1);
+	}
+
+	++pool->nthreads;
+	dD("Started worker thread #%u", pool->nthreads);
+
+	return (0);
+}
+
+probe_wpool_t *probe_wpool_new(uint32_t max_threads, uint32_t queue_max)
+{
+	probe_wpool_t *pool;
+
+	if (max_threads == 0 || queue_max == 0) {
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	pool = malloc(sizeof(probe_wpool_t));
+	pool->queue = calloc(queue_max, sizeof(probe_pwpair_t *));
+	pool->queue_beg = 0;
+	pool->queue_cnt = 0;
+	pool->queue_max = queue_max;
+	pool->max_threads = max_threads;
+	pool->nthreads = 0;
+	pool->nidle = 0;
+	pool->nblocked = 0;
+	pool->shutdown = false;
+	pool->released = false;
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->notempty, NULL);
+	pthread_cond_init(&pool->notfull, NULL);
+
+	return (pool);
+}
+
+int probe_wpool_submit(probe_wpool_t *pool, probe_pwpair_t *pair)
+{
+	pthread_mutex_lock(&pool->mutex);
+
+	while (pool->queue_cnt == pool->queue_max && !pool->shutdown) {
+		if (pool->nthreads == pool->nblocked) {
+			if (wpool_spawn(pool) != 0)
+				break;
+			continue;
+		}
+		dD("Worker queue is full, waiting");
+		pthread_cond_wait(&pool->notfull, &pool->mutex);
+	}
+
+	if (pool->queue_cnt == pool->queue_max || pool->shutdown) {
+		pthread_mutex_unlock(&pool->mutex);
+		return (-1);
+	}
+
+	pool->queue[(pool->queue_beg + pool->queue_cnt) % pool->queue_max] = pair;
+	++pool->queue_cnt;
+
+	if (wpool_need_worker(pool) && wpool_spawn(pool) != 0 && pool->nthreads == 0) {
+		/* Nobody would ever pick up the request */
+		--pool->queue_cnt;
+		pthread_mutex_unlock(&pool->mutex);
+		return (-1);
+	}
+
+	pthread_cond_signal(&pool->notempty);
+	pthread_mutex_unlock(&pool->mutex);
+
+	return (0);
+}
+
+void probe_wpool_block_enter(probe_wpool_t *pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	++pool->nblocked;
+
+	if (wpool_need_worker(pool))
+		wpool_spawn(pool);
+
+	/* Wake up a submitter waiting for a free slot */
+	pthread_cond_broadcast(&pool->notfull);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void probe_wpool_block_leave(probe_wpool_t *pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	--pool->nblocked;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void probe_wpool_shutdown(probe_wpool_t *pool)
+{
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->shutdown = true;
+	pthread_cond_broadcast(&pool->notempty);
+	pthread_cond_broadcast(&pool->notfull);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void probe_wpool_free(probe_wpool_t *pool)
+{
+	probe_pwpair_t *pair;
+
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->shutdown = true;
+	pool->released = true;
+
+	while (pool->queue_cnt > 0) {
+		pair = wpool_dequeue(pool);
+
+		if (rbt_i32_del(pair->probe->workers, pair->pth->sid, NULL) != 0)
+			dW("Dropped request (ID=%u) not found in the probe thread tree", pair->pth->sid);
+
+		SEAP_msg_free(pair->pth->msg);
+		free(pair->pth);
+		free(pair);
+	}
+
+	pthread_cond_broadcast(&pool->notempty);
+	pthread_cond_broadcast(&pool->notfull);
+
+	if (pool->nthreads == 0) {
+		pthread_mutex_unlock(&pool->mutex);
+		probe_wpool_destroy(pool);
+	} else {
+		/* The last worker releases the pool */
+		pthread_mutex_unlock(&pool->mutex);
+	}
+}
+
+uint32_t probe_wpool_max_threads(uint32_t default_value)
+{
+	const char *str = getenv("OSCAP_PROBE_MAX_THREADS");
+	char *end;
+	unsigned long value;
+
+	if (str == NULL || *str == '\0')
+		return (default_value);
+
+	errno = 0;
+	value = strtoul(str, &end, 10);
+
+	if (errno != 0 || *end != '\0' || value == 0 || value > UINT32_MAX) {
+		dW("Invalid value of OSCAP_PROBE_MAX_THREADS: \"%s\", using %u", str, default_value);
+		return (default_value);
+	}
+
+	return ((uint32_t)value);
+}
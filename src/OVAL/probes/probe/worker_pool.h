@@ -0,0 +1,98 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#ifndef PROBE_WPOOL_QUEUE_CAPACITY
+# define PROBE_WPOOL_QUEUE_CAPACITY 256 /**< maximum number of requests waiting for a worker */
+#endif
+
+/**
+ * Pool of reusable worker threads serving the eval requests of a probe.
+ *
+ * Worker threads are started on demand up to the pool limit and they stay
+ * alive between requests. Requests which can't be served immediately wait
+ * in a bounded FIFO queue. When the queue is full, the submitter is blocked
+ * until a slot is freed, which in turn stops the input handler from reading
+ * further requests from the SEAP descriptor.
+ *
+ * A worker evaluating a set object may wait for the library to evaluate
+ * another object, which can result in a new request for this very probe.
+ * Such workers mark themselves as blocked and if every worker is blocked,
+ * the pool starts an extra worker above the limit so that the evaluation
+ * can't deadlock.
+ */
+typedef struct probe_wpool probe_wpool_t;
+
+struct probe_pwpair;
+
+/**
+ * Create a new worker pool. No threads are started until the first request
+ * is submitted.
+ * @param max_threads maximum number of concurrently running worker threads
+ * @param queue_max maximum number of requests waiting for a worker
+ * @return new pool or NULL on failure
+ */
+probe_wpool_t *probe_wpool_new(uint32_t max_threads, uint32_t queue_max);
+
+/**
+ * Hand over a request to the pool. The function blocks while the request
+ * queue is full. The ownership of the pair is transferred to the pool.
+ * @retval 0 on success
+ * @retval -1 if the request can't be handled; the caller keeps the ownership
+ */
+int probe_wpool_submit(probe_wpool_t *pool, struct probe_pwpair *pair);
+
+/**
+ * Mark the calling worker as waiting for the library.
+ */
+void probe_wpool_block_enter(probe_wpool_t *pool);
+
+/**
+ * Mark the calling worker as running again.
+ */
+void probe_wpool_block_leave(probe_wpool_t *pool);
+
+/**
+ * Stop accepting requests. Submitters waiting for a free slot are woken up
+ * and fail, idle workers terminate. Must be called before the thread which
+ * submits the requests is cancelled, otherwise it may wait for a slot
+ * forever with cancellation disabled.
+ */
+void probe_wpool_shutdown(probe_wpool_t *pool);
+
+/**
+ * Shut the pool down. Queued requests are dropped and idle workers are
+ * terminated. Workers which are still evaluating a request finish it and
+ * the last one releases the pool memory.
+ */
+void probe_wpool_free(probe_wpool_t *pool);
+
+/**
+ * Get the pool size requested by the user using the OSCAP_PROBE_MAX_THREADS
+ * environment variable.
+ * @param default_value value returned if the variable isn't set or is invalid
+ */
+uint32_t probe_wpool_max_threads(uint32_t default_value);
+
+#endif /* WORKER_POOL_H */
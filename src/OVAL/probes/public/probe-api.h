@@ -253,6 +253,13 @@ OSCAP_API SEXP_t *probe_cobj_get_msgs(const SEXP_t *cobj);
 OSCAP_API SEXP_t *probe_cobj_get_mask(const SEXP_t *cobj);
 OSCAP_API int probe_cobj_add_item(SEXP_t *cobj, const SEXP_t *item);
 OSCAP_API SEXP_t *probe_cobj_get_items(const SEXP_t *cobj);
+/*
+ * Items which didn't fit into the memory are stored in a segment file
+ * (see oval_spill.h). The path of the segment is the optional fifth
+ * element of the collected object.
+ */
+int probe_cobj_set_spill(SEXP_t *cobj, const char *path);
+SEXP_t *probe_cobj_get_spill(const SEXP_t *cobj);
 OSCAP_API void probe_cobj_set_flag(SEXP_t *cobj, oval_syschar_collection_flag_t flag);
 OSCAP_API oval_syschar_collection_flag_t probe_cobj_get_flag(const SEXP_t *cobj);
 oval_syschar_collection_flag_t probe_cobj_combine_flags(oval_syschar_collection_flag_t f1,
@@ -439,6 +446,7 @@ OSCAP_API void probe_tfc54behaviors_canonicalize(SEXP_t **behaviors);
 #define PROBECMD_STE_FETCH 1 /**< State fetch command code */
 #define PROBECMD_OBJ_EVAL  2 /**< Object eval command code */
 #define PROBECMD_RESET     3 /**< Reset command code */
+#define PROBECMD_INVALIDATE 4 /**< Cached results invalidation command code */
 
 
 OSCAP_API int probe_offline_mode_supported(void);
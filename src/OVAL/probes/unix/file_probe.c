@@ -330,7 +330,7 @@ static int file_cb(const char *prefix, const char *p, const char *f, void *ptr,
 	}
 
 	char *st_path_with_prefix = oscap_path_join(prefix, st_path);
-	if (lstat(st_path_with_prefix, &st) == -1) {
+	if (oval_fts_cache_lstat(st_path_with_prefix, &st) == -1) {
                 dI("lstat failed when processing %s: errno=%u, %s.", st_path, errno, strerror (errno));
 		/*
 		 * Whatever the reason of this lstat error (for example the file may
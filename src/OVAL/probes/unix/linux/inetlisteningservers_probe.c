@@ -54,8 +54,6 @@
 #include <stdio.h>
 #include <stdio_ext.h>
 #include <errno.h>
-#include <dirent.h>
-#include <fcntl.h>
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <regex.h>
@@ -64,6 +62,8 @@
 #include "probe-api.h"
 #include "probe/entcmp.h"
 #include "common/debug_priv.h"
+#include "oval_proc_snapshot.h"
+#include "sockdiag.h"
 #include "inetlisteningservers_probe.h"
 
 /* This structure contains the information OVAL is asking or requesting */
@@ -82,219 +82,6 @@ struct result_info {
 	unsigned rport;
 };
 
-/* This structure is used to store information from scanning all runnning
- * processes. It will be used later to augment server info */
-typedef struct _lnode {
-  pid_t pid;            // process ID
-  uid_t uid;            // effective user ID
-  char *cmd;            // command run by user
-  unsigned long inode;  // inode of socket
-  struct _lnode* next;  // Next node pointer
-} lnode;
-
-/* This is the linked list head. Only data elements go here. */
-typedef struct {
-  lnode *head;          // List head
-  lnode *cur;           // Pointer to current node
-} llist;
-
-/* Function prototypes */
-static inline lnode *list_get_cur(llist *l) { return l->cur; }
-static void list_create(llist *l);
-static void list_append(llist *l, lnode *node);
-static void list_clear(llist* l);
-static lnode *list_find_inode(llist *l, unsigned long i);
-
-
-static void list_create(llist *l)
-{
-	l->head = NULL;
-	l->cur = NULL;
-}
-
-static void list_append(llist *l, lnode *node)
-{
-	lnode* newnode;
-
-	if (node == NULL || l == NULL)
-		return;
-
-	newnode = malloc(sizeof(lnode));
-	if (newnode == NULL)
-		return;
-
-	newnode->pid = node->pid;
-	newnode->uid = node->uid;
-	newnode->inode = node->inode;
-	// Take custody of the memory
-	newnode->cmd = node->cmd;
-	newnode->next = NULL;
-
-	// if we are at top, fix this up
-	if (l->head == NULL)
-		l->head = newnode;
-	else	// Otherwise add pointer to newnode
-		l->cur->next = newnode;
-
-	// make newnode current
-	l->cur = newnode;
-}
-
-static void list_clear(llist* l)
-{
-	lnode* nextnode;
-	register lnode* cur;
-
-	cur = l->head;
-	while (cur) {
-		nextnode=cur->next;
-		free(cur->cmd);
-		free(cur);
-		cur=nextnode;
-	}
-	l->head = NULL;
-	l->cur = NULL;
-}
-
-static lnode *list_find_inode(llist *l, unsigned long i)
-{
-        register lnode* cur;
-
-       	cur = l->head;	/* start at the beginning */
-	while (cur) {
-		if (cur->inode == i) {
-			l->cur = cur;
-			return cur;
-		} else
-			cur = cur->next;
-	}
-	return NULL;
-}
-
-static int collect_process_info(llist *l)
-{
-	DIR *d, *f;
-	struct dirent *ent;
-
-	d = opendir("/proc");
-	if (d == NULL)
-		return 1;
-
-	while (( ent = readdir(d) )) {
-		FILE *sf;
-		int pid, ppid;
-		char buf[100];
-		char *tmp, cmd[16], state, *text = NULL;
-		int fd, len, euid = 0;
-
-		// Skip non-process dir entries
-		if(*ent->d_name<'0' || *ent->d_name>'9')
-			continue;
-		errno = 0;
-		pid = strtol(ent->d_name, NULL, 10);
-		if (errno)
-			continue;
-
-		// Parse up the stat file for the proc
-		snprintf(buf, 32, "/proc/%d/stat", pid);
-		fd = open(buf, O_RDONLY, 0);
-		if (fd < 0)
-			continue;
-		len = read(fd, buf, sizeof buf - 1);
-		close(fd);
-		if (len < 40)
-			continue;
-		buf[len] = 0;
-		tmp = strrchr(buf, ')');
-		if (tmp)
-			*tmp = 0;
-		else
-			continue;
-		memset(cmd, 0, sizeof(cmd));
-		sscanf(buf, "%d (%15c", &ppid, cmd);
-		sscanf(tmp+2, "%c %d", &state, &ppid);
-
-		// Skip kthreads
-		if (pid == 2 || ppid == 2)
-			continue;
-
-		// Get the effective uid
-		snprintf(buf, 32, "/proc/%d/status", pid);
-		sf = fopen(buf, "rt");
-		if (sf) {
-			int line = 0;
-			__fsetlocking(sf, FSETLOCKING_BYCALLER);
-			while (fgets(buf, sizeof(buf), sf)) {
-				if (line == 0) {
-					line++;
-					continue;
-				}
-				if (memcmp(buf, "Uid:", 4) == 0) {
-					int id;
-					sscanf(buf, "Uid: %d %d",
-						&id, &euid);
-					break;
-				}
-			}
-			fclose(sf);
-		}
-
-		// Now lets get the inodes each process has open
-		snprintf(buf, 32, "/proc/%d/fd", pid);
-		f = opendir(buf);
-		if (f == NULL) {
-			// Process might have ended or we don;t have access - ignore it
-			free(text);
-			continue;
-		}
-		// For each file in the fd dir...
-		while (( ent = readdir(f) )) {
-			char line[256], ln[256], *s, *e;
-			unsigned long inode;
-			lnode node;
-			int lnlen;
-
-			if (ent->d_name[0] == '.')
-				continue;
-			snprintf(ln, 256, "%s/%s", buf, ent->d_name);
-			if ((lnlen = readlink(ln, line, sizeof(line)-1)) < 0)
-				continue;
-			line[lnlen] = 0;
-
-			// Only look at the socket entries
-			if (memcmp(line, "socket:", 7) == 0) {
-				// Type 1 sockets
-				s = strchr(line+7, '[');
-				if (s == NULL)
-					continue;
-				s++;
-				e = strchr(s, ']');
-				if (e == NULL)
-					continue;
-				*e = 0;
-			} else if (memcmp(line, "[0000]:", 7) == 0) {
-				// Type 2 sockets
-				s = line + 8;
-			} else
-				continue;
-			errno = 0;
-			inode = strtoul(s, NULL, 10);
-			if (errno)
-				continue;
-			node.pid = pid;
-			node.uid = euid;
-			node.cmd = strdup(cmd);
-			node.inode = inode;
-			// We make one entry for each socket inode
-			list_append(l, &node);
-		}
-		closedir(f);
-		free(text);
-	}
-	closedir(d);
-	return 0;
-}
-
 static int eval_data(const char *type, const char *local_address,
 	unsigned int local_port, struct server_info *req)
 {
@@ -324,30 +111,27 @@ static int eval_data(const char *type, const char *local_address,
 	return 1;
 }
 
-static void report_finding(struct result_info *res, llist *l, probe_ctx *ctx)
+static void report_finding(struct result_info *res, OVAL_PROC_SNAPSHOT *snap, OVAL_PROC_ENTRY *n, probe_ctx *ctx)
 {
         SEXP_t *item;
         SEXP_t se_lport_mem, se_rport_mem, se_lfull_mem, se_ffull_mem, *se_uid_mem = NULL;
-	lnode *n = NULL;
-
-	if (l) {
-		n = list_get_cur(l);
-	}
 
 	if (n) {
+		oval_proc_entry_uids(snap, n);
+
                 item = probe_item_create(OVAL_LINUX_INET_LISTENING_SERVER, NULL,
                                  "protocol",             OVAL_DATATYPE_STRING,  res->proto,
                                  "local_address",        OVAL_DATATYPE_STRING,  res->laddr,
 				 "local_port",           OVAL_DATATYPE_SEXP, SEXP_number_newu_64_r(&se_lport_mem, res->lport),
                                  "local_full_address",   OVAL_DATATYPE_SEXP,    SEXP_string_newf_r(&se_lfull_mem,
                                                                                                    "%s:%u", res->laddr, res->lport),
-                                 "program_name",         OVAL_DATATYPE_STRING,  n->cmd,
+                                 "program_name",         OVAL_DATATYPE_STRING,  n->comm,
                                  "foreign_address",      OVAL_DATATYPE_STRING,  res->raddr,
 				 "foreign_port",         OVAL_DATATYPE_SEXP, SEXP_number_newu_64_r(&se_rport_mem, res->rport),
                                  "foreign_full_address", OVAL_DATATYPE_SEXP,    SEXP_string_newf_r(&se_ffull_mem,
                                                                                                    "%s:%u", res->raddr, res->rport),
                                  "pid",                  OVAL_DATATYPE_INTEGER, (int64_t)n->pid,
-				 "user_id",              OVAL_DATATYPE_SEXP, se_uid_mem = SEXP_number_newu_64(n->uid),
+				 "user_id",              OVAL_DATATYPE_SEXP, se_uid_mem = SEXP_number_newu_64(n->euid),
                                  NULL);
 	} else {
                 item = probe_item_create(OVAL_LINUX_INET_LISTENING_SERVER, NULL,
@@ -372,6 +156,22 @@ static void report_finding(struct result_info *res, llist *l, probe_ctx *ctx)
         SEXP_free(se_uid_mem);
 }
 
+/* Report the socket if it matches the object */
+static void check_socket(const char *type, const char *laddr, unsigned lport,
+	const char *raddr, unsigned rport, unsigned long inode,
+	OVAL_PROC_SNAPSHOT *snap, probe_ctx *ctx, struct server_info *req)
+{
+	if (eval_data(type, laddr, lport, req)) {
+		struct result_info r;
+		r.proto = type;
+		r.laddr = laddr;
+		r.lport = lport;
+		r.raddr = raddr;
+		r.rport = rport;
+		report_finding(&r, snap, oval_proc_snapshot_socket_owner(snap, inode), ctx);
+	}
+}
+
 static void addr_convert(const char *src, char *dest, int size)
 {
 	if (strlen(src) > 8) {
@@ -388,7 +188,11 @@ static void addr_convert(const char *src, char *dest, int size)
 }
 
 
-static int read_tcp(const char *proc, const char *type, llist *l, probe_ctx *ctx, struct server_info *req)
+/*
+ * The sockets are read from /proc/net/ when the kernel can't report them
+ * through NETLINK_SOCK_DIAG.
+ */
+static int read_proc(const char *proc, const char *type, OVAL_PROC_SNAPSHOT *snap, probe_ctx *ctx, struct server_info *req)
 {
 	int line = 0;
 	FILE *f;
@@ -421,132 +225,47 @@ static int read_tcp(const char *proc, const char *type, llist *l, probe_ctx *ctx
 		char src[NI_MAXHOST], dest[NI_MAXHOST];
 		addr_convert(local_addr, src, NI_MAXHOST);
 		addr_convert(rem_addr, dest, NI_MAXHOST);
-		dI("Have tcp port: %s:%u", src, local_port);
-		if (eval_data(type, src, local_port, req)) {
-			struct result_info r;
-			r.proto = type;
-			r.laddr = src;
-			r.lport = local_port;
-			r.raddr = dest;
-			r.rport = rem_port;
-			if (list_find_inode(l, inode)) {
-				report_finding(&r, l, ctx);
-			} else {
-				report_finding(&r, NULL, ctx);
-			}
-		}
+		dI("Have %s port: %s:%u", type, src, local_port);
+		check_socket(type, src, local_port, dest, rem_port, inode, snap, ctx, req);
 	}
 	fclose(f);
 	return 0;
 }
 
-static int read_udp(const char *proc, const char *type, llist *l, probe_ctx *ctx, struct server_info *req)
-{
-	int line = 0;
-	FILE *f;
-	char buf[256];
-	unsigned long rxq, txq, time_len, retr, inode;
-	int local_port, rem_port, d, state, timer_run, uid, timeout;
-	char rem_addr[128], local_addr[128], more[512];
+struct sockdiag_arg {
+	const char *type;
+	OVAL_PROC_SNAPSHOT *snap;
+	probe_ctx *ctx;
+	struct server_info *req;
+};
 
-	f = fopen(proc, "rt");
-	if (f == NULL) {
-		if (errno != ENOENT)
-			return 1;
-		else
-			return 0;
-	}
-	__fsetlocking(f, FSETLOCKING_BYCALLER);
-	while (fgets(buf, sizeof(buf), f)) {
-		if (line == 0) {
-			line++;
-			continue;
-		}
-		more[0] = 0;
-		sscanf(buf, "%d: %64[0-9A-Fa-f]:%X %64[0-9A-Fa-f]:%X %X "
-			"%lX:%lX %X:%lX %lX %d %d %lu %511s\n",
-			&d, local_addr, &local_port, rem_addr, &rem_port,
-			&state, &txq, &rxq, &timer_run, &time_len, &retr,
-			&uid, &timeout, &inode, more);
+static void sockdiag_callback(const struct sockdiag_inet *sock, void *arg)
+{
+	struct sockdiag_arg *a = arg;
 
-		char src[NI_MAXHOST], dest[NI_MAXHOST];
-		addr_convert(local_addr, src, NI_MAXHOST);
-		addr_convert(rem_addr, dest, NI_MAXHOST);
-		dI("Have udp port: %s:%u", src, local_port);
-		if (eval_data(type, src, local_port, req)) {
-			struct result_info r;
-			r.proto = type;
-			r.laddr = src;
-			r.lport = local_port;
-			r.raddr = dest;
-			r.rport = rem_port;
-			if (list_find_inode(l, inode)) {
-				report_finding(&r, l, ctx);
-			} else {
-				report_finding(&r, NULL, ctx);
-			}
-		}
-	}
-	fclose(f);
-	return 0;
+	dI("Have %s port: %s:%u", a->type, sock->laddr, sock->lport);
+	check_socket(a->type, sock->laddr, sock->lport, sock->raddr, sock->rport, sock->inode,
+		     a->snap, a->ctx, a->req);
 }
 
-static int read_raw(const char *proc, const char *type, llist *l, probe_ctx *ctx, struct server_info *req)
+static int read_sockets(const char *proc, int family, int protocol, const char *type,
+	OVAL_PROC_SNAPSHOT *snap, probe_ctx *ctx, struct server_info *req)
 {
-	int line = 0;
-	FILE *f;
-	char buf[256];
-	unsigned long rxq, txq, time_len, retr, inode;
-	int local_port, rem_port, d, state, timer_run, uid, timeout;
-	char rem_addr[128], local_addr[128], more[512];
+	struct sockdiag_arg arg = { type, snap, ctx, req };
+	int ret;
 
-	f = fopen(proc, "rt");
-	if (f == NULL) {
-		if (errno != ENOENT)
-			return 1;
-		else
-			return 0;
-	}
-	__fsetlocking(f, FSETLOCKING_BYCALLER);
-	while (fgets(buf, sizeof(buf), f)) {
-		if (line == 0) {
-			line++;
-			continue;
-		}
-		more[0] = 0;
-		sscanf(buf, "%d: %64[0-9A-Fa-f]:%X %64[0-9A-Fa-f]:%X %X "
-			"%lX:%lX %X:%lX %lX %d %d %lu %511s\n",
-			&d, local_addr, &local_port, rem_addr, &rem_port,
-			&state, &txq, &rxq, &timer_run, &time_len, &retr,
-			&uid, &timeout, &inode, more);
+	ret = sockdiag_inet_dump(family, protocol, sockdiag_callback, &arg);
+	if (ret >= 0)
+		return ret;
 
-		char src[NI_MAXHOST], dest[NI_MAXHOST];
-		addr_convert(local_addr, src, NI_MAXHOST);
-		addr_convert(rem_addr, dest, NI_MAXHOST);
-		dI("Have raw port: %s:%u", src, local_port);
-		if (eval_data(type, src, local_port, req)) {
-			struct result_info r;
-			r.proto = type;
-			r.laddr = src;
-			r.lport = local_port;
-			r.raddr = dest;
-			r.rport = rem_port;
-			if (list_find_inode(l, inode)) {
-				report_finding(&r, l, ctx);
-			} else {
-				report_finding(&r, NULL, ctx);
-			}
-		}
-	}
-	fclose(f);
-	return 0;
+	return read_proc(proc, type, snap, ctx, req);
 }
 
 int inetlisteningservers_probe_main(probe_ctx *ctx, void *arg)
 {
         SEXP_t *object;
 	int err;
-	llist ll;
+	OVAL_PROC_SNAPSHOT *snap;
 
         object = probe_ctx_getobject(ctx);
 	struct server_info *req = malloc(sizeof(struct server_info));
@@ -569,8 +288,8 @@ int inetlisteningservers_probe_main(probe_ctx *ctx, void *arg)
 	}
 
 	// Now start collecting the info
-	list_create(&ll);
-	if (collect_process_info(&ll)) {
+	snap = oval_proc_snapshot_get();
+	if (snap == NULL) {
 		SEXP_t *msg;
 
 		msg = probe_msg_creat(OVAL_MESSAGE_LEVEL_ERROR, "Permission error.");
@@ -583,19 +302,19 @@ int inetlisteningservers_probe_main(probe_ctx *ctx, void *arg)
 	}
 
 	// Now we check the tcp socket list...
-	read_tcp("/proc/net/tcp", "tcp", &ll, ctx, req);
-	read_tcp("/proc/net/tcp6", "tcp", &ll, ctx, req);
+	read_sockets("/proc/net/tcp", AF_INET, IPPROTO_TCP, "tcp", snap, ctx, req);
+	read_sockets("/proc/net/tcp6", AF_INET6, IPPROTO_TCP, "tcp", snap, ctx, req);
 
 	// Next udp sockets...
-	read_udp("/proc/net/udp", "udp", &ll, ctx, req);
-	read_udp("/proc/net/udp6", "udp", &ll, ctx, req);
+	read_sockets("/proc/net/udp", AF_INET, IPPROTO_UDP, "udp", snap, ctx, req);
+	read_sockets("/proc/net/udp6", AF_INET6, IPPROTO_UDP, "udp", snap, ctx, req);
 
 	// Next, raw sockets...not exactly part of standard yet. They
 	// can be used to send datagrams, so we will pretend they are udp
-	read_raw("/proc/net/raw", "udp", &ll, ctx, req);
-	read_raw("/proc/net/raw6", "udp", &ll, ctx, req);
+	read_sockets("/proc/net/raw", AF_INET, IPPROTO_RAW, "udp", snap, ctx, req);
+	read_sockets("/proc/net/raw6", AF_INET6, IPPROTO_RAW, "udp", snap, ctx, req);
 
-	list_clear(&ll);
+	oval_proc_snapshot_release(snap);
 
 	err = 0;
  cleanup:
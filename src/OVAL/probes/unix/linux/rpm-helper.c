@@ -24,6 +24,13 @@
 #include <config.h>
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <regex.h>
+
+#include "oscap_helpers.h"
+
 #ifdef RPM46_FOUND
 int rpmErrorCb (rpmlogRec rec, rpmlogCallbackData data)
 {
@@ -39,3 +46,289 @@ void rpmLibsPreload()
 	const char* rcfiles = "";
 	rpmReadConfigFiles(rcfiles, NULL);
 }
+
+static struct {
+	pthread_mutex_t lock;
+	struct rpm_probe_global *session;
+} rpm_session = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+struct rpm_probe_global *rpm_probe_global_get(void)
+{
+	struct rpm_probe_global *g_rpm;
+
+	pthread_mutex_lock(&rpm_session.lock);
+	if (rpm_session.session == NULL) {
+		g_rpm = calloc(1, sizeof(struct rpm_probe_global));
+		if (g_rpm != NULL) {
+#ifdef RPM46_FOUND
+			rpmlogSetCallback(rpmErrorCb, NULL);
+#endif
+			if (rpmReadConfigFiles((const char *)NULL, (const char *)NULL) != 0) {
+				dI("rpmReadConfigFiles failed: %u, %s.", errno, strerror(errno));
+				g_rpm->rpmts = NULL;
+			} else {
+				g_rpm->rpmts = rpmtsCreate();
+
+				char *dbpath = getenv("OSCAP_PROBE_RPMDB_PATH");
+				if (dbpath) {
+					addMacro(NULL, "_dbpath", NULL, dbpath, 0);
+				}
+			}
+			pthread_mutex_init(&(g_rpm->mutex), NULL);
+			rpm_session.session = g_rpm;
+		}
+	}
+	g_rpm = rpm_session.session;
+	if (g_rpm != NULL)
+		++g_rpm->refs;
+	pthread_mutex_unlock(&rpm_session.lock);
+
+	return g_rpm;
+}
+
+static void rpm_snapshot_free(struct rpm_snapshot *snapshot)
+{
+	if (snapshot == NULL)
+		return;
+
+	for (size_t i = 0; i < snapshot->count; ++i) {
+		struct rpm_package *p = &snapshot->packages[i];
+
+		free(p->name);
+		free(p->epoch);
+		free(p->version);
+		free(p->release);
+		free(p->arch);
+		free(p->evr);
+		free(p->signature_keyid);
+		free(p->extended_name);
+	}
+	free(snapshot->packages);
+	free(snapshot);
+}
+
+void rpm_probe_global_release(struct rpm_probe_global *g_rpm)
+{
+	if (g_rpm == NULL)
+		return;
+
+	pthread_mutex_lock(&rpm_session.lock);
+	if (--g_rpm->refs == 0) {
+		rpm_session.session = NULL;
+
+		rpm_snapshot_free(g_rpm->snapshot);
+		if (g_rpm->rpmts != NULL)
+			rpmtsFree(g_rpm->rpmts);
+		pthread_mutex_destroy(&(g_rpm->mutex));
+		free(g_rpm);
+
+		rpmFreeCrypto();
+		rpmFreeRpmrc();
+		rpmFreeMacros(NULL);
+		rpmlogClose();
+	}
+	pthread_mutex_unlock(&rpm_session.lock);
+}
+
+static const char g_keyid_regex_string[] = "Key ID [a-fA-F0-9]{16}";
+
+static void package_from_header(Header h, struct rpm_package *p, regex_t *keyid_regex)
+{
+	errmsg_t rpmerr;
+	char *str, *sid;
+	const char *epoch_override;
+	regmatch_t keyid_match[1];
+
+	p->name = headerFormat(h, "%{NAME}", &rpmerr);
+	p->arch = headerFormat(h, "%{ARCH}", &rpmerr);
+	p->epoch = headerFormat(h, "%{EPOCH}", &rpmerr);
+	p->release = headerFormat(h, "%{RELEASE}", &rpmerr);
+	p->version = headerFormat(h, "%{VERSION}", &rpmerr);
+
+	epoch_override = oscap_streq(p->epoch, "(none)") ? "0" : p->epoch;
+	p->evr = oscap_sprintf("%s:%s-%s", epoch_override, p->version, p->release);
+	p->extended_name = oscap_sprintf("%s-%s:%s-%s.%s", p->name, epoch_override,
+					 p->version, p->release, p->arch);
+
+	str = headerFormat(h, "%|SIGGPG?{%{SIGGPG:pgpsig}}:{%{SIGPGP:pgpsig}}|", &rpmerr);
+
+	if (str == NULL || regexec(keyid_regex, str, 1, keyid_match, 0) != 0) {
+		sid = NULL;
+		dD("Failed to extract the Key ID value: regex=\"%s\", string=\"%s\"",
+		   g_keyid_regex_string, str);
+	} else {
+		size_t keyid_start, keyid_length;
+
+		if (keyid_match[0].rm_so < 0 || keyid_match[0].rm_eo < 0)
+			sid = NULL;
+		else {
+			keyid_start = keyid_match[0].rm_so + strlen("Key ID ");
+			keyid_length = keyid_match[0].rm_eo - keyid_start;
+			sid = str + keyid_start;
+			sid[keyid_length] = '\0';
+		}
+	}
+
+	p->signature_keyid = strdup(sid != NULL ? sid : "0");
+	free(str);
+}
+
+static int package_cmp(const void *a, const void *b)
+{
+	const struct rpm_package *pa = a, *pb = b;
+	int ret = strcmp(pa->name, pb->name);
+
+	/* keep the database order of the packages of the same name */
+	if (ret == 0)
+		ret = pa->offset < pb->offset ? -1 : pa->offset > pb->offset;
+
+	return ret;
+}
+
+static struct rpm_snapshot *rpm_snapshot_new(rpmts ts)
+{
+	struct rpm_snapshot *snapshot;
+	rpmdbMatchIterator match;
+	regex_t keyid_regex;
+	Header pkgh;
+	size_t size = 0;
+
+	if (regcomp(&keyid_regex, g_keyid_regex_string, REG_EXTENDED) != 0) {
+		dE("regcomp(%s) failed.", g_keyid_regex_string);
+		return NULL;
+	}
+
+	snapshot = calloc(1, sizeof(struct rpm_snapshot));
+	if (snapshot == NULL) {
+		regfree(&keyid_regex);
+		return NULL;
+	}
+
+	match = rpmtsInitIterator(ts, RPMDBI_PACKAGES, NULL, 0);
+	if (match == NULL) {
+		/* empty or unreadable database */
+		regfree(&keyid_regex);
+		return snapshot;
+	}
+
+	while ((pkgh = rpmdbNextIterator(match)) != NULL) {
+		if (snapshot->count == size) {
+			size_t new_size = size > 0 ? size * 2 : 1024;
+			struct rpm_package *packages = realloc(snapshot->packages, new_size * sizeof(struct rpm_package));
+
+			if (packages == NULL) {
+				rpmdbFreeIterator(match);
+				regfree(&keyid_regex);
+				rpm_snapshot_free(snapshot);
+				return NULL;
+			}
+			snapshot->packages = packages;
+			size = new_size;
+		}
+
+		package_from_header(pkgh, &snapshot->packages[snapshot->count], &keyid_regex);
+		snapshot->packages[snapshot->count].offset = rpmdbGetIteratorOffset(match);
+		++snapshot->count;
+	}
+
+	rpmdbFreeIterator(match);
+	regfree(&keyid_regex);
+
+	qsort(snapshot->packages, snapshot->count, sizeof(struct rpm_package), package_cmp);
+	dD("RPM snapshot: %zu packages.", snapshot->count);
+
+	return snapshot;
+}
+
+const struct rpm_snapshot *rpm_probe_snapshot(struct rpm_probe_global *g_rpm)
+{
+	struct rpm_snapshot *snapshot;
+	int prev_cancel_state = -1;
+
+	if (pthread_mutex_lock(&g_rpm->mutex) != 0) {
+		dE("Can't lock mutex");
+		return NULL;
+	}
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &prev_cancel_state);
+
+	if (g_rpm->snapshot == NULL)
+		g_rpm->snapshot = rpm_snapshot_new(g_rpm->rpmts);
+	snapshot = g_rpm->snapshot;
+
+	pthread_mutex_unlock(&g_rpm->mutex);
+	pthread_setcancelstate(prev_cancel_state, NULL);
+
+	return snapshot;
+}
+
+const struct rpm_package *rpm_snapshot_find(const struct rpm_snapshot *snapshot, const char *name, size_t *count)
+{
+	size_t lo = 0, hi = snapshot->count, end;
+
+	/* the first package which isn't ordered before the name */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (strcmp(snapshot->packages[mid].name, name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (end = lo; end < snapshot->count; ++end) {
+		if (strcmp(snapshot->packages[end].name, name) != 0)
+			break;
+	}
+
+	*count = end - lo;
+	return snapshot->packages + lo;
+}
+
+Header rpm_probe_header(struct rpm_probe_global *g_rpm, const struct rpm_package *package)
+{
+	rpmdbMatchIterator match;
+	unsigned int offset = package->offset;
+	Header pkgh;
+
+	match = rpmtsInitIterator(g_rpm->rpmts, RPMDBI_PACKAGES, &offset, sizeof(offset));
+	if (match == NULL)
+		return NULL;
+
+	pkgh = rpmdbNextIterator(match);
+	if (pkgh != NULL)
+		pkgh = headerLink(pkgh);
+	rpmdbFreeIterator(match);
+
+	return pkgh;
+}
+
+int rpm_probe_file_owners(struct rpm_probe_global *g_rpm, const char *path, unsigned int **offsets)
+{
+	rpmdbMatchIterator match;
+	int count = 0;
+
+	*offsets = NULL;
+
+	/* a path passed with RPMTAG_BASENAMES is looked up in the file index */
+	match = rpmtsInitIterator(g_rpm->rpmts, RPMTAG_BASENAMES, path, 0);
+	if (match == NULL)
+		return 0;
+
+	while (rpmdbNextIterator(match) != NULL) {
+		unsigned int *tmp = realloc(*offsets, (count + 1) * sizeof(unsigned int));
+
+		if (tmp == NULL) {
+			free(*offsets);
+			*offsets = NULL;
+			count = -1;
+			break;
+		}
+		*offsets = tmp;
+		(*offsets)[count++] = rpmdbGetIteratorOffset(match);
+	}
+	rpmdbFreeIterator(match);
+
+	return count;
+}
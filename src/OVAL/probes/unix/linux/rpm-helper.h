@@ -37,9 +37,40 @@
 #include "common/debug_priv.h"
 #include "pthread.h"
 
+struct rpm_snapshot;
+
 struct rpm_probe_global {
 	rpmts rpmts;
 	pthread_mutex_t mutex;
+	unsigned int refs;	///< users of the shared session
+	struct rpm_snapshot *snapshot;	///< built by the first query
+};
+
+/*
+ * Installed package as seen by the package snapshot. The strings are
+ * formatted by headerFormat(), the missing epoch is "(none)".
+ */
+struct rpm_package {
+	char *name;
+	char *epoch;
+	char *version;
+	char *release;
+	char *arch;
+	char *evr;		///< epoch:version-release, the missing epoch is 0
+	char *signature_keyid;	///< "0" if the package isn't signed
+	char *extended_name;	///< name-epoch:version-release.arch
+	unsigned int offset;	///< header instance in the rpm database
+};
+
+/*
+ * Read-only list of the installed packages sorted by name. It's built
+ * only once for the session and it's never changed afterwards, so it can
+ * be searched without holding the session mutex. Only reading headers
+ * from the database has to be serialized.
+ */
+struct rpm_snapshot {
+	struct rpm_package *packages;
+	size_t count;
 };
 
 #ifndef HAVE_HEADERFORMAT
@@ -87,6 +118,45 @@ int rpmErrorCb (rpmlogRec rec, rpmlogCallbackData data);
 #define DISABLE_PLUGINS(ts) rpmDefineMacro(NULL,"__plugindir \"\"", 0);
 #endif
 
+/**
+ * Get the rpm session shared by the rpminfo, rpmverify and rpmverifyfile
+ * probes. The rpm configuration is read and the transaction set is created
+ * by the first probe which asks for the session, the session is freed when
+ * the last one releases it.
+ * @return the session, its rpmts is NULL if the rpm configuration can't be
+ * read
+ */
+struct rpm_probe_global *rpm_probe_global_get(void);
+
+void rpm_probe_global_release(struct rpm_probe_global *g_rpm);
+
+/**
+ * Get the package snapshot, the first call reads the headers of all the
+ * installed packages. Must be called without the session mutex held.
+ * @return the snapshot or NULL if the database can't be read
+ */
+const struct rpm_snapshot *rpm_probe_snapshot(struct rpm_probe_global *g_rpm);
+
+/**
+ * Find the packages of the given name in the snapshot.
+ * @return the first package, *count is set to the number of packages
+ */
+const struct rpm_package *rpm_snapshot_find(const struct rpm_snapshot *snapshot, const char *name, size_t *count);
+
+/**
+ * Read the header of the package from the database. The session mutex
+ * has to be held, the header has to be freed by headerFree().
+ */
+Header rpm_probe_header(struct rpm_probe_global *g_rpm, const struct rpm_package *package);
+
+/**
+ * Look up the header instances of the packages which own the file in the
+ * file index of the database. The session mutex has to be held.
+ * @return the number of the owners stored in *offsets (to be freed by the
+ * caller) or -1 on error
+ */
+int rpm_probe_file_owners(struct rpm_probe_global *g_rpm, const char *path, unsigned int **offsets);
+
 /**
  * Preload libraries required by rpm
  * It destroy error callback!
@@ -57,7 +57,6 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-#include <regex.h>
 
 /* RPM headers */
 #include "rpm-helper.h"
@@ -77,199 +76,10 @@ struct rpminfo_req {
         oval_operation_t op;
 };
 
-struct rpminfo_rep {
-        char *name;
-        char *arch;
-        char *epoch;
-        char *release;
-        char *version;
-        char *evr;
-        char *signature_keyid;
-	char extended_name[1024];
-};
-
 #define RPMINFO_LOCK	RPM_MUTEX_LOCK(&g_rpm->mutex)
 
 #define RPMINFO_UNLOCK	RPM_MUTEX_UNLOCK(&g_rpm->mutex)
 
-static const char g_keyid_regex_string[] = "Key ID [a-fA-F0-9]{16}";
-
-static void __rpminfo_rep_free (struct rpminfo_rep *ptr)
-{
-        free (ptr->name);
-        free (ptr->arch);
-        free (ptr->epoch);
-        free (ptr->release);
-        free (ptr->version);
-        free (ptr->evr);
-        free (ptr->signature_keyid);
-}
-
-static void pkgh2rep(Header h, struct rpminfo_rep *r, regex_t *keyid_regex)
-{
-        errmsg_t rpmerr;
-        char *str, *sid;
-	char *epoch_override = NULL;
-        size_t len;
-	regmatch_t keyid_match[1];
-
-	if (h == NULL || r == NULL) {
-		return;
-	}
-
-        r->name = headerFormat (h, "%{NAME}", &rpmerr);
-        r->arch = headerFormat (h, "%{ARCH}", &rpmerr);
-        r->epoch = headerFormat (h, "%{EPOCH}", &rpmerr);
-        r->release = headerFormat (h, "%{RELEASE}", &rpmerr);
-        r->version = headerFormat (h, "%{VERSION}", &rpmerr);
-	epoch_override = oscap_streq(r->epoch, "(none)") ? "0" : r->epoch;
-	snprintf(r->extended_name, 1024, "%s-%s:%s-%s.%s", r->name, epoch_override, r->version, r->release, r->arch);
-
-	len = (strlen(epoch_override) +
-               strlen (r->release) +
-               strlen (r->version) + 2);
-
-        str = malloc (sizeof (char) * (len + 1));
-        snprintf (str, len + 1, "%s:%s-%s",
-		epoch_override,
-                  r->version,
-                  r->release);
-
-        r->evr = str;
-
-        str = headerFormat (h, "%|SIGGPG?{%{SIGGPG:pgpsig}}:{%{SIGPGP:pgpsig}}|", &rpmerr);
-
-	if (regexec(keyid_regex, str, 1, keyid_match, 0) != 0) {
-		sid = NULL;
-		dD("Failed to extract the Key ID value: regex=\"%s\", string=\"%s\"",
-		   g_keyid_regex_string, str);
-	} else {
-		size_t keyid_start, keyid_length;
-
-		if (keyid_match[0].rm_so < 0 || keyid_match[0].rm_eo < 0)
-			sid = NULL;
-		else {
-			keyid_start = keyid_match[0].rm_so + strlen("Key ID ");
-			keyid_length = keyid_match[0].rm_eo - keyid_start;
-			sid = str + keyid_start;
-			sid[keyid_length] = '\0';
-		}
-	}
-
-        r->signature_keyid = strdup(sid != NULL ? sid : "0");
-        free (str);
-}
-
-/*
- * req - Structure containing the name of the package.
- * rep - Pointer to rpminfo_rep structure pointer. An
- *       array of rpminfo_rep structures will be allocated
- *       here.
- *
- * The return value on error is -1. Otherwise the number of
- * rpminfo_rep structures allocated in *rep is returned.
- */
-static int get_rpminfo(struct rpminfo_req *req, struct rpminfo_rep **rep, struct rpm_probe_global *g_rpm)
-{
-	rpmdbMatchIterator match;
-	Header pkgh;
-	int ret = 0, i;
-	regex_t keyid_regex;
-
-	if (regcomp(&keyid_regex, g_keyid_regex_string, REG_EXTENDED) != 0) {
-		dE("regcomp(%s) failed.");
-		return -1;
-	}
-
-        RPMINFO_LOCK;
-
-        ret = -1;
-
-        switch (req->op) {
-        case OVAL_OPERATION_EQUALS:
-		match = rpmtsInitIterator(g_rpm->rpmts, RPMTAG_NAME, (const void *)req->name, 0);
-
-                if (match == NULL) {
-                        ret = 0;
-                        goto ret;
-                }
-
-                ret = rpmdbGetIteratorCount (match);
-
-                break;
-	case OVAL_OPERATION_NOT_EQUAL:
-		match = rpmtsInitIterator(g_rpm->rpmts, RPMDBI_PACKAGES, NULL, 0);
-                if (match == NULL) {
-                        ret = 0;
-                        goto ret;
-                }
-
-                if (rpmdbSetIteratorRE (match, RPMTAG_NAME, RPMMIRE_GLOB, "*") != 0)
-                {
-                        ret = -1;
-                        goto ret;
-                }
-
-                break;
-        case OVAL_OPERATION_PATTERN_MATCH:
-		match = rpmtsInitIterator(g_rpm->rpmts, RPMDBI_PACKAGES, NULL, 0);
-
-                if (match == NULL) {
-                        ret = 0;
-                        goto ret;
-                }
-
-                if (rpmdbSetIteratorRE (match, RPMTAG_NAME, RPMMIRE_REGEX,
-                                        (const char *)req->name) != 0)
-                {
-                        ret = -1;
-                        goto ret;
-                }
-
-                break;
-        default:
-                /* not supported */
-                ret = -1;
-                goto ret;
-        }
-
-        if (ret != -1) {
-                /*
-                 * We can allocate all memory needed now because we know the number
-                 * of results.
-                 */
-                (*rep) = realloc (*rep, sizeof (struct rpminfo_rep) * ret);
-
-                for (i = 0; i < ret; ++i) {
-                        pkgh = rpmdbNextIterator (match);
-
-                        if (pkgh != NULL)
-			pkgh2rep(pkgh, (*rep) + i, &keyid_regex);
-                        else {
-                                /* XXX: emit warning */
-                                break;
-                        }
-                }
-        } else {
-                ret = 0;
-
-                while ((pkgh = rpmdbNextIterator (match)) != NULL) {
-                        (*rep) = realloc (*rep, sizeof (struct rpminfo_rep) * ++ret);
-			if (*rep == NULL) {
-					return -1;
-			}
-			pkgh2rep(pkgh, (*rep) + (ret - 1), &keyid_regex);
-                }
-        }
-
-	match = rpmdbFreeIterator (match);
-ret:
-        RPMINFO_UNLOCK;
-
-	regfree(&keyid_regex);
-        return (ret);
-}
-
 int rpminfo_probe_offline_mode_supported()
 {
 	return PROBE_OFFLINE_CHROOT | PROBE_OFFLINE_RPMDB;
@@ -277,124 +87,66 @@ int rpminfo_probe_offline_mode_supported()
 
 void *rpminfo_probe_init(void)
 {
-#ifdef RPM46_FOUND
-	rpmlogSetCallback(rpmErrorCb, NULL);
-#endif
-	struct rpm_probe_global *g_rpm = malloc(sizeof(struct rpm_probe_global));
-	if (rpmReadConfigFiles ((const char *)NULL, (const char *)NULL) != 0) {
-		dI("rpmReadConfigFiles failed: %u, %s.", errno, strerror (errno));
-		g_rpm->rpmts = NULL;
-		return ((void *)g_rpm);
-        }
-
-	g_rpm->rpmts = rpmtsCreate();
-	pthread_mutex_init (&(g_rpm->mutex), NULL);
-
-	char *dbpath = getenv("OSCAP_PROBE_RPMDB_PATH");
-	if (dbpath) {
-		addMacro(NULL, "_dbpath", NULL, dbpath, 0);
-	}
-
-	return ((void *)g_rpm);
+	return rpm_probe_global_get();
 }
 
 void rpminfo_probe_fini (void *ptr)
 {
-        struct rpm_probe_global *r = (struct rpm_probe_global *)ptr;
-
-	rpmFreeCrypto();
-	rpmFreeRpmrc();
-	rpmFreeMacros(NULL);
-	rpmlogClose();
-
-	if (r == NULL)
-		return;
-
-
-	if (r->rpmts == NULL)
-		return;
-
-        rpmtsFree(r->rpmts);
-        pthread_mutex_destroy (&(r->mutex));
-
-	free(r);
-        return;
+	rpm_probe_global_release((struct rpm_probe_global *)ptr);
 }
 
-static int collect_rpm_files(SEXP_t *item, const struct rpminfo_rep *rep, struct rpm_probe_global *g_rpm)
+static int collect_rpm_files(SEXP_t *item, const struct rpm_package *package, struct rpm_probe_global *g_rpm)
 {
 	SEXP_t *value;
-	rpmdbMatchIterator ts;
 	Header pkgh;
 	rpmfi fi;
 	rpmTag tag[2] = { RPMTAG_BASENAMES, RPMTAG_DIRNAMES };
-	int i, ret = 0;
+	int i;
 
-	ts = rpmtsInitIterator(g_rpm->rpmts, RPMDBI_PACKAGES, NULL, 0);
-	if (ts == NULL) {
-		return -1;
-	}
+	RPMINFO_LOCK;
 
-	if (rpmdbSetIteratorRE(ts, RPMTAG_NAME, RPMMIRE_STRCMP, rep->name) != 0) {
-		ret = -1;
-		goto cleanup;
-	}
-	if (rpmdbSetIteratorRE(ts, RPMTAG_EPOCH, RPMMIRE_STRCMP, rep->epoch) != 0) {
-		ret = -1;
-		goto cleanup;
-	}
-	if (rpmdbSetIteratorRE(ts, RPMTAG_VERSION, RPMMIRE_STRCMP, rep->version) != 0) {
-		ret = -1;
-		goto cleanup;
-	}
-	if (rpmdbSetIteratorRE(ts, RPMTAG_RELEASE, RPMMIRE_STRCMP, rep->release) != 0) {
-		ret = -1;
-		goto cleanup;
-	}
-	if (rpmdbSetIteratorRE(ts, RPMTAG_ARCH, RPMMIRE_STRCMP, rep->arch) != 0) {
-		ret = -1;
-		goto cleanup;
+	pkgh = rpm_probe_header(g_rpm, package);
+	if (pkgh == NULL) {
+		RPMINFO_UNLOCK;
+		return -1;
 	}
 
-	while ((pkgh = rpmdbNextIterator(ts)) != NULL) {
-		/*
-		 * Inspect package files & directories
-		 */
-		for (i = 0; i < 2; ++i) {
-			fi = rpmfiNew(g_rpm->rpmts, pkgh, tag[i], 1);
-
-			while (rpmfiNext(fi) != -1) {
-				const char *filepath;
-				filepath = rpmfiFN(fi);
-				value = probe_entval_from_cstr(
-						OVAL_DATATYPE_STRING,
-						filepath,
-						strlen(filepath)
-						);
-				if (value != NULL) {
-					probe_item_ent_add(item, "filepath", NULL, value);
-					SEXP_free(value);
-				}
+	/*
+	 * Inspect package files & directories
+	 */
+	for (i = 0; i < 2; ++i) {
+		fi = rpmfiNew(g_rpm->rpmts, pkgh, tag[i], 1);
+
+		while (rpmfiNext(fi) != -1) {
+			const char *filepath;
+			filepath = rpmfiFN(fi);
+			value = probe_entval_from_cstr(
+					OVAL_DATATYPE_STRING,
+					filepath,
+					strlen(filepath)
+					);
+			if (value != NULL) {
+				probe_item_ent_add(item, "filepath", NULL, value);
+				SEXP_free(value);
 			}
-			rpmfiFree(fi);
 		}
-
+		rpmfiFree(fi);
 	}
-cleanup:
-	ts = rpmdbFreeIterator(ts);
-	return ret;
+
+	headerFree(pkgh);
+	RPMINFO_UNLOCK;
+	return 0;
 }
 
 int rpminfo_probe_main(probe_ctx *ctx, void *arg)
 {
 	SEXP_t *val, *item, *ent, *probe_in;
 	oval_schema_version_t over;
-	int rpmret, i;
+	int i;
 
         struct rpminfo_req request_st;
-        struct rpminfo_rep *reply_st;
 
-	// arg is NULL if regex compilation failed
+	// arg is NULL if the session couldn't be allocated
 	if (arg == NULL) {
 		return PROBE_EINIT;
 	}
@@ -409,7 +161,9 @@ int rpminfo_probe_main(probe_ctx *ctx, void *arg)
 
 	if (ctx->offline_mode & PROBE_OFFLINE_OWN) {
 		const char* root = getenv("OSCAP_PROBE_ROOT");
+		RPMINFO_LOCK;
 		rpmtsSetRootDir(g_rpm->rpmts, root);
+		RPMINFO_UNLOCK;
 	}
 
 	probe_in = probe_ctx_getobject(ctx);
@@ -473,90 +227,95 @@ int rpminfo_probe_main(probe_ctx *ctx, void *arg)
                 }
         }
 
-        reply_st  = NULL;
-
-        /* get info from RPM db */
-	switch (rpmret = get_rpminfo(&request_st, &reply_st, g_rpm)) {
-        case 0: /* Not found */
-                dI("Package \"%s\" not found.", request_st.name);
-                break;
-        case -1: /* Error */
-                dI("get_rpminfo failed");
-
-                item = probe_item_create(OVAL_LINUX_RPM_INFO, NULL,
-                                         "name", OVAL_DATATYPE_STRING, request_st.name,
-                                         NULL);
-
-                probe_item_setstatus (item, SYSCHAR_STATUS_ERROR);
-                probe_item_collect(ctx, item);
-                break;
-        default: /* Ok */
-                _A(rpmret   >= 0);
-                _A(reply_st != NULL);
-                {
-                        SEXP_t *name;
-
-                        for (i = 0; i < rpmret; ++i) {
-				name = SEXP_string_newf("%s", reply_st[i].name);
-
-				if (probe_entobj_cmp(ent, name) != OVAL_RESULT_TRUE) {
-					SEXP_free(name);
-					continue;
-				}
+	/* get info from the package snapshot */
+	const struct rpm_snapshot *snapshot = rpm_probe_snapshot(g_rpm);
+	const struct rpm_package *packages;
+	size_t count;
 
-                                item = probe_item_create(OVAL_LINUX_RPM_INFO, NULL,
-                                                         "name",    OVAL_DATATYPE_SEXP, name,
-                                                         "arch",    OVAL_DATATYPE_STRING, reply_st[i].arch,
-                                                         "epoch",   OVAL_DATATYPE_STRING, reply_st[i].epoch,
-                                                         "release", OVAL_DATATYPE_STRING, reply_st[i].release,
-                                                         "version", OVAL_DATATYPE_STRING, reply_st[i].version,
-                                                         "evr",     OVAL_DATATYPE_EVR_STRING, reply_st[i].evr,
-                                                         "signature_keyid", OVAL_DATATYPE_STRING, reply_st[i].signature_keyid,
-                                                         NULL);
-
-				/* OVAL 5.10 added extended_name and filepaths behavior */
-				if (oval_schema_version_cmp(over, OVAL_SCHEMA_VERSION(5.10)) >= 0) {
-					SEXP_t *value, *bh_value;
-					value = probe_entval_from_cstr(
-							OVAL_DATATYPE_STRING,
-							reply_st[i].extended_name,
-							strlen(reply_st[i].extended_name)
-					);
-					probe_item_ent_add(item, "extended_name", NULL, value);
-					SEXP_free(value);
-
-					/*
-					 * Parse behaviors
-					 */
-					value = probe_obj_getent(probe_in, "behaviors", 1);
-					if (value != NULL) {
-						bh_value = probe_ent_getattrval(value, "filepaths");
-						if (bh_value != NULL) {
-							if (SEXP_strcmp(bh_value, "true") == 0) {
-								/* collect package files */
-								collect_rpm_files(item, &reply_st[i], g_rpm);
-
-							}
-							SEXP_free(bh_value);
-						}
-						SEXP_free(value);
-					}
+	if (snapshot == NULL) {
+		dI("Can't read the RPM database");
 
-				}
+		item = probe_item_create(OVAL_LINUX_RPM_INFO, NULL,
+					 "name", OVAL_DATATYPE_STRING, request_st.name,
+					 NULL);
+
+		probe_item_setstatus (item, SYSCHAR_STATUS_ERROR);
+		probe_item_collect(ctx, item);
+		SEXP_free(ent);
+		free(request_st.name);
+		return 0;
+	}
+
+	if (request_st.op == OVAL_OPERATION_EQUALS && !probe_ent_attrexists(ent, "var_ref")) {
+		packages = rpm_snapshot_find(snapshot, request_st.name, &count);
+	} else {
+		/* the names are matched by probe_entobj_cmp() below */
+		packages = snapshot->packages;
+		count = snapshot->count;
+	}
+
+	if (count == 0)
+		dI("Package \"%s\" not found.", request_st.name);
 
+	for (i = 0; i < (int)count; ++i) {
+		const struct rpm_package *pkg = &packages[i];
+		SEXP_t *name;
 
-				SEXP_free(name);
-                                __rpminfo_rep_free (&(reply_st[i]));
+		name = SEXP_string_newf("%s", pkg->name);
 
-				if (probe_item_collect(ctx, item) < 0) {
-					SEXP_free(ent);
-					return PROBE_EUNKNOWN;
+		if (probe_entobj_cmp(ent, name) != OVAL_RESULT_TRUE) {
+			SEXP_free(name);
+			continue;
+		}
+
+		item = probe_item_create(OVAL_LINUX_RPM_INFO, NULL,
+					 "name",    OVAL_DATATYPE_SEXP, name,
+					 "arch",    OVAL_DATATYPE_STRING, pkg->arch,
+					 "epoch",   OVAL_DATATYPE_STRING, pkg->epoch,
+					 "release", OVAL_DATATYPE_STRING, pkg->release,
+					 "version", OVAL_DATATYPE_STRING, pkg->version,
+					 "evr",     OVAL_DATATYPE_EVR_STRING, pkg->evr,
+					 "signature_keyid", OVAL_DATATYPE_STRING, pkg->signature_keyid,
+					 NULL);
+
+		/* OVAL 5.10 added extended_name and filepaths behavior */
+		if (oval_schema_version_cmp(over, OVAL_SCHEMA_VERSION(5.10)) >= 0) {
+			SEXP_t *value, *bh_value;
+			value = probe_entval_from_cstr(
+					OVAL_DATATYPE_STRING,
+					pkg->extended_name,
+					strlen(pkg->extended_name)
+			);
+			probe_item_ent_add(item, "extended_name", NULL, value);
+			SEXP_free(value);
+
+			/*
+			 * Parse behaviors
+			 */
+			value = probe_obj_getent(probe_in, "behaviors", 1);
+			if (value != NULL) {
+				bh_value = probe_ent_getattrval(value, "filepaths");
+				if (bh_value != NULL) {
+					if (SEXP_strcmp(bh_value, "true") == 0) {
+						/* collect package files */
+						collect_rpm_files(item, pkg, g_rpm);
+
+					}
+					SEXP_free(bh_value);
 				}
-                        }
+				SEXP_free(value);
+			}
 
-                        free (reply_st);
-                }
-        }
+		}
+
+		SEXP_free(name);
+
+		if (probe_item_collect(ctx, item) < 0) {
+			SEXP_free(ent);
+			free(request_st.name);
+			return PROBE_EUNKNOWN;
+		}
+	}
 
 	SEXP_free(ent);
         free(request_st.name);
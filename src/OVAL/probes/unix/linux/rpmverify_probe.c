@@ -39,7 +39,6 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-#include <pcre.h>
 
 #include "rpm-helper.h"
 
@@ -58,7 +57,7 @@
 #include "rpmverify_probe.h"
 
 struct rpmverify_res {
-        char *name;  /**< package name */
+        const char *name;  /**< package name */
         char *file;  /**< filepath */
         rpmVerifyAttrs vflags; /**< rpm verify flags */
         rpmVerifyAttrs oflags; /**< rpm verify omit flags */
@@ -72,6 +71,15 @@ struct rpmverify_res {
 #define RPMVERIFY_LOCK   RPM_MUTEX_LOCK(&g_rpm->mutex)
 #define RPMVERIFY_UNLOCK RPM_MUTEX_UNLOCK(&g_rpm->mutex)
 
+static bool is_owner(const unsigned int *owners, int count, unsigned int offset)
+{
+	for (int i = 0; i < count; ++i) {
+		if (owners[i] == offset)
+			return true;
+	}
+	return false;
+}
+
 static int rpmverify_collect(probe_ctx *ctx,
                              const char *name, oval_operation_t name_op,
                              const char *file, oval_operation_t file_op,
@@ -80,90 +88,63 @@ static int rpmverify_collect(probe_ctx *ctx,
 		void (*callback)(probe_ctx *, struct rpmverify_res *),
 		struct rpm_probe_global *g_rpm)
 {
-	rpmdbMatchIterator match;
+	const struct rpm_snapshot *snapshot;
+	const struct rpm_package *packages;
+	size_t count, p;
         rpmVerifyAttrs omit = (rpmVerifyAttrs)(flags & RPMVERIFY_RPMATTRMASK);
-	Header pkgh;
-        pcre *re = NULL;
-	int  ret = -1;
-
-        /* pre-compile regex if needed */
-        if (file_op == OVAL_OPERATION_PATTERN_MATCH) {
-                const char *errmsg;
-                int erroff;
-
-                re = pcre_compile(file, PCRE_UTF8, &errmsg,  &erroff, NULL);
+	unsigned int *owners = NULL;
+	int owner_count = -1;
 
-                if (re == NULL) {
-                        /* TODO */
-                        return (-1);
-                }
-        }
+	if (RPMTAG_BASENAMES == 0 || RPMTAG_DIRNAMES == 0) {
+		return -1;
+	}
 
-        RPMVERIFY_LOCK;
+	snapshot = rpm_probe_snapshot(g_rpm);
+	if (snapshot == NULL)
+		return -1;
 
         switch (name_op) {
         case OVAL_OPERATION_EQUALS:
-		match = rpmtsInitIterator(g_rpm->rpmts, RPMTAG_NAME, (const void *)name, 0);
-
-                if (match == NULL) {
-                        ret = 0;
-                        goto ret;
-                }
-
-                ret = rpmdbGetIteratorCount (match);
-
-                break;
+		if (!probe_ent_attrexists(name_ent, "var_ref")) {
+			packages = rpm_snapshot_find(snapshot, name, &count);
+			break;
+		}
+		/* fall through */
 	case OVAL_OPERATION_NOT_EQUAL:
-		match = rpmtsInitIterator(g_rpm->rpmts, RPMDBI_PACKAGES, NULL, 0);
-
-                if (match == NULL) {
-                        ret = 0;
-                        goto ret;
-                }
-
-                if (rpmdbSetIteratorRE (match, RPMTAG_NAME, RPMMIRE_GLOB, "*") != 0)
-                {
-                        ret = -1;
-                        goto ret;
-                }
-
-                break;
         case OVAL_OPERATION_PATTERN_MATCH:
-		match = rpmtsInitIterator(g_rpm->rpmts, RPMDBI_PACKAGES, NULL, 0);
-
-                if (match == NULL) {
-                        ret = 0;
-                        goto ret;
-                }
-
-                if (rpmdbSetIteratorRE (match, RPMTAG_NAME, RPMMIRE_REGEX,
-                                        (const char *)name) != 0)
-                {
-                        ret = -1;
-                        goto ret;
-                }
-
+		/* the names are matched by probe_entobj_cmp() below */
+		packages = snapshot->packages;
+		count = snapshot->count;
                 break;
         default:
                 /* not supported */
                 dE("package name: operation not supported");
-                ret = -1;
-                goto ret;
+                return -1;
         }
 
-	if (RPMTAG_BASENAMES == 0 || RPMTAG_DIRNAMES == 0) {
-		return -1;
+	/* only the owners of the file need to be inspected */
+	if (file_op == OVAL_OPERATION_EQUALS && !probe_ent_attrexists(filepath_ent, "var_ref")) {
+		RPMVERIFY_LOCK;
+		owner_count = rpm_probe_file_owners(g_rpm, file, &owners);
+		RPMVERIFY_UNLOCK;
+
+		if (owner_count < 0)
+			return -1;
 	}
 
-        while ((pkgh = rpmdbNextIterator (match)) != NULL) {
+	for (p = 0; p < count; ++p) {
+		const struct rpm_package *pkg = &packages[p];
+		Header pkgh;
                 rpmfi  fi;
 		rpmTag tag[2] = { RPMTAG_BASENAMES, RPMTAG_DIRNAMES };
                 struct rpmverify_res res;
-                errmsg_t rpmerr;
 		int i;
 		SEXP_t *name_sexp;
 
-                res.name = headerFormat(pkgh, "%{NAME}", &rpmerr);
+		if (owner_count >= 0 && !is_owner(owners, owner_count, pkg->offset))
+			continue;
+
+                res.name = pkg->name;
 
 		name_sexp = SEXP_string_newf("%s", res.name);
 		if (probe_entobj_cmp(name_ent, name_sexp) != OVAL_RESULT_TRUE) {
@@ -172,6 +153,14 @@ static int rpmverify_collect(probe_ctx *ctx,
 		}
 		SEXP_free(name_sexp);
 
+		RPMVERIFY_LOCK;
+
+		pkgh = rpm_probe_header(g_rpm, pkg);
+		if (pkgh == NULL) {
+			RPMVERIFY_UNLOCK;
+			continue;
+		}
+
                 /*
                  * Inspect package files & directories
                  */
@@ -207,16 +196,13 @@ static int rpmverify_collect(probe_ctx *ctx,
 
 		  rpmfiFree(fi);
 		}
-	}
 
-	match = rpmdbFreeIterator (match);
-        ret   = 0;
-ret:
-        if (re != NULL)
-                pcre_free(re);
+		headerFree(pkgh);
+		RPMVERIFY_UNLOCK;
+	}
 
-        RPMVERIFY_UNLOCK;
-        return (ret);
+	free(owners);
+        return 0;
 }
 
 void rpmverify_probe_preload()
@@ -232,38 +218,18 @@ int rpmverify_probe_offline_mode_supported()
 
 void *rpmverify_probe_init(void)
 {
-#ifdef RPM46_FOUND
-	rpmlogSetCallback(rpmErrorCb, NULL);
-#endif
-        if (rpmReadConfigFiles ((const char *)NULL, (const char *)NULL) != 0) {
-                dI("rpmReadConfigFiles failed: %u, %s.", errno, strerror (errno));
-                return (NULL);
-        }
-	struct rpm_probe_global *g_rpm = malloc(sizeof(struct rpm_probe_global));
-	g_rpm->rpmts = rpmtsCreate();
+	struct rpm_probe_global *g_rpm = rpm_probe_global_get();
 
-	pthread_mutex_init(&(g_rpm->mutex), NULL);
+	if (g_rpm != NULL && g_rpm->rpmts == NULL) {
+		rpm_probe_global_release(g_rpm);
+		return (NULL);
+	}
         return ((void *)g_rpm);
 }
 
 void rpmverify_probe_fini(void *ptr)
 {
-        struct rpm_probe_global *r = (struct rpm_probe_global *)ptr;
-
-	rpmFreeCrypto();
-	rpmFreeRpmrc();
-	rpmFreeMacros(NULL);
-	rpmlogClose();
-
-	// If probe_init() failed r->rpmts and r->mutex were not initialized
-	if (r == NULL)
-		return;
-
-	rpmtsFree(r->rpmts);
-	pthread_mutex_destroy (&(r->mutex));
-	free(r);
-
-        return;
+	rpm_probe_global_release((struct rpm_probe_global *)ptr);
 }
 
 static void rpmverify_additem(probe_ctx *ctx, struct rpmverify_res *res)
@@ -340,7 +306,9 @@ int rpmverify_probe_main(probe_ctx *ctx, void *arg)
 
 	if (ctx->offline_mode & PROBE_OFFLINE_OWN) {
 		const char* root = getenv("OSCAP_PROBE_ROOT");
+		RPMVERIFY_LOCK;
 		rpmtsSetRootDir(g_rpm->rpmts, root);
+		RPMVERIFY_UNLOCK;
 	}
 
         /*
@@ -34,6 +34,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
@@ -41,6 +42,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <pcre.h>
 
 #include "rpm-helper.h"
@@ -48,24 +51,28 @@
 /* Individual RPM headers */
 #include <rpm/rpmfi.h>
 #include <rpm/rpmcli.h>
+#ifdef RPM47_FOUND
+#include <rpm/rpmpgp.h>
+#endif
 
 /* SEAP */
 #include <probe-api.h>
 #include "debug_priv.h"
 #include "probe/entcmp.h"
+#include <crapi/crapi.h>
 
 #include <probe/probe.h>
 #include <probe/option.h>
 #include "rpmverifyfile_probe.h"
 
 struct rpmverify_res {
-	char *name;  /**< package name */
+	const char *name;  /**< package name */
 	const char *epoch;
 	const char *version;
 	const char *release;
 	const char *arch;
 	char *file;  /**< filepath */
-	char extended_name[1024];
+	const char *extended_name;
 	rpmVerifyAttrs vflags; /**< rpm verify flags */
 	rpmVerifyAttrs oflags; /**< rpm verify omit flags */
 	rpmfileAttrs   fflags; /**< rpm file flags */
@@ -94,35 +101,299 @@ struct rpmverify_res {
 
 #define RPMVERIFY_UNLOCK RPM_MUTEX_UNLOCK(&g_rpm->mutex)
 
-/* modify passed-in iterator to test also given entity */
-static int adjust_filter(rpmdbMatchIterator iterator, SEXP_t *ent, rpmTag rpm_tag) {
-	oval_operation_t ent_op;
-	char ent_str[1024];
-	int ret = 0;
+/*
+ * The files of up to RPMVERIFY_BATCH packages are read from the rpmdb and
+ * checked by rpmVerifyFile() under the lock, except for their digests.
+ * The digests, which take most of the time, are then computed outside of
+ * the lock by the calling thread and by helper threads, each thread takes
+ * the files of one package at a time. The helper threads are shared by all
+ * the objects evaluated at the same time, so there are never more than
+ * rpmverify_threads() - 1 of them in the process. The items are reported
+ * in the order of the packages and their files once the whole batch is
+ * verified.
+ */
+#define RPMVERIFY_BATCH       64
+#define RPMVERIFY_MAX_THREADS 16
+#define RPMVERIFY_DIGEST_MAX  64
+
+struct rpmverify_file {
+	struct rpmverify_res res;
+	bool          defer_digest; /**< digest is verified outside of the lock */
+	crapi_alg_t   alg;
+	size_t        digest_len;
+	unsigned char digest[RPMVERIFY_DIGEST_MAX];
+};
 
-	if (ent) {
-		ent_op = probe_ent_getoperation(ent, OVAL_OPERATION_EQUALS);
-		PROBE_ENT_STRVAL(ent, ent_str, sizeof ent_str, /* void */, strcpy(ent_str, ""););
+struct rpmverify_batch {
+	struct rpmverify_file *files;
+	size_t  count;
+	size_t  size;
+	size_t *pkg_end;    /**< index behind the last file of each package */
+	size_t  pkg_count;
+	size_t  pkg_next;   /**< next package to be taken by a worker */
+	pthread_mutex_t lock;
+};
 
-		switch (ent_op) {
-		case OVAL_OPERATION_EQUALS:
-			if (rpmdbSetIteratorRE (iterator, rpm_tag, RPMMIRE_STRCMP, ent_str) != 0)
-				ret = -1;
+static pthread_mutex_t rpmverify_helpers_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int rpmverify_helpers_busy = 0;
+
+#ifdef RPM47_FOUND
+static unsigned int rpmverify_threads(void)
+{
+	const char *str = getenv("OSCAP_PROBE_RPMVERIFY_THREADS");
+	char *end;
+	unsigned long value;
+	long ncpu;
+
+	if (str != NULL && *str != '\0') {
+		errno = 0;
+		value = strtoul(str, &end, 10);
+
+		if (errno == 0 && *end == '\0' && value > 0 && value <= RPMVERIFY_MAX_THREADS)
+			return (unsigned int)value;
+
+		dW("Invalid value of OSCAP_PROBE_RPMVERIFY_THREADS: \"%s\"", str);
+	}
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (ncpu < 1)
+		return 1;
+
+	return ncpu > RPMVERIFY_MAX_THREADS ? RPMVERIFY_MAX_THREADS : (unsigned int)ncpu;
+}
+
+/*
+ * Decide whether the digest of the file can be verified outside of the
+ * lock and remember the expected value. The conditions follow those
+ * rpmVerifyFile() uses for the digest check, the type of the file on
+ * the disk is checked by the worker.
+ */
+static bool rpmverify_defer_digest(rpmfi fi, rpmVerifyAttrs omit, struct rpmverify_file *f)
+{
+	const unsigned char *digest;
+	size_t len = 0;
+	int algo = 0;
+
+	if ((omit & RPMVERIFY_FILEDIGEST) || (f->res.fflags & RPMFILE_GHOST))
+		return false;
+
+	switch (rpmfiFState(fi)) {
+	case RPMFILE_STATE_NORMAL:
+	case RPMFILE_STATE_MISSING:
+		break;
+	default:
+		return false;
+	}
+
+	digest = rpmfiFDigest(fi, &algo, &len);
+	if (digest == NULL || len == 0 || len > sizeof f->digest)
+		return false;
+
+	switch (algo) {
+	case PGPHASHALGO_MD5:
+		f->alg = CRAPI_DIGEST_MD5;
+		break;
+	case PGPHASHALGO_SHA1:
+		f->alg = CRAPI_DIGEST_SHA1;
+		break;
+	case PGPHASHALGO_RIPEMD160:
+		f->alg = CRAPI_DIGEST_RMD160;
+		break;
+	case PGPHASHALGO_SHA224:
+		f->alg = CRAPI_DIGEST_SHA224;
+		break;
+	case PGPHASHALGO_SHA256:
+		f->alg = CRAPI_DIGEST_SHA256;
+		break;
+	case PGPHASHALGO_SHA384:
+		f->alg = CRAPI_DIGEST_SHA384;
+		break;
+	case PGPHASHALGO_SHA512:
+		f->alg = CRAPI_DIGEST_SHA512;
+		break;
+	default:
+		/* left to rpmVerifyFile() */
+		return false;
+	}
+
+	memcpy(f->digest, digest, len);
+	f->digest_len = len;
+
+	return true;
+}
+#endif
+
+/*
+ * Compute the digest with crapi_mdigest_fdv(), which read()s the file
+ * through a fixed size buffer. The file isn't mapped, a file truncated
+ * meanwhile would raise SIGBUS in the probe process.
+ */
+static void rpmverify_file_digest(struct rpmverify_file *f)
+{
+	unsigned char digest[RPMVERIFY_DIGEST_MAX];
+	struct crapi_mdigest_t md;
+	struct stat st;
+	int fd;
+
+	/* rpmVerifyFile() has reported the missing files already */
+	if (lstat(f->res.file, &st) != 0 || !S_ISREG(st.st_mode))
+		return;
+
+	md.alg  = f->alg;
+	md.dst  = digest;
+	md.size = sizeof digest;
+
+	fd = open(f->res.file, O_RDONLY | O_NOCTTY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0 || crapi_mdigest_fdv(fd, 1, &md) != 0) {
+		dD("Can't compute the digest of \"%s\": %s", f->res.file, strerror(errno));
+		f->res.vflags |= RPMVERIFY_READFAIL | RPMVERIFY_FILEDIGEST;
+	} else if (md.size != f->digest_len || memcmp(digest, f->digest, md.size) != 0) {
+		f->res.vflags |= RPMVERIFY_FILEDIGEST;
+	}
+
+	if (fd >= 0)
+		close(fd);
+}
+
+static void *rpmverify_worker(void *arg)
+{
+	struct rpmverify_batch *batch = arg;
+	size_t p, i;
 
+	for (;;) {
+		pthread_mutex_lock(&batch->lock);
+		p = batch->pkg_next++;
+		pthread_mutex_unlock(&batch->lock);
+
+		if (p >= batch->pkg_count)
 			break;
-		case OVAL_OPERATION_PATTERN_MATCH:
-			if (rpmdbSetIteratorRE (iterator, rpm_tag, RPMMIRE_REGEX,
-						(const char *)ent_str) != 0)
-				ret = -1;
 
+		for (i = p > 0 ? batch->pkg_end[p - 1] : 0; i < batch->pkg_end[p]; ++i) {
+			if (batch->files[i].defer_digest)
+				rpmverify_file_digest(&batch->files[i]);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Reserve up to `wanted' helper threads from the budget of the process.
+ */
+static unsigned int rpmverify_helpers_get(unsigned int nthreads, unsigned int wanted)
+{
+	unsigned int avail;
+
+	pthread_mutex_lock(&rpmverify_helpers_lock);
+	avail = nthreads - 1 > rpmverify_helpers_busy ? nthreads - 1 - rpmverify_helpers_busy : 0;
+	if (wanted > avail)
+		wanted = avail;
+	rpmverify_helpers_busy += wanted;
+	pthread_mutex_unlock(&rpmverify_helpers_lock);
+
+	return wanted;
+}
+
+static void rpmverify_helpers_put(unsigned int count)
+{
+	pthread_mutex_lock(&rpmverify_helpers_lock);
+	rpmverify_helpers_busy -= count;
+	pthread_mutex_unlock(&rpmverify_helpers_lock);
+}
+
+static void rpmverify_batch_digests(struct rpmverify_batch *batch, unsigned int nthreads)
+{
+	pthread_t threads[RPMVERIFY_MAX_THREADS];
+	unsigned int helpers, started = 0, t;
+
+	batch->pkg_next = 0;
+
+	if (nthreads > batch->pkg_count)
+		helpers = batch->pkg_count > 0 ? batch->pkg_count - 1 : 0;
+	else
+		helpers = nthreads - 1;
+
+	/* the calling thread is one of the workers */
+	helpers = rpmverify_helpers_get(nthreads, helpers);
+
+	for (t = 0; t < helpers; ++t) {
+		if (pthread_create(&threads[started], NULL, rpmverify_worker, batch) != 0) {
+			dW("Can't start an rpmverifyfile worker thread: %s", strerror(errno));
+			break;
+		}
+		++started;
+	}
+
+	rpmverify_worker(batch);
+
+	for (t = 0; t < started; ++t)
+		pthread_join(threads[t], NULL);
+
+	rpmverify_helpers_put(helpers);
+}
+
+static void rpmverify_batch_clear(struct rpmverify_batch *batch)
+{
+	size_t i;
+
+	for (i = 0; i < batch->count; ++i)
+		free(batch->files[i].res.file);
+
+	batch->count = 0;
+	batch->pkg_count = 0;
+}
+
+static struct rpmverify_file *rpmverify_batch_add(struct rpmverify_batch *batch)
+{
+	if (batch->count == batch->size) {
+		size_t size = batch->size > 0 ? batch->size * 2 : 256;
+		struct rpmverify_file *files = realloc(batch->files, size * sizeof(struct rpmverify_file));
+
+		if (files == NULL)
+			return NULL;
+
+		batch->files = files;
+		batch->size = size;
+	}
+
+	return &batch->files[batch->count++];
+}
+
+/*
+ * Verify the deferred digests and report the files of the batch.
+ * @return 1 if the callback asked to stop, 0 otherwise
+ */
+static int rpmverify_batch_flush(probe_ctx *ctx, struct rpmverify_batch *batch, unsigned int nthreads,
+				 int (*callback)(probe_ctx *, struct rpmverify_res *))
+{
+	size_t i;
+	int ret = 0;
+
+	if (nthreads > 1)
+		rpmverify_batch_digests(batch, nthreads);
+
+	for (i = 0; i < batch->count; ++i) {
+		if (callback(ctx, &batch->files[i].res) != 0) {
+			ret = 1;
 			break;
-		default:
-			ret = 0;
 		}
 	}
+
+	rpmverify_batch_clear(batch);
+
 	return ret;
 }
 
+static bool is_owner(const unsigned int *owners, int count, unsigned int offset)
+{
+	for (int i = 0; i < count; ++i) {
+		if (owners[i] == offset)
+			return true;
+	}
+	return false;
+}
+
 static int rpmverify_collect(probe_ctx *ctx,
 			     const char *file, oval_operation_t file_op,
 			     SEXP_t *name_ent, SEXP_t *epoch_ent, SEXP_t *version_ent, SEXP_t *release_ent, SEXP_t *arch_ent,
@@ -130,12 +401,21 @@ static int rpmverify_collect(probe_ctx *ctx,
 		int (*callback)(probe_ctx *, struct rpmverify_res *),
 		struct rpm_probe_global *g_rpm)
 {
-	rpmdbMatchIterator match;
+	const struct rpm_snapshot *snapshot;
+	const struct rpm_package *packages;
+	size_t count, p, pkg_end[RPMVERIFY_BATCH];
 	rpmVerifyAttrs omit = (rpmVerifyAttrs)(flags & RPMVERIFY_RPMATTRMASK);
-	Header pkgh;
+	unsigned int *owners = NULL;
+	unsigned int nthreads;
+	int owner_count = -1;
+	struct rpmverify_batch batch;
 	pcre *re = NULL;
 	int  ret = -1;
 
+	if (RPMTAG_BASENAMES == 0 || RPMTAG_DIRNAMES == 0) {
+		return -1;
+	}
+
 	/* pre-compile regex if needed */
 	if (file_op == OVAL_OPERATION_PATTERN_MATCH) {
 		const char *errmsg;
@@ -149,51 +429,56 @@ static int rpmverify_collect(probe_ctx *ctx,
 		}
 	}
 
-	RPMVERIFY_LOCK;
+	memset(&batch, 0, sizeof batch);
+	batch.pkg_end = pkg_end;
+	pthread_mutex_init(&batch.lock, NULL);
 
-	match = rpmtsInitIterator(g_rpm->rpmts, RPMDBI_PACKAGES, NULL, 0);
-	if (match == NULL) {
-		ret = 0;
-		goto ret;
-	}
+#ifdef RPM47_FOUND
+	nthreads = rpmverify_threads();
+#else
+	/* rpmfiFDigest() isn't available */
+	nthreads = 1;
+#endif
+	dD("Verifying the file digests using %u thread(s)", nthreads);
 
-	if ((ret = adjust_filter(match, name_ent, RPMTAG_NAME)) == -1) {
-		dE("can't adjust filter with name");
-		goto ret;
-	}
-	if ((ret = adjust_filter(match, epoch_ent, RPMTAG_EPOCH)) == -1) {
-		dE("can't adjust filter with epoch");
-		goto ret;
-	}
-	if ((ret = adjust_filter(match, version_ent, RPMTAG_VERSION)) == -1) {
-		dE("can't adjust filter with version");
-		goto ret;
-	}
-	if ((ret = adjust_filter(match, release_ent, RPMTAG_RELEASE)) == -1) {
-		dE("can't adjust filter with version");
-		goto ret;
-	}
-	if ((ret = adjust_filter(match, arch_ent, RPMTAG_ARCH)) == -1) {
-		dE("can't adjust filter with version");
-		goto ret;
+	snapshot = rpm_probe_snapshot(g_rpm);
+	if (snapshot == NULL)
+		goto cleanup;
+
+	if (name_ent != NULL &&
+	    probe_ent_getoperation(name_ent, OVAL_OPERATION_EQUALS) == OVAL_OPERATION_EQUALS &&
+	    !probe_ent_attrexists(name_ent, "var_ref")) {
+		char name[1024];
+
+		PROBE_ENT_STRVAL(name_ent, name, sizeof name, /* void */, strcpy(name, ""););
+		packages = rpm_snapshot_find(snapshot, name, &count);
+	} else {
+		packages = snapshot->packages;
+		count = snapshot->count;
 	}
 
-	if (RPMTAG_BASENAMES == 0 || RPMTAG_DIRNAMES == 0) {
-		return -1;
+	/* only the owners of the file need to be inspected */
+	if (file_op == OVAL_OPERATION_EQUALS) {
+		RPMVERIFY_LOCK;
+		owner_count = rpm_probe_file_owners(g_rpm, file, &owners);
+		RPMVERIFY_UNLOCK;
+
+		if (owner_count < 0)
+			goto cleanup;
 	}
 
-	while ((pkgh = rpmdbNextIterator (match)) != NULL) {
+	for (p = 0; p < count; ++p) {
+		const struct rpm_package *pkg = &packages[p];
+		struct rpmverify_file *f;
+		Header pkgh;
 		SEXP_t *ent;
 		rpmfi  fi;
 		rpmTag tag[2] = { RPMTAG_BASENAMES, RPMTAG_DIRNAMES };
 		struct rpmverify_res res;
-		errmsg_t rpmerr;
 		int i;
 
-		/*
-+SEXP_t *probe_ent_from_cstr(const char *name, oval_datatype_t type,
-+                            const char *value, size_t vallen)
-		 */
+		if (owner_count >= 0 && !is_owner(owners, owner_count, pkg->offset))
+			continue;
 
 #define COMPARE_ENT(XXX) \
 		if (XXX ## _ent != NULL) { \
@@ -207,21 +492,25 @@ static int rpmverify_collect(probe_ctx *ctx,
 			SEXP_free(ent); \
 		}
 
-		res.name = headerFormat(pkgh, "%{NAME}", &rpmerr);
+		res.name = pkg->name;
 		COMPARE_ENT(name);
-
-		res.epoch = headerFormat(pkgh, "%{EPOCH}", &rpmerr);
+		res.epoch = pkg->epoch;
 		COMPARE_ENT(epoch);
-
-		res.version = headerFormat(pkgh, "%{VERSION}", &rpmerr);
+		res.version = pkg->version;
 		COMPARE_ENT(version);
-		res.release = headerFormat(pkgh, "%{RELEASE}", &rpmerr);
+		res.release = pkg->release;
 		COMPARE_ENT(release);
-		res.arch = headerFormat(pkgh, "%{ARCH}", &rpmerr);
+		res.arch = pkg->arch;
 		COMPARE_ENT(arch);
-		snprintf(res.extended_name, 1024, "%s-%s:%s-%s.%s", res.name,
-			oscap_streq(res.epoch, "(none)") ? "0" : res.epoch,
-			res.version, res.release, res.arch);
+		res.extended_name = pkg->extended_name;
+
+		RPMVERIFY_LOCK;
+
+		pkgh = rpm_probe_header(g_rpm, pkg);
+		if (pkgh == NULL) {
+			RPMVERIFY_UNLOCK;
+			continue;
+		}
 
 		/*
 		 * Inspect package files & directories
@@ -267,7 +556,10 @@ static int rpmverify_collect(probe_ctx *ctx,
 			dE("pcre_exec() failed!");
 			ret = -1;
 			free(res.file);
-			goto ret;
+			rpmfiFree(fi);
+			headerFree(pkgh);
+			RPMVERIFY_UNLOCK;
+			goto cleanup;
 		      }
 		      break;
 		    default:
@@ -275,31 +567,61 @@ static int rpmverify_collect(probe_ctx *ctx,
 		      dE("Operation \"%d\" on `filepath' not supported", file_op);
 		      ret = -1;
 					free(res.file);
-		      goto ret;
+		      rpmfiFree(fi);
+		      headerFree(pkgh);
+		      RPMVERIFY_UNLOCK;
+		      goto cleanup;
 		    }
 
-			if (rpmVerifyFile(g_rpm->rpmts, fi, &res.vflags, omit) != 0)
-		      res.vflags = RPMVERIFY_FAILURES;
-
-		    if (callback(ctx, &res) != 0) {
-			    ret = 0;
-					free(res.file);
-			    goto ret;
-		    }
-			free(res.file);
+			f = rpmverify_batch_add(&batch);
+			if (f == NULL) {
+				ret = -1;
+				free(res.file);
+				rpmfiFree(fi);
+				headerFree(pkgh);
+				RPMVERIFY_UNLOCK;
+				goto cleanup;
+			}
+			f->res = res;
+			f->defer_digest = false;
+#ifdef RPM47_FOUND
+			if (nthreads > 1)
+				f->defer_digest = rpmverify_defer_digest(fi, omit, f);
+#endif
+			if (rpmVerifyFile(g_rpm->rpmts, fi, &f->res.vflags,
+					  f->defer_digest ? omit | RPMVERIFY_FILEDIGEST : omit) != 0) {
+				f->res.vflags = RPMVERIFY_FAILURES;
+				f->defer_digest = false;
+			}
 		  }
 
 		  rpmfiFree(fi);
 		}
+
+		headerFree(pkgh);
+		RPMVERIFY_UNLOCK;
+
+		if (batch.count > (batch.pkg_count > 0 ? batch.pkg_end[batch.pkg_count - 1] : 0))
+			batch.pkg_end[batch.pkg_count++] = batch.count;
+
+		if (batch.pkg_count == RPMVERIFY_BATCH &&
+		    rpmverify_batch_flush(ctx, &batch, nthreads, callback) != 0) {
+			ret = 0;
+			goto cleanup;
+		}
 	}
 
-	match = rpmdbFreeIterator (match);
+	rpmverify_batch_flush(ctx, &batch, nthreads, callback);
+
 	ret   = 0;
-ret:
+cleanup:
+	rpmverify_batch_clear(&batch);
+	free(batch.files);
+	pthread_mutex_destroy(&batch.lock);
 	if (re != NULL)
 		pcre_free(re);
+	free(owners);
 
-	RPMVERIFY_UNLOCK;
 	return (ret);
 }
 
@@ -316,40 +638,19 @@ int rpmverifyfile_probe_offline_mode_supported()
 
 void *rpmverifyfile_probe_init(void)
 {
-#ifdef RPM46_FOUND
-	rpmlogSetCallback(rpmErrorCb, NULL);
-#endif
-	if (rpmReadConfigFiles ((const char *)NULL, (const char *)NULL) != 0) {
-		dI("rpmReadConfigFiles failed: %u, %s.", errno, strerror (errno));
+	struct rpm_probe_global *g_rpm = rpm_probe_global_get();
+
+	if (g_rpm != NULL && g_rpm->rpmts == NULL) {
+		rpm_probe_global_release(g_rpm);
 		return (NULL);
 	}
 
-	struct rpm_probe_global *g_rpm = malloc(sizeof(struct rpm_probe_global));
-	g_rpm->rpmts = rpmtsCreate();
-
-	pthread_mutex_init(&(g_rpm->mutex), NULL);
-
 	return ((void *)g_rpm);
 }
 
 void rpmverifyfile_probe_fini(void *ptr)
 {
-	struct rpm_probe_global *r = (struct rpm_probe_global *)ptr;
-
-	rpmFreeCrypto();
-	rpmFreeRpmrc();
-	rpmFreeMacros(NULL);
-	rpmlogClose();
-
-	// If probe_init() failed r->rpmts and r->mutex were not initialized
-	if (r == NULL)
-		return;
-
-	rpmtsFree(r->rpmts);
-	pthread_mutex_destroy (&(r->mutex));
-	free(r);
-
-	return;
+	rpm_probe_global_release((struct rpm_probe_global *)ptr);
 }
 
 static void _add_ent_from_cstr(SEXP_t *item, const char *name, const char *value)
@@ -456,7 +757,9 @@ int rpmverifyfile_probe_main(probe_ctx *ctx, void *arg)
 
 	if (ctx->offline_mode & PROBE_OFFLINE_OWN) {
 		const char* root = getenv("OSCAP_PROBE_ROOT");
+		RPMVERIFY_LOCK;
 		rpmtsSetRootDir(g_rpm->rpmts, root);
+		RPMVERIFY_UNLOCK;
 	}
 
 	/*
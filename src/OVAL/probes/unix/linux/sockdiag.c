@@ -0,0 +1,257 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+#include <linux/packet_diag.h>
+
+#include "common/debug_priv.h"
+#include "sockdiag.h"
+
+#define SOCKDIAG_BUFSIZE 65536
+
+/*
+ * Send the dump request and pass every reply message to the parser.
+ * Returns 0 only if the kernel finished the dump without an error.
+ */
+static int sockdiag_dump(void *req, size_t req_len,
+			 int (*parse)(const struct nlmsghdr *nlh, void *arg), void *arg)
+{
+	struct sockaddr_nl nladdr;
+	struct nlmsghdr *nlh = req;
+	void *buf;
+	int fd, ret = -1;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+	if (fd < 0) {
+		dI("Can't open NETLINK_SOCK_DIAG socket: %s", strerror(errno));
+		return -1;
+	}
+
+	memset(&nladdr, 0, sizeof nladdr);
+	nladdr.nl_family = AF_NETLINK;
+
+	nlh->nlmsg_len = req_len;
+	nlh->nlmsg_type = SOCK_DIAG_BY_FAMILY;
+	nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	nlh->nlmsg_seq = 1;
+
+	if (sendto(fd, req, req_len, 0, (struct sockaddr *)&nladdr, sizeof nladdr) < 0) {
+		dI("Can't send the sock_diag request: %s", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	buf = malloc(SOCKDIAG_BUFSIZE);
+	if (buf == NULL) {
+		close(fd);
+		return -1;
+	}
+
+	for (;;) {
+		ssize_t len = recv(fd, buf, SOCKDIAG_BUFSIZE, 0);
+
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			dE("Can't receive the sock_diag reply: %s", strerror(errno));
+			goto out;
+		}
+
+		for (nlh = buf; NLMSG_OK(nlh, (size_t)len); nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_type == NLMSG_DONE) {
+				/* the dump may end with an error as well */
+				int *err = NLMSG_DATA(nlh);
+
+				if (nlh->nlmsg_len >= NLMSG_LENGTH(sizeof(int)) && *err < 0) {
+					dI("sock_diag dump failed: %s", strerror(-*err));
+				} else {
+					ret = 0;
+				}
+				goto out;
+			}
+			if (nlh->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *err = NLMSG_DATA(nlh);
+
+				dI("sock_diag request failed: %s", strerror(-err->error));
+				goto out;
+			}
+			if (nlh->nlmsg_type != SOCK_DIAG_BY_FAMILY)
+				continue;
+
+			if (parse(nlh, arg) != 0)
+				goto out;
+		}
+	}
+out:
+	free(buf);
+	close(fd);
+	return ret;
+}
+
+/*
+ * The sockets are collected first and reported only when the whole dump
+ * succeeded, the caller reads /proc/net/ instead otherwise.
+ */
+struct sockdiag_list {
+	void *items;
+	size_t size;
+	size_t count;
+	size_t alloc;
+};
+
+static void *sockdiag_list_add(struct sockdiag_list *list)
+{
+	if (list->count == list->alloc) {
+		size_t alloc = list->alloc > 0 ? list->alloc * 2 : 64;
+		void *items = realloc(list->items, alloc * list->size);
+
+		if (items == NULL)
+			return NULL;
+
+		list->items = items;
+		list->alloc = alloc;
+	}
+
+	return (char *)list->items + list->size * list->count++;
+}
+
+static int sockdiag_inet_parse(const struct nlmsghdr *nlh, void *arg)
+{
+	const struct inet_diag_msg *msg = NLMSG_DATA(nlh);
+	struct sockdiag_inet *sock;
+
+	if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct inet_diag_msg)))
+		return 0;
+
+	sock = sockdiag_list_add(arg);
+	if (sock == NULL)
+		return -1;
+
+	inet_ntop(msg->idiag_family, msg->id.idiag_src, sock->laddr, sizeof sock->laddr);
+	inet_ntop(msg->idiag_family, msg->id.idiag_dst, sock->raddr, sizeof sock->raddr);
+	sock->lport = ntohs(msg->id.idiag_sport);
+	sock->rport = ntohs(msg->id.idiag_dport);
+	sock->inode = msg->idiag_inode;
+
+	return 0;
+}
+
+int sockdiag_inet_dump(int family, int protocol,
+		       void (*callback)(const struct sockdiag_inet *sock, void *arg), void *arg)
+{
+	struct {
+		struct nlmsghdr nlh;
+		struct inet_diag_req_v2 r;
+	} req;
+	struct sockdiag_list list = { NULL, sizeof(struct sockdiag_inet), 0, 0 };
+	size_t i;
+
+	memset(&req, 0, sizeof req);
+	req.r.sdiag_family = family;
+	req.r.sdiag_protocol = protocol;
+	req.r.idiag_states = ~0U;
+	/*
+	 * The raw diag module takes the protocol of the raw sockets to report
+	 * from the pad field, IPPROTO_RAW asks for all of them.
+	 */
+	if (protocol == IPPROTO_RAW)
+		req.r.pad = IPPROTO_RAW;
+
+	if (sockdiag_dump(&req, sizeof req, sockdiag_inet_parse, &list) != 0) {
+		free(list.items);
+		return -1;
+	}
+
+	for (i = 0; i < list.count; ++i)
+		callback((struct sockdiag_inet *)list.items + i, arg);
+
+	free(list.items);
+	return 0;
+}
+
+static int sockdiag_packet_parse(const struct nlmsghdr *nlh, void *arg)
+{
+	const struct packet_diag_msg *msg = NLMSG_DATA(nlh);
+	const struct nlattr *attr;
+	struct sockdiag_packet *sock;
+	int len;
+
+	if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct packet_diag_msg)))
+		return 0;
+
+	sock = sockdiag_list_add(arg);
+	if (sock == NULL)
+		return -1;
+
+	sock->proto_num = msg->pdiag_num;
+	sock->ifindex = 0;
+	sock->inode = msg->pdiag_ino;
+
+	len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(struct packet_diag_msg));
+	attr = (const struct nlattr *)((const char *)msg + NLMSG_ALIGN(sizeof(struct packet_diag_msg)));
+
+	while (len >= (int)sizeof(struct nlattr) && attr->nla_len >= sizeof(struct nlattr) && attr->nla_len <= len) {
+		if (attr->nla_type == PACKET_DIAG_INFO &&
+		    attr->nla_len >= NLA_HDRLEN + sizeof(struct packet_diag_info)) {
+			const struct packet_diag_info *info = (const void *)((const char *)attr + NLA_HDRLEN);
+
+			sock->ifindex = info->pdi_index;
+		}
+		len -= NLA_ALIGN(attr->nla_len);
+		attr = (const struct nlattr *)((const char *)attr + NLA_ALIGN(attr->nla_len));
+	}
+
+	return 0;
+}
+
+int sockdiag_packet_dump(void (*callback)(const struct sockdiag_packet *sock, void *arg), void *arg)
+{
+	struct {
+		struct nlmsghdr nlh;
+		struct packet_diag_req r;
+	} req;
+	struct sockdiag_list list = { NULL, sizeof(struct sockdiag_packet), 0, 0 };
+	size_t i;
+
+	memset(&req, 0, sizeof req);
+	req.r.sdiag_family = AF_PACKET;
+	req.r.pdiag_show = PACKET_SHOW_INFO;
+
+	if (sockdiag_dump(&req, sizeof req, sockdiag_packet_parse, &list) != 0) {
+		free(list.items);
+		return -1;
+	}
+
+	for (i = 0; i < list.count; ++i)
+		callback((struct sockdiag_packet *)list.items + i, arg);
+
+	free(list.items);
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef OPENSCAP_SOCKDIAG_H
+#define OPENSCAP_SOCKDIAG_H
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/*
+ * Socket listing through NETLINK_SOCK_DIAG. The sockets come from the
+ * kernel in binary batches, so there's no need to parse /proc/net/ text
+ * tables. The dump functions return 0 on success. If the dump fails at
+ * any point (the diag module isn't available, the reply is cut short,
+ * ...) -1 is returned without reporting any socket, the caller is expected
+ * to fall back to /proc/net/ then.
+ */
+
+struct sockdiag_inet {
+	char laddr[INET6_ADDRSTRLEN];
+	unsigned lport;
+	char raddr[INET6_ADDRSTRLEN];
+	unsigned rport;
+	unsigned long inode;
+};
+
+struct sockdiag_packet {
+	unsigned proto_num;	///< ethernet protocol, host byte order
+	int ifindex;
+	unsigned long inode;
+};
+
+/**
+ * Report all the sockets of the family (AF_INET, AF_INET6) and protocol
+ * (IPPROTO_TCP, IPPROTO_UDP, IPPROTO_RAW) in any state. The local port
+ * of a raw socket is its protocol, as in /proc/net/raw.
+ */
+int sockdiag_inet_dump(int family, int protocol,
+		       void (*callback)(const struct sockdiag_inet *sock, void *arg), void *arg);
+
+/**
+ * Report all the AF_PACKET sockets.
+ */
+int sockdiag_packet_dump(void (*callback)(const struct sockdiag_packet *sock, void *arg), void *arg);
+
+#endif /* OPENSCAP_SOCKDIAG_H */
@@ -0,0 +1,731 @@
+/**
+ * @file   systemdcache.c
+ * @brief  systemd unit properties cached for the whole scan
+ */
+
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "common/list.h"
+#include "systemdshared.h"
+#include "systemdcache.h"
+
+/*
+ * Number of calls sent before the first reply is collected. The system
+ * bus limits the number of replies a connection may be waiting for.
+ */
+#define SYSTEMD_CACHE_WINDOW 64
+
+struct systemd_property {
+	char *name;
+	char **values;
+	size_t count;
+};
+
+struct systemd_unit {
+	char *name;
+	char *path;
+	bool queued;	///< already in the list of units being fetched
+	bool loaded;	///< the properties were fetched, successfully or not
+	bool failed;
+	struct systemd_property *props;
+	size_t prop_count;
+	const struct systemd_property *requires;
+	const struct systemd_property *wants;
+};
+
+struct systemd_cache {
+	pthread_mutex_t lock;	///< serializes the fetching and the lookups
+	unsigned int refs;	///< protected by systemd_cache.lock
+
+	DBusConnection *conn;
+	struct oscap_htable *units;	///< unit name -> struct systemd_unit
+	struct systemd_unit **listed;	///< units reported by ListUnits
+	size_t listed_count;
+	size_t listed_size;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	SYSTEMD_CACHE *cache;
+} systemd_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static void systemd_unit_free(void *ptr)
+{
+	struct systemd_unit *unit = ptr;
+
+	for (size_t i = 0; i < unit->prop_count; ++i) {
+		for (size_t j = 0; j < unit->props[i].count; ++j)
+			free(unit->props[i].values[j]);
+		free(unit->props[i].values);
+		free(unit->props[i].name);
+	}
+	free(unit->props);
+	free(unit->path);
+	free(unit->name);
+	free(unit);
+}
+
+static void systemd_cache_free(SYSTEMD_CACHE *cache)
+{
+	oscap_htable_free(cache->units, systemd_unit_free);
+	free(cache->listed);
+	disconnect_dbus(cache->conn);
+	pthread_mutex_destroy(&cache->lock);
+	free(cache);
+}
+
+static struct systemd_unit *systemd_cache_unit(SYSTEMD_CACHE *cache, const char *name)
+{
+	struct systemd_unit *unit = oscap_htable_get(cache->units, name);
+
+	if (unit != NULL)
+		return unit;
+
+	unit = calloc(1, sizeof(struct systemd_unit));
+	if (unit == NULL)
+		return NULL;
+	unit->name = oscap_strdup(name);
+	if (!oscap_htable_add(cache->units, unit->name, unit)) {
+		systemd_unit_free(unit);
+		return NULL;
+	}
+
+	return unit;
+}
+
+static int list_callback(const char *name, void *cbarg)
+{
+	SYSTEMD_CACHE *cache = cbarg;
+	struct systemd_unit *unit = systemd_cache_unit(cache, name);
+
+	if (unit == NULL)
+		return 1;
+
+	if (cache->listed_count == cache->listed_size) {
+		size_t size = cache->listed_size > 0 ? cache->listed_size * 2 : 256;
+		struct systemd_unit **listed = realloc(cache->listed, size * sizeof(struct systemd_unit *));
+
+		if (listed == NULL)
+			return 1;
+		cache->listed = listed;
+		cache->listed_size = size;
+	}
+	cache->listed[cache->listed_count++] = unit;
+
+	return 0;
+}
+
+static SYSTEMD_CACHE *systemd_cache_new(void)
+{
+	SYSTEMD_CACHE *cache;
+	DBusConnection *conn;
+
+	conn = connect_dbus();
+	if (conn == NULL)
+		return NULL;
+
+	cache = calloc(1, sizeof(SYSTEMD_CACHE));
+	if (cache == NULL) {
+		disconnect_dbus(conn);
+		return NULL;
+	}
+
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->refs = 1;
+	cache->conn = conn;
+	cache->units = oscap_htable_new();
+	if (cache->units == NULL) {
+		systemd_cache_free(cache);
+		return NULL;
+	}
+
+	get_all_systemd_units(conn, list_callback, cache);
+	dD("systemd cache: %zu units listed.", cache->listed_count);
+
+	return cache;
+}
+
+SYSTEMD_CACHE *systemd_cache_get(void)
+{
+	SYSTEMD_CACHE *cache;
+
+	pthread_mutex_lock(&systemd_cache.lock);
+	if (systemd_cache.cache == NULL)
+		systemd_cache.cache = systemd_cache_new();
+	cache = systemd_cache.cache;
+	if (cache != NULL)
+		++cache->refs;
+	pthread_mutex_unlock(&systemd_cache.lock);
+
+	return cache;
+}
+
+void systemd_cache_release(SYSTEMD_CACHE *cache)
+{
+	if (cache == NULL)
+		return;
+
+	pthread_mutex_lock(&systemd_cache.lock);
+	if (--cache->refs == 0)
+		systemd_cache_free(cache);
+	pthread_mutex_unlock(&systemd_cache.lock);
+}
+
+void systemd_cache_invalidate(void)
+{
+	SYSTEMD_CACHE *cache;
+
+	pthread_mutex_lock(&systemd_cache.lock);
+	cache = systemd_cache.cache;
+	systemd_cache.cache = NULL;
+	if (cache != NULL && --cache->refs == 0)
+		systemd_cache_free(cache);
+	pthread_mutex_unlock(&systemd_cache.lock);
+}
+
+size_t systemd_cache_unit_count(const SYSTEMD_CACHE *cache)
+{
+	return cache->listed_count;
+}
+
+const char *systemd_cache_unit_name(const SYSTEMD_CACHE *cache, size_t i)
+{
+	return cache->listed[i]->name;
+}
+
+/*
+ * Send the calls built by the build function all at once (up to the window
+ * size) and only then wait for the replies. systemd processes the requests
+ * back to back instead of waiting for us to parse each reply.
+ */
+static void systemd_pipeline(DBusConnection *conn, struct systemd_unit **units, size_t count,
+			     DBusMessage *(*build)(struct systemd_unit *unit),
+			     void (*parse)(struct systemd_unit *unit, DBusMessage *reply))
+{
+	DBusPendingCall *pending[SYSTEMD_CACHE_WINDOW];
+
+	for (size_t base = 0; base < count; base += SYSTEMD_CACHE_WINDOW) {
+		size_t n = count - base < SYSTEMD_CACHE_WINDOW ? count - base : SYSTEMD_CACHE_WINDOW;
+
+		for (size_t i = 0; i < n; ++i) {
+			DBusMessage *msg = build(units[base + i]);
+
+			pending[i] = NULL;
+			if (msg == NULL)
+				continue;
+			if (!dbus_connection_send_with_reply(conn, msg, &pending[i], -1)) {
+				dI("Failed to send message via dbus!");
+				pending[i] = NULL;
+			}
+			dbus_message_unref(msg);
+		}
+
+		dbus_connection_flush(conn);
+
+		for (size_t i = 0; i < n; ++i) {
+			DBusMessage *reply = NULL;
+
+			if (pending[i] != NULL) {
+				dbus_pending_call_block(pending[i]);
+				reply = dbus_pending_call_steal_reply(pending[i]);
+				dbus_pending_call_unref(pending[i]);
+				if (reply == NULL)
+					dI("Failed to steal dbus pending call reply.");
+			}
+
+			if (reply != NULL && dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR) {
+				dI("The call for unit '%s' failed: %s", units[base + i]->name,
+				   dbus_message_get_error_name(reply));
+				dbus_message_unref(reply);
+				reply = NULL;
+			}
+
+			parse(units[base + i], reply);
+			if (reply != NULL)
+				dbus_message_unref(reply);
+		}
+	}
+}
+
+static DBusMessage *load_unit_build(struct systemd_unit *unit)
+{
+	DBusMessage *msg;
+	DBusMessageIter args;
+
+	msg = dbus_message_new_method_call(
+		"org.freedesktop.systemd1",
+		"/org/freedesktop/systemd1",
+		"org.freedesktop.systemd1.Manager",
+		// LoadUnit is similar to GetUnit except it will load the unit file
+		// if it hasn't been loaded yet.
+		"LoadUnit"
+	);
+	if (msg == NULL) {
+		dI("Failed to create dbus_message via dbus_message_new_method_call!");
+		return NULL;
+	}
+
+	dbus_message_iter_init_append(msg, &args);
+	if (!dbus_message_iter_append_basic(&args, DBUS_TYPE_STRING, &unit->name)) {
+		dI("Failed to append unit '%s' string parameter to dbus message!", unit->name);
+		dbus_message_unref(msg);
+		return NULL;
+	}
+
+	return msg;
+}
+
+static void load_unit_parse(struct systemd_unit *unit, DBusMessage *reply)
+{
+	DBusMessageIter args;
+	_DBusBasicValue path;
+
+	if (reply == NULL)
+		return;
+
+	if (!dbus_message_iter_init(reply, &args)) {
+		dI("Failed to initialize iterator over received dbus message.");
+		return;
+	}
+
+	if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_OBJECT_PATH) {
+		dI("Expected string argument in reply. Instead received: %s.", dbus_message_type_to_string(dbus_message_iter_get_arg_type(&args)));
+		return;
+	}
+
+	dbus_message_iter_get_basic(&args, &path);
+	unit->path = oscap_strdup(path.str);
+}
+
+static DBusMessage *get_all_build(struct systemd_unit *unit)
+{
+	DBusMessage *msg;
+	DBusMessageIter args;
+	const char *interface = "org.freedesktop.systemd1.Unit";
+
+	if (unit->path == NULL)
+		return NULL;
+
+	msg = dbus_message_new_method_call(
+		"org.freedesktop.systemd1",
+		unit->path,
+		"org.freedesktop.DBus.Properties",
+		"GetAll"
+	);
+	if (msg == NULL) {
+		dI("Failed to create dbus_message via dbus_message_new_method_call!");
+		return NULL;
+	}
+
+	dbus_message_iter_init_append(msg, &args);
+	if (!dbus_message_iter_append_basic(&args, DBUS_TYPE_STRING, &interface)) {
+		dI("Failed to append interface '%s' string parameter to dbus message!", interface);
+		dbus_message_unref(msg);
+		return NULL;
+	}
+
+	return msg;
+}
+
+static bool property_add_value(struct systemd_property *prop, char *value)
+{
+	char **values = realloc(prop->values, (prop->count + 1) * sizeof(char *));
+
+	if (values == NULL) {
+		free(value);
+		return false;
+	}
+	values[prop->count++] = value;
+	prop->values = values;
+
+	return true;
+}
+
+static struct systemd_property *unit_add_property(struct systemd_unit *unit, const char *name)
+{
+	struct systemd_property *props;
+
+	props = realloc(unit->props, (unit->prop_count + 1) * sizeof(struct systemd_property));
+	if (props == NULL)
+		return NULL;
+	unit->props = props;
+
+	props = &unit->props[unit->prop_count++];
+	props->name = oscap_strdup(name);
+	props->values = NULL;
+	props->count = 0;
+
+	return props;
+}
+
+static void get_all_parse(struct systemd_unit *unit, DBusMessage *reply)
+{
+	DBusMessageIter args, property_iter;
+
+	unit->loaded = true;
+	unit->failed = true;
+
+	if (reply == NULL)
+		return;
+
+	if (!dbus_message_iter_init(reply, &args)) {
+		dI("Failed to initialize iterator over received dbus message.");
+		return;
+	}
+
+	if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_ARRAY && dbus_message_iter_get_element_type(&args) != DBUS_TYPE_DICT_ENTRY) {
+		dI("Expected array of dict_entry argument in reply. Instead received: %s.", dbus_message_type_to_string(dbus_message_iter_get_arg_type(&args)));
+		return;
+	}
+
+	unit->failed = false;
+
+	dbus_message_iter_recurse(&args, &property_iter);
+	do {
+		DBusMessageIter dict_entry, value_variant;
+		struct systemd_property *prop;
+		_DBusBasicValue value;
+
+		dbus_message_iter_recurse(&property_iter, &dict_entry);
+
+		if (dbus_message_iter_get_arg_type(&dict_entry) != DBUS_TYPE_STRING) {
+			dI("Expected string as key in dict_entry. Instead received: %s.", dbus_message_type_to_string(dbus_message_iter_get_arg_type(&dict_entry)));
+			break;
+		}
+
+		dbus_message_iter_get_basic(&dict_entry, &value);
+
+		if (dbus_message_iter_next(&dict_entry) == false) {
+			dW("Expected another field in dict_entry.");
+			break;
+		}
+
+		if (dbus_message_iter_get_arg_type(&dict_entry) != DBUS_TYPE_VARIANT) {
+			dI("Expected variant as value in dict_entry. Instead received: %s.", dbus_message_type_to_string(dbus_message_iter_get_arg_type(&dict_entry)));
+			break;
+		}
+
+		prop = unit_add_property(unit, value.str);
+		if (prop == NULL)
+			break;
+
+		dbus_message_iter_recurse(&dict_entry, &value_variant);
+
+		// DBUS_TYPE_ARRAY is a special case, we keep each element as one value entry
+		if (dbus_message_iter_get_arg_type(&value_variant) == DBUS_TYPE_ARRAY) {
+			DBusMessageIter array;
+			dbus_message_iter_recurse(&value_variant, &array);
+
+			do {
+				char *element = dbus_value_to_string(&array);
+				if (element == NULL)
+					continue;
+
+				if (!property_add_value(prop, element))
+					break;
+			}
+			while (dbus_message_iter_next(&array));
+		}
+		else {
+			property_add_value(prop, dbus_value_to_string(&value_variant));
+		}
+	}
+	while (dbus_message_iter_next(&property_iter));
+
+	/* the pointers are taken once the array doesn't move anymore */
+	for (size_t i = 0; i < unit->prop_count; ++i) {
+		if (strcmp(unit->props[i].name, "Requires") == 0)
+			unit->requires = &unit->props[i];
+		else if (strcmp(unit->props[i].name, "Wants") == 0)
+			unit->wants = &unit->props[i];
+	}
+}
+
+/* Fetch the properties of the units, with the cache locked */
+static void systemd_cache_load(SYSTEMD_CACHE *cache, struct systemd_unit *const *units, size_t count)
+{
+	struct systemd_unit **batch;
+	size_t n = 0;
+
+	batch = malloc(count * sizeof(struct systemd_unit *));
+	if (batch == NULL)
+		return;
+
+	for (size_t i = 0; i < count; ++i) {
+		if (!units[i]->loaded)
+			batch[n++] = units[i];
+	}
+
+	if (n > 0) {
+		dD("systemd cache: fetching %zu units.", n);
+		systemd_pipeline(cache->conn, batch, n, load_unit_build, load_unit_parse);
+		systemd_pipeline(cache->conn, batch, n, get_all_build, get_all_parse);
+	}
+
+	free(batch);
+}
+
+void systemd_cache_prefetch(SYSTEMD_CACHE *cache, const char **names, size_t count)
+{
+	struct systemd_unit **units;
+	size_t n = 0;
+
+	units = malloc(count * sizeof(struct systemd_unit *));
+	if (units == NULL)
+		return;
+
+	pthread_mutex_lock(&cache->lock);
+	for (size_t i = 0; i < count; ++i) {
+		struct systemd_unit *unit = systemd_cache_unit(cache, names[i]);
+
+		if (unit != NULL && !unit->loaded && !unit->queued) {
+			unit->queued = true;
+			units[n++] = unit;
+		}
+	}
+	systemd_cache_load(cache, units, n);
+	for (size_t i = 0; i < n; ++i)
+		units[i]->queued = false;
+	pthread_mutex_unlock(&cache->lock);
+
+	free(units);
+}
+
+int systemd_cache_unit_properties(SYSTEMD_CACHE *cache, const char *name,
+				  int (*callback)(const char *property, const char *value, void *arg), void *arg)
+{
+	struct systemd_unit *unit;
+	int ret = -1;
+
+	pthread_mutex_lock(&cache->lock);
+	unit = systemd_cache_unit(cache, name);
+	if (unit == NULL)
+		goto cleanup;
+	if (!unit->loaded)
+		systemd_cache_load(cache, &unit, 1);
+	if (unit->failed)
+		goto cleanup;
+
+	for (size_t i = 0; i < unit->prop_count; ++i) {
+		const struct systemd_property *prop = &unit->props[i];
+
+		for (size_t j = 0; j < prop->count; ++j) {
+			if (callback(prop->name, prop->values[j], arg) != 0)
+				goto done;
+		}
+	}
+done:
+	ret = 0;
+cleanup:
+	pthread_mutex_unlock(&cache->lock);
+	return ret;
+}
+
+static bool is_unit_name_a_target(const char *unit)
+{
+	const char *suffix = ".target";
+	const size_t suffix_len = strlen(suffix);
+
+	if (!unit)
+		return false;
+
+	const size_t len = strlen(unit);
+	if (suffix_len >  len)
+		return false;
+
+	return strncmp(unit + len - suffix_len, suffix, suffix_len) == 0;
+}
+
+static bool is_edge(const char *dependency)
+{
+	return dependency != NULL && dependency[0] != '\0';
+}
+
+static bool unit_push(struct systemd_unit ***units, size_t *count, size_t *size, struct systemd_unit *unit)
+{
+	if (*count == *size) {
+		size_t new_size = *size > 0 ? *size * 2 : 64;
+		struct systemd_unit **tmp = realloc(*units, new_size * sizeof(struct systemd_unit *));
+
+		if (tmp == NULL)
+			return false;
+		*units = tmp;
+		*size = new_size;
+	}
+	unit->queued = true;
+	(*units)[(*count)++] = unit;
+
+	return true;
+}
+
+/*
+ * Fetch the whole dependency closure of the targets one level at a time,
+ * so that all the targets found on a level are fetched by pipelined calls.
+ * The queue keeps all the visited targets, a level is a slice of it.
+ */
+static void systemd_cache_load_closure(SYSTEMD_CACHE *cache, struct systemd_unit *const *roots, size_t count)
+{
+	struct systemd_unit **queue = NULL;
+	size_t queue_count = 0, queue_size = 0, level = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		if (!is_unit_name_a_target(roots[i]->name) || roots[i]->queued)
+			continue;
+		if (!unit_push(&queue, &queue_count, &queue_size, roots[i]))
+			goto cleanup;
+	}
+
+	while (level < queue_count) {
+		const size_t end = queue_count;
+
+		systemd_cache_load(cache, queue + level, end - level);
+
+		for (size_t i = level; i < end; ++i) {
+			const struct systemd_property *edges[] = { queue[i]->requires, queue[i]->wants };
+
+			for (size_t e = 0; e < 2; ++e) {
+				if (edges[e] == NULL)
+					continue;
+				for (size_t j = 0; j < edges[e]->count; ++j) {
+					const char *name = edges[e]->values[j];
+					struct systemd_unit *dep;
+
+					if (!is_edge(name) || !is_unit_name_a_target(name))
+						continue;
+					dep = systemd_cache_unit(cache, name);
+					if (dep == NULL || dep->queued)
+						continue;
+					if (!unit_push(&queue, &queue_count, &queue_size, dep))
+						goto cleanup;
+				}
+			}
+		}
+		level = end;
+	}
+
+cleanup:
+	for (size_t i = 0; i < queue_count; ++i)
+		queue[i]->queued = false;
+	free(queue);
+}
+
+void systemd_cache_prefetch_dependencies(SYSTEMD_CACHE *cache, const char **names, size_t count)
+{
+	struct systemd_unit **units;
+	size_t n = 0;
+
+	units = malloc(count * sizeof(struct systemd_unit *));
+	if (units == NULL)
+		return;
+
+	pthread_mutex_lock(&cache->lock);
+	for (size_t i = 0; i < count; ++i) {
+		struct systemd_unit *unit = systemd_cache_unit(cache, names[i]);
+
+		if (unit != NULL)
+			units[n++] = unit;
+	}
+	systemd_cache_load_closure(cache, units, n);
+	pthread_mutex_unlock(&cache->lock);
+
+	free(units);
+}
+
+struct systemd_walk {
+	const struct systemd_unit *unit;
+	const struct systemd_walk *up;
+};
+
+static bool walk_visited(const struct systemd_walk *walk, const struct systemd_unit *unit)
+{
+	for (; walk != NULL; walk = walk->up) {
+		if (walk->unit == unit)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Report the edges depth first. A target which is already on the path
+ * isn't entered again, the dependency loop would never end otherwise.
+ */
+static int systemd_cache_walk(SYSTEMD_CACHE *cache, const struct systemd_walk *walk,
+			      int (*callback)(const char *dependency, void *arg), void *arg)
+{
+	const struct systemd_unit *unit = walk->unit;
+	const struct systemd_property *edges[] = { unit->requires, unit->wants };
+
+	for (size_t e = 0; e < 2; ++e) {
+		if (edges[e] == NULL)
+			continue;
+		for (size_t j = 0; j < edges[e]->count; ++j) {
+			const char *name = edges[e]->values[j];
+			struct systemd_walk down;
+
+			if (!is_edge(name))
+				continue;
+			if (callback(name, arg) != 0)
+				return 1;
+			if (!is_unit_name_a_target(name))
+				continue;
+
+			down.unit = oscap_htable_get(cache->units, name);
+			down.up = walk;
+			if (down.unit == NULL || walk_visited(walk, down.unit))
+				continue;
+			if (systemd_cache_walk(cache, &down, callback, arg) != 0)
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+void systemd_cache_unit_dependencies(SYSTEMD_CACHE *cache, const char *name,
+				     int (*callback)(const char *dependency, void *arg), void *arg)
+{
+	struct systemd_unit *unit;
+	struct systemd_walk walk;
+
+	// systemctl list-dependencies only recurses into target units
+	if (!is_unit_name_a_target(name))
+		return;
+
+	pthread_mutex_lock(&cache->lock);
+	unit = systemd_cache_unit(cache, name);
+	if (unit != NULL) {
+		systemd_cache_load_closure(cache, &unit, 1);
+		walk.unit = unit;
+		walk.up = NULL;
+		systemd_cache_walk(cache, &walk, callback, arg);
+	}
+	pthread_mutex_unlock(&cache->lock);
+}
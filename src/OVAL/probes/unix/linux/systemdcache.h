@@ -0,0 +1,90 @@
+/**
+ * @file   systemdcache.h
+ * @brief  systemd unit properties cached for the whole scan
+ */
+
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef OPENSCAP_OVAL_PROBES_SYSTEMDCACHE_H_
+#define OPENSCAP_OVAL_PROBES_SYSTEMDCACHE_H_
+
+#include <stddef.h>
+
+/*
+ * The units are listed once per scan and the properties of a unit are
+ * fetched the first time they're asked for. The LoadUnit and GetAll calls
+ * for a batch of units are sent to systemd at once and the replies are
+ * collected afterwards, so that the probes don't wait for a round-trip
+ * per unit. The Requires and Wants properties of the fetched units form
+ * the dependency graph used by the systemdunitdependency probe.
+ */
+typedef struct systemd_cache SYSTEMD_CACHE;
+
+/**
+ * Get the cache of the current scan, list the units if there's none.
+ * The cache has to be released by systemd_cache_release().
+ * @return the cache or NULL if the system bus isn't available
+ */
+SYSTEMD_CACHE *systemd_cache_get(void);
+
+void systemd_cache_release(SYSTEMD_CACHE *cache);
+
+/**
+ * Number of units reported by the ListUnits method.
+ */
+size_t systemd_cache_unit_count(const SYSTEMD_CACHE *cache);
+
+const char *systemd_cache_unit_name(const SYSTEMD_CACHE *cache, size_t i);
+
+/**
+ * Fetch the properties of all the units which aren't in the cache yet
+ * with pipelined calls.
+ */
+void systemd_cache_prefetch(SYSTEMD_CACHE *cache, const char **units, size_t count);
+
+/**
+ * Fetch the dependency closures of the targets among the units, the
+ * targets found on one level of the closures are fetched together.
+ */
+void systemd_cache_prefetch_dependencies(SYSTEMD_CACHE *cache, const char **units, size_t count);
+
+/**
+ * Report the properties of the unit. Array properties are reported one
+ * element per callback, in the order the elements came from systemd.
+ * The callback stops the iteration by returning a non-zero value.
+ * @return 0 on success, -1 if the properties couldn't be fetched
+ */
+int systemd_cache_unit_properties(SYSTEMD_CACHE *cache, const char *unit,
+				  int (*callback)(const char *property, const char *value, void *arg), void *arg);
+
+/**
+ * Report the Requires and then the Wants dependencies of the unit and
+ * recurse into those which are targets, the same way as
+ * systemctl list-dependencies does.
+ */
+void systemd_cache_unit_dependencies(SYSTEMD_CACHE *cache, const char *unit,
+				     int (*callback)(const char *dependency, void *arg), void *arg);
+
+/**
+ * Drop the cache. Probes holding it keep their reference.
+ */
+void systemd_cache_invalidate(void);
+
+#endif
@@ -72,10 +72,6 @@
  #include <proc/devname.h>
 #endif
 
-#ifdef SELINUX_FOUND
-#include <selinux/selinux.h>
-#include <selinux/context.h>
-#endif
 #ifdef CAP_FOUND
 #include <ctype.h>
 #include <sys/types.h>
@@ -100,12 +96,9 @@ extern char const *_cap_names[];
 #include "probe/entcmp.h"
 #include "common/debug_priv.h"
 #include <ctype.h>
-#include "common/oscap_buffer.h"
 #include "process58_probe.h"
 #include "oscap_helpers.h"
 
-#define CHUNK_SIZE 1024
-
 /* Convenience structure for the results being reported */
 struct result_info {
         const char *command_line;
@@ -152,72 +145,7 @@ static void report_finding(struct result_info *res, probe_ctx *ctx)
 
 #if defined(OS_LINUX)
 
-unsigned long ticks, boot;
-
-static void get_boot_time(void)
-{
-	char buf[100];
-	FILE *sf;
-	int line;
-
-	boot = 0;
-	sf = fopen("/proc/stat", "rt");
-	if (sf == NULL)
-		return;
-
-	line = 0;
-	__fsetlocking(sf, FSETLOCKING_BYCALLER);
-	while (fgets(buf, sizeof(buf), sf)) {
-		if (line == 0) {
-			line++;
-			continue;
-		}
-		if (memcmp(buf, "btime", 5) == 0) {
-			sscanf(buf, "btime %lu", &boot);
-			break;
-		}
-	}
-	fclose(sf);
-}
-
-static int get_uids(int pid, struct result_info *r)
-{
-	char buf[100];
-	FILE *sf;
-
-	r->ruid = -1;
-	r->user_id = -1;
-	r->loginuid = -1;
-
-	snprintf(buf, sizeof(buf), "/proc/%d/status", pid);
-	sf = fopen(buf, "rt");
-	if (sf) {
-		int line = 0;
-		__fsetlocking(sf, FSETLOCKING_BYCALLER);
-		while (fgets(buf, sizeof(buf), sf)) {
-			if (line == 0) {
-				line++;
-				continue;
-			}
-			if (memcmp(buf, "Uid:", 4) == 0) {
-				sscanf(buf, "Uid: %d %d", &r->ruid, &r->user_id);
-				break;
-			}
-		}
-		fclose(sf);
-	}
-
-	snprintf(buf, sizeof(buf), "/proc/%d/loginuid", pid);
-	sf = fopen(buf, "rt");
-	if (sf) {
-		if (fscanf(sf, "%u", &r->loginuid) < 1) {
-			dW("fscanf failed from %s", buf);
-		}
-		fclose(sf);
-	}
-
-	return 0;
-}
+#include "oval_proc_snapshot.h"
 
 static char *convert_time(unsigned long long t, char *tbuf, int tb_size)
 {
@@ -237,40 +165,6 @@ static char *convert_time(unsigned long long t, char *tbuf, int tb_size)
 	return tbuf;
 }
 
-#ifdef SELINUX_FOUND
-static char *get_selinux_label(int pid) {
-	char *selinux_label;
-	security_context_t pid_context;
-	context_t context;
-
-	if (is_selinux_enabled() == 1) {
-		if (getpidcon(pid, &pid_context) == -1) {
-			/* error getting pid selinux context */
-			dW("Can't get selinux context for process %d", pid);
-			return NULL;
-		}
-		context = context_new(pid_context);
-		if (context == NULL) {
-			// There must be 3 or 4 colon-separated components and no
-			// whitespace in any component other than the MLS
-			// component.
-			freecon(pid_context);
-			return NULL;
-		}
-		selinux_label = strdup(context_type_get(context));
-		context_free(context);
-		freecon(pid_context);
-		return selinux_label;
-	} else {
-		return NULL;
-	}
-}
-#else
-static char *get_selinux_label(int pid) {
-	return NULL;
-}
-#endif /* SELINUX_FOUND */
-
 static char **get_posix_capability(int pid, int max_cap_id) {
 #ifdef CAP_FOUND
 	cap_t pid_caps;
@@ -334,105 +228,6 @@ static char **get_posix_capability(int pid, int max_cap_id) {
 #endif
 }
 
-/* get exec shield status according to http://people.redhat.com/sgrubb/files/lsexec
- * return value: -1 - not detected, 0 - disabled, 1 - enabled */
-static int get_exec_shield_status(int pid) {
-	char buf[501];
-	FILE *sf;
-	long unsigned low, high, inode;
-	long long unsigned offset;
-	int dev_min, dev_maj;
-	char perm[3], trim;
-	int ret = -1, read_items;
-
-	snprintf(buf, sizeof(buf), "/proc/%d/maps", pid);
-	sf = fopen(buf, "rt");
-	if (sf) {
-		while (fgets(buf, 500, sf)) {
-			read_items = sscanf(
-				buf, "%lx-%lx rw%s %llx %x:%x %lu %c\n",
-				&low, &high, perm, &offset, &dev_min,
-				&dev_maj, &inode, &trim
-			);
-			if (read_items == 7) {
-				if (perm[0] == 'x' && offset != 0) {
-					ret = 0;
-				}
-				else {
-					ret = 1;
-				}
-			}
-		}
-		fclose(sf);
-	}
-
-	return ret;
-}
-
-/**
- * Parse /proc/%d/cmdline file
- * @param filepath Path to file ~ use preallocated buffer for the path
- * @param buffer output buffer with non-zero size
- * @return ps-like command info or NULL
- */
-static inline bool get_process_cmdline(const char* filepath, struct oscap_buffer* const buffer){
-
-	int fd = open(filepath, O_RDONLY, 0);
-
-	if (fd < 0) {
-		return false;
-	}
-
-	oscap_buffer_clear(buffer);
-
-
-
-	for(;;) {
-		char chunk[CHUNK_SIZE];
-		// Read data, store to buffer
-		ssize_t read_size = read(fd, chunk, CHUNK_SIZE);
-		if (read_size < 0) {
-			close(fd);
-			return false;
-		}
-		oscap_buffer_append_binary_data(buffer, chunk, read_size);
-
-		// If reach end of file, then end the loop
-		if (CHUNK_SIZE != read_size) {
-			break;
-		}
-	}
-
-	close(fd);
-
-	int length = oscap_buffer_get_length(buffer);
-	char* buffer_mem = oscap_buffer_get_raw(buffer);
-
-	if ( length == 0 ) { // empty file
-		return false;
-	} else {
-
-		// Skip multiple trailing zeros
-		int i = length - 1;
-		while ( (i > 0) && (buffer_mem[i] == '\0') ) {
-			--i;
-		}
-
-		// Program and args are separated by '\0'
-		// Replace them with spaces ' '
-		while( i >= 0 ){
-			char chr = buffer_mem[i];
-			if ( ( chr == '\0') || ( chr == '\n' ) ) {
-				buffer_mem[i] = ' ';
-			} else if ( !isprint(chr) ) { // "ps" replace non-printable characters with '.' (LC_ALL=C)
-				buffer_mem[i] = '.';
-			}
-			--i;
-		}
-	}
-	return true;
-}
-
 /**
  * Make "[%s] <defunct>" from cmd string - inplace
  * @param cmd_buffer @see read_process() > cmd_buffer
@@ -448,18 +243,24 @@ static inline char *make_defunc_str(char* const cmd_buffer){
 
 static int read_process(SEXP_t *cmd_ent, SEXP_t *pid_ent, probe_ctx *ctx)
 {
-	int err = 1, max_cap_id;
-	DIR *d;
-	struct dirent *ent;
+	int max_cap_id;
+	OVAL_PROC_SNAPSHOT *snap;
+	unsigned long ticks, boot;
+	size_t i, count;
 	oval_schema_version_t oval_version;
 
-	d = opendir("/proc");
-	if (d == NULL)
-		return err;
+	snap = oval_proc_snapshot_get();
+	if (snap == NULL)
+		return 1;
+
+	ticks = oval_proc_snapshot_ticks(snap);
+	boot = oval_proc_snapshot_boot(snap);
+	count = oval_proc_snapshot_count(snap);
 
-	// Get the time tick hertz
-	ticks = (unsigned long)sysconf(_SC_CLK_TCK);
-	get_boot_time();
+	if (count == 0) {
+		oval_proc_snapshot_release(snap);
+		return 1;
+	}
 
 	oval_version = probe_obj_get_platform_schema_version(probe_ctx_getobject(ctx));
 	if (oval_schema_version_cmp(oval_version, OVAL_SCHEMA_VERSION(5.11)) < 0) {
@@ -468,122 +269,50 @@ static int read_process(SEXP_t *cmd_ent, SEXP_t *pid_ent, probe_ctx *ctx)
 		max_cap_id = OVAL_5_11_MAX_CAP_ID;
 	}
 
-	struct oscap_buffer *cmdline_buffer = oscap_buffer_new();
-	
 	char cmd_buffer[1 + 15 + 11 + 1]; // Format:" [ cmd:15 ] <defunc>"
 	cmd_buffer[0] = '[';
 
-	// Scan the directories
-	while (( ent = readdir(d) )) {
-		int fd, len;
-		char buf[256];
-		char *tmp, state, tty_dev[128];
-		int pid, ppid, pgrp, session, tty_nr, tpgid;
-		unsigned flags, sched_policy;
-		unsigned long minflt, cminflt, majflt, cmajflt, uutime, ustime;
-		long cutime, cstime, priority, cnice, nthreads, itrealvalue;
-		unsigned long long start;
+	for (i = 0; i < count; ++i) {
+		OVAL_PROC_ENTRY *proc = oval_proc_snapshot_at(snap, i);
+		char tty_dev[128];
 		SEXP_t *cmd_sexp = NULL, *pid_sexp = NULL;
 
-		// Skip non-process58 dir entries
-		if(*ent->d_name<'0' || *ent->d_name>'9')
-			continue;
-		errno = 0;
-		pid = strtol(ent->d_name, NULL, 10);
-		if (errno || pid == 2) // skip err & kthreads
-			continue;
-
-		// Parse up the stat file for the proc
-		snprintf(buf, 32, "/proc/%d/stat", pid);
-		fd = open(buf, O_RDONLY, 0);
-		if (fd < 0)
-			continue;
-		len = read(fd, buf, sizeof buf - 1);
-		close(fd);
-		if (len < 40)
-			continue;
-		buf[len] = 0;
-		tmp = strrchr(buf, ')');
-		if (tmp)
-			*tmp = 0;
-		else
-			continue;
 		memset(cmd_buffer + 1, 0, sizeof(cmd_buffer)-1); // clear cmd after starting '['
-		sscanf(buf, "%d (%15c", &ppid, cmd_buffer + 1);
-		sscanf(tmp+2,	"%c %d %d %d %d %d "
-				"%u %lu %lu %lu %lu "
-				"%lu %lu %lu %ld %ld "
-				"%ld %ld %ld %llu",
-			&state, &ppid, &pgrp, &session, &tty_nr, &tpgid,
-			&flags, &minflt, &cminflt, &majflt, &cmajflt,
-			&uutime, &ustime, &cutime, &cstime, &priority,
-			&cnice, &nthreads, &itrealvalue, &start
-		);
-
-		// Skip kthreads
-		if (ppid == 2)
-			continue;
+		strncpy(cmd_buffer + 1, proc->comm, 15);
 
 		const char* cmd;
-		if (state == 'Z') { // zombie
+		if (proc->state == 'Z') { // zombie
 			cmd = make_defunc_str(cmd_buffer);
 		} else {
-			snprintf(buf, 32, "/proc/%d/cmdline", pid);
-			if (get_process_cmdline(buf, cmdline_buffer)) {
-				cmd = oscap_buffer_get_raw(cmdline_buffer); // use full cmdline
-			} else {
+			cmd = oval_proc_entry_cmdline(snap, proc); // use full cmdline
+			if (cmd == NULL) {
 				cmd = cmd_buffer + 1;
 			}
 		}
 
-
-		err = 0; // If we get this far, no permission problems
 		dI("Have command: %s", cmd);
 		cmd_sexp = SEXP_string_newf("%s", cmd);
-		pid_sexp = SEXP_number_newu_32(pid);
+		pid_sexp = SEXP_number_newu_32(proc->pid);
 		if ((cmd_sexp == NULL || probe_entobj_cmp(cmd_ent, cmd_sexp) == OVAL_RESULT_TRUE) &&
 		    (pid_sexp == NULL || probe_entobj_cmp(pid_ent, pid_sexp) == OVAL_RESULT_TRUE)
 		) {
 			struct result_info r;
-			unsigned long t = uutime/ticks + ustime/ticks;
-			char tbuf[32], sbuf[32], *selinux_domain_label, **posix_capabilities;
+			unsigned long t = proc->utime/ticks + proc->stime/ticks;
+			char tbuf[32], sbuf[32], **posix_capabilities;
 			int tday,tyear;
 			time_t s_time;
-			struct tm *proc, *now;
+			struct tm *ptm, *now;
 			const char *fmt;
 
-			// Now get scheduler policy
-			sched_policy = sched_getscheduler(pid);
-			switch (sched_policy) {
-				case SCHED_OTHER:
-					r.scheduling_class = "TS";
-					break;
-				case SCHED_BATCH:
-					r.scheduling_class = "B";
-					break;
-#ifdef SCHED_IDLE
-				case SCHED_IDLE:
-					r.scheduling_class = "#5";
-					break;
-#endif
-				case SCHED_FIFO:
-					r.scheduling_class = "FF";
-					break;
-				case SCHED_RR:
-					r.scheduling_class = "RR";
-					break;
-				default:
-					r.scheduling_class = "?";
-					break;
-			}
+			r.scheduling_class = oval_proc_entry_sched_class(snap, proc);
 
 			// Calculate the start time
 			s_time = time(NULL);
 			now = localtime(&s_time);
 			tyear = now->tm_year;
 			tday = now->tm_yday;
-			s_time = boot + (start / ticks);
-			proc = localtime(&s_time);
+			s_time = boot + (proc->start / ticks);
+			ptm = localtime(&s_time);
 
 			// Select format based on how long we've been running
 			//
@@ -592,38 +321,37 @@ static int read_process(SEXP_t *cmd_ent, SEXP_t *pid_ent, probe_ctx *ctx)
 			// the same day the process started or formatted as MMM_DD (Ex.: Feb_5)
 			// if process started the previous day or further in the past."
 			//
-			if (tday != proc->tm_yday || tyear != proc->tm_year)
+			if (tday != ptm->tm_yday || tyear != ptm->tm_year)
 				fmt = "%b_%d";
 			else
 				fmt = "%H:%M:%S";
-			strftime(sbuf, sizeof(sbuf), fmt, proc);
+			strftime(sbuf, sizeof(sbuf), fmt, ptm);
 
 			r.command_line = cmd;
 			r.exec_time = convert_time(t, tbuf, sizeof(tbuf));
-			r.pid = pid;
-			r.ppid = ppid;
-			r.priority = priority;
+			r.pid = proc->pid;
+			r.ppid = proc->ppid;
+			r.priority = proc->priority;
 			r.start_time = sbuf;
 
-			dev_to_tty(tty_dev, sizeof(tty_dev), (dev_t) tty_nr, pid, ABBREV_DEV);
+			dev_to_tty(tty_dev, sizeof(tty_dev), (dev_t) proc->tty_nr, proc->pid, ABBREV_DEV);
 			r.tty = tty_dev;
 
-			r.exec_shield = (get_exec_shield_status(pid) > 0);
+			r.exec_shield = (oval_proc_entry_exec_shield(snap, proc) > 0);
 
-			selinux_domain_label = get_selinux_label(pid);
-			r.selinux_domain_label = selinux_domain_label;
+			r.selinux_domain_label = oval_proc_entry_selinux_label(snap, proc);
 
-			posix_capabilities = get_posix_capability(pid, max_cap_id);
+			posix_capabilities = get_posix_capability(proc->pid, max_cap_id);
 			r.posix_capability = posix_capabilities;
 
-			r.session_id = session;
+			r.session_id = proc->session;
 
-			get_uids(pid, &r);
+			oval_proc_entry_uids(snap, proc);
+			r.ruid = proc->ruid;
+			r.user_id = proc->euid;
+			r.loginuid = proc->loginuid;
 			report_finding(&r, ctx);
 
-			if (selinux_domain_label != NULL)
-				free(selinux_domain_label);
-
 			if (posix_capabilities != NULL) {
 				char **posix_capabilities_p = posix_capabilities;
 				while (*posix_capabilities_p)
@@ -634,9 +362,9 @@ static int read_process(SEXP_t *cmd_ent, SEXP_t *pid_ent, probe_ctx *ctx)
 		SEXP_free(cmd_sexp);
 		SEXP_free(pid_sexp);
 	}
-        closedir(d);
-	oscap_buffer_free(cmdline_buffer);
-	return err;
+
+	oval_proc_snapshot_release(snap);
+	return 0;
 }
 
 int process58_probe_main(probe_ctx *ctx, void *arg)
@@ -103,62 +103,7 @@ static void report_finding(struct result_info *res, probe_ctx *ctx)
 
 #if defined(OS_LINUX)
 
-unsigned long ticks, boot;
-
-static void get_boot_time(void)
-{
-	char buf[100];
-	FILE *sf;
-	int line;
-
-	boot = 0;
-	sf = fopen("/proc/stat", "rt");
-	if (sf == NULL)
-		return;
-
-	line = 0;
-	__fsetlocking(sf, FSETLOCKING_BYCALLER);
-	while (fgets(buf, sizeof(buf), sf)) {
-		if (line == 0) {
-			line++;
-			continue;
-		}
-		if (memcmp(buf, "btime", 5) == 0) {
-			sscanf(buf, "btime %lu", &boot);
-			break;
-		}
-	}
-	fclose(sf);
-}
-
-static int get_uids(int pid, struct result_info *r)
-{
-	char buf[100];
-	FILE *sf;
-
-	r->ruid = -1;
-	r->user_id = -1;
-
-	snprintf(buf, sizeof(buf), "/proc/%d/status", pid);
-	sf = fopen(buf, "rt");
-	if (sf) {
-		int line = 0;
-		__fsetlocking(sf, FSETLOCKING_BYCALLER);
-		while (fgets(buf, sizeof(buf), sf)) {
-			if (line == 0) {
-				line++;
-				continue;
-			}
-			if (memcmp(buf, "Uid:", 4) == 0) {
-				sscanf(buf, "Uid: %d %d", &r->ruid, &r->user_id);
-				break;
-			}
-		}
-		fclose(sf);
-	}
-
-	return 0;
-}
+#include "oval_proc_snapshot.h"
 
 static char *convert_time(unsigned long long t, char *tbuf, int tb_size)
 {
@@ -180,113 +125,48 @@ static char *convert_time(unsigned long long t, char *tbuf, int tb_size)
 
 static int read_process(SEXP_t *cmd_ent, probe_ctx *ctx)
 {
-	int err = 1;
-	DIR *d;
-	struct dirent *ent;
+	OVAL_PROC_SNAPSHOT *snap;
+	unsigned long ticks, boot;
+	size_t i, count;
 
-	d = opendir("/proc");
-	if (d == NULL)
-		return err;
+	snap = oval_proc_snapshot_get();
+	if (snap == NULL)
+		return 1;
 
-	// Get the time tick hertz
-	ticks = (unsigned long)sysconf(_SC_CLK_TCK);
-	get_boot_time();
+	ticks = oval_proc_snapshot_ticks(snap);
+	boot = oval_proc_snapshot_boot(snap);
+	count = oval_proc_snapshot_count(snap);
 
-	// Scan the directories
-	while (( ent = readdir(d) )) {
-		int fd, len;
-		char buf[256];
-		char *tmp, cmd[16], state, tty_dev[128];
-		int pid, ppid, pgrp, session, tty_nr, tpgid;
-		unsigned flags, sched_policy;
-		unsigned long minflt, cminflt, majflt, cmajflt, uutime, ustime;
-		long cutime, cstime, priority, cnice, nthreads, itrealvalue;
-		unsigned long long start;
-		SEXP_t *cmd_sexp;
-
-		// Skip non-process dir entries
-		if(*ent->d_name<'0' || *ent->d_name>'9')
-			continue;
-		errno = 0;
-		pid = strtol(ent->d_name, NULL, 10);
-		if (errno || pid == 2) // skip err & kthreads
-			continue;
+	if (count == 0) {
+		oval_proc_snapshot_release(snap);
+		return 1;
+	}
 
-		// Parse up the stat file for the proc
-		snprintf(buf, 32, "/proc/%d/stat", pid);
-		fd = open(buf, O_RDONLY, 0);
-		if (fd < 0)
-			continue;
-		len = read(fd, buf, sizeof buf - 1);
-		close(fd);
-		if (len < 40)
-			continue;
-		buf[len] = 0;
-		tmp = strrchr(buf, ')');
-		if (tmp)
-			*tmp = 0;
-		else
-			continue;
-		memset(cmd, 0, sizeof(cmd));
-		sscanf(buf, "%d (%15c", &ppid, cmd);
-		sscanf(tmp+2,	"%c %d %d %d %d %d "
-				"%u %lu %lu %lu %lu "
-				"%lu %lu %lu %ld %ld "
-				"%ld %ld %ld %llu",
-			&state, &ppid, &pgrp, &session, &tty_nr, &tpgid,
-			&flags, &minflt, &cminflt, &majflt, &cmajflt,
-			&uutime, &ustime, &cutime, &cstime, &priority,
-			&cnice, &nthreads, &itrealvalue, &start
-		);
-
-		// Skip kthreads
-		if (ppid == 2)
-			continue;
+	for (i = 0; i < count; ++i) {
+		OVAL_PROC_ENTRY *proc = oval_proc_snapshot_at(snap, i);
+		char tty_dev[128];
+		SEXP_t *cmd_sexp;
 
-		err = 0; // If we get this far, no permission problems
-		dI("Have command: %s", cmd);
-		cmd_sexp = SEXP_string_newf("%s", cmd);
+		dI("Have command: %s", proc->comm);
+		cmd_sexp = SEXP_string_newf("%s", proc->comm);
 		if (probe_entobj_cmp(cmd_ent, cmd_sexp) == OVAL_RESULT_TRUE) {
 			struct result_info r;
-			unsigned long t = uutime/ticks + ustime/ticks;
+			unsigned long t = proc->utime/ticks + proc->stime/ticks;
 			char tbuf[32], sbuf[32];
 			int tday,tyear;
 			time_t s_time;
-			struct tm *proc, *now;
+			struct tm *ptm, *now;
 			const char *fmt;
 
-			// Now get scheduler policy
-			sched_policy = sched_getscheduler(pid);
-			switch (sched_policy) {
-				case SCHED_OTHER:
-					r.scheduling_class = "TS";
-					break;
-				case SCHED_BATCH:
-					r.scheduling_class = "B";
-					break;
-#ifdef SCHED_IDLE
-				case SCHED_IDLE:
-					r.scheduling_class = "#5";
-					break;
-#endif
-				case SCHED_FIFO:
-					r.scheduling_class = "FF";
-					break;
-				case SCHED_RR:
-					r.scheduling_class = "RR";
-					break;
-				default:
-					r.scheduling_class = "?";
-					break;
-			}
+			r.scheduling_class = oval_proc_entry_sched_class(snap, proc);
 
 			// Calculate the start time
 			s_time = time(NULL);
 			now = localtime(&s_time);
 			tyear = now->tm_year;
 			tday = now->tm_yday;
-			s_time = boot + (start / ticks);
-			proc = localtime(&s_time);
+			s_time = boot + (proc->start / ticks);
+			ptm = localtime(&s_time);
 
 			// Select format based on how long we've been running
 			//
@@ -295,30 +175,33 @@ static int read_process(SEXP_t *cmd_ent, probe_ctx *ctx)
 			// the same day the process started or formatted as MMM_DD (Ex.: Feb_5)
 			// if process started the previous day or further in the past."
 			//
-			if (tday != proc->tm_yday || tyear != proc->tm_year)
+			if (tday != ptm->tm_yday || tyear != ptm->tm_year)
 				fmt = "%b_%d";
 			else
 				fmt = "%H:%M:%S";
-			strftime(sbuf, sizeof(sbuf), fmt, proc);
+			strftime(sbuf, sizeof(sbuf), fmt, ptm);
 
-			r.command = cmd;
+			r.command = proc->comm;
 			r.exec_time = convert_time(t, tbuf, sizeof(tbuf));
-			r.pid = pid;
-			r.ppid = ppid;
-			r.priority = priority;
+			r.pid = proc->pid;
+			r.ppid = proc->ppid;
+			r.priority = proc->priority;
 			r.start_time = sbuf;
 
-                        dev_to_tty(tty_dev, sizeof(tty_dev), (dev_t) tty_nr, pid, ABBREV_DEV);
+                        dev_to_tty(tty_dev, sizeof(tty_dev), (dev_t) proc->tty_nr, proc->pid, ABBREV_DEV);
                         r.tty = tty_dev;
 
-			get_uids(pid, &r);
+			oval_proc_entry_uids(snap, proc);
+			r.ruid = proc->ruid;
+			r.user_id = proc->euid;
 			report_finding(&r, ctx);
 		}
 		SEXP_free(cmd_sexp);
 	}
-        closedir(d);
 
-	return err;
+	oval_proc_snapshot_release(snap);
+
+	return 0;
 }
 
 int process_probe_main(probe_ctx *ctx, void *arg)
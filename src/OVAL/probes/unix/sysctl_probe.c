@@ -36,10 +36,14 @@
 #if defined(OS_LINUX)
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "oval_fts.h"
 #include "common/debug_priv.h"
 #include "sysctl_probe.h"
@@ -47,29 +51,270 @@
 #define PROC_SYS_DIR "/proc/sys"
 #define PROC_SYS_MAXDEPTH 7
 
-int sysctl_probe_main(probe_ctx *ctx, void *probe_arg)
+struct sysctl_entry {
+	char   *path;
+	SEXP_t *mib;
+};
+
+/*
+ * Names of all the readable sysctls, collected by the first object
+ * which needs to match the names against something else than a single
+ * value. The values are always read when an item is collected.
+ */
+struct sysctl_snapshot {
+	pthread_mutex_t      lock;
+	bool                 ready;
+	struct sysctl_entry *entries;
+	size_t               count;
+};
+
+void *sysctl_probe_init(void)
 {
-        OVAL_FTS    *ofts;
-        OVAL_FTSENT *ofts_ent;
+	struct sysctl_snapshot *snap = calloc(1, sizeof(struct sysctl_snapshot));
 
-        SEXP_t *name_entity, *probe_in;
-        SEXP_t *r0, *r1, *r2, *r3;
-        SEXP_t *ent_attrs, *bh_entity, *path_entity, *filename_entity;
-        oval_schema_version_t over;
-        int over_cmp;
+	if (snap == NULL)
+		return NULL;
+
+	if (pthread_mutex_init(&snap->lock, NULL) != 0) {
+		dE("Can't initialize mutex: errno=%u, %s.", errno, strerror(errno));
+		free(snap);
+		return NULL;
+	}
+
+	return snap;
+}
+
+void sysctl_probe_fini(void *arg)
+{
+	struct sysctl_snapshot *snap = (struct sysctl_snapshot *)arg;
+	size_t i;
+
+	if (snap == NULL)
+		return;
 
+	for (i = 0; i < snap->count; ++i) {
+		free(snap->entries[i].path);
+		SEXP_free(snap->entries[i].mib);
+	}
+
+	free(snap->entries);
+	pthread_mutex_destroy(&snap->lock);
+	free(snap);
+}
+
+/* Skip write-only files, eg. /proc/sys/net/ipv4/route/flush */
+static bool sysctl_readable(const char *mibpath, const struct stat *file_stat)
+{
+	/* the sysctl utility uses same condition in sysctl.c in ReadSetting() */
+	if ((file_stat->st_mode & S_IRUSR) == 0) {
+		dI("Skipping write-only file %s", mibpath);
+		return false;
+	}
+
+	return true;
+}
+
+static void sysctl_collect(probe_ctx *ctx, const char *mibpath, SEXP_t *se_mib, int over_cmp)
+{
 	const char *ipv6_conf_path = "/proc/sys/net/ipv6/conf/";
 	size_t ipv6_conf_path_len = strlen(ipv6_conf_path);
 
-        probe_in    = probe_ctx_getobject(ctx);
-        name_entity = probe_obj_getent(probe_in, "name", 1);
-        over        = probe_obj_get_platform_schema_version(probe_in);
-        over_cmp    = oval_schema_version_cmp(over, OVAL_SCHEMA_VERSION(5.10));
+	FILE   *fp;
+	SEXP_t *item;
+	char    sysval[8192];
+	char   *sysvals[512];
+	long i, l;
+	size_t s;
+
+	dI("MIB match");
+
+	/*
+	 * read sysctl value
+	 */
+	fp = fopen(mibpath, "r");
+
+	if (fp == NULL) {
+		dE("Can't read sysctl value from \"%s\": %u, %s",
+		   mibpath, errno, strerror(errno));
+		goto fail_item;
+	}
+
+	l = fread(sysval, 1, sizeof sysval - 1, fp);
+
+	if (ferror(fp)) {
+		/* Linux 4.1.0 introduced a per-NIC IPv6 stable_secret file.
+		 * The stable_secret file cannot be read until it is set,
+		 * so we skip it when it is not readable. Otherwise we collect it.
+		 */
+		if (strncmp(mibpath, ipv6_conf_path, ipv6_conf_path_len) == 0 &&
+				strcmp(strrchr(mibpath, '/') + 1, "stable_secret") == 0) {
+			dI("Skipping file %s", mibpath);
+			fclose(fp);
+			return;
+		} else {
+			dE("An error ocured when reading from \"%s\" (fp=%p): l=%ld, %u, %s",
+				mibpath, fp, l, errno, strerror(errno));
+			goto fail_item;
+		}
+	}
+
+	fclose(fp);
+
+	/* Skip empty values as sysctl tool does.
+	 * See https://bugzilla.redhat.com/show_bug.cgi?id=1473207
+	 */
+	if (l == 0) {
+		dI("Skipping file '%s' because it has no value.", mibpath);
+		return;
+	}
+
+	/*
+	 * sanitize the value
+	 *  - only printable and whitespace chars allowed
+	 *  - remove the last '\n'
+	 */
+	sysvals[0] = sysval;
+
+	for(s = 0, i = 0; i < l && s < sizeof sysvals/sizeof(char *) - 1; ++i) {
+		if ((!isprint(sysval[i]) && !isspace(sysval[i]))
+		    || (over_cmp >= 0 && sysval[i] == '\n' /* OVAL 5.10 and above */))
+		{
+			sysval[i] = '\0';
+			sysvals[++s] = sysval + i + 1;
+		}
+	}
+
+	if (sysval[l - 1] == '\n')
+		sysval[l - 1] = '\0';
+	else
+		sysval[l] = '\0';
+
+	if (strlen(sysvals[s]) == 0)
+		sysvals[s] = NULL;
+	else
+		sysvals[++s] = NULL;
+
+	if (over_cmp >= 0) {
+		/* Only in OVAL 5.10 and above */
+		item = probe_item_create(OVAL_UNIX_SYSCTL, NULL,
+					 "name",  OVAL_DATATYPE_SEXP,   se_mib,
+					 "value", OVAL_DATATYPE_STRING_M, sysvals,
+					 NULL);
+	} else {
+		item = probe_item_create(OVAL_UNIX_SYSCTL, NULL,
+					 "name",  OVAL_DATATYPE_SEXP,   se_mib,
+					 "value", OVAL_DATATYPE_STRING, sysval,
+					 NULL);
+	}
+
+	probe_item_collect(ctx, item);
+	return;
+fail_item:
+	item = probe_item_create(OVAL_UNIX_SYSCTL, NULL, NULL);
+	probe_item_setstatus(item, SYSCHAR_STATUS_ERROR);
+	probe_item_collect(ctx, item);
+}
 
-        if (name_entity == NULL) {
-                dE("Missing \"name\" entity in the input object");
-                return (PROBE_ENOENT);
-        }
+/*
+ * Collect the sysctl with the given name without walking /proc/sys.
+ * The dots in the name usually separate the path components, but the
+ * components may contain dots as well (e.g. net.ipv4.conf.eth0.100.rp_filter
+ * for a VLAN interface). So all the ways of splitting the name into the
+ * components are tried, just as if the name was compared to the names of
+ * all the files under /proc/sys. The names never contain a slash, it is
+ * rejected by the caller, and the "." and ".." components are skipped, so
+ * the lookup can't leave /proc/sys.
+ */
+static bool sysctl_component_valid(const char *comp, size_t complen)
+{
+	if (complen == 0)
+		return false;
+	if (comp[0] == '.' && (complen == 1 || (complen == 2 && comp[1] == '.')))
+		return false;
+	return true;
+}
+
+static void sysctl_lookup(probe_ctx *ctx, char *path, size_t pathlen, const char *name, int depth,
+			  SEXP_t *se_mib, int over_cmp)
+{
+	const char *dot;
+	struct stat file_stat;
+	size_t complen;
+
+	for (dot = strchr(name, '.'); ; dot = strchr(dot + 1, '.')) {
+		complen = (dot != NULL ? (size_t)(dot - name) : strlen(name));
+
+		if (pathlen + 1 + complen >= PATH_MAX)
+			break;
+
+		if (!sysctl_component_valid(name, complen)) {
+			if (dot == NULL)
+				break;
+			continue;
+		}
+
+		path[pathlen] = '/';
+		memcpy(path + pathlen + 1, name, complen);
+		path[pathlen + 1 + complen] = '\0';
+
+		if (stat(path, &file_stat) == 0) {
+			if (dot == NULL) {
+				if (!S_ISDIR(file_stat.st_mode) && sysctl_readable(path, &file_stat))
+					sysctl_collect(ctx, path, se_mib, over_cmp);
+			} else if (S_ISDIR(file_stat.st_mode) && depth + 1 <= PROC_SYS_MAXDEPTH) {
+				sysctl_lookup(ctx, path, pathlen + 1 + complen, dot + 1, depth + 1,
+					      se_mib, over_cmp);
+			}
+		}
+
+		if (dot == NULL)
+			break;
+	}
+
+	path[pathlen] = '\0';
+}
+
+static int sysctl_snapshot_add(struct sysctl_snapshot *snap, const char *mibpath)
+{
+	struct sysctl_entry *entries;
+	char   *mib;
+	size_t  miblen;
+
+	if ((snap->count & (snap->count - 1)) == 0) {
+		entries = realloc(snap->entries, sizeof(struct sysctl_entry) * (snap->count > 0 ? snap->count * 2 : 256));
+
+		if (entries == NULL)
+			return -1;
+
+		snap->entries = entries;
+	}
+
+	mib    = strdup(mibpath + strlen(PROC_SYS_DIR) + 1);
+	miblen = strlen(mib);
+
+	while (miblen > 0) {
+		if(mib[miblen - 1] == '/')
+			mib[miblen - 1] = '.';
+		--miblen;
+	}
+
+	dI("MIB: %s", mib);
+
+	snap->entries[snap->count].path = strdup(mibpath);
+	snap->entries[snap->count].mib  = SEXP_string_new(mib, strlen(mib));
+	++snap->count;
+
+	free(mib);
+	return 0;
+}
+
+static int sysctl_snapshot_build(probe_ctx *ctx, struct sysctl_snapshot *snap)
+{
+        OVAL_FTS    *ofts;
+        OVAL_FTSENT *ofts_ent;
+
+        SEXP_t *r0, *r1, *r2, *r3;
+        SEXP_t *ent_attrs, *bh_entity, *path_entity, *filename_entity;
 
         /*
          * prepare behaviors
@@ -104,173 +349,128 @@ int sysctl_probe_main(probe_ctx *ctx, void *probe_arg)
 
         /*
          * collect sysctls
-         *  XXX: use direct access for the "equals" op
          */
         ofts = oval_fts_open_prefixed(NULL, path_entity, filename_entity, NULL, bh_entity, probe_ctx_getresult(ctx));
 
+	SEXP_free(path_entity);
+	SEXP_free(filename_entity);
+	SEXP_free(bh_entity);
+
         if (ofts == NULL) {
                 dE("oval_fts_open_prefixed(%s, %s) failed", PROC_SYS_DIR, ".\\+");
-		SEXP_free(path_entity);
-		SEXP_free(filename_entity);
-		SEXP_free(bh_entity);
-		SEXP_free(name_entity);
-
-                return (PROBE_EFATAL);
+                return -1;
         }
 
         while ((ofts_ent = oval_fts_read(ofts)) != NULL) {
-                SEXP_t *se_mib;
-                char    mibpath[PATH_MAX], *mib;
-                size_t  miblen;
+                char    mibpath[PATH_MAX];
 		struct stat file_stat;
 
                 snprintf(mibpath, sizeof mibpath, "%s/%s", ofts_ent->path, ofts_ent->file);
+		oval_ftsent_free(ofts_ent);
 
-		/* Skip write-only files, eg. /proc/sys/net/ipv4/route/flush */
 		if (stat(mibpath, &file_stat) == -1) {
 			dE("Stat failed on %s: %u, %s", mibpath, errno, strerror(errno));
-			oval_ftsent_free(ofts_ent);
 			continue;
 		}
-		/* the sysctl utility uses same condition in sysctl.c in ReadSetting() */
-		if ((file_stat.st_mode & S_IRUSR) == 0) {
-			dI("Skipping write-only file %s", mibpath);
-			oval_ftsent_free(ofts_ent);
+
+		if (!sysctl_readable(mibpath, &file_stat))
 			continue;
+
+		if (sysctl_snapshot_add(snap, mibpath) != 0) {
+			oval_fts_close(ofts);
+			return -1;
 		}
+        }
 
-                mib    = strdup(mibpath + strlen(PROC_SYS_DIR) + 1);
-                miblen = strlen(mib);
+        oval_fts_close(ofts);
+        return 0;
+}
 
-                while (miblen > 0) {
-                        if(mib[miblen - 1] == '/')
-                                mib[miblen - 1] = '.';
-                        --miblen;
-                }
+int sysctl_probe_main(probe_ctx *ctx, void *probe_arg)
+{
+        struct sysctl_snapshot *snap = (struct sysctl_snapshot *)probe_arg;
+        SEXP_t *name_entity, *probe_in, *name_value;
+        oval_schema_version_t over;
+        int over_cmp;
+        size_t i;
 
-                dI("MIB: %s", mib);
-                se_mib = SEXP_string_new(mib, strlen(mib));
-                free(mib);
-
-                if (probe_entobj_cmp(name_entity, se_mib) == OVAL_RESULT_TRUE) {
-                        FILE   *fp;
-                        SEXP_t *item;
-                        char    sysval[8192];
-                        char   *sysvals[512];
-                        long i, l;
-                        size_t s;
-
-                        dI("MIB match");
-
-                        /*
-                         * read sysctl value
-                         */
-                        fp = fopen(mibpath, "r");
-
-                        if (fp == NULL) {
-                                dE("Can't read sysctl value from \"%s\": %u, %s",
-                                   mibpath, errno, strerror(errno));
-                                goto fail_item;
-                        }
-
-                        l = fread(sysval, 1, sizeof sysval - 1, fp);
-
-                        if (ferror(fp)) {
-				/* Linux 4.1.0 introduced a per-NIC IPv6 stable_secret file.
-				 * The stable_secret file cannot be read until it is set,
-				 * so we skip it when it is not readable. Otherwise we collect it.
-				 */
-				if (strncmp(ofts_ent->path, ipv6_conf_path, ipv6_conf_path_len) == 0 &&
-						strcmp(ofts_ent->file, "stable_secret") == 0) {
-					dI("Skipping file %s", mibpath);
-					oval_ftsent_free(ofts_ent);
-					SEXP_free(se_mib);
-					fclose(fp);
-					continue;
-				} else {
-					dE("An error ocured when reading from \"%s\" (fp=%p): l=%ld, %u, %s",
-						mibpath, fp, l, errno, strerror(errno));
-					goto fail_item;
-				}
-                        }
-
-                        fclose(fp);
-
-			/* Skip empty values as sysctl tool does.
-			 * See https://bugzilla.redhat.com/show_bug.cgi?id=1473207
-			 */
-			if (l == 0) {
-				dI("Skipping file '%s' because it has no value.", mibpath);
-				oval_ftsent_free(ofts_ent);
-				SEXP_free(se_mib);
-				continue;
-			}
+        if (snap == NULL)
+                return (PROBE_EINIT);
+
+        probe_in    = probe_ctx_getobject(ctx);
+        name_entity = probe_obj_getent(probe_in, "name", 1);
+        over        = probe_obj_get_platform_schema_version(probe_in);
+        over_cmp    = oval_schema_version_cmp(over, OVAL_SCHEMA_VERSION(5.10));
 
-                        /*
-                         * sanitize the value
-                         *  - only printable and whitespace chars allowed
-                         *  - remove the last '\n'
-                         */
-                        sysvals[0] = sysval;
-
-                        for(s = 0, i = 0; i < l && s < sizeof sysvals/sizeof(char *) - 1; ++i) {
-	                        if ((!isprint(sysval[i]) && !isspace(sysval[i]))
-	                            || (over_cmp >= 0 && sysval[i] == '\n' /* OVAL 5.10 and above */))
-                                {
-                                        sysval[i] = '\0';
-                                        sysvals[++s] = sysval + i + 1;
-                                }
-                        }
-
-                        if (sysval[l - 1] == '\n')
-                                sysval[l - 1] = '\0';
-                        else
-                                sysval[l] = '\0';
-
-                        if (strlen(sysvals[s]) == 0)
-                                sysvals[s] = NULL;
-                        else
-                                sysvals[++s] = NULL;
-
-                        if (over_cmp >= 0) {
-	                        /* Only in OVAL 5.10 and above */
-	                        item = probe_item_create(OVAL_UNIX_SYSCTL, NULL,
-	                                                 "name",  OVAL_DATATYPE_SEXP,   se_mib,
-	                                                 "value", OVAL_DATATYPE_STRING_M, sysvals,
-	                                                 NULL);
-                        } else {
-	                        item = probe_item_create(OVAL_UNIX_SYSCTL, NULL,
-	                                                 "name",  OVAL_DATATYPE_SEXP,   se_mib,
-	                                                 "value", OVAL_DATATYPE_STRING, sysval,
-	                                                 NULL);
-                        }
-
-                        goto add_item;
-                fail_item:
-                        if (fp != NULL)
-                                fclose(fp);
-
-			item = probe_item_create(OVAL_UNIX_SYSCTL, NULL, NULL);
-                        probe_item_setstatus(item, SYSCHAR_STATUS_ERROR);
-                add_item:
-                        probe_item_collect(ctx, item);
+        if (name_entity == NULL) {
+                dE("Missing \"name\" entity in the input object");
+                return (PROBE_ENOENT);
+        }
+
+        /*
+         * The name can be looked up directly for the "equals" operation
+         * with a single value
+         */
+        name_value = probe_ent_getval(name_entity);
+
+        if (probe_ent_getoperation(name_entity, OVAL_OPERATION_EQUALS) == OVAL_OPERATION_EQUALS &&
+            !probe_ent_attrexists(name_entity, "var_ref") &&
+            name_value != NULL && SEXP_stringp(name_value) && SEXP_string_length(name_value) > 0) {
+                char mibpath[PATH_MAX] = PROC_SYS_DIR;
+                char *name = SEXP_string_cstr(name_value);
+
+                /* The MIB names use dots only, a name with a slash doesn't match anything */
+                if (strchr(name, '/') == NULL)
+                        sysctl_lookup(ctx, mibpath, strlen(mibpath), name, 0, name_value, over_cmp);
+
+                free(name);
+                SEXP_free(name_value);
+                SEXP_free(name_entity);
+
+                return (0);
+        }
+
+        SEXP_free(name_value);
+
+        if (pthread_mutex_lock(&snap->lock) != 0) {
+                dE("Can't lock mutex: errno=%u, %s.", errno, strerror(errno));
+                SEXP_free(name_entity);
+                return (PROBE_EFATAL);
+        }
+
+        if (!snap->ready) {
+                if (sysctl_snapshot_build(ctx, snap) != 0) {
+                        pthread_mutex_unlock(&snap->lock);
+                        SEXP_free(name_entity);
+                        return (PROBE_EFATAL);
                 }
 
-                oval_ftsent_free(ofts_ent);
-                SEXP_free(se_mib);
+                snap->ready = true;
+        }
+
+        pthread_mutex_unlock(&snap->lock);
+
+        for (i = 0; i < snap->count; ++i) {
+                if (probe_entobj_cmp(name_entity, snap->entries[i].mib) == OVAL_RESULT_TRUE)
+                        sysctl_collect(ctx, snap->entries[i].path, snap->entries[i].mib, over_cmp);
         }
 
-        oval_fts_close(ofts);
-	SEXP_free(path_entity);
-	SEXP_free(filename_entity);
-	SEXP_free(bh_entity);
 	SEXP_free(name_entity);
 
         return (0);
 }
 #else
+void *sysctl_probe_init(void)
+{
+	return NULL;
+}
+
 int sysctl_probe_main(probe_ctx *ctx, void *probe_arg)
 {
         return(PROBE_EOPNOTSUPP);
 }
+
+void sysctl_probe_fini(void *arg)
+{
+}
 #endif
@@ -101,6 +101,14 @@ OSCAP_API int oval_agent_reset_session(oval_agent_session_t * ag_sess);
  */
 OSCAP_API int oval_agent_abort_session(oval_agent_session_t *ag_sess);
 
+/**
+ * Set the number of threads used by @ref oval_agent_eval_system to evaluate
+ * the tests once the system characteristics are collected. The default is
+ * taken from the OSCAP_OVAL_EVAL_THREADS environment variable, or 1, which
+ * means serial evaluation. The results don't depend on the number of threads.
+ */
+OSCAP_API void oval_agent_set_eval_threads(oval_agent_session_t *ag_sess, unsigned int threads);
+
 typedef int (*agent_reporter)(const struct oval_result_definition * res_def, void *arg);
 
 /**
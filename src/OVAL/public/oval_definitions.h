@@ -1800,6 +1800,11 @@ OSCAP_API void oval_variable_set_datatype(struct oval_variable *, oval_datatype_
  */
 OSCAP_API void oval_variable_add_value(struct oval_variable *, struct oval_value *);	//type==OVAL_VARIABLE_CONSTANT
 
+/**
+ * Forget the values of the variable. The computed values of a local variable
+ * are dropped, so that they're computed again when the variable is queried.
+ * @memberof oval_variable
+ */
 OSCAP_API void oval_variable_clear_values(struct oval_variable *);
 
 /**
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <pcre.h>
+
+#include "oval_cmp_regex_impl.h"
+
+#define OVAL_REGEX_CACHE_BUCKETS 1021
+
+struct oval_regex {
+	char *pattern;
+	int options;
+	uint32_t hash;
+	pcre *re;
+	pcre_extra *extra;
+	unsigned int refs;		///< the cache holds one reference while the pattern is cached
+
+	struct oval_regex *next;	///< next pattern in the bucket
+	struct oval_regex *lru_prev;	///< more recently used pattern
+	struct oval_regex *lru_next;	///< less recently used pattern
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct oval_regex *buckets[OVAL_REGEX_CACHE_BUCKETS];
+	struct oval_regex *lru_head;
+	struct oval_regex *lru_tail;
+	size_t count;
+} regex_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static pthread_once_t regex_cache_once = PTHREAD_ONCE_INIT;
+
+static uint32_t oval_regex_hash(const char *pattern, int options)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261u ^ (uint32_t) options;
+
+	for (; *pattern != '\0'; ++pattern) {
+		h ^= (unsigned char) *pattern;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+static void oval_regex_free(struct oval_regex *re)
+{
+#ifdef PCRE_STUDY_JIT_COMPILE
+	pcre_free_study(re->extra);
+#else
+	pcre_free(re->extra);
+#endif
+	pcre_free(re->re);
+	free(re->pattern);
+	free(re);
+}
+
+static void oval_regex_lru_unlink(struct oval_regex *re)
+{
+	if (re->lru_prev != NULL)
+		re->lru_prev->lru_next = re->lru_next;
+	else
+		regex_cache.lru_head = re->lru_next;
+
+	if (re->lru_next != NULL)
+		re->lru_next->lru_prev = re->lru_prev;
+	else
+		regex_cache.lru_tail = re->lru_prev;
+
+	re->lru_prev = re->lru_next = NULL;
+}
+
+static void oval_regex_lru_push(struct oval_regex *re)
+{
+	re->lru_prev = NULL;
+	re->lru_next = regex_cache.lru_head;
+
+	if (regex_cache.lru_head != NULL)
+		regex_cache.lru_head->lru_prev = re;
+	else
+		regex_cache.lru_tail = re;
+
+	regex_cache.lru_head = re;
+}
+
+/*
+ * Remove the pattern from the cache. The pattern is freed once the last
+ * user releases it.
+ */
+static void oval_regex_evict(struct oval_regex *re)
+{
+	struct oval_regex **link = &regex_cache.buckets[re->hash % OVAL_REGEX_CACHE_BUCKETS];
+
+	while (*link != re)
+		link = &(*link)->next;
+	*link = re->next;
+
+	oval_regex_lru_unlink(re);
+	--regex_cache.count;
+
+	if (--re->refs == 0)
+		oval_regex_free(re);
+}
+
+static void oval_regex_cache_free(void)
+{
+	pthread_mutex_lock(&regex_cache.lock);
+	while (regex_cache.lru_tail != NULL)
+		oval_regex_evict(regex_cache.lru_tail);
+	pthread_mutex_unlock(&regex_cache.lock);
+}
+
+static void oval_regex_cache_init(void)
+{
+	atexit(oval_regex_cache_free);
+}
+
+static struct oval_regex *oval_regex_compile(const char *pattern, int options, uint32_t hash, const char **err, int *errofs)
+{
+	struct oval_regex *re;
+	const char *errmsg;
+	int erroffset;
+
+	re = malloc(sizeof(struct oval_regex));
+	if (re == NULL)
+		return NULL;
+
+	re->re = pcre_compile(pattern, options, &errmsg, &erroffset, NULL);
+	if (re->re == NULL) {
+		if (err != NULL)
+			*err = errmsg;
+		if (errofs != NULL)
+			*errofs = erroffset;
+		free(re);
+		return NULL;
+	}
+
+	/*
+	 * The pattern is compiled once and then matched many times, so it
+	 * pays off to study it. NULL extra data is fine for pcre_exec().
+	 */
+#ifdef PCRE_STUDY_JIT_COMPILE
+	re->extra = pcre_study(re->re, PCRE_STUDY_JIT_COMPILE, &errmsg);
+#else
+	re->extra = pcre_study(re->re, 0, &errmsg);
+#endif
+
+	re->pattern = strdup(pattern);
+	re->options = options;
+	re->hash = hash;
+	re->refs = 1;
+	re->next = NULL;
+	re->lru_prev = re->lru_next = NULL;
+
+	return re;
+}
+
+struct oval_regex *oval_regex_get(const char *pattern, int options, const char **err, int *errofs)
+{
+	struct oval_regex *re, *cached;
+	uint32_t hash;
+	size_t bucket;
+
+	pthread_once(&regex_cache_once, oval_regex_cache_init);
+
+	hash = oval_regex_hash(pattern, options);
+	bucket = hash % OVAL_REGEX_CACHE_BUCKETS;
+
+	pthread_mutex_lock(&regex_cache.lock);
+	for (re = regex_cache.buckets[bucket]; re != NULL; re = re->next) {
+		if (re->hash == hash && re->options == options && strcmp(re->pattern, pattern) == 0) {
+			++re->refs;
+			oval_regex_lru_unlink(re);
+			oval_regex_lru_push(re);
+			pthread_mutex_unlock(&regex_cache.lock);
+			return re;
+		}
+	}
+	pthread_mutex_unlock(&regex_cache.lock);
+
+	/* Compile outside of the lock, other patterns may be matched meanwhile */
+	re = oval_regex_compile(pattern, options, hash, err, errofs);
+	if (re == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&regex_cache.lock);
+
+	/* Another thread might have compiled the same pattern meanwhile */
+	for (cached = regex_cache.buckets[bucket]; cached != NULL; cached = cached->next) {
+		if (cached->hash == hash && cached->options == options && strcmp(cached->pattern, pattern) == 0)
+			break;
+	}
+
+	if (cached != NULL) {
+		++cached->refs;
+		pthread_mutex_unlock(&regex_cache.lock);
+		oval_regex_free(re);
+		return cached;
+	}
+
+	if (regex_cache.count >= OVAL_REGEX_CACHE_SIZE)
+		oval_regex_evict(regex_cache.lru_tail);
+
+	re->next = regex_cache.buckets[bucket];
+	regex_cache.buckets[bucket] = re;
+	oval_regex_lru_push(re);
+	++regex_cache.count;
+	++re->refs;
+
+	pthread_mutex_unlock(&regex_cache.lock);
+
+	return re;
+}
+
+void oval_regex_release(struct oval_regex *re)
+{
+	if (re == NULL)
+		return;
+
+	pthread_mutex_lock(&regex_cache.lock);
+	if (--re->refs == 0)
+		oval_regex_free(re);
+	pthread_mutex_unlock(&regex_cache.lock);
+}
+
+int oval_regex_exec(struct oval_regex *re, const char *subject, size_t length, int *ovector, int ovecsize)
+{
+	return pcre_exec(re->re, re->extra, subject, length, 0, 0, ovector, ovecsize);
+}
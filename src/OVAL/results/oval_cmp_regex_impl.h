@@ -0,0 +1,63 @@
+/**
+ * @file oval_cmp_regex_impl.h
+ * @brief Cache of compiled regular expressions used by OVAL comparisons
+ */
+
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef OSCAP_OVAL_CMP_REGEX_IMPL_H_
+#define OSCAP_OVAL_CMP_REGEX_IMPL_H_
+
+#include <stddef.h>
+
+/*
+ * Maximum number of compiled patterns kept in the cache. The least
+ * recently used pattern is dropped when a new one doesn't fit.
+ */
+#define OVAL_REGEX_CACHE_SIZE 512
+
+/**
+ * Compiled pattern shared by all the users of the same pattern and options.
+ */
+struct oval_regex;
+
+/**
+ * Get the compiled pattern from the process-wide cache, compile and study
+ * the pattern if it isn't there yet. The cache is thread-safe.
+ * @param pattern the pattern
+ * @param options pcre_compile() options
+ * @param err pointer to the error message if the compilation fails (optional)
+ * @param errofs offset of the error in the pattern (optional)
+ * @return the compiled pattern which needs to be released using
+ *         oval_regex_release(), or NULL if the pattern can't be compiled
+ */
+struct oval_regex *oval_regex_get(const char *pattern, int options, const char **err, int *errofs);
+
+/**
+ * Release the pattern obtained by oval_regex_get().
+ */
+void oval_regex_release(struct oval_regex *re);
+
+/**
+ * Match the subject against the pattern, see pcre_exec().
+ */
+int oval_regex_exec(struct oval_regex *re, const char *subject, size_t length, int *ovector, int ovecsize);
+
+#endif
@@ -249,7 +249,8 @@ int oval_results_model_eval(struct oval_results_model *res_model)
 
 static xmlNode *oval_results_to_dom(struct oval_results_model *results_model,
 				    struct oval_directives_model *directives_model, 
-				    xmlDocPtr doc, xmlNode * parent)
+				    xmlDocPtr doc, xmlNode * parent,
+				    struct oscap_xml_stream *stream)
 {
 	xmlNode *root_node;
 	struct oval_result_directives * dirs;
@@ -284,15 +285,21 @@ static xmlNode *oval_results_to_dom(struct oval_results_model *results_model,
 		struct oval_definition_model *definition_model = oval_results_model_get_definition_model(results_model);
 		oval_definition_model_to_dom(definition_model, doc, root_node);
 	}
+	/* The definitions may declare a namespace at the root, so its start tag
+	 * can't be written before them */
+	oscap_xml_stream_start_element(stream, root_node);
 
 	xmlNode *results_node = xmlNewTextChild(root_node, ns_results, BAD_CAST "results", NULL);
+	oscap_xml_stream_start_element(stream, results_node);
 	struct oval_result_system_iterator *systems = oval_results_model_get_systems(results_model);
 	while (oval_result_system_iterator_has_more(systems)) {
 		struct oval_result_system *sys = oval_result_system_iterator_next(systems);
-		oval_result_system_to_dom(sys, results_model, dirs_model, doc, results_node);
+		oval_result_system_to_dom(sys, results_model, dirs_model, doc, results_node, stream);
 	}
 	oval_result_system_iterator_free(systems);
+	oscap_xml_stream_end_element(stream);
 
+	oscap_xml_stream_end_element(stream);
 	return root_node;
 }
 
@@ -306,7 +313,7 @@ struct oscap_source *oval_results_model_export_source(struct oval_results_model
 		return NULL;
 	}
 
-	oval_results_to_dom(results_model, directives_model, doc, NULL);
+	oval_results_to_dom(results_model, directives_model, doc, NULL, NULL);
 	return oscap_source_new_from_xmlDoc(doc, name);
 }
 
@@ -314,13 +321,23 @@ int oval_results_model_export(struct oval_results_model *results_model,
 			      struct oval_directives_model *directives_model,
 			      const char *file)
 {
-	struct oscap_source *source = oval_results_model_export_source(results_model, directives_model, file);
-	if (source == NULL) {
+	__attribute__nonnull__(results_model);
+
+	xmlDocPtr doc = xmlNewDoc(BAD_CAST "1.0");
+	if (doc == NULL) {
+		oscap_setxmlerr(xmlGetLastError());
 		return -1;
 	}
-	int ret = oscap_source_save_as(source, NULL);
-	oscap_source_free(source);
-	return ret;
+
+	/* The results are written as they're converted, the document is never complete */
+	struct oscap_xml_stream *stream = oscap_xml_stream_new(file);
+	if (stream == NULL) {
+		xmlFreeDoc(doc);
+		return -1;
+	}
+	oval_results_to_dom(results_model, directives_model, doc, NULL, stream);
+	xmlFreeDoc(doc);
+	return oscap_xml_stream_close(stream) == 1 ? 0 : -1;
 }
 
 int oval_results_model_parse(xmlTextReaderPtr reader, struct oval_parser_context *context) {
@@ -36,6 +36,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "oval_definitions.h"
 #include "oval_agent_api.h"
@@ -56,6 +57,7 @@ typedef struct oval_result_system {
 	struct oval_smc *definitions;			///< Map contains lists of oval_result_definition
 	struct oval_smc *tests;				///< Map contains lists of oval_result_test
 	struct oval_syschar_model *syschar_model;
+	pthread_mutex_t lock;				///< Serializes additions of result definitions and tests
 } oval_result_system_t;
 
 
@@ -117,6 +119,13 @@ struct oval_result_system *oval_result_system_new(struct oval_results_model *mod
 	sys->syschar_model = syschar_model;
 	sys->model = model;
 
+	/* recursive: creating a result definition creates its result tests */
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&sys->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+
 	oval_results_model_add_system(model, sys);
 
 	return sys;
@@ -149,6 +158,7 @@ void oval_result_system_free(struct oval_result_system *sys)
 	sys->syschar_model = NULL;
 	sys->tests = NULL;
 
+	pthread_mutex_destroy(&sys->lock);
 	free(sys);
 }
 
@@ -203,6 +213,7 @@ struct oval_result_definition *oval_result_system_get_new_definition
 	struct oval_result_definition *rslt_definition = NULL;
 	if (oval_definition) {
 		char *id = oval_definition_get_id(oval_definition);
+		pthread_mutex_lock(&sys->lock);
 		rslt_definition = oval_result_system_get_definition(sys, id);
 		if (rslt_definition == NULL) {
 			rslt_definition = make_result_definition_from_oval_definition(sys, oval_definition,
@@ -215,12 +226,14 @@ struct oval_result_definition *oval_result_system_get_new_definition
 			rslt_definition = make_result_definition_from_oval_definition(sys, oval_definition, hint);
 			oval_result_system_add_definition(sys, rslt_definition);
 		}
+		pthread_mutex_unlock(&sys->lock);
 	}
 	return rslt_definition;
 }
 
 struct oval_result_test *oval_result_system_get_new_test(struct oval_result_system *sys, struct oval_test *oval_test, int variable_instance) {
 	char *id = oval_test_get_id(oval_test);
+	pthread_mutex_lock(&sys->lock);
 	struct oval_result_test *rslt_testtest = oval_result_system_get_test(sys, id);
 	if (rslt_testtest == NULL) {
 		//test = oval_result_test_new(sys, id);
@@ -232,6 +245,7 @@ struct oval_result_test *oval_result_system_get_new_test(struct oval_result_syst
 		rslt_testtest = make_result_test_from_oval_test(sys, oval_test, variable_instance);
 		oval_result_system_add_test(sys, rslt_testtest);
 	}
+	pthread_mutex_unlock(&sys->lock);
 	return rslt_testtest;
 }
 
@@ -258,7 +272,9 @@ void oval_result_system_add_definition(struct oval_result_system *sys, struct ov
 	__attribute__nonnull__(sys);
 	if (definition) {
 		const char *id = oval_result_definition_get_id(definition);
+		pthread_mutex_lock(&sys->lock);
 		oval_smc_put_last(sys->definitions, id, definition);
+		pthread_mutex_unlock(&sys->lock);
 	}
 }
 
@@ -267,7 +283,9 @@ void oval_result_system_add_test(struct oval_result_system *sys, struct oval_res
 	__attribute__nonnull__(sys);
 	if (test) {
 		const char *id = oval_result_test_get_id(test);
+		pthread_mutex_lock(&sys->lock);
 		oval_smc_put_last(sys->tests, id, test);
+		pthread_mutex_unlock(&sys->lock);
 	}
 }
 
@@ -376,6 +394,7 @@ struct oval_result_definition *oval_result_system_prepare_definition(struct oval
 		return NULL;
 	}
 
+	pthread_mutex_lock(&sys->lock);
         rslt_definition = oval_result_system_get_definition(sys, id);
         if (rslt_definition == NULL) {
 		rslt_definition = make_result_definition_from_oval_definition(sys, oval_definition, 1);
@@ -387,6 +406,7 @@ struct oval_result_definition *oval_result_system_prepare_definition(struct oval
 		rslt_definition = make_result_definition_from_oval_definition(sys, oval_definition, hint);
 		oval_result_system_add_definition(sys, rslt_definition);
 	}
+	pthread_mutex_unlock(&sys->lock);
 	return rslt_definition;
 }
 
@@ -415,7 +435,8 @@ static void _oval_result_definition_to_dom_based_on_directives(struct oval_resul
 xmlNode *oval_result_system_to_dom(struct oval_result_system * sys,
 				   struct oval_results_model * results_model,
 				   struct oval_directives_model * directives_model, 
-				   xmlDocPtr doc, xmlNode * parent) {
+				   xmlDocPtr doc, xmlNode * parent,
+				   struct oscap_xml_stream *stream) {
 
 	struct oval_result_directives * directives;
 	struct oval_result_directives * class_dirs;
@@ -423,10 +444,12 @@ xmlNode *oval_result_system_to_dom(struct oval_result_system * sys,
 
 	xmlNs *ns_results = xmlSearchNsByHref(doc, parent, OVAL_RESULTS_NAMESPACE);
 	xmlNode *system_node = xmlNewTextChild(parent, ns_results, BAD_CAST "system", NULL);
+	oscap_xml_stream_start_element(stream, system_node);
 
 	struct oval_smc *tstmap = oval_smc_new();
 
 	xmlNode *definitions_node = xmlNewTextChild(system_node, ns_results, BAD_CAST "definitions", NULL);
+	oscap_xml_stream_start_element(stream, definitions_node);
 	struct oval_definition_model *definition_model = oval_results_model_get_definition_model(results_model);
 	struct oval_definition_iterator *oval_definitions = oval_definition_model_get_definitions(definition_model);
 	while(oval_definition_iterator_has_more(oval_definitions)) {
@@ -452,8 +475,10 @@ xmlNode *oval_result_system_to_dom(struct oval_result_system * sys,
 				_oval_result_definition_to_dom_based_on_directives(rslt_definition, directives, doc, definitions_node, tstmap);
 			}
 		}
+		oscap_xml_stream_flush(stream);
 	}
 	oval_definition_iterator_free(oval_definitions);
+	oscap_xml_stream_end_element(stream);
 
 	struct oval_syschar_model *syschar_model = oval_result_system_get_syschar_model(sys);
 	struct oval_string_map *sysmap = oval_string_map_new();
@@ -464,6 +489,7 @@ xmlNode *oval_result_system_to_dom(struct oval_result_system * sys,
 	struct oval_smc_iterator *result_tests = oval_smc_iterator_new(tstmap);
 	if (oval_smc_iterator_has_more(result_tests)) {
 		xmlNode *tests_node = xmlNewTextChild(system_node, ns_results, BAD_CAST "tests", NULL);
+		oscap_xml_stream_start_element(stream, tests_node);
 		while (oval_smc_iterator_has_more(result_tests)) {
 			struct oval_state_iterator *ste_itr;
 			struct oval_result_test *result_test = oval_smc_iterator_next(result_tests);
@@ -502,13 +528,16 @@ xmlNode *oval_result_system_to_dom(struct oval_result_system * sys,
 				}
 			}
 			oval_state_iterator_free(ste_itr);
+			oscap_xml_stream_flush(stream);
 		}
+		oscap_xml_stream_end_element(stream);
 	}
 	oval_smc_iterator_free(result_tests);
 
 	bool export_sys_char = oval_results_model_get_export_system_characteristics(results_model);
 	oval_syschar_model_to_dom(syschar_model, doc, system_node, 
-				  (oval_syschar_resolver *) _oval_result_system_resolve_syschar, sysmap, export_sys_char);
+				  (oval_syschar_resolver *) _oval_result_system_resolve_syschar, sysmap, export_sys_char, stream);
+	oscap_xml_stream_end_element(stream);
 
 	oval_string_map_free(sysmap, NULL);
 	oval_string_map_free(objmap, NULL);
@@ -991,7 +991,7 @@ _oval_result_test_evaluate_items(struct oval_test *test, struct oval_syschar *sy
 }
 
 /* this function will gather all the necessary ingredients and call 'evaluate_items' when it finds them */
-static oval_result_t _oval_result_test_result(struct oval_result_test *rtest, void **args)
+static oval_result_t _oval_result_test_result(struct oval_result_test *rtest, void **args, bool query)
 {
 	__attribute__nonnull__(rtest);
 
@@ -1010,7 +1010,7 @@ static oval_result_t _oval_result_test_result(struct oval_result_test *rtest, vo
 	struct oval_result_system *sys = oval_result_test_get_system(rtest);
 	struct oval_results_model *results_model = oval_result_system_get_results_model(sys);
 	struct oval_probe_session *probe_session = oval_results_model_get_probe_session(results_model);
-	if (probe_session != NULL) {
+	if (query && probe_session != NULL) {
 		/* probe test */
 		int ret = oval_probe_query_test(probe_session, test);
 		if (ret != 0) {
@@ -1118,7 +1118,7 @@ static void _oval_result_test_initialize_bindings(struct oval_result_test *rslt_
 	rslt_test->bindings_initialized = true;
 }
 
-oval_result_t oval_result_test_eval(struct oval_result_test *rtest)
+static oval_result_t _oval_result_test_eval(struct oval_result_test *rtest, bool query)
 {
 	__attribute__nonnull__(rtest);
 
@@ -1133,7 +1133,7 @@ oval_result_t oval_result_test_eval(struct oval_result_test *rtest)
 			struct oval_string_map *tmp_map = oval_string_map_new();
 			void *args[] = { rtest->system, rtest, tmp_map };
 			dIndent(1);
-			rtest->result = _oval_result_test_result(rtest, args);
+			rtest->result = _oval_result_test_result(rtest, args, query);
 			dIndent(-1);
 			oval_string_map_free(tmp_map, NULL);
 
@@ -1150,6 +1150,16 @@ oval_result_t oval_result_test_eval(struct oval_result_test *rtest)
 	return rtest->result;
 }
 
+oval_result_t oval_result_test_eval(struct oval_result_test *rtest)
+{
+	return _oval_result_test_eval(rtest, true);
+}
+
+oval_result_t oval_result_test_eval_collected(struct oval_result_test *rtest)
+{
+	return _oval_result_test_eval(rtest, false);
+}
+
 oval_result_t oval_result_test_get_result(struct oval_result_test * rtest)
 {
 	__attribute__nonnull__(rtest);
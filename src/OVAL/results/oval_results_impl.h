@@ -42,7 +42,8 @@
 
 
 int oval_result_system_parse_tag(xmlTextReaderPtr, struct oval_parser_context *, void *);
-xmlNode *oval_result_system_to_dom(struct oval_result_system *, struct oval_results_model *, struct oval_directives_model *, xmlDocPtr, xmlNode *);
+xmlNode *oval_result_system_to_dom(struct oval_result_system *, struct oval_results_model *, struct oval_directives_model *, xmlDocPtr, xmlNode *,
+				   struct oscap_xml_stream *stream);
 
 struct oval_result_test *oval_result_system_get_new_test(struct oval_result_system *, struct oval_test *, int variable_instance);
 
@@ -104,5 +105,13 @@ const char *oval_result_test_get_id(const struct oval_result_test *test);
 
 struct oval_result_definition *oval_result_system_prepare_definition(struct oval_result_system *sys, const char *id);
 
+/**
+ * Evaluate the test without querying the probe session or computing any
+ * variables, the object and the variables must be resolved by
+ * oval_probe_resolve_test() already. Tests of different systems or
+ * different tests of the same system may be evaluated concurrently.
+ */
+oval_result_t oval_result_test_eval_collected(struct oval_result_test *rtest);
+
 
 #endif				/* OVAL_RESULTS_IMPL_H_ */
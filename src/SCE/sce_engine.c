@@ -53,6 +53,9 @@
 #include <limits.h>
 #include <unistd.h>
 #include <libgen.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
 
 struct sce_check_result
 {
@@ -259,17 +262,66 @@ void sce_session_export_to_directory(struct sce_session* s, const char* director
 	sce_check_result_iterator_free(it);
 }
 
+/*
+ * A script started ahead of the rule which needs its result. The scripts
+ * are started in the order the checks were announced by the policy and at
+ * most max_jobs of them run at the same time. The result is taken over by
+ * sce_engine_eval_rule() when the rule is evaluated, so the results are
+ * added to the session in the same order as if the scripts ran serially.
+ */
+struct sce_job
+{
+	char *path;				///< full path of the script
+	char **env_values;			///< NULL terminated environment of the script
+	size_t env_value_count;
+	pid_t pid;				///< 0 until the script is started
+	int stdout_fd;				///< -1 once the pipe is at EOF
+	int stderr_fd;				///< -1 once the pipe is at EOF
+	struct oscap_string *stdout_string;
+	struct oscap_string *stderr_string;
+	int wstatus;
+	bool finished;				///< the output is read and the script is reaped
+	bool discarded;				///< the result won't be used
+	struct sce_job *next;
+};
+
 struct sce_parameters
 {
 	char* xccdf_directory;
 	struct sce_session* session;
+	unsigned int max_jobs;			///< scripts which may run at the same time
+	struct sce_job *jobs;			///< announced and standalone scripts in order
 };
 
+static void _sce_jobs_discard(struct sce_parameters *parameters);
+
+static unsigned int _sce_max_jobs(void)
+{
+	const char *str = getenv("OSCAP_SCE_JOBS");
+	char *end;
+	unsigned long value;
+
+	if (str == NULL || *str == '\0')
+		return 1;
+
+	errno = 0;
+	value = strtoul(str, &end, 10);
+
+	if (errno != 0 || *end != '\0' || value == 0 || value > 1024) {
+		dW("Invalid value of OSCAP_SCE_JOBS: \"%s\", using 1", str);
+		return 1;
+	}
+
+	return (unsigned int) value;
+}
+
 struct sce_parameters* sce_parameters_new(void)
 {
 	struct sce_parameters *ret = malloc(sizeof(struct sce_parameters));
 	ret->xccdf_directory = NULL;
 	ret->session = NULL;
+	ret->max_jobs = _sce_max_jobs();
+	ret->jobs = NULL;
 
 	return ret;
 }
@@ -279,6 +331,7 @@ void sce_parameters_free(struct sce_parameters* v)
 	if (!v)
 		return;
 
+	_sce_jobs_discard(v);
 	free(v->xccdf_directory);
 	sce_session_free(v->session);
 
@@ -316,25 +369,29 @@ void sce_parameters_allocate_session(struct sce_parameters* v)
 
 static void _pipe_try_read_into_string(int fd, struct oscap_string *string, bool *eof)
 {
-	// FIXME: Read by larger chunks in the future
-	char readbuf;
+	char readbuf[4096];
 	while (true) {
-		const int read_status = read(fd, &readbuf, 1);
-		if (read_status == 1) {  // successful read
-			if (readbuf == '&') {
+		const ssize_t read_status = read(fd, readbuf, sizeof(readbuf) - 1);
+		if (read_status > 0) {  // successful read
+			readbuf[read_status] = '\0';
+			char *start = readbuf;
+			char *amp;
+			while ((amp = strchr(start, '&')) != NULL) {
 				// & is a special case, we have to "escape" it manually
 				// (all else will eventually get handled by libxml)
+				*amp = '\0';
+				oscap_string_append_string(string, start);
 				oscap_string_append_string(string, "&amp;");
-			} else {
-				oscap_string_append_char(string, readbuf);
+				start = amp + 1;
 			}
+			oscap_string_append_string(string, start);
 		}
 		else if (read_status == 0) {  // EOF
 			*eof = true;
 			break;
 		}
 		else {
-			if (errno == EAGAIN) {
+			if (errno == EAGAIN || errno == EINTR) {
 				// NOOP, we are waiting for more input
 				break;
 			}
@@ -346,62 +403,30 @@ static void _pipe_try_read_into_string(int fd, struct oscap_string *string, bool
 	}
 }
 
-xccdf_test_result_type_t sce_engine_eval_rule(struct xccdf_policy *policy, const char *rule_id, const char *id, const char *href,
-		struct xccdf_value_binding_iterator *value_binding_it,
-		struct xccdf_check_import_iterator *check_import_it,
-		void *usr)
-{
-	struct sce_parameters* parameters = (struct sce_parameters*)usr;
-	const char* xccdf_directory = parameters->xccdf_directory;
-
-	char* tmp_href = oscap_sprintf("%s/%s", xccdf_directory, href);
-
-	if (access(tmp_href, F_OK))
-	{
-		// we only do this check to provide helpful error message
-		// there is an inherent race condition, the file might
-		// not exist anymore at the time we execve it!
-
-		// the script hasn't been found, perhaps another sce instance
-		// with a different XCCDF directory can find it?
-		oscap_seterr(OSCAP_EFAMILY_SCE, "SCE couldn't find script file '%s'. "
-				"Expected location: '%s'.", href, tmp_href);
-		free(tmp_href);
-		return XCCDF_RESULT_NOT_CHECKED;
-	}
-
-	if (access(tmp_href, F_OK | X_OK))
-	{
-		// again, only to provide helpful error message
-		oscap_seterr(OSCAP_EFAMILY_SCE, "SCE has found script file '%s' at '%s' "
-				"but it isn't executable!", href, tmp_href);
-		free(tmp_href);
-		return XCCDF_RESULT_ERROR;
-	}
-
-	// all the result codes are shifted by 100, because otherwise syntax errors in scripts
-	// or even their nonexistence would cause XCCDF_RESULT_PASS to be the result
-
-	char* argvp[1 + 1] = {
-		tmp_href,
-		NULL
+/**
+ * Build the environment of the script from the compiled in result codes
+ * and the values bound to the check.
+ * @return NULL terminated array of KEY=VALUE strings
+ */
+static char **_sce_env_values_new(struct xccdf_value_binding_iterator *value_binding_it, size_t *count)
+{
+	static const char *const compiled_in[] = {
+		"PATH=/bin:/sbin:/usr/bin:/usr/sbin",
+		"XCCDF_RESULT_PASS=101",
+		"XCCDF_RESULT_FAIL=102",
+		"XCCDF_RESULT_ERROR=103",
+		"XCCDF_RESULT_UNKNOWN=104",
+		"XCCDF_RESULT_NOT_APPLICABLE=105",
+		"XCCDF_RESULT_NOT_CHECKED=106",
+		"XCCDF_RESULT_NOT_SELECTED=107",
+		"XCCDF_RESULT_INFORMATIONAL=108",
+		"XCCDF_RESULT_FIXED=109",
 	};
+	size_t env_value_count = sizeof(compiled_in) / sizeof(compiled_in[0]);
+	char **env_values = malloc(env_value_count * sizeof(char *));
 
-	// bound values in KEY=VALUE form, ready to be passed as environment variables
-	char ** env_values = malloc(10 * sizeof(char * ));
-	size_t env_value_count = 10;
-
-	env_values[0] = "PATH=/bin:/sbin:/usr/bin:/usr/sbin";
-
-	env_values[1] = "XCCDF_RESULT_PASS=101";
-	env_values[2] = "XCCDF_RESULT_FAIL=102";
-	env_values[3] = "XCCDF_RESULT_ERROR=103";
-	env_values[4] = "XCCDF_RESULT_UNKNOWN=104";
-	env_values[5] = "XCCDF_RESULT_NOT_APPLICABLE=105";
-	env_values[6] = "XCCDF_RESULT_NOT_CHECKED=106";
-	env_values[7] = "XCCDF_RESULT_NOT_SELECTED=107";
-	env_values[8] = "XCCDF_RESULT_INFORMATIONAL=108";
-	env_values[9] = "XCCDF_RESULT_FIXED=109";
+	for (size_t i = 0; i < env_value_count; ++i)
+		env_values[i] = oscap_strdup(compiled_in[i]);
 
 	while (xccdf_value_binding_iterator_has_more(value_binding_it))
 	{
@@ -481,207 +506,497 @@ xccdf_test_result_type_t sce_engine_eval_rule(struct xccdf_policy *policy, const
 
 	env_values = realloc(env_values, (env_value_count + 1) * sizeof(char*));
 	env_values[env_value_count] = NULL;
+	*count = env_value_count;
+
+	return env_values;
+}
+
+static void _sce_env_values_free(char **env_values, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		free(env_values[i]);
+	free(env_values);
+}
+
+static struct sce_job *_sce_job_new(char *path, char **env_values, size_t env_value_count)
+{
+	struct sce_job *job = malloc(sizeof(struct sce_job));
+	job->path = path;
+	job->env_values = env_values;
+	job->env_value_count = env_value_count;
+	job->pid = 0;
+	job->stdout_fd = -1;
+	job->stderr_fd = -1;
+	job->stdout_string = oscap_string_new();
+	job->stderr_string = oscap_string_new();
+	job->wstatus = 0;
+	job->finished = false;
+	job->discarded = false;
+	job->next = NULL;
+
+	return job;
+}
+
+static void _sce_job_free(struct sce_job *job)
+{
+	if (job->stdout_fd != -1)
+		close(job->stdout_fd);
+	if (job->stderr_fd != -1)
+		close(job->stderr_fd);
+	oscap_string_free(job->stdout_string);
+	oscap_string_free(job->stderr_string);
+	_sce_env_values_free(job->env_values, job->env_value_count);
+	free(job->path);
+	free(job);
+}
+
+static bool _sce_job_matches(const struct sce_job *job, const char *path, char **env_values, size_t env_value_count)
+{
+	if (job->discarded || job->env_value_count != env_value_count || strcmp(job->path, path) != 0)
+		return false;
+	for (size_t i = 0; i < env_value_count; ++i) {
+		if (strcmp(job->env_values[i], env_values[i]) != 0)
+			return false;
+	}
+	return true;
+}
+
+static int _sce_set_nonblock(int fd)
+{
+	const int flags = fcntl(fd, F_GETFL, 0);
+	if (flags == -1)
+		return -1;
+	return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/**
+ * Fork and execute the script of the job.
+ * @return 0 on success, -1 if the script couldn't be started (the job is finished then)
+ */
+static int _sce_job_start(struct sce_job *job)
+{
+	// all the result codes are shifted by 100, because otherwise syntax errors in scripts
+	// or even their nonexistence would cause XCCDF_RESULT_PASS to be the result
+
+	char* argvp[1 + 1] = {
+		job->path,
+		NULL
+	};
 
-	// We open a pipe for communication with the forked process
+	// We open a pipe for communication with the forked process. The reading
+	// ends must not leak into the scripts started later, otherwise we would
+	// never see EOF on the pipes of the scripts running at the same time.
 	int stdout_pipefd[2];
 	int stderr_pipefd[2];
-	if (pipe(stdout_pipefd) == -1 || pipe(stderr_pipefd) == -1)
+	if (pipe(stdout_pipefd) == -1)
 	{
 		perror("pipe");
-		// the first 9 values (0 to 8) are compiled in
-		for (size_t i = 9; i < env_value_count; ++i)
-		{
-			free(env_values[i]);
-		}
-		free(env_values);
-		return XCCDF_RESULT_ERROR;
+		job->finished = true;
+		return -1;
+	}
+	if (pipe(stderr_pipefd) == -1)
+	{
+		perror("pipe");
+		close(stdout_pipefd[0]);
+		close(stdout_pipefd[1]);
+		job->finished = true;
+		return -1;
 	}
+	fcntl(stdout_pipefd[0], F_SETFD, FD_CLOEXEC);
+	fcntl(stderr_pipefd[0], F_SETFD, FD_CLOEXEC);
 
 	// FIXME: We definitely want to impose security restrictions in the forked child process in the future.
 	//        This would prevent scripts from writing to files or deleting them.
 
-	int fork_result = fork();
-	if (fork_result >= 0)
+	pid_t fork_result = fork();
+	if (fork_result < 0)
 	{
-		// fork successful
+		perror("fork");
+		close(stdout_pipefd[0]);
+		close(stdout_pipefd[1]);
+		close(stderr_pipefd[0]);
+		close(stderr_pipefd[1]);
+		job->finished = true;
+		return -1;
+	}
 
-		if (fork_result == 0)
-		{
-		    // we won't read from the pipes, so close the reading fd
-		    close(stdout_pipefd[0]);
-		    close(stderr_pipefd[0]);
-
-			// forward stdout and stderr to our custom opened pipes
-			dup2(stdout_pipefd[1], fileno(stdout));
-			dup2(stderr_pipefd[1], fileno(stderr));
-
-			// we duplicated the file descriptors twice, we can close the original
-			// ones now, stdout and stderr will be closed properly after the execved
-			// script/executable finishes
-			close(stdout_pipefd[1]);
-			close(stderr_pipefd[1]);
-
-			// before we execute the script, lets make sure we get SIGTERM when
-			// oscap is killed, crashes or otherwise terminates
+	if (fork_result == 0)
+	{
+		// we won't read from the pipes, so close the reading fd
+		close(stdout_pipefd[0]);
+		close(stderr_pipefd[0]);
+
+		// forward stdout and stderr to our custom opened pipes
+		dup2(stdout_pipefd[1], fileno(stdout));
+		dup2(stderr_pipefd[1], fileno(stderr));
+
+		// we duplicated the file descriptors twice, we can close the original
+		// ones now, stdout and stderr will be closed properly after the execved
+		// script/executable finishes
+		close(stdout_pipefd[1]);
+		close(stderr_pipefd[1]);
+
+		// before we execute the script, lets make sure we get SIGTERM when
+		// oscap is killed, crashes or otherwise terminates
 #ifdef PR_SET_PDEATHSIG
-			// requires Linux 2.1.57 or later
-			prctl(PR_SET_PDEATHSIG, SIGTERM);
+		// requires Linux 2.1.57 or later
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
 #else
-			// TODO: Please provide alternatives
+		// TODO: Please provide alternatives
 #endif
 
-			// we are the child process
-			execve(tmp_href, argvp, env_values);
+		// we are the child process
+		execve(job->path, argvp, job->env_values);
+
+		// no need to check the return value of execve, if it returned at all we are in trouble
+		printf("Unexpected error when executing script '%s'. Error message follows.\n", job->path);
+		perror("execve");
+
+		// the parent process considers us a script check, we have to return a value that will mean XCCDF_RESULT_ERROR
+		_exit(103);
+	}
+
+	// we won't write to the pipes, so close the writing fd
+	close(stdout_pipefd[1]);
+	close(stderr_pipefd[1]);
 
-			// no need to check the return value of execve, if it returned at all we are in trouble
-			printf("Unexpected error when executing script '%s'. Error message follows.\n", href);
-			perror("execve");
+	job->pid = fork_result;
+	job->stdout_fd = stdout_pipefd[0];
+	job->stderr_fd = stderr_pipefd[0];
 
-			// the parent process considers us a script check, we have to return a value that will mean XCCDF_RESULT_ERROR
-			exit(103);
+	if (_sce_set_nonblock(job->stdout_fd) == -1 || _sce_set_nonblock(job->stderr_fd) == -1) {
+		// we can still read the output, the script just runs to its end meanwhile
+		dW("Failed to set nonblocking flag on the pipes of '%s': %s", job->path, strerror(errno));
+	}
+
+	return 0;
+}
+
+static void _sce_job_reap(struct sce_job *job)
+{
+	while (waitpid(job->pid, &job->wstatus, 0) == -1 && errno == EINTR)
+		;
+	job->finished = true;
+}
+
+/**
+ * Run the jobs until the given one is finished. The target is started
+ * once fewer than max_jobs scripts run, the queued jobs take the slots
+ * left after it, so at most max_jobs scripts run at the same time. The
+ * output of all the running scripts is read as soon as it is available.
+ * Finished discarded jobs are removed from the list.
+ * @param target job to wait for or NULL to wait for all the running jobs
+ */
+static void _sce_jobs_run(struct sce_parameters *parameters, struct sce_job *target)
+{
+	while (true) {
+		unsigned int running = 0;
+		nfds_t nfds = 0;
+		struct pollfd *fds = NULL;
+
+		for (struct sce_job *job = parameters->jobs; job != NULL; job = job->next) {
+			if (job->pid != 0 && !job->finished)
+				++running;
 		}
-		else
-		{
-			// we won't write to the pipes, so close the writing fd
-			close(stdout_pipefd[1]);
-			close(stderr_pipefd[1]);
-
-			const int flag_stdout = fcntl(stdout_pipefd[0], F_GETFL, 0);
-			if (flag_stdout == -1) {
-				oscap_seterr(OSCAP_EFAMILY_SCE, "Failed to obtain status of stdout pipe: %s",
-						strerror(errno));
-				return XCCDF_RESULT_ERROR;
+
+		// the target takes the first free slot
+		if (target != NULL && target->pid == 0 && !target->finished && running < parameters->max_jobs) {
+			if (_sce_job_start(target) != 0)
+				return;
+			++running;
+		}
+
+		// collect the pipes of the running jobs and start the queued ones
+		for (struct sce_job *job = parameters->jobs; job != NULL; job = job->next) {
+			if (job->finished)
+				continue;
+			if (job->pid == 0) {
+				if (job->discarded)
+					continue;
+				if (target == NULL || target->pid == 0 || running >= parameters->max_jobs)
+					continue;
+				if (_sce_job_start(job) != 0)
+					continue;
+				++running;
 			}
-			int retval = fcntl(stdout_pipefd[0], F_SETFL, flag_stdout | O_NONBLOCK);
-			if (retval == -1) {
-				oscap_seterr(OSCAP_EFAMILY_SCE,
-						"Failed to set nonblocking flag on stdout pipe: %s",
-						strerror(errno));
-				return XCCDF_RESULT_ERROR;
+			if (job->stdout_fd == -1 && job->stderr_fd == -1) {
+				_sce_job_reap(job);
+				--running;
+				continue;
 			}
-
-			const int flag_stderr = fcntl(stderr_pipefd[0], F_GETFL, 0);
-			if (flag_stderr == -1) {
-				oscap_seterr(OSCAP_EFAMILY_SCE,
-						"Failed to obtain status of stderr pipe: %s",
-						strerror(errno));
-				return XCCDF_RESULT_ERROR;
+			struct pollfd *new_fds = realloc(fds, (nfds + 2) * sizeof(struct pollfd));
+			if (new_fds == NULL) {
+				oscap_seterr(OSCAP_EFAMILY_SCE, "Failed to allocate memory to wait for the output of the scripts.");
+				free(fds);
+				return;
+			}
+			fds = new_fds;
+			if (job->stdout_fd != -1) {
+				fds[nfds].fd = job->stdout_fd;
+				fds[nfds].events = POLLIN;
+				++nfds;
 			}
-			retval = fcntl(stderr_pipefd[0], F_SETFL, flag_stderr | O_NONBLOCK);
-			if (retval == -1) {
-				oscap_seterr(OSCAP_EFAMILY_SCE,
-						"Failed to set nonblocking flag on stderr pipe: %s",
-						strerror(errno));
-				return XCCDF_RESULT_ERROR;
+			if (job->stderr_fd != -1) {
+				fds[nfds].fd = job->stderr_fd;
+				fds[nfds].events = POLLIN;
+				++nfds;
 			}
+		}
 
-			// we have to read from both pipes at the same time to avoid stalling
-			struct oscap_string *stdout_string = oscap_string_new();
-			struct oscap_string *stderr_string = oscap_string_new();
+		// drop the finished jobs nobody is interested in
+		struct sce_job **prev = &parameters->jobs;
+		while (*prev != NULL) {
+			struct sce_job *job = *prev;
+			if (job->discarded && (job->finished || job->pid == 0)) {
+				*prev = job->next;
+				_sce_job_free(job);
+			} else {
+				prev = &job->next;
+			}
+		}
 
-			bool stdout_eof = false;
-			bool stderr_eof = false;
+		if (target != NULL && target->finished) {
+			free(fds);
+			return;
+		}
+		if (nfds == 0) {
+			// the jobs which held the slots were just reaped
+			if (target != NULL && target->pid == 0)
+				continue;
+			return;
+		}
 
-			while (!stdout_eof || !stderr_eof) {
-				if (!stdout_eof)
-					_pipe_try_read_into_string(stdout_pipefd[0], stdout_string, &stdout_eof);
+		if (poll(fds, nfds, -1) == -1 && errno != EINTR) {
+			oscap_seterr(OSCAP_EFAMILY_SCE, "Failed to wait for the output of the scripts: %s", strerror(errno));
+			free(fds);
+			return;
+		}
+		free(fds);
+
+		// read whatever is available, we have to read from all the pipes to avoid stalling
+		for (struct sce_job *job = parameters->jobs; job != NULL; job = job->next) {
+			if (job->finished || job->pid == 0)
+				continue;
+			if (job->stdout_fd != -1) {
+				bool eof = false;
+				_pipe_try_read_into_string(job->stdout_fd, job->stdout_string, &eof);
+				if (eof) {
+					close(job->stdout_fd);
+					job->stdout_fd = -1;
+				}
+			}
+			if (job->stderr_fd != -1) {
+				bool eof = false;
+				_pipe_try_read_into_string(job->stderr_fd, job->stderr_string, &eof);
+				if (eof) {
+					close(job->stderr_fd);
+					job->stderr_fd = -1;
+				}
+			}
+		}
+	}
+}
 
-				if (!stderr_eof)
-					_pipe_try_read_into_string(stderr_pipefd[0], stderr_string, &stderr_eof);
+static void _sce_jobs_discard(struct sce_parameters *parameters)
+{
+	for (struct sce_job *job = parameters->jobs; job != NULL; job = job->next)
+		job->discarded = true;
+	_sce_jobs_run(parameters, NULL);
+}
 
-				// sleep for 10ms to avoid wasting CPU
-				usleep(10 * 1000);
-			}
+static void _sce_jobs_remove(struct sce_parameters *parameters, struct sce_job *target)
+{
+	struct sce_job **prev = &parameters->jobs;
+	while (*prev != target)
+		prev = &(*prev)->next;
+	*prev = target->next;
+	target->next = NULL;
+}
 
-			close(stdout_pipefd[0]);
-			close(stderr_pipefd[0]);
+static void _sce_jobs_append(struct sce_parameters *parameters, struct sce_job *job)
+{
+	struct sce_job **prev = &parameters->jobs;
+	while (*prev != NULL)
+		prev = &(*prev)->next;
+	*prev = job;
+}
 
-			char *stdout_buffer = oscap_string_bequeath(stdout_string);
-			char *stderr_buffer = oscap_string_bequeath(stderr_string);
+/**
+ * Get the full path of the script if it can be executed.
+ * @return the path or NULL with the result the rule shall have in *result
+ */
+static char *_sce_script_path(struct sce_parameters *parameters, const char *href, xccdf_test_result_type_t *result)
+{
+	char* tmp_href = oscap_sprintf("%s/%s", parameters->xccdf_directory, href);
 
-			// we are the parent process
-			int wstatus;
-			waitpid(fork_result, &wstatus, 0);
+	if (access(tmp_href, F_OK))
+	{
+		// we only do this check to provide helpful error message
+		// there is an inherent race condition, the file might
+		// not exist anymore at the time we execve it!
 
-			// we subtract 100 here to shift the exit code to xccdf_test_result_type_t enum range
-			int raw_result = WEXITSTATUS(wstatus) - 100;
-			if (raw_result <= 0 || raw_result > XCCDF_RESULT_FIXED)
-			{
-				// the script returned invalid exit code, we need to safeguard us against that
-				raw_result = XCCDF_RESULT_ERROR;
-			}
+		// the script hasn't been found, perhaps another sce instance
+		// with a different XCCDF directory can find it?
+		oscap_seterr(OSCAP_EFAMILY_SCE, "SCE couldn't find script file '%s'. "
+				"Expected location: '%s'.", href, tmp_href);
+		free(tmp_href);
+		*result = XCCDF_RESULT_NOT_CHECKED;
+		return NULL;
+	}
 
-			struct sce_session* session = sce_parameters_get_session(parameters);
-			if (session)
-			{
-				struct sce_check_result* check_result = sce_check_result_new();
-				sce_check_result_set_href(check_result, tmp_href);
-				char *base_name = oscap_basename(tmp_href);
-				sce_check_result_set_basename(check_result, base_name);
-				free(base_name);
-				sce_check_result_set_stdout(check_result, stdout_buffer);
-				sce_check_result_set_stderr(check_result, stderr_buffer);
-				sce_check_result_set_exit_code(check_result, WEXITSTATUS(wstatus));
-				sce_check_result_set_xccdf_result(check_result, (xccdf_test_result_type_t)raw_result);
-
-				for (size_t i = 0; i < env_value_count; ++i)
-				{
-					sce_check_result_add_environment_variable(check_result, env_values[i]);
-				}
+	if (access(tmp_href, F_OK | X_OK))
+	{
+		// again, only to provide helpful error message
+		oscap_seterr(OSCAP_EFAMILY_SCE, "SCE has found script file '%s' at '%s' "
+				"but it isn't executable!", href, tmp_href);
+		free(tmp_href);
+		*result = XCCDF_RESULT_ERROR;
+		return NULL;
+	}
 
-				sce_session_add_check_result(session, check_result);
-			}
+	return tmp_href;
+}
 
-			// the first 10 values (0 to 9) are compiled in
-			for (size_t i = 10; i < env_value_count; ++i)
-			{
-				free(env_values[i]);
-			}
-			free(env_values);
-
-			// lets interpret the check imports passed to us
-			xccdf_check_import_iterator_reset(check_import_it);
-			while (xccdf_check_import_iterator_has_more(check_import_it))
-			{
-				struct xccdf_check_import * check_import = xccdf_check_import_iterator_next(check_import_it);
-				const char *name = xccdf_check_import_get_name(check_import);
-
-				if (strcmp(name, "stdout") == 0)
-				{
-					xccdf_check_import_set_content(check_import, stdout_buffer);
-				}
-				else if (strcmp(name, "stderr") == 0)
-				{
-					xccdf_check_import_set_content(check_import, stderr_buffer);
-				}
-			}
+static void *sce_engine_query(void *usr, xccdf_policy_engine_query_t query_type, void *query_data)
+{
+	struct sce_parameters *parameters = (struct sce_parameters *) usr;
+
+	switch (query_type) {
+	case POLICY_ENGINE_QUERY_PREFETCH:
+		// scripts are only run ahead if they may run in parallel
+		return parameters->max_jobs > 1 ? parameters : NULL;
+	case POLICY_ENGINE_QUERY_PREFETCH_CHECK: {
+		struct xccdf_policy_engine_check *check = (struct xccdf_policy_engine_check *) query_data;
+		if (parameters->max_jobs <= 1 || check == NULL || check->href == NULL)
+			return NULL;
+		char *path = oscap_sprintf("%s/%s", parameters->xccdf_directory, check->href);
+		if (access(path, F_OK | X_OK)) {
+			// the error is reported when the rule is evaluated
+			free(path);
+			return NULL;
+		}
+		size_t env_value_count;
+		char **env_values = _sce_env_values_new(check->value_binding_it, &env_value_count);
+		_sce_jobs_append(parameters, _sce_job_new(path, env_values, env_value_count));
+		return NULL;
+	}
+	case POLICY_ENGINE_QUERY_PREFETCH_END:
+		_sce_jobs_discard(parameters);
+		return NULL;
+	default:
+		return NULL;
+	}
+}
+
+xccdf_test_result_type_t sce_engine_eval_rule(struct xccdf_policy *policy, const char *rule_id, const char *id, const char *href,
+		struct xccdf_value_binding_iterator *value_binding_it,
+		struct xccdf_check_import_iterator *check_import_it,
+		void *usr)
+{
+	struct sce_parameters* parameters = (struct sce_parameters*)usr;
 
-			free(tmp_href);
-			free(stdout_buffer);
-			free(stderr_buffer);
+	xccdf_test_result_type_t result;
+	char *tmp_href = _sce_script_path(parameters, href, &result);
+	if (tmp_href == NULL)
+		return result;
+
+	size_t env_value_count;
+	char **env_values = _sce_env_values_new(value_binding_it, &env_value_count);
+
+	// The engine isn't told which rule is evaluated, so the script started
+	// ahead is recognized by its path and environment. Scripts announced
+	// before it are not going to be evaluated anymore.
+	struct sce_job *job = NULL;
+	for (struct sce_job *it = parameters->jobs; it != NULL; it = it->next) {
+		if (_sce_job_matches(it, tmp_href, env_values, env_value_count)) {
+			job = it;
+			break;
+		}
+	}
+	if (job != NULL) {
+		for (struct sce_job *it = parameters->jobs; it != job; it = it->next)
+			it->discarded = true;
+		_sce_env_values_free(env_values, env_value_count);
+		free(tmp_href);
+	} else {
+		job = _sce_job_new(tmp_href, env_values, env_value_count);
+		_sce_jobs_append(parameters, job);
+	}
 
-			return (xccdf_test_result_type_t)raw_result;
+	_sce_jobs_run(parameters, job);
+	_sce_jobs_remove(parameters, job);
+	if (!job->finished || job->pid == 0) {
+		// starting or waiting for the script failed
+		if (job->pid != 0 && !job->finished) {
+			kill(job->pid, SIGTERM);
+			_sce_job_reap(job);
 		}
+		_sce_job_free(job);
+		return XCCDF_RESULT_ERROR;
+	}
+
+	char *stdout_buffer = oscap_string_bequeath(job->stdout_string);
+	char *stderr_buffer = oscap_string_bequeath(job->stderr_string);
+	job->stdout_string = NULL;
+	job->stderr_string = NULL;
+	int wstatus = job->wstatus;
+
+	// we subtract 100 here to shift the exit code to xccdf_test_result_type_t enum range
+	int raw_result = WEXITSTATUS(wstatus) - 100;
+	if (raw_result <= 0 || raw_result > XCCDF_RESULT_FIXED)
+	{
+		// the script returned invalid exit code, we need to safeguard us against that
+		raw_result = XCCDF_RESULT_ERROR;
 	}
-	else
+
+	struct sce_session* session = sce_parameters_get_session(parameters);
+	if (session)
 	{
-		// the first 9 values (0 to 8) are compiled in
-		for (size_t i = 9; i < env_value_count; ++i)
+		struct sce_check_result* check_result = sce_check_result_new();
+		sce_check_result_set_href(check_result, job->path);
+		char *base_name = oscap_basename(job->path);
+		sce_check_result_set_basename(check_result, base_name);
+		free(base_name);
+		sce_check_result_set_stdout(check_result, stdout_buffer);
+		sce_check_result_set_stderr(check_result, stderr_buffer);
+		sce_check_result_set_exit_code(check_result, WEXITSTATUS(wstatus));
+		sce_check_result_set_xccdf_result(check_result, (xccdf_test_result_type_t)raw_result);
+
+		for (size_t i = 0; i < job->env_value_count; ++i)
 		{
-			free(env_values[i]);
+			sce_check_result_add_environment_variable(check_result, job->env_values[i]);
 		}
-		free(env_values);
 
-		close(stdout_pipefd[0]);
-		close(stdout_pipefd[1]);
-		close(stderr_pipefd[0]);
-		close(stderr_pipefd[1]);
-		return XCCDF_RESULT_ERROR;
+		sce_session_add_check_result(session, check_result);
 	}
+
+	_sce_job_free(job);
+
+	// lets interpret the check imports passed to us
+	xccdf_check_import_iterator_reset(check_import_it);
+	while (xccdf_check_import_iterator_has_more(check_import_it))
+	{
+		struct xccdf_check_import * check_import = xccdf_check_import_iterator_next(check_import_it);
+		const char *name = xccdf_check_import_get_name(check_import);
+
+		if (strcmp(name, "stdout") == 0)
+		{
+			xccdf_check_import_set_content(check_import, stdout_buffer);
+		}
+		else if (strcmp(name, "stderr") == 0)
+		{
+			xccdf_check_import_set_content(check_import, stderr_buffer);
+		}
+	}
+
+	free(stdout_buffer);
+	free(stderr_buffer);
+
+	return (xccdf_test_result_type_t)raw_result;
 }
 
 bool xccdf_policy_model_register_engine_sce(struct xccdf_policy_model * model, struct sce_parameters *parameters)
 {
 	return xccdf_policy_model_register_engine_and_query_callback(model,
-		"http://open-scap.org/page/SCE", sce_engine_eval_rule, (void*)parameters, NULL);
+		"http://open-scap.org/page/SCE", sce_engine_eval_rule, (void*)parameters, sce_engine_query);
 }
@@ -70,8 +70,23 @@ struct xccdf_policy_iterator;
  */
 typedef enum {
 	POLICY_ENGINE_QUERY_NAMES_FOR_HREF = 1,		/// Considering xccdf:check-content-ref, what are possible @name attributes for given href?
+	POLICY_ENGINE_QUERY_PREFETCH = 2,		/// Does the checking engine want to start evaluating checks ahead of xccdf_policy_evaluate?
+	POLICY_ENGINE_QUERY_PREFETCH_CHECK = 3,		/// This check will be evaluated later by the running xccdf_policy_evaluate.
+	POLICY_ENGINE_QUERY_PREFETCH_END = 4,		/// The xccdf_policy_evaluate has finished, checks which weren't evaluated may be dropped.
 } xccdf_policy_engine_query_t;
 
+/**
+ * Simple check announced to the checking engine by POLICY_ENGINE_QUERY_PREFETCH_CHECK.
+ * The check will be evaluated by the eval function of the engine later with the same
+ * href and value bindings, in the order the checks were announced. Rules which aren't
+ * selected or applicable are not announced.
+ */
+struct xccdf_policy_engine_check {
+	const char *name;					///< @name of the xccdf:check-content-ref or NULL
+	const char *href;					///< @href of the xccdf:check-content-ref
+	struct xccdf_value_binding_iterator *value_binding_it;	///< values exported to the check
+};
+
 /**
  * Type of function which implements queries defined within xccdf_policy_engine_query_t.
  *
@@ -81,9 +96,13 @@ typedef enum {
  * is always user data as registered. Second argument defines the query. Third argument is
  * dependent on query and defined as follows:
  *  - (const char *)href -- for POLICY_ENGINE_QUERY_NAMES_FOR_HREF
+ *  - NULL -- for POLICY_ENGINE_QUERY_PREFETCH and POLICY_ENGINE_QUERY_PREFETCH_END
+ *  - (struct xccdf_policy_engine_check *) -- for POLICY_ENGINE_QUERY_PREFETCH_CHECK
  *
  * Expected return type depends also on query as follows:
  *  - (struct oscap_stringlists *) -- for POLICY_ENGINE_QUERY_NAMES_FOR_HREF
+ *  - any non-NULL pointer if the checks shall be announced -- for POLICY_ENGINE_QUERY_PREFETCH
+ *  - NULL -- for POLICY_ENGINE_QUERY_PREFETCH_CHECK and POLICY_ENGINE_QUERY_PREFETCH_END
  *  - NULL shall be returned if the function doesn't understand the query.
  */
 typedef void *(*xccdf_policy_engine_query_fn) (void *, xccdf_policy_engine_query_t, void *);
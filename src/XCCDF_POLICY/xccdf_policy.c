@@ -550,7 +550,7 @@ _xccdf_policy_is_engine_registered(struct xccdf_policy *policy, char *sysname)
 }
 
 static struct xccdf_check *
-_xccdf_policy_rule_get_applicable_check(struct xccdf_policy *policy, struct xccdf_item *rule)
+_xccdf_policy_rule_get_applicable_check(struct xccdf_policy *policy, struct xccdf_item *rule, bool warn)
 {
 	// Citations inline come from NISTIR-7275r4.
 	struct xccdf_check *result = NULL;
@@ -591,10 +591,10 @@ _xccdf_policy_rule_get_applicable_check(struct xccdf_policy *policy, struct xccd
 		}
 
 		// Only print a warning if we didn't select a check but could've otherwise.
-		if (print_oval_warning) {
+		if (warn && print_oval_warning) {
 			printf("WARNING: Skipping rule that uses OVAL but is possibly malformed; "
 			       "an incorrect content reference prevents this check from being evaluated.\n");
-		} else if (print_general_warning && result == NULL) {
+		} else if (warn && print_general_warning && result == NULL) {
 			printf("WARNING: Skipping rule that requires an unregistered check system "
 			       "or incorrect content reference to evaluate. "
 			       "Please consider providing a valid SCAP/OVAL instead of %s\n",
@@ -1013,7 +1013,7 @@ _xccdf_policy_rule_evaluate(struct xccdf_policy * policy, const struct xccdf_rul
 		return _xccdf_policy_report_rule_result(policy, result, rule, NULL, XCCDF_RESULT_NOT_APPLICABLE, NULL);
 	}
 
-	const struct xccdf_check *orig_check = _xccdf_policy_rule_get_applicable_check(policy, (struct xccdf_item *) rule);
+	const struct xccdf_check *orig_check = _xccdf_policy_rule_get_applicable_check(policy, (struct xccdf_item *) rule, true);
 	if (orig_check == NULL)
 		// No candidate or applicable check found.
 		return _xccdf_policy_report_rule_result(policy, result, rule, NULL, XCCDF_RESULT_NOT_CHECKED, "No candidate or applicable check found.");
@@ -1158,6 +1158,120 @@ static int xccdf_policy_item_evaluate(struct xccdf_policy * policy, struct xccdf
     return ret;
 }
 
+/**
+ * Announce the simple check of the rule (or of all the rules of the group)
+ * to the checking engines which prefetch checks. Only the rules which
+ * _xccdf_policy_rule_evaluate() would pass to the engine are announced.
+ */
+static void _xccdf_policy_item_prefetch(struct xccdf_policy *policy, struct xccdf_item *item, struct oscap_list *engines)
+{
+	if (xccdf_item_get_type(item) == XCCDF_GROUP) {
+		struct xccdf_item_iterator *child_it = xccdf_group_get_content((const struct xccdf_group *) item);
+		while (xccdf_item_iterator_has_more(child_it))
+			_xccdf_policy_item_prefetch(policy, xccdf_item_iterator_next(child_it), engines);
+		xccdf_item_iterator_free(child_it);
+		return;
+	}
+	if (xccdf_item_get_type(item) != XCCDF_RULE)
+		return;
+
+	const struct xccdf_rule *rule = (const struct xccdf_rule *) item;
+	const char *rule_id = xccdf_rule_get_id(rule);
+	if (policy->rule != NULL && strcmp(policy->rule, rule_id) != 0)
+		return;
+	if (!xccdf_policy_is_item_selected(policy, rule_id))
+		return;
+	struct xccdf_refine_rule_internal *r_rule = oscap_htable_get(policy->refine_rules_internal, rule_id);
+	if (xccdf_get_final_role(rule, r_rule) == XCCDF_ROLE_UNCHECKED)
+		return;
+
+	struct xccdf_check *check = _xccdf_policy_rule_get_applicable_check(policy, item, false);
+	if (check == NULL || xccdf_check_get_complex(check))
+		return;
+	const char *system_name = xccdf_check_get_system(check);
+	if (!oscap_list_contains(engines, (void *) system_name, (oscap_cmp_func) xccdf_policy_engine_filter))
+		return;
+	if (!xccdf_policy_model_item_is_applicable(policy->model, item))
+		return;
+
+	// Only the first check-content-ref is announced, the others are alternatives
+	// evaluated only if the first one can't be resolved.
+	struct xccdf_check_content_ref_iterator *content_it = xccdf_check_get_content_refs(check);
+	struct xccdf_check_content_ref *content = xccdf_check_content_ref_iterator_has_more(content_it) ?
+		xccdf_check_content_ref_iterator_next(content_it) : NULL;
+	xccdf_check_content_ref_iterator_free(content_it);
+	if (content == NULL)
+		return;
+	const char *content_name = xccdf_check_content_ref_get_name(content);
+	if (content_name == NULL && xccdf_check_get_multicheck(check))
+		return;
+
+	struct oscap_list *bindings = xccdf_policy_check_get_value_bindings(policy, xccdf_check_get_exports(check));
+	if (bindings == NULL) {
+		// the error is reported again when the rule is evaluated
+		oscap_clearerr();
+		return;
+	}
+
+	struct oscap_iterator *engine_it = oscap_iterator_new(engines);
+	while (oscap_iterator_has_more(engine_it)) {
+		struct xccdf_policy_engine *engine = (struct xccdf_policy_engine *) oscap_iterator_next(engine_it);
+		if (!xccdf_policy_engine_filter(engine, system_name))
+			continue;
+		struct xccdf_policy_engine_check engine_check = {
+			.name = content_name,
+			.href = xccdf_check_content_ref_get_href(content),
+			.value_binding_it = (struct xccdf_value_binding_iterator *) oscap_iterator_new(bindings),
+		};
+		xccdf_policy_engine_query(engine, POLICY_ENGINE_QUERY_PREFETCH_CHECK, &engine_check);
+		xccdf_value_binding_iterator_free(engine_check.value_binding_it);
+	}
+	oscap_iterator_free(engine_it);
+	oscap_list_free(bindings, (oscap_destruct_func) xccdf_value_binding_free);
+}
+
+/**
+ * Let the checking engines which want to evaluate checks ahead know the checks
+ * which will be evaluated by the policy.
+ * @return list of such engines or NULL if there are none
+ */
+static struct oscap_list *_xccdf_policy_prefetch_start(struct xccdf_policy *policy, struct xccdf_benchmark *benchmark)
+{
+	struct oscap_list *engines = NULL;
+	struct oscap_iterator *engine_it = oscap_iterator_new(policy->model->engines);
+	while (oscap_iterator_has_more(engine_it)) {
+		struct xccdf_policy_engine *engine = (struct xccdf_policy_engine *) oscap_iterator_next(engine_it);
+		if (xccdf_policy_engine_query(engine, POLICY_ENGINE_QUERY_PREFETCH, NULL) == NULL)
+			continue;
+		if (engines == NULL)
+			engines = oscap_list_new();
+		oscap_list_add(engines, engine);
+	}
+	oscap_iterator_free(engine_it);
+	if (engines == NULL)
+		return NULL;
+
+	struct xccdf_item_iterator *item_it = xccdf_benchmark_get_content(benchmark);
+	while (xccdf_item_iterator_has_more(item_it))
+		_xccdf_policy_item_prefetch(policy, xccdf_item_iterator_next(item_it), engines);
+	xccdf_item_iterator_free(item_it);
+	return engines;
+}
+
+static void _xccdf_policy_prefetch_end(struct oscap_list *engines)
+{
+	if (engines == NULL)
+		return;
+	struct oscap_iterator *engine_it = oscap_iterator_new(engines);
+	while (oscap_iterator_has_more(engine_it)) {
+		struct xccdf_policy_engine *engine = (struct xccdf_policy_engine *) oscap_iterator_next(engine_it);
+		xccdf_policy_engine_query(engine, POLICY_ENGINE_QUERY_PREFETCH_END, NULL);
+	}
+	oscap_iterator_free(engine_it);
+	// the engines are owned by the policy model
+	oscap_list_free(engines, NULL);
+}
+
 struct oscap_file_entry {
 	char* system_name;
 	char* file;
@@ -2027,6 +2141,8 @@ struct xccdf_result * xccdf_policy_evaluate(struct xccdf_policy * policy)
 
     free(id);
 
+	struct oscap_list *prefetch_engines = _xccdf_policy_prefetch_start(policy, benchmark);
+
 	/** We need to process document top-down order.
 	 * See conflicts/requires and Item Processing Algorithm */
 	struct xccdf_item_iterator *item_it = xccdf_benchmark_get_content(benchmark);
@@ -2035,6 +2151,7 @@ struct xccdf_result * xccdf_policy_evaluate(struct xccdf_policy * policy)
 		ret = xccdf_policy_item_evaluate(policy, item, result);
 		if (ret == -1) {
 			xccdf_item_iterator_free(item_it);
+			_xccdf_policy_prefetch_end(prefetch_engines);
 			xccdf_result_free(result);
 			return NULL;
 		}
@@ -2042,6 +2159,7 @@ struct xccdf_result * xccdf_policy_evaluate(struct xccdf_policy * policy)
 			break;
 	}
 	xccdf_item_iterator_free(item_it);
+	_xccdf_policy_prefetch_end(prefetch_engines);
 
 	if (policy->rule != NULL && !policy->rule_found) {
 		oscap_seterr(OSCAP_EFAMILY_XCCDF,
@@ -27,6 +27,8 @@
 
 # include <stdio.h>
 # include <stdarg.h>
+# include <stdint.h>
+# include <stdbool.h>
 # include <string.h>
 # include <stdlib.h>
 # include <sys/types.h>
@@ -76,6 +78,10 @@ static const struct oscap_string_map OSCAP_VERBOSITY_LEVELS[] = {
 
 #  if defined(OSCAP_THREAD_SAFE)
 #   include <pthread.h>
+#   include <poll.h>
+#   if defined(OS_LINUX)
+#    include <sys/eventfd.h>
+#   endif
 static pthread_mutex_t __debuglog_mutex = PTHREAD_MUTEX_INITIALIZER;
 #  endif
 FILE *__debuglog_fp = NULL;
@@ -119,6 +125,508 @@ int setenv(const char *name, const char *value, int overwrite)
 }
 #endif
 
+#if defined(OSCAP_THREAD_SAFE) && !defined(OS_WINDOWS)
+/*
+ * Messages written to a log file are passed to a background writer
+ * thread, so that the threads which log don't wait for the file. Every
+ * thread appends its messages to its own ring and the messages get a
+ * global sequence number. The writer merges the rings by the sequence
+ * numbers, so the messages are written in the order they were logged.
+ */
+# define DEBUG_ASYNC
+#endif
+
+/*
+ * A formatted message. Short messages fit into the inline buffer.
+ */
+#define DEBUG_MSG_INLINE 512
+
+struct debug_msg {
+	char  *data;
+	size_t len;
+	size_t size;
+	char   inline_buf[DEBUG_MSG_INLINE];
+};
+
+static void debug_msg_init(struct debug_msg *msg)
+{
+	msg->data = msg->inline_buf;
+	msg->len  = 0;
+	msg->size = sizeof msg->inline_buf;
+}
+
+static void debug_msg_free(struct debug_msg *msg)
+{
+	if (msg->data != msg->inline_buf)
+		free(msg->data);
+}
+
+static bool debug_msg_reserve(struct debug_msg *msg, size_t len)
+{
+	size_t size;
+	char *data;
+
+	if (msg->len + len < msg->size)
+		return true;
+
+	for (size = msg->size * 2; size <= msg->len + len; size *= 2);
+
+	if (msg->data == msg->inline_buf) {
+		data = malloc(size);
+		if (data != NULL)
+			memcpy(data, msg->data, msg->len);
+	} else {
+		data = realloc(msg->data, size);
+	}
+	if (data == NULL)
+		return false;
+
+	msg->data = data;
+	msg->size = size;
+
+	return true;
+}
+
+static void debug_msg_append(struct debug_msg *msg, const char *data, size_t len)
+{
+	if (!debug_msg_reserve(msg, len))
+		return;
+
+	memcpy(msg->data + msg->len, data, len);
+	msg->len += len;
+}
+
+static void debug_msg_vappendf(struct debug_msg *msg, const char *fmt, va_list ap)
+{
+	va_list ap2;
+	int n;
+
+	va_copy(ap2, ap);
+	n = vsnprintf(msg->data + msg->len, msg->size - msg->len, fmt, ap);
+
+	if (n >= 0 && (size_t)n >= msg->size - msg->len) {
+		if (debug_msg_reserve(msg, n))
+			vsnprintf(msg->data + msg->len, msg->size - msg->len, fmt, ap2);
+		else
+			n = msg->size - msg->len - 1;
+	}
+	va_end(ap2);
+
+	if (n > 0)
+		msg->len += n;
+}
+
+static void debug_msg_appendf(struct debug_msg *msg, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	debug_msg_vappendf(msg, fmt, ap);
+	va_end(ap);
+}
+
+#if defined(OVAL_PROBES_ENABLED)
+static void debug_msg_append_sexp(struct debug_msg *msg, const SEXP_t *sexp)
+{
+#if defined(OS_WINDOWS)
+	char buf[4096];
+	size_t n;
+	FILE *fp = tmpfile();
+
+	if (fp == NULL)
+		return;
+
+	SEXP_fprintfa(fp, sexp);
+	rewind(fp);
+	while ((n = fread(buf, 1, sizeof buf, fp)) > 0)
+		debug_msg_append(msg, buf, n);
+	fclose(fp);
+#else
+	char *buf = NULL;
+	size_t size = 0;
+	FILE *fp = open_memstream(&buf, &size);
+
+	if (fp == NULL)
+		return;
+
+	SEXP_fprintfa(fp, sexp);
+	fclose(fp);
+	debug_msg_append(msg, buf, size);
+	free(buf);
+#endif
+}
+#endif
+
+#if defined(DEBUG_ASYNC)
+#define DEBUG_RING_SIZE        (256 * 1024) /* bytes per thread, power of 2 */
+#define DEBUG_RING_MSG_MAX     (DEBUG_RING_SIZE / 4) /* longer messages are cut */
+#define DEBUG_RING_ALIGN       16
+#define DEBUG_RING_PAD         UINT32_MAX   /* record length of the padding at the end of the ring */
+#define DEBUG_WRITER_INTERVAL  10           /* ms, how often the writer looks for messages */
+#define DEBUG_WRITER_GAP_WAIT  10           /* ms, how long the writer waits for a missing message */
+
+struct debug_rec {
+	uint64_t seq;
+	uint32_t len;
+	uint32_t reserved;
+};
+
+struct debug_ring {
+	struct debug_ring *next; ///< protected by debug_async.lock
+	bool     orphan;         ///< the thread has exited
+	uint64_t head __attribute__((aligned(64))); ///< read by the writer
+	uint64_t tail __attribute__((aligned(64))); ///< written by the thread
+	char     buf[DEBUG_RING_SIZE] __attribute__((aligned(64)));
+};
+
+/*
+ * The lock protects only the list of the rings. The writer is woken up
+ * through wake_fd (an eventfd, or a pipe where it isn't available), the
+ * wake_pending flag makes sure there's at most one pending wake up, so
+ * the threads which log don't write to the descriptor all the time.
+ */
+static struct {
+	volatile bool      enabled;
+	bool               started;
+	bool               stop;
+	bool               wake_pending;
+	int                wake_fd[2]; ///< read end, write end
+	pthread_key_t      key;
+	pthread_mutex_t    lock;
+	pthread_t          writer;
+	struct debug_ring *rings;
+	uint64_t           seq;
+	uint64_t           next_seq; ///< next message to be written, used by the writer only
+	bool               gap;
+	struct timespec    gap_since;
+} debug_async = {
+	.wake_fd = { -1, -1 },
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+#define DEBUG_RING_RECLEN(len) (((sizeof(struct debug_rec) + (len)) + DEBUG_RING_ALIGN - 1) & ~((size_t)DEBUG_RING_ALIGN - 1))
+#define DEBUG_RING_OFFSET(pos) ((size_t)(pos) & (DEBUG_RING_SIZE - 1))
+
+static void debug_ring_release(void *arg)
+{
+	struct debug_ring *ring = arg;
+
+	/* The ring is freed by the writer once it's drained */
+	__atomic_store_n(&ring->orphan, true, __ATOMIC_RELEASE);
+}
+
+static struct debug_ring *debug_ring_get(void)
+{
+	struct debug_ring *ring;
+
+	ring = pthread_getspecific(debug_async.key);
+	if (ring != NULL)
+		return ring;
+
+	if (posix_memalign((void **)&ring, 64, sizeof(struct debug_ring)) != 0)
+		return NULL;
+
+	ring->orphan = false;
+	ring->head = 0;
+	ring->tail = 0;
+
+	if (pthread_setspecific(debug_async.key, ring) != 0) {
+		free(ring);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&debug_async.lock);
+	ring->next = debug_async.rings;
+	debug_async.rings = ring;
+	pthread_mutex_unlock(&debug_async.lock);
+
+	return ring;
+}
+
+static void debug_async_notify(void)
+{
+	uint64_t one = 1;
+
+	/* EAGAIN means the writer has been notified already */
+	if (write(debug_async.wake_fd[1], &one, sizeof one) < 0)
+		return;
+}
+
+static void debug_async_wake(void)
+{
+	if (!__atomic_exchange_n(&debug_async.wake_pending, true, __ATOMIC_ACQ_REL))
+		debug_async_notify();
+}
+
+/*
+ * Wait until the writer is woken up or the interval expires.
+ */
+static void debug_async_wait(void)
+{
+	struct pollfd pfd = { debug_async.wake_fd[0], POLLIN, 0 };
+	char buf[64];
+
+	if (poll(&pfd, 1, DEBUG_WRITER_INTERVAL) > 0) {
+		while (read(debug_async.wake_fd[0], buf, sizeof buf) > 0);
+	}
+	__atomic_store_n(&debug_async.wake_pending, false, __ATOMIC_RELEASE);
+}
+
+/*
+ * Append the message to the ring of the calling thread. If the ring is
+ * full, the thread waits for the writer.
+ * @return false if the message has to be written synchronously
+ */
+static bool debug_async_push(struct debug_msg *msg)
+{
+	struct debug_ring *ring;
+	struct debug_rec *rec;
+	uint64_t tail;
+	size_t len, reclen, contig, need;
+
+	if (!debug_async.enabled)
+		return false;
+
+	ring = debug_ring_get();
+	if (ring == NULL)
+		return false;
+
+	len = msg->len;
+	if (len > DEBUG_RING_MSG_MAX) {
+		len = DEBUG_RING_MSG_MAX;
+		msg->data[len - 1] = '\n';
+	}
+
+	reclen = DEBUG_RING_RECLEN(len);
+	tail = ring->tail;
+	contig = DEBUG_RING_SIZE - DEBUG_RING_OFFSET(tail);
+	need = reclen + (contig < reclen ? contig : 0);
+
+	while (tail + need - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) > DEBUG_RING_SIZE) {
+		struct timespec ts = { 0, 100 * 1000 };
+
+		debug_async_wake();
+		nanosleep(&ts, NULL);
+	}
+
+	if (contig < reclen) {
+		/* The record would wrap around, skip the rest of the ring */
+		rec = (struct debug_rec *)(ring->buf + DEBUG_RING_OFFSET(tail));
+		rec->len = DEBUG_RING_PAD;
+		tail += contig;
+	}
+
+	rec = (struct debug_rec *)(ring->buf + DEBUG_RING_OFFSET(tail));
+	rec->len = len;
+	memcpy(rec + 1, msg->data, len);
+	rec->seq = __atomic_fetch_add(&debug_async.seq, 1, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&ring->tail, tail + reclen, __ATOMIC_RELEASE);
+
+	if (tail + reclen - __atomic_load_n(&ring->head, __ATOMIC_RELAXED) > DEBUG_RING_SIZE / 2)
+		debug_async_wake();
+
+	return true;
+}
+
+static bool debug_async_gap_expired(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (!debug_async.gap) {
+		debug_async.gap = true;
+		debug_async.gap_since = now;
+		return false;
+	}
+
+	return (now.tv_sec - debug_async.gap_since.tv_sec) * 1000 +
+		(now.tv_nsec - debug_async.gap_since.tv_nsec) / 1000000 >= DEBUG_WRITER_GAP_WAIT;
+}
+
+/*
+ * Write the messages from the rings in the order of their sequence
+ * numbers. A message with a lower number than the ones in the rings may
+ * be just being appended, so the writer waits for it for a while. It may
+ * never come if the thread was canceled.
+ * The lock is held only while the rings are searched, the rings are freed
+ * only by the writer, so the record can be written without it.
+ * @return the number of written messages
+ */
+static size_t debug_async_drain(bool final)
+{
+	size_t count = 0;
+
+	for (;;) {
+		struct debug_ring **prev, *ring, *best = NULL;
+		struct debug_rec *rec, *best_rec = NULL;
+
+		pthread_mutex_lock(&debug_async.lock);
+		for (prev = &debug_async.rings; (ring = *prev) != NULL; ) {
+			uint64_t head = ring->head;
+			uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+			if (head != tail) {
+				rec = (struct debug_rec *)(ring->buf + DEBUG_RING_OFFSET(head));
+				if (rec->len == DEBUG_RING_PAD) {
+					head += DEBUG_RING_SIZE - DEBUG_RING_OFFSET(head);
+					__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+				}
+			}
+
+			if (head == tail) {
+				if (__atomic_load_n(&ring->orphan, __ATOMIC_ACQUIRE) &&
+				    __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) {
+					*prev = ring->next;
+					free(ring);
+					continue;
+				}
+				prev = &ring->next;
+				continue;
+			}
+
+			rec = (struct debug_rec *)(ring->buf + DEBUG_RING_OFFSET(head));
+			if (best_rec == NULL || rec->seq < best_rec->seq) {
+				best = ring;
+				best_rec = rec;
+			}
+			prev = &ring->next;
+		}
+		pthread_mutex_unlock(&debug_async.lock);
+
+		if (best == NULL)
+			return count;
+
+		if (best_rec->seq > debug_async.next_seq && !final && !debug_async_gap_expired())
+			return count;
+
+		fwrite(best_rec + 1, 1, best_rec->len, __debuglog_fp);
+		if (best_rec->seq >= debug_async.next_seq)
+			debug_async.next_seq = best_rec->seq + 1;
+		debug_async.gap = false;
+
+		__atomic_store_n(&best->head, best->head + DEBUG_RING_RECLEN(best_rec->len), __ATOMIC_RELEASE);
+		++count;
+	}
+}
+
+static void *debug_async_writer(void *arg)
+{
+#if defined(HAVE_PTHREAD_SETNAME_NP)
+# if defined(OS_APPLE)
+	pthread_setname_np("debug_writer");
+# else
+	pthread_setname_np(pthread_self(), "debug_writer");
+# endif
+#endif
+
+	for (;;) {
+		if (debug_async_drain(false) > 0) {
+			fflush(__debuglog_fp);
+			continue;
+		}
+
+		if (__atomic_load_n(&debug_async.stop, __ATOMIC_ACQUIRE))
+			break;
+
+		debug_async_wait();
+	}
+
+	debug_async_drain(true);
+	fflush(__debuglog_fp);
+
+	return NULL;
+}
+
+static void debug_async_wake_close(void)
+{
+	if (debug_async.wake_fd[1] != debug_async.wake_fd[0])
+		close(debug_async.wake_fd[1]);
+	close(debug_async.wake_fd[0]);
+	debug_async.wake_fd[0] = debug_async.wake_fd[1] = -1;
+	debug_async.wake_pending = false;
+}
+
+static int debug_async_wake_open(void)
+{
+	if (debug_async.wake_fd[0] >= 0)
+		return 0;
+#if defined(OS_LINUX)
+	debug_async.wake_fd[0] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (debug_async.wake_fd[0] < 0)
+		return -1;
+	debug_async.wake_fd[1] = debug_async.wake_fd[0];
+#else
+	if (pipe(debug_async.wake_fd) != 0)
+		return -1;
+	for (int i = 0; i < 2; ++i) {
+		fcntl(debug_async.wake_fd[i], F_SETFD, FD_CLOEXEC);
+		fcntl(debug_async.wake_fd[i], F_SETFL, O_NONBLOCK);
+	}
+#endif
+	return 0;
+}
+
+static void debug_async_stop(void)
+{
+	if (!debug_async.started)
+		return;
+
+	debug_async.enabled = false;
+
+	__atomic_store_n(&debug_async.stop, true, __ATOMIC_RELEASE);
+	debug_async_notify();
+
+	pthread_join(debug_async.writer, NULL);
+	debug_async_wake_close();
+	debug_async.started = false;
+}
+
+/* The writer thread doesn't exist in a forked child */
+static void debug_async_atfork_child(void)
+{
+	debug_async.enabled = false;
+	debug_async.started = false;
+	/* don't share the descriptors with the parent */
+	if (debug_async.wake_fd[0] >= 0)
+		debug_async_wake_close();
+}
+
+static void debug_async_start(void)
+{
+	const char *sync = getenv("OSCAP_VERBOSE_LOG_SYNC");
+
+	if (sync != NULL && strcmp(sync, "1") == 0)
+		return;
+
+	if (debug_async.started) {
+		debug_async.enabled = true;
+		return;
+	}
+
+	if (debug_async_wake_open() != 0)
+		return;
+	debug_async.stop = false;
+
+	if (pthread_key_create(&debug_async.key, debug_ring_release) != 0) {
+		debug_async_wake_close();
+		return;
+	}
+
+	if (pthread_create(&debug_async.writer, NULL, debug_async_writer, NULL) != 0) {
+		pthread_key_delete(debug_async.key);
+		debug_async_wake_close();
+		return;
+	}
+
+	pthread_atfork(NULL, NULL, debug_async_atfork_child);
+	debug_async.started = true;
+	debug_async.enabled = true;
+	atexit(&debug_async_stop);
+}
+#endif /* DEBUG_ASYNC */
+
 static void __oscap_debuglog_close(void)
 {
         fclose(__debuglog_fp);
@@ -166,8 +674,12 @@ bool oscap_set_verbose(const char *verbosity_level, const char *filename)
 		oscap_seterr(OSCAP_EFAMILY_OSCAP, "Failed to associate stream with file %s: %s.", filename, strerror(errno));
 		return false;
 	}
-	setbuf(__debuglog_fp, NULL);
+	/* Whole messages are flushed, one by one or in batches by the writer thread */
+	setvbuf(__debuglog_fp, NULL, _IOFBF, BUFSIZ);
 	atexit(&__oscap_debuglog_close);
+#if defined(DEBUG_ASYNC)
+	debug_async_start();
+#endif
 	return true;
 }
 
@@ -183,12 +695,10 @@ static const char *__oscap_path_rstrip(const char *path)
 }
 
 
-static void debug_message_start(int level, int indent)
+static void debug_message_start(struct debug_msg *msg, int level, int indent)
 {
 	char  l;
 
-	__LOCK_FP;
-
 	switch (level) {
 	case DBG_E:
 		l = 'E';
@@ -205,13 +715,14 @@ static void debug_message_start(int level, int indent)
 	default:
 		l = '0';
 	}
-	fprintf(__debuglog_fp, "%c: %s: ", l, GET_PROGRAM_NAME);
+	debug_msg_init(msg);
+	debug_msg_appendf(msg, "%c: %s: ", l, GET_PROGRAM_NAME);
 	for (int i = 0; i < indent; i++) {
-		fprintf(__debuglog_fp, "  ");
+		debug_msg_append(msg, "  ", 2);
 	}
 }
 
-static void debug_message_devel_metadata(const char *file, const char *fn, size_t line)
+static void debug_message_devel_metadata(struct debug_msg *msg, const char *file, const char *fn, size_t line)
 {
 	const char *f = __oscap_path_rstrip(file);
 #if defined(OSCAP_THREAD_SAFE)
@@ -228,25 +739,35 @@ static void debug_message_devel_metadata(const char *file, const char *fn, size_
 	/* XXX: non-portable usage of pthread_t */
 	unsigned long long tid = (unsigned long long) thread;
 #endif
-	fprintf(__debuglog_fp, " [%s(%ld):%s(%llx):%s:%zu:%s]",
+	debug_msg_appendf(msg, " [%s(%ld):%s(%llx):%s:%zu:%s]",
 		GET_PROGRAM_NAME, (long) getpid(), thread_name,
 		tid, f, line, fn);
 #else
-	fprintf(__debuglog_fp, " [%ld:%s:%zu:%s]", (long) getpid(),
+	debug_msg_appendf(msg, " [%ld:%s:%zu:%s]", (long) getpid(),
 		f, line, fn);
 #endif
 }
 
-static void debug_message_end()
+static void debug_message_end(struct debug_msg *msg)
 {
-	fputc('\n', __debuglog_fp);
-	__UNLOCK_FP;
-	return;
+	debug_msg_append(msg, "\n", 1);
+
+#if defined(DEBUG_ASYNC)
+	if (!debug_async_push(msg))
+#endif
+	{
+		__LOCK_FP;
+		fwrite(msg->data, 1, msg->len, __debuglog_fp);
+		fflush(__debuglog_fp);
+		__UNLOCK_FP;
+	}
+	debug_msg_free(msg);
 }
 
 void __oscap_dlprintf(int level, const char *file, const char *fn, size_t line, int delta_indent, const char *fmt, ...)
 {
 	static int indent = 0;
+	struct debug_msg msg;
 	va_list ap;
 
 	if (__debuglog_fp == NULL) {
@@ -260,33 +781,35 @@ void __oscap_dlprintf(int level, const char *file, const char *fn, size_t line,
 		return;
 	}
 	va_start(ap, fmt);
-	debug_message_start(level, indent);
-	vfprintf(__debuglog_fp, fmt, ap);
+	debug_message_start(&msg, level, indent);
+	debug_msg_vappendf(&msg, fmt, ap);
 	if (__debuglog_level == DBG_D) {
-		debug_message_devel_metadata(file, fn, line);
+		debug_message_devel_metadata(&msg, file, fn, line);
 	}
-	debug_message_end();
+	debug_message_end(&msg);
 	va_end(ap);
 }
 
 void __oscap_debuglog_object (const char *file, const char *fn, size_t line, int objtype, void *obj)
 {
+	struct debug_msg msg;
+
 	if (__debuglog_fp == NULL) {
 		return;
 	}
 	if (__debuglog_level < DBG_D) {
 		return;
 	}
-	debug_message_start(DBG_D, 0);
+	debug_message_start(&msg, DBG_D, 0);
 	switch (objtype) {
 	case OSCAP_DEBUGOBJ_SEXP:
 #if defined(OVAL_PROBES_ENABLED)
-		SEXP_fprintfa(__debuglog_fp, (SEXP_t *)obj);
+		debug_msg_append_sexp(&msg, (SEXP_t *)obj);
 #endif
 		break;
 	default:
-		fprintf(__debuglog_fp, "Attempt to dump a not supported object.");
+		debug_msg_appendf(&msg, "Attempt to dump a not supported object.");
 	}
-	debug_message_devel_metadata(file, fn, line);
-	debug_message_end();
+	debug_message_devel_metadata(&msg, file, fn, line);
+	debug_message_end(&msg);
 }
@@ -275,3 +275,213 @@ xmlNs *lookup_xsi_ns(xmlDoc *doc)
 	}
 	return ns_xsi;
 }
+
+/* libxml2 indents by two spaces per level up to 60 spaces */
+#define OSCAP_XML_STREAM_MAX_INDENT 30
+static const char OSCAP_XML_STREAM_INDENT[] =
+	"\n                                                            ";
+
+struct oscap_xml_stream_element {
+	xmlNode *node;
+	bool empty;	///< no child has been written yet
+};
+
+struct oscap_xml_stream {
+	xmlTextWriterPtr writer;
+	xmlOutputBufferPtr out;
+	int fd;
+	struct oscap_xml_stream_element *open;	///< stack of the started elements
+	size_t depth;
+	size_t capacity;
+	bool failed;	///< the stack couldn't grow, nothing is written any more
+};
+
+struct oscap_xml_stream *oscap_xml_stream_new(const char *filename)
+{
+	struct oscap_xml_stream *stream = calloc(1, sizeof(struct oscap_xml_stream));
+	if (stream == NULL)
+		return NULL;
+	stream->fd = -1;
+
+	if (strcmp(filename, "-") == 0) {
+		stream->out = xmlOutputBufferCreateFilename(filename, NULL, 0);
+	}
+	else {
+#ifdef OS_WINDOWS
+		stream->fd = open(filename, O_CREAT|O_TRUNC|O_WRONLY, S_IREAD|S_IWRITE);
+#else
+		stream->fd = open(filename, O_CREAT|O_TRUNC|O_WRONLY,
+				S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
+#endif
+		if (stream->fd < 0) {
+			oscap_seterr(OSCAP_EFAMILY_GLIBC, "%s '%s'", strerror(errno), filename);
+			free(stream);
+			return NULL;
+		}
+		stream->out = xmlOutputBufferCreateFd(stream->fd, NULL);
+	}
+	if (stream->out == NULL) {
+		oscap_setxmlerr(xmlGetLastError());
+		dW("xmlOutputBufferCreateFile() failed.");
+		goto fail;
+	}
+
+	/* The writer takes the ownership of the output buffer */
+	stream->writer = xmlNewTextWriter(stream->out);
+	if (stream->writer == NULL) {
+		xmlOutputBufferClose(stream->out);
+		oscap_setxmlerr(xmlGetLastError());
+		goto fail;
+	}
+	if (xmlTextWriterStartDocument(stream->writer, NULL, "UTF-8", NULL) < 0) {
+		oscap_setxmlerr(xmlGetLastError());
+		xmlFreeTextWriter(stream->writer);
+		goto fail;
+	}
+	return stream;
+
+fail:
+	if (stream->fd >= 0)
+		close(stream->fd);
+	free(stream);
+	return NULL;
+}
+
+static void _oscap_xml_stream_indent(struct oscap_xml_stream *stream, size_t level)
+{
+	if (level > OSCAP_XML_STREAM_MAX_INDENT)
+		level = OSCAP_XML_STREAM_MAX_INDENT;
+	xmlTextWriterWriteRawLen(stream->writer, BAD_CAST OSCAP_XML_STREAM_INDENT, 1 + 2 * level);
+}
+
+static void _oscap_xml_stream_write_child(struct oscap_xml_stream *stream, xmlNode *child)
+{
+	/* Children are indented the same way as by xmlSaveFormatFileTo() */
+	_oscap_xml_stream_indent(stream, stream->depth);
+	stream->open[stream->depth - 1].empty = false;
+	xmlNodeDumpOutput(stream->out, child->doc, child, stream->depth, 1, "UTF-8");
+	xmlUnlinkNode(child);
+	xmlFreeNode(child);
+}
+
+static void _oscap_xml_stream_write_attribute(struct oscap_xml_stream *stream,
+					       const xmlChar *prefix, const xmlChar *name, const xmlChar *value)
+{
+	xmlChar *qname = xmlBuildQName(name, prefix, NULL, 0);
+	xmlTextWriterWriteAttribute(stream->writer, qname, value);
+	if (qname != name)
+		xmlFree(qname);
+}
+
+int oscap_xml_stream_start_element(struct oscap_xml_stream *stream, xmlNode *node)
+{
+	if (stream == NULL)
+		return 0;
+	if (stream->failed)
+		return -1;
+
+	if (stream->depth == stream->capacity) {
+		size_t capacity = stream->capacity ? 2 * stream->capacity : 8;
+		struct oscap_xml_stream_element *open = realloc(stream->open, capacity * sizeof(struct oscap_xml_stream_element));
+		if (open == NULL) {
+			oscap_seterr(OSCAP_EFAMILY_GLIBC, "%s", strerror(errno));
+			/* The elements which are left are freed with their document */
+			stream->failed = true;
+			return -1;
+		}
+		stream->open = open;
+		stream->capacity = capacity;
+	}
+
+	if (stream->depth > 0) {
+		/* The preceding siblings have to be written first */
+		xmlNode *child = stream->open[stream->depth - 1].node->children;
+		while (child != NULL && child != node) {
+			xmlNode *next = child->next;
+			_oscap_xml_stream_write_child(stream, child);
+			child = next;
+		}
+		_oscap_xml_stream_indent(stream, stream->depth);
+		stream->open[stream->depth - 1].empty = false;
+	}
+
+	const xmlChar *prefix = node->ns != NULL ? node->ns->prefix : NULL;
+	xmlChar *qname = xmlBuildQName(node->name, prefix, NULL, 0);
+	xmlTextWriterStartElement(stream->writer, qname);
+	if (qname != node->name)
+		xmlFree(qname);
+
+	for (xmlNs *ns = node->nsDef; ns != NULL; ns = ns->next) {
+		if (ns->prefix != NULL)
+			_oscap_xml_stream_write_attribute(stream, BAD_CAST "xmlns", ns->prefix, ns->href);
+		else
+			_oscap_xml_stream_write_attribute(stream, NULL, BAD_CAST "xmlns", ns->href);
+	}
+	for (xmlAttr *attr = node->properties; attr != NULL; attr = attr->next) {
+		xmlChar *value = xmlNodeGetContent((xmlNode *) attr);
+		_oscap_xml_stream_write_attribute(stream, attr->ns != NULL ? attr->ns->prefix : NULL,
+						  attr->name, value != NULL ? value : BAD_CAST "");
+		xmlFree(value);
+	}
+
+	stream->open[stream->depth].node = node;
+	stream->open[stream->depth].empty = true;
+	++stream->depth;
+
+	oscap_xml_stream_flush(stream);
+	return 0;
+}
+
+void oscap_xml_stream_flush(struct oscap_xml_stream *stream)
+{
+	if (stream == NULL || stream->failed || stream->depth == 0)
+		return;
+
+	xmlNode *child = stream->open[stream->depth - 1].node->children;
+	while (child != NULL) {
+		xmlNode *next = child->next;
+		_oscap_xml_stream_write_child(stream, child);
+		child = next;
+	}
+}
+
+void oscap_xml_stream_end_element(struct oscap_xml_stream *stream)
+{
+	if (stream == NULL || stream->failed || stream->depth == 0)
+		return;
+
+	oscap_xml_stream_flush(stream);
+	struct oscap_xml_stream_element *top = &stream->open[--stream->depth];
+	if (!top->empty)
+		_oscap_xml_stream_indent(stream, stream->depth);
+	/* Empty element is closed by "/>" */
+	xmlTextWriterEndElement(stream->writer);
+	xmlUnlinkNode(top->node);
+	xmlFreeNode(top->node);
+}
+
+int oscap_xml_stream_close(struct oscap_xml_stream *stream)
+{
+	if (stream == NULL)
+		return -1;
+
+	while (stream->depth > 0)
+		oscap_xml_stream_end_element(stream);
+
+	int ret = 1;
+	if (stream->failed) {
+		dW("Failed to write the XML document.");
+		ret = -1;
+	} else if (xmlTextWriterEndDocument(stream->writer) < 0 ||
+	    xmlTextWriterFlush(stream->writer) < 0 || stream->out->error != 0) {
+		oscap_setxmlerr(xmlGetLastError());
+		dW("Failed to write the XML document.");
+		ret = -1;
+	}
+	xmlFreeTextWriter(stream->writer);
+	if (stream->fd >= 0)
+		close(stream->fd);
+	free(stream->open);
+	free(stream);
+	return ret;
+}
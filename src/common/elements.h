@@ -78,4 +78,53 @@ int oscap_xml_save_filename_free(const char *filename, xmlDocPtr doc);
 
 xmlNs *lookup_xsi_ns(xmlDoc *doc);
 
+/*
+ * Streaming export of documents which are too large to be kept as DOM.
+ * The document is still built by the usual *_to_dom functions, but the
+ * subtrees are written and freed as soon as they're complete. Once the
+ * start tag of an element is written by oscap_xml_stream_start_element()
+ * the children appended to it are written by oscap_xml_stream_flush()
+ * and oscap_xml_stream_end_element(). The output is the same as the one
+ * of oscap_xml_save_filename() for the whole document.
+ *
+ * The namespaces of an element have to be declared before its start tag
+ * is written. All the functions accept NULL stream and do nothing then,
+ * so that the same code builds the whole DOM when no stream is given.
+ */
+struct oscap_xml_stream;
+
+/**
+ * Start writing a document to the file of the given filename.
+ * @param filename path to the file, "-" for the standard output
+ * @return the stream or NULL on failure (oscap_seterr is set appropriatly).
+ */
+struct oscap_xml_stream *oscap_xml_stream_new(const char *filename);
+
+/**
+ * Write the start tag of the element and the children it already has.
+ * The element has to be the document root or the last child of the
+ * innermost element which has been started.
+ * @return 0 on success, -1 on failure (oscap_seterr is set appropriatly).
+ * After a failure the stream doesn't write nor free anything, the elements
+ * stay in their document and oscap_xml_stream_close() returns -1.
+ */
+int oscap_xml_stream_start_element(struct oscap_xml_stream *stream, xmlNode *node);
+
+/**
+ * Write and free the children of the innermost started element.
+ */
+void oscap_xml_stream_flush(struct oscap_xml_stream *stream);
+
+/**
+ * Write the rest of the children and the end tag of the innermost started
+ * element. The element is freed.
+ */
+void oscap_xml_stream_end_element(struct oscap_xml_stream *stream);
+
+/**
+ * End the elements which are still open, finish the document and dispose the stream.
+ * @return 1 on success, -1 on failure (oscap_seterr is set appropriatly).
+ */
+int oscap_xml_stream_close(struct oscap_xml_stream *stream);
+
 #endif
@@ -30,6 +30,8 @@
 #include <stdarg.h>
 
 #include "list.h"
+#include "MurmurHash3.h"
+
 static inline bool _oscap_iterator_has_more_internal(const struct oscap_iterator *it);
 
 struct oscap_list *oscap_list_new(void)
@@ -372,48 +374,91 @@ OSCAP_ITERATOR_REMOVE(oscap_stringlist, oscap_stringlist_free)
     /*OSCAP_ITERATOR_RESET(oscap_string)*/
 
 
-#define OSCAP_DEFAULT_HSIZE 389
-static inline unsigned int oscap_htable_hash(const char *str, size_t htable_size)
+#define OSCAP_DEFAULT_HSIZE 16
+#define OSCAP_HTABLE_SEED 0x5ca1ab1e
+// Marks an index slot of a detached item, the lookups continue behind it.
+#define OSCAP_HTABLE_DETACHED SIZE_MAX
+
+static inline uint32_t oscap_htable_hash(const char *str)
 {
-	unsigned h = 0;
-	unsigned char *p;
-	for (p = (unsigned char *)str; *p != '\0'; p++)
-		h = (97 * h) + *p;
-	return h % htable_size;
+	uint32_t h;
+	MurmurHash3_x86_32(str, (int)strlen(str), OSCAP_HTABLE_SEED, &h);
+	return h;
+}
+
+/*
+ * Build the index of the given size. The detached items are dropped from
+ * the array first, the order of the others is kept. This moves the items,
+ * so it must not happen while the table is iterated.
+ */
+static bool oscap_htable_rebuild(struct oscap_htable *htable, size_t hsize)
+{
+	size_t *index = calloc(hsize, sizeof(size_t));
+	struct oscap_htable_item *items = htable->items;
+	size_t i, n = 0;
+
+	if (index == NULL)
+		return false;
+
+	if (hsize != htable->hsize || htable->items == NULL) {
+		// the array never holds more items than 3/4 of the index
+		items = realloc(htable->items, (hsize / 4 * 3) * sizeof(struct oscap_htable_item));
+		if (items == NULL) {
+			free(index);
+			return false;
+		}
+	}
+
+	for (i = 0; i < htable->used; ++i) {
+		size_t slot;
+
+		if (items[i].key == NULL)
+			continue;
+		items[n] = items[i];
+		for (slot = items[n].hash & (hsize - 1); index[slot] != 0; slot = (slot + 1) & (hsize - 1))
+			;
+		index[slot] = ++n;
+	}
+
+	free(htable->index);
+	htable->index = index;
+	htable->items = items;
+	htable->hsize = hsize;
+	htable->used = n;
+	return true;
 }
 
 struct oscap_htable *oscap_htable_new1(oscap_compare_func cmp, size_t hsize)
 {
 	struct oscap_htable *t;
+	size_t size = 8;
     
     assert(hsize > 0);
 
-	t = malloc(sizeof(struct oscap_htable));
+	while (size / 4 * 3 < hsize)
+		size *= 2;
+
+	t = calloc(1, sizeof(struct oscap_htable));
 	if (t == NULL)
 		return NULL;
-	t->hsize = hsize;
-	t->itemcount = 0;
-	t->table = calloc(hsize, sizeof(struct oscap_htable_item *));
-	if (t->table == NULL) {
+	t->cmp = cmp;
+	if (!oscap_htable_rebuild(t, size)) {
 		free(t);
 		return NULL;
 	}
-	t->cmp = cmp;
 	return t;
 }
 
 struct oscap_htable * oscap_htable_clone(const struct oscap_htable * table, oscap_clone_func cloner)
 {
-	struct oscap_htable *t = oscap_htable_new();
+	struct oscap_htable *t = oscap_htable_new1(table->cmp, table->itemcount > 0 ? table->itemcount : 1);
 	if (t == NULL)
 		return NULL;
 
-	for (size_t i = 0; i < table->hsize; ++i) {
-		struct oscap_htable_item *item = table->table[i];
-		while (item != NULL) {
+	for (size_t i = 0; i < table->used; ++i) {
+		const struct oscap_htable_item *item = &table->items[i];
+		if (item->key != NULL)
 			oscap_htable_add(t, item->key, (void *) cloner(item->value));
-			item = item->next;
-		}
 	}
 	
 	return t;
@@ -433,67 +478,84 @@ struct oscap_htable *oscap_htable_new(void)
 	return oscap_htable_new1(oscap_htable_cmp, OSCAP_DEFAULT_HSIZE);
 }
 
-static struct oscap_htable_item *oscap_htable_lookup(struct oscap_htable *htable, const char *key)
+/*
+ * Find the index slot of the key.
+ * @return the slot or SIZE_MAX if the key isn't in the table
+ */
+static size_t oscap_htable_lookup(const struct oscap_htable *htable, const char *key, uint32_t hash)
 {
 	__attribute__nonnull__(htable);
-	if (key == NULL)
-		return NULL;
-	unsigned int hashcode = oscap_htable_hash(key, htable->hsize);
-	struct oscap_htable_item *htitem = htable->table[hashcode];
-	while (htitem != NULL) {
-		if (htable->cmp(htitem->key, key) == 0)
-			return htitem;
-		htitem = htitem->next;
+	size_t mask = htable->hsize - 1;
+	size_t slot;
+
+	for (slot = hash & mask; htable->index[slot] != 0; slot = (slot + 1) & mask) {
+		const struct oscap_htable_item *htitem;
+
+		if (htable->index[slot] == OSCAP_HTABLE_DETACHED)
+			continue;
+		htitem = &htable->items[htable->index[slot] - 1];
+		if (htitem->hash == hash && htable->cmp(htitem->key, key) == 0)
+			return slot;
 	}
-	return NULL;
+	return SIZE_MAX;
 }
 
 bool oscap_htable_add(struct oscap_htable * htable, const char *key, void *item)
 {
 	__attribute__nonnull__(htable);
-	/*
-	   unsigned int hashcode = oscap_htable_hash(key, htable->hsize);
-	   struct oscap_htable_item* htitem = htable->table[hashcode];
-	   while(htitem != NULL)
-	   {
-	   if( (*(htable->cmp))(htitem->key, key) == 0) return false;
-	   if(htitem->next == NULL) break;
-	   htitem = htitem->next;
-	   }
-	   // htitem points to the last item
-	 */
-	if (oscap_htable_lookup(htable, key) != NULL)
+	if (key == NULL)
+		return false;
+	uint32_t hash = oscap_htable_hash(key);
+	if (oscap_htable_lookup(htable, key, hash) != SIZE_MAX)
 		return false;
-	unsigned int hashcode = oscap_htable_hash(key, htable->hsize);
-	struct oscap_htable_item *newhtitem;
-	newhtitem = malloc(sizeof(struct oscap_htable_item));
+
+	if (htable->used + 1 > htable->hsize / 4 * 3) {
+		// reuse the slots of the detached items if there are enough of them
+		size_t hsize = htable->itemcount + 1 > htable->hsize / 2 ? htable->hsize * 2 : htable->hsize;
+		if (!oscap_htable_rebuild(htable, hsize))
+			return false;
+	}
+
+	size_t mask = htable->hsize - 1;
+	size_t slot;
+	for (slot = hash & mask; htable->index[slot] != 0 && htable->index[slot] != OSCAP_HTABLE_DETACHED; slot = (slot + 1) & mask)
+		;
+
+	struct oscap_htable_item *newhtitem = &htable->items[htable->used];
 	newhtitem->key = oscap_strdup(key);
 	newhtitem->value = item;
-	newhtitem->next = htable->table[hashcode];
-	htable->table[hashcode] = newhtitem;
+	newhtitem->hash = hash;
+	htable->index[slot] = ++htable->used;
 	htable->itemcount++;
 	return true;
 }
 
 void *oscap_htable_detach(struct oscap_htable *htable, const char *key)
 {
-	struct oscap_htable_item *htitem = oscap_htable_lookup(htable, key);
-	if (htitem) {
-		void *val = htitem->value;
-		free(htitem->key);
-		htitem->key = NULL;
-		htitem->value = NULL;
-		htable->itemcount--;
-		return val;
-	}
-	return NULL;
+	__attribute__nonnull__(htable);
+	if (key == NULL)
+		return NULL;
+	size_t slot = oscap_htable_lookup(htable, key, oscap_htable_hash(key));
+	if (slot == SIZE_MAX)
+		return NULL;
+
+	struct oscap_htable_item *htitem = &htable->items[htable->index[slot] - 1];
+	void *val = htitem->value;
+	free(htitem->key);
+	htitem->key = NULL;
+	htitem->value = NULL;
+	htable->index[slot] = OSCAP_HTABLE_DETACHED;
+	htable->itemcount--;
+	return val;
 }
 
 void *oscap_htable_get(struct oscap_htable *htable, const char *key)
 {
 	__attribute__nonnull__(htable);
-	struct oscap_htable_item *htitem = oscap_htable_lookup(htable, key);
-	return htitem ? htitem->value : NULL;
+	if (key == NULL)
+		return NULL;
+	size_t slot = oscap_htable_lookup(htable, key, oscap_htable_hash(key));
+	return slot != SIZE_MAX ? htable->items[htable->index[slot] - 1].value : NULL;
 }
 
 void oscap_print_depth(int);
@@ -505,37 +567,30 @@ void oscap_htable_dump(struct oscap_htable *htable, oscap_dump_func dumper, int
 		return;
 	}
 	printf(" (hash table, %u item%s)\n", (unsigned)htable->itemcount, (htable->itemcount == 1 ? "" : "s"));
-	int i;
-	for (i = 0; i < (int)htable->hsize; ++i) {
-		struct oscap_htable_item *item = htable->table[i];
-		while (item) {
-			oscap_print_depth(depth);
-			printf("'%s':\n", item->key);
-			dumper(item->value, depth + 1);
-			item = item->next;
-		}
+	for (size_t i = 0; i < htable->used; ++i) {
+		struct oscap_htable_item *item = &htable->items[i];
+		if (item->key == NULL)
+			continue;
+		oscap_print_depth(depth);
+		printf("'%s':\n", item->key);
+		dumper(item->value, depth + 1);
 	}
 }
 
 void oscap_htable_free(struct oscap_htable *htable, oscap_destruct_func destructor)
 {
 	if (htable) {
-		size_t ht;
-		struct oscap_htable_item *cur, *next;
-
-		for (ht = 0; ht < htable->hsize; ++ht) {
-			cur = htable->table[ht];
-			while (cur) {
-				next = cur->next;
-				free(cur->key);
-				if (destructor)
-					destructor(cur->value);
-				free(cur);
-				cur = next;
-			}
+		for (size_t i = 0; i < htable->used; ++i) {
+			struct oscap_htable_item *cur = &htable->items[i];
+			if (cur->key == NULL)
+				continue;
+			free(cur->key);
+			if (destructor)
+				destructor(cur->value);
 		}
 
-		free(htable->table);
+		free(htable->items);
+		free(htable->index);
 		free(htable);
 	}
 }
@@ -547,8 +602,7 @@ void oscap_htable_free0(struct oscap_htable *htable)
 
 struct oscap_htable_iterator {
 	struct oscap_htable *htable;	// Table we iterate through
-	struct oscap_htable_item *cur;	// The current item
-	size_t hpos;			// Line on which we are now
+	size_t pos;			// Position of the next item in the array
 };
 
 struct oscap_htable_iterator *
@@ -556,8 +610,7 @@ oscap_htable_iterator_new(struct oscap_htable *htable)
 {
 	struct oscap_htable_iterator *hit = calloc(1, sizeof(struct oscap_htable_iterator));
 	hit->htable = htable;
-	hit->cur = NULL;
-	hit->hpos = 0;
+	hit->pos = 0;
 	return hit;
 }
 
@@ -567,48 +620,20 @@ oscap_htable_iterator_has_more(struct oscap_htable_iterator *hit)
 	__attribute__nonnull__(hit);
 	if (hit->htable == NULL)
 		return false;
-	size_t i = hit->hpos;
-	if (hit->cur != NULL) {
-		if (hit->cur->next != NULL)
-			return true;
-		if (i + 1 >= hit->htable->hsize)
-			return false;
-		i++;
-	}
-	for (; i < hit->htable->hsize; i++) {
-		if (hit->htable->table[i] == NULL)
-			continue;
-		if (i != hit->hpos)
-			hit->hpos = i - 1;
-		return true;
-	}
-	hit->hpos = i;
-	return false;
+	while (hit->pos < hit->htable->used && hit->htable->items[hit->pos].key == NULL)
+		hit->pos++;
+	return hit->pos < hit->htable->used;
 }
 
 const struct oscap_htable_item *
 oscap_htable_iterator_next(struct oscap_htable_iterator *hit)
 {
 	__attribute__nonnull__(hit);
-	if (hit->cur != NULL) {
-		if (hit->cur->next != NULL) {
-			hit->cur = hit->cur->next;
-			return hit->cur;
-		}
-		if (hit->hpos + 1 >= hit->htable->hsize) {
-			assert(false);
-			return NULL;
-		}
-		hit->hpos++;
-	}
-	for (; hit->hpos < hit->htable->hsize; hit->hpos++) {
-		if (hit->htable->table[hit->hpos] == NULL)
-			continue;
-		hit->cur = hit->htable->table[hit->hpos];
-		return hit->cur;
+	if (!oscap_htable_iterator_has_more(hit)) {
+		assert(false); // no more item found
+		return NULL;
 	}
-	assert(false); // no more item found
-	return NULL;
+	return &hit->htable->items[hit->pos++];
 }
 
 const char *
@@ -639,8 +664,7 @@ void
 oscap_htable_iterator_reset(struct oscap_htable_iterator *hit)
 {
 	__attribute__nonnull__(hit);
-	hit->cur = NULL;
-	hit->hpos = 0;
+	hit->pos = 0;
 }
 
 void
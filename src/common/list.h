@@ -30,6 +30,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "util.h"
 #include "public/oscap.h"
@@ -169,23 +170,36 @@ void *oscap_list_find(struct oscap_list *list, void *what, oscap_cmp_func compar
 typedef int (*oscap_compare_func) (const char *, const char *);
 // Hash table item.
 struct oscap_htable_item {
-	struct oscap_htable_item *next;	// Next item.
-	char *key;		// Item key.
+	char *key;		// Item key, NULL if the item was detached.
 	void *value;		// Item value.
+	uint32_t hash;		// Hash of the key.
 };
 
-// Hash table.
+/*
+ * Hash table.
+ *
+ * The items are kept in an array in the order they were added and the keys
+ * are looked up through an open addressing index with linear probing. The
+ * index is doubled when it gets three quarters full, so the table can hold
+ * any number of items. Iterators return the items in the insertion order.
+ * The index is rebuilt by oscap_htable_add(), which also drops the detached
+ * items from the array, so adding items while the table is iterated is
+ * undefined.
+ */
 struct oscap_htable {
-	size_t hsize;		// Size of the hash table.
+	size_t hsize;		// Number of slots in the index, a power of two.
 	size_t itemcount;	// Number of elements in the hash table.
-	struct oscap_htable_item **table;	// The table itself.
+	size_t used;		// Number of items in the array, detached ones included.
+	struct oscap_htable_item *items;	// The items in the insertion order.
+	size_t *index;		// Position of the item in the array + 1, 0 if the slot is free.
 	oscap_compare_func cmp;	// Funcion used to compare keys (e.g. strcmp).
 };
 
 /*
  * Create a new hash table.
- * @param cmp Pointer to a function used as the key comparator.
- * @hsize Size of the hash table.
+ * @param cmp Pointer to a function used as the key comparator. Keys equal
+ * according to the function have to be equal strings.
+ * @hsize Number of items the table has room for initially, it grows as needed.
  * @internal
  * @return new hash table
  */
@@ -209,6 +223,8 @@ struct oscap_htable * oscap_htable_clone(const struct oscap_htable * table, osca
 
 /*
  * Add an item to the hash table.
+ * The item array may be compacted and moved, so the iterators of the table
+ * and the items they returned are invalid afterwards.
  * @return True on success, false if the key already exists.
  */
 bool oscap_htable_add(struct oscap_htable *htable, const char *key, void *item);
@@ -243,6 +259,8 @@ struct oscap_htable_iterator;
 
 /**
  * Create new iterator through hash table. No ordering is defined for items.
+ * The items can be detached during the iteration, but adding an item to
+ * the table while it is iterated is undefined.
  * @param htable Hash table to iterate through.
  * @return the iterator
  */
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pcre.h>
+#include "oval_cmp_regex_impl.h"
+
+static int test_match(const char *pattern, int options, const char *subject, int expected)
+{
+	struct oval_regex *re;
+	int ret;
+
+	re = oval_regex_get(pattern, options, NULL, NULL);
+	if (re == NULL) {
+		printf("\tFAIL\t%s\tcan't compile\n", pattern);
+		return 0;
+	}
+
+	ret = oval_regex_exec(re, subject, strlen(subject), NULL, 0) >= 0;
+	oval_regex_release(re);
+
+	printf("\t%s\t%s\t%s\t%d\n", ret == expected ? "PASS" : "FAIL", pattern, subject, ret);
+	return ret == expected;
+}
+
+int main(int argc, char *argv[])
+{
+	struct oval_regex *re1, *re2;
+	const char *err = NULL;
+	int errofs, i, retval = 0;
+	char pattern[32];
+
+	if (!test_match("^foo[0-9]+$", PCRE_UTF8, "foo42", 1) ||
+	    !test_match("^foo[0-9]+$", PCRE_UTF8, "foo", 0) ||
+	    !test_match("^FOO$", PCRE_CASELESS, "foo", 1) ||
+	    !test_match("^FOO$", 0, "foo", 0))
+		retval = 1;
+
+	/* The same pattern with the same options is shared */
+	re1 = oval_regex_get("^bar$", 0, NULL, NULL);
+	re2 = oval_regex_get("^bar$", 0, NULL, NULL);
+	if (re1 == NULL || re1 != re2) {
+		printf("\tFAIL\tpattern not shared\n");
+		retval = 1;
+	}
+
+	/* A pattern in use survives its eviction */
+	for (i = 0; i < 2 * OVAL_REGEX_CACHE_SIZE; i++) {
+		snprintf(pattern, sizeof pattern, "^x%d$", i);
+		oval_regex_release(oval_regex_get(pattern, 0, NULL, NULL));
+	}
+	if (oval_regex_exec(re1, "bar", 3, NULL, 0) < 0) {
+		printf("\tFAIL\tevicted pattern doesn't match\n");
+		retval = 1;
+	}
+	oval_regex_release(re1);
+	oval_regex_release(re2);
+
+	if (oval_regex_get("(", 0, &err, &errofs) != NULL || err == NULL) {
+		printf("\tFAIL\tinvalid pattern compiled\n");
+		retval = 1;
+	}
+
+	return retval;
+}
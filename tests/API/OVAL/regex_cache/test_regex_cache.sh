@@ -0,0 +1,24 @@
+#!/usr/bin/env bash
+
+# Copyright 2018 Red Hat Inc., Durham, North Carolina.
+# All Rights Reserved.
+#
+# OpenScap Test Suite
+
+. $builddir/tests/test_common.sh
+
+# Test cases.
+
+function test_regex_cache {
+    ./test_regex_cache
+}
+
+# Testing.
+
+test_init
+
+if [ -z ${CUSTOM_OSCAP+x} ] ; then
+    test_run "test_regex_cache" test_regex_cache
+fi
+
+test_exit
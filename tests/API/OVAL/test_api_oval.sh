@@ -30,11 +30,24 @@ function test_api_oval_results {
     cmp $srcdir/results-good.xml exported-results.xml
 }
 
+function test_api_oval_results_stream {
+    # oval_results_model_export() streams the document, the output has to
+    # be the same as the one of the DOM built by oval_results_model_export_source()
+    ./test_api_results $srcdir/results.xml streamed-results.xml dom-results.xml || return 1
+    cmp dom-results.xml streamed-results.xml
+}
+
 function test_api_oval_directives {
     ./test_api_directives $srcdir/directives.xml exported-directives.xml
     cmp $srcdir/directives.xml exported-directives.xml
 }
 
+function test_api_oval_eval_threads {
+    # The environment variables are the items collected by eval_threads.xml
+    EVAL_THREADS_1=Hello EVAL_THREADS_2=Hi EVAL_THREADS_3=Hello EVAL_THREADS_4=Hey \
+	./test_api_oval_eval_threads $srcdir/eval_threads.xml
+}
+
 # Testing.
 
 test_init
@@ -43,7 +56,9 @@ if [ -z ${CUSTOM_OSCAP+x} ] ; then
     test_run "test_api_oval_definition" test_api_oval_definition
     test_run "test_api_oval_syschar" test_api_oval_syschar
     test_run "test_api_oval_results" test_api_oval_results
+    test_run "test_api_oval_results_stream" test_api_oval_results_stream
     test_run "test_api_oval_directives" test_api_oval_directives
+    test_run "test_api_oval_eval_threads" test_api_oval_eval_threads
 fi
 
 test_exit
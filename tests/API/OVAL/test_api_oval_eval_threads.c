@@ -0,0 +1,172 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Evaluate the same content serially and with several evaluation threads
+ * and check that the results of the definitions, the tests and the tested
+ * items are the same. The IDs and the order of the items depend on the
+ * collection, so only the count of the items with each result is compared.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oval_agent_api.h"
+#include "oval_definitions.h"
+#include "oval_results.h"
+#include "oscap.h"
+#include "oscap_source.h"
+
+#define FAIL(...)                                             \
+        do {                                                  \
+                fprintf (stderr, "FAIL: " __VA_ARGS__);       \
+                exit (1);                                     \
+        } while (0)
+
+#define TEST_THREADS 4
+#define TEST_ROUNDS  8
+
+static const oval_result_t item_results[] = {
+	OVAL_RESULT_TRUE,
+	OVAL_RESULT_FALSE,
+	OVAL_RESULT_UNKNOWN,
+	OVAL_RESULT_ERROR,
+	OVAL_RESULT_NOT_EVALUATED,
+	OVAL_RESULT_NOT_APPLICABLE
+};
+
+#define ITEM_RESULT_CNT (sizeof item_results / sizeof item_results[0])
+
+static void dump_system(FILE *fp, struct oval_result_system *rsystem)
+{
+	struct oval_result_definition_iterator *rdef_it;
+	struct oval_result_test_iterator *rtest_it;
+
+	rdef_it = oval_result_system_get_definitions(rsystem);
+	while (oval_result_definition_iterator_has_more(rdef_it)) {
+		struct oval_result_definition *rdef = oval_result_definition_iterator_next(rdef_it);
+
+		fprintf(fp, "definition %s %s\n", oval_result_definition_get_id(rdef),
+			oval_result_get_text(oval_result_definition_get_result(rdef)));
+	}
+	oval_result_definition_iterator_free(rdef_it);
+
+	rtest_it = oval_result_system_get_tests(rsystem);
+	while (oval_result_test_iterator_has_more(rtest_it)) {
+		struct oval_result_test *rtest = oval_result_test_iterator_next(rtest_it);
+		struct oval_result_item_iterator *ritem_it;
+		unsigned int count[ITEM_RESULT_CNT] = { 0 };
+		size_t i;
+
+		fprintf(fp, "test %s %s", oval_test_get_id(oval_result_test_get_test(rtest)),
+			oval_result_get_text(oval_result_test_get_result(rtest)));
+
+		ritem_it = oval_result_test_get_items(rtest);
+		while (oval_result_item_iterator_has_more(ritem_it)) {
+			struct oval_result_item *ritem = oval_result_item_iterator_next(ritem_it);
+			oval_result_t result = oval_result_item_get_result(ritem);
+
+			for (i = 0; i < ITEM_RESULT_CNT; ++i) {
+				if (item_results[i] == result)
+					++count[i];
+			}
+		}
+		oval_result_item_iterator_free(ritem_it);
+
+		for (i = 0; i < ITEM_RESULT_CNT; ++i) {
+			if (count[i] > 0)
+				fprintf(fp, " %s:%u", oval_result_get_text(item_results[i]), count[i]);
+		}
+		fputc('\n', fp);
+	}
+	oval_result_test_iterator_free(rtest_it);
+}
+
+/* Evaluate the content and return the dump of its results */
+static char *eval_content(const char *path, unsigned int threads)
+{
+	struct oscap_source *source;
+	struct oval_definition_model *def_model;
+	oval_agent_session_t *session;
+	struct oval_result_system_iterator *rsystem_it;
+	char *dump = NULL;
+	size_t dump_len = 0;
+	FILE *fp;
+
+	source = oscap_source_new_from_file(path);
+	def_model = oval_definition_model_import_source(source);
+	if (def_model == NULL)
+		FAIL("Can't import \"%s\"\n", path);
+
+	session = oval_agent_new_session(def_model, "eval_threads");
+	if (session == NULL)
+		FAIL("oval_agent_new_session\n");
+
+	oval_agent_set_eval_threads(session, threads);
+	if (oval_agent_eval_system(session, NULL, NULL) != 0)
+		FAIL("oval_agent_eval_system with %u threads\n", threads);
+
+	fp = open_memstream(&dump, &dump_len);
+	if (fp == NULL)
+		FAIL("open_memstream\n");
+
+	rsystem_it = oval_results_model_get_systems(oval_agent_get_results_model(session));
+	while (oval_result_system_iterator_has_more(rsystem_it))
+		dump_system(fp, oval_result_system_iterator_next(rsystem_it));
+	oval_result_system_iterator_free(rsystem_it);
+	fclose(fp);
+
+	oval_agent_destroy_session(session);
+	oval_definition_model_free(def_model);
+	oscap_source_free(source);
+
+	return dump;
+}
+
+int main(int argc, char **argv)
+{
+	char *serial, *parallel;
+	int i;
+
+	if (argc != 2)
+		FAIL("Usage: %s <oval-definitions>\n", argv[0]);
+
+	serial = eval_content(argv[1], 1);
+	if (strstr(serial, "test ") == NULL)
+		FAIL("No test was evaluated:\n%s", serial);
+
+	/* The order of the evaluation differs in every round */
+	for (i = 0; i < TEST_ROUNDS; ++i) {
+		parallel = eval_content(argv[1], TEST_THREADS);
+
+		if (strcmp(serial, parallel) != 0)
+			FAIL("The results differ in round %d.\nSerial:\n%s\nParallel:\n%s", i, serial, parallel);
+		free(parallel);
+	}
+
+	free(serial);
+	oscap_cleanup();
+
+	return 0;
+}
@@ -4,6 +4,7 @@
 #endif
 
 #include <sexp.h>
+#include <sexp-ID.h>
 #include <string.h>
 #include <inttypes.h>
 
@@ -149,6 +150,34 @@ int main (void)
 	TESTCMP(cmp_l4, cmp_l3, true);
 	TESTCMP(cmp_l3, cmp_l4, true);
 
+	/* the same once the hashes of the strings are cached */
+	if (SEXP_ID_v(cmp_l3) != SEXP_ID_v(cmp_l4) ||
+	    SEXP_ID_v(cmp_l1) == SEXP_ID_v(cmp_l2))
+		return (1);
+	SEXP_ID_v(cmp_l1);
+
+	TESTCMP(cmp_l1, cmp_l2, false);
+	TESTCMP(cmp_l2, cmp_l3, false);
+	TESTCMP(cmp_l4, cmp_l3, true);
+
+	{
+		SEXP_t *s1 = SEXP_string_newf("abcd");
+		SEXP_t *s2 = SEXP_string_newf("abce");
+		SEXP_t *s3 = SEXP_string_newf("abcd");
+
+		TESTCMP(s1, s2, false);
+		SEXP_ID_v(s1);
+		SEXP_ID_v(s2);
+		TESTCMP(s1, s2, false);
+		TESTCMP(s1, s3, true);
+		SEXP_ID_v(s3);
+		TESTCMP(s3, s1, true);
+
+		SEXP_free(s1);
+		SEXP_free(s2);
+		SEXP_free(s3);
+	}
+
 	SEXP_free(cmp_l1);
 	SEXP_free(cmp_l2);
 	SEXP_free(cmp_l3);
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sexp.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define ITEM_COUNT 1000
+
+int main (void)
+{
+	SEXP_t *list, *copy, *str, *num;
+	size_t base, used;
+
+	setbuf (stdout, NULL);
+
+	base = SEXP_memusage();
+	list = SEXP_list_new(NULL);
+
+	for (int i = 0; i < ITEM_COUNT; ++i) {
+		str = SEXP_string_newf("item_%d_with_some_longer_value", i);
+		num = SEXP_number_newu(i);
+		SEXP_list_add(list, str);
+		SEXP_list_add(list, num);
+		SEXP_free(str);
+		SEXP_free(num);
+	}
+
+	used = SEXP_memusage();
+	if (used < base + ITEM_COUNT * strlen("item_0_with_some_longer_value")) {
+		printf("memory usage didn't grow: base=%zu, used=%zu\n", base, used);
+		return (1);
+	}
+
+	/* A reference doesn't allocate the values again */
+	copy = SEXP_ref(list);
+	if (SEXP_memusage() != used) {
+		printf("reference changed the memory usage: %zu != %zu\n", SEXP_memusage(), used);
+		return (1);
+	}
+	SEXP_free(copy);
+	SEXP_free(list);
+
+	if (SEXP_memusage() != base) {
+		printf("memory usage isn't back at the base: base=%zu, current=%zu\n", base, SEXP_memusage());
+		return (1);
+	}
+
+	return (0);
+}
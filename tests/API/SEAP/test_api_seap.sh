@@ -40,9 +40,11 @@ if [ -z ${CUSTOM_OSCAP+x} ] ; then
     test_run "test_api_seap_concurency"           test_api_seap_concurency
     test_run "test_api_seap_spb"                  ./test_api_seap_spb
     test_run "test_api_seap_list"                 ./test_api_seap_list
+    test_run "test_api_seap_ring"                 ./test_api_seap_ring
     test_run "test_api_seap_number_expression"    ./test_api_seap_number
     test_run "test_api_seap_string_expression"    ./test_api_seap_string
     test_run "test_api_SEXP_deepcmp"              ./test_api_SEXP_deepcmp
+    test_run "test_api_SEXP_memusage"             ./test_api_SEXP_memusage
     test_run "test_api_strto"                     ./test_api_strto
 fi
 
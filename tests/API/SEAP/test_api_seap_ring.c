@@ -0,0 +1,200 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Check that the SEAP queue schemes deliver all the packets in order and
+ * compare the throughput of SCH_QUEUE with SCH_RING. Both runs go through
+ * sch_queue_sendpacket() and sch_queue_recvpacket(), the producers act as
+ * the probe and the consumer as the library side of the descriptor.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "sch_queue.h"
+#include "../probe/probe_main.h"
+
+#ifndef TEST_MSG_COUNT
+#define TEST_MSG_COUNT 1000000
+#endif
+
+#ifndef TEST_PRODUCER_COUNT
+#define TEST_PRODUCER_COUNT 2
+#endif
+
+/*
+ * sch_queue_connect() starts the probe thread, the descriptor is set up
+ * by hand here, so this is never called.
+ */
+void *probe_common_main(void *arg)
+{
+	abort();
+	return NULL;
+}
+
+struct bench {
+	SEAP_desc_t desc;
+	sch_queuedata_t data;
+	pthread_mutex_t w_lock; /* serializes the producers like the descriptor write lock */
+};
+
+struct producer_arg {
+	struct bench *bench;
+	uintptr_t id;
+};
+
+static void *producer(void *arg)
+{
+	struct producer_arg *parg = (struct producer_arg *)arg;
+	struct bench *b = parg->bench;
+	uintptr_t i;
+
+	for (i = 1; i <= TEST_MSG_COUNT / TEST_PRODUCER_COUNT; ++i) {
+		/* message = producer id in the top bits, sequence number in the rest */
+		SEAP_packet_t *msg = (SEAP_packet_t *)((parg->id << 24) | i);
+
+		pthread_mutex_lock(&b->w_lock);
+		if (sch_queue_sendpacket(&b->desc, msg) != 0)
+			abort();
+		pthread_mutex_unlock(&b->w_lock);
+	}
+
+	return NULL;
+}
+
+static void bench_init(struct bench *b, SEAP_scheme_t scheme)
+{
+	sch_queuedata_t *data = &b->data;
+
+	memset(b, 0, sizeof(struct bench));
+	data->scheme = scheme;
+	data->serialize = false;
+	/* the consumer runs in this thread, the producers are the "probe" */
+	data->parent_thread_id = pthread_self();
+
+	if (scheme == SCH_RING) {
+		data->to_probe_ring = spsc_ring_new();
+		data->from_probe_ring = spsc_ring_new();
+		if (data->to_probe_ring == NULL || data->from_probe_ring == NULL)
+			abort();
+	} else {
+		data->to_probe_queue = oscap_queue_new();
+		data->from_probe_queue = oscap_queue_new();
+		pthread_cond_init(&data->to_probe_cond, NULL);
+		pthread_mutex_init(&data->to_probe_mutex, NULL);
+		pthread_cond_init(&data->from_probe_cond, NULL);
+		pthread_mutex_init(&data->from_probe_mutex, NULL);
+	}
+
+	b->desc.scheme = scheme;
+	b->desc.scheme_data = data;
+	pthread_mutex_init(&b->w_lock, NULL);
+}
+
+static void bench_free(struct bench *b)
+{
+	sch_queuedata_t *data = &b->data;
+
+	if (data->scheme == SCH_RING) {
+		if (spsc_ring_trypop(data->from_probe_ring) != NULL) {
+			fprintf(stderr, "The ring isn't empty\n");
+			exit(1);
+		}
+		spsc_ring_free(data->to_probe_ring, NULL);
+		spsc_ring_free(data->from_probe_ring, NULL);
+	} else {
+		if (data->from_probe_cnt != 0) {
+			fprintf(stderr, "The queue isn't empty\n");
+			exit(1);
+		}
+		oscap_queue_free(data->to_probe_queue, NULL);
+		oscap_queue_free(data->from_probe_queue, NULL);
+		pthread_cond_destroy(&data->to_probe_cond);
+		pthread_mutex_destroy(&data->to_probe_mutex);
+		pthread_cond_destroy(&data->from_probe_cond);
+		pthread_mutex_destroy(&data->from_probe_mutex);
+	}
+	pthread_mutex_destroy(&b->w_lock);
+}
+
+static double run(SEAP_scheme_t scheme)
+{
+	struct bench b;
+	struct producer_arg parg[TEST_PRODUCER_COUNT];
+	pthread_t th[TEST_PRODUCER_COUNT];
+	uintptr_t last[TEST_PRODUCER_COUNT] = { 0 };
+	struct timeval t0, t1;
+	int i, n;
+
+	bench_init(&b, scheme);
+
+	gettimeofday(&t0, NULL);
+
+	for (i = 0; i < TEST_PRODUCER_COUNT; ++i) {
+		parg[i].bench = &b;
+		parg[i].id = i;
+		if (pthread_create(&th[i], NULL, producer, &parg[i]) != 0)
+			abort();
+	}
+
+	n = (TEST_MSG_COUNT / TEST_PRODUCER_COUNT) * TEST_PRODUCER_COUNT;
+
+	for (i = 0; i < n; ++i) {
+		uintptr_t msg = (uintptr_t)sch_queue_recvpacket(&b.desc);
+		uintptr_t id = msg >> 24;
+		uintptr_t seq = msg & 0xffffff;
+
+		if (id >= TEST_PRODUCER_COUNT || seq != last[id] + 1) {
+			fprintf(stderr, "Unexpected message: producer=%lu, seq=%lu, expected=%lu\n",
+				(unsigned long)id, (unsigned long)seq, (unsigned long)(last[id] + 1));
+			exit(1);
+		}
+		last[id] = seq;
+	}
+
+	gettimeofday(&t1, NULL);
+
+	for (i = 0; i < TEST_PRODUCER_COUNT; ++i)
+		pthread_join(th[i], NULL);
+
+	bench_free(&b);
+
+	return n / (((double)t1.tv_sec + (double)t1.tv_usec / 1000000.0) -
+		    ((double)t0.tv_sec + (double)t0.tv_usec / 1000000.0));
+}
+
+int main(void)
+{
+	double queue_rate, ring_rate;
+
+	queue_rate = run(SCH_QUEUE);
+	ring_rate = run(SCH_RING);
+
+	printf("queue: %.0f msg/s\n", queue_rate);
+	printf("ring:  %.0f msg/s\n", ring_rate);
+
+	return 0;
+}
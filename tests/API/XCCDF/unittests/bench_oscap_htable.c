@@ -0,0 +1,191 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/*
+ * Time oscap_htable against the fixed size chained table it replaced.
+ * Every key is added once and looked up BENCH_GET_COUNT times. This is
+ * a benchmark, it isn't run by the test suite.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "common/list.h"
+#include "common/util.h"
+#include "oscap_helpers.h"
+
+#ifndef BENCH_KEY_COUNT
+#define BENCH_KEY_COUNT 100000
+#endif
+
+#ifndef BENCH_GET_COUNT
+#define BENCH_GET_COUNT 10
+#endif
+
+/*
+ * The previous oscap_htable: 389 buckets of chained items
+ */
+#define CHAINED_HSIZE 389
+
+struct chained_item {
+	struct chained_item *next;
+	char *key;
+	void *value;
+};
+
+struct chained_table {
+	struct chained_item *table[CHAINED_HSIZE];
+};
+
+static unsigned int chained_hash(const char *str)
+{
+	unsigned h = 0;
+	unsigned char *p;
+	for (p = (unsigned char *)str; *p != '\0'; p++)
+		h = (97 * h) + *p;
+	return h % CHAINED_HSIZE;
+}
+
+static struct chained_item *chained_lookup(struct chained_table *t, const char *key)
+{
+	struct chained_item *item = t->table[chained_hash(key)];
+
+	while (item != NULL) {
+		if (strcmp(item->key, key) == 0)
+			return item;
+		item = item->next;
+	}
+	return NULL;
+}
+
+static bool chained_add(struct chained_table *t, const char *key, void *value)
+{
+	unsigned int hashcode;
+	struct chained_item *item;
+
+	if (chained_lookup(t, key) != NULL)
+		return false;
+	hashcode = chained_hash(key);
+	item = malloc(sizeof(struct chained_item));
+	item->key = oscap_strdup(key);
+	item->value = value;
+	item->next = t->table[hashcode];
+	t->table[hashcode] = item;
+	return true;
+}
+
+static void *chained_get(struct chained_table *t, const char *key)
+{
+	struct chained_item *item = chained_lookup(t, key);
+	return item ? item->value : NULL;
+}
+
+static void chained_free(struct chained_table *t)
+{
+	int i;
+
+	for (i = 0; i < CHAINED_HSIZE; ++i) {
+		struct chained_item *item = t->table[i];
+
+		while (item != NULL) {
+			struct chained_item *next = item->next;
+			free(item->key);
+			free(item);
+			item = next;
+		}
+	}
+	free(t);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static double bench_chained(char **keys)
+{
+	struct chained_table *t = calloc(1, sizeof(struct chained_table));
+	double t0 = now();
+	int i, j;
+
+	for (i = 0; i < BENCH_KEY_COUNT; ++i)
+		chained_add(t, keys[i], keys[i]);
+	for (j = 0; j < BENCH_GET_COUNT; ++j) {
+		for (i = 0; i < BENCH_KEY_COUNT; ++i) {
+			if (chained_get(t, keys[i]) != keys[i])
+				abort();
+		}
+	}
+
+	t0 = now() - t0;
+	chained_free(t);
+	return t0;
+}
+
+static double bench_htable(char **keys)
+{
+	struct oscap_htable *t = oscap_htable_new();
+	double t0 = now();
+	int i, j;
+
+	for (i = 0; i < BENCH_KEY_COUNT; ++i)
+		oscap_htable_add(t, keys[i], keys[i]);
+	for (j = 0; j < BENCH_GET_COUNT; ++j) {
+		for (i = 0; i < BENCH_KEY_COUNT; ++i) {
+			if (oscap_htable_get(t, keys[i]) != keys[i])
+				abort();
+		}
+	}
+
+	t0 = now() - t0;
+	oscap_htable_free0(t);
+	return t0;
+}
+
+int main(void)
+{
+	char **keys = malloc(sizeof(char *) * BENCH_KEY_COUNT);
+	double chained, htable;
+	int i;
+
+	for (i = 0; i < BENCH_KEY_COUNT; ++i)
+		keys[i] = oscap_sprintf("xccdf_org.ssgproject.content_rule_%d", i);
+
+	chained = bench_chained(keys);
+	htable = bench_htable(keys);
+
+	printf("%d keys, 1 add and %d gets per key\n", BENCH_KEY_COUNT, BENCH_GET_COUNT);
+	printf("chained: %.2f s\n", chained);
+	printf("htable:  %.2f s\n", htable);
+
+	for (i = 0; i < BENCH_KEY_COUNT; ++i)
+		free(keys[i]);
+	free(keys);
+
+	return 0;
+}
@@ -233,6 +233,90 @@ static void _test_hit_multiple_items1(void)
 	oscap_htable_free0(h);
 }
 
+static void *_htable_clone_value(void *value)
+{
+	return value;
+}
+static void _test_htable_order(void)
+{
+	struct oscap_htable *h = oscap_htable_new1(_htable_cmp, 1);
+	for (int i = 0; i < 1000; i++) {
+		char key[12];
+		snprintf(key, 12, "%d", i);
+		oscap_assert(oscap_htable_add(h, key, NULL));
+	}
+	oscap_assert(!oscap_htable_add(h, "500", NULL));
+
+	/* the items come in the order they were added */
+	struct oscap_htable_iterator *hit = oscap_htable_iterator_new(h);
+	int i = 0;
+	while (oscap_htable_iterator_has_more(hit)) {
+		char key[12];
+		snprintf(key, 12, "%d", i++);
+		oscap_assert(strcmp(oscap_htable_iterator_next_key(hit), key) == 0);
+	}
+	oscap_assert(i == 1000);
+	oscap_htable_iterator_free(hit);
+	oscap_htable_free0(h);
+}
+
+static void _test_htable_detach(void)
+{
+	static const char *values[] = { "a", "b", "c" };
+	struct oscap_htable *h = oscap_htable_new();
+	oscap_assert(oscap_htable_add(h, "a", (char *) values[0]));
+	oscap_assert(oscap_htable_add(h, "b", (char *) values[1]));
+	oscap_assert(oscap_htable_add(h, "c", (char *) values[2]));
+
+	oscap_assert(oscap_htable_detach(h, "b") == values[1]);
+	oscap_assert(oscap_htable_detach(h, "b") == NULL);
+	oscap_assert(oscap_htable_get(h, "b") == NULL);
+	oscap_assert(oscap_htable_get(h, "c") == values[2]);
+
+	/* detached items are skipped and re-added ones go last */
+	oscap_assert(oscap_htable_add(h, "b", (char *) values[1]));
+	struct oscap_htable_iterator *hit = oscap_htable_iterator_new(h);
+	oscap_assert(strcmp(oscap_htable_iterator_next_key(hit), "a") == 0);
+	oscap_assert(strcmp(oscap_htable_iterator_next_key(hit), "c") == 0);
+	oscap_assert(strcmp(oscap_htable_iterator_next_key(hit), "b") == 0);
+	oscap_assert(!oscap_htable_iterator_has_more(hit));
+	oscap_htable_iterator_free(hit);
+
+	/* the slots of the detached items are reused */
+	size_t hsize = h->hsize;
+	for (int i = 0; i < 10000; i++) {
+		oscap_assert(oscap_htable_detach(h, "a") == values[0]);
+		oscap_assert(oscap_htable_add(h, "a", (char *) values[0]));
+	}
+	oscap_assert(h->itemcount == 3);
+	oscap_assert(h->hsize == hsize);
+	oscap_htable_free0(h);
+}
+
+#define HTABLE_LARGE_LEN 100000
+
+static void _test_htable_large(void)
+{
+	struct oscap_htable *h = oscap_htable_new();
+	char key[32];
+	for (intptr_t i = 0; i < HTABLE_LARGE_LEN; i++) {
+		snprintf(key, sizeof(key), "xccdf_org.example_rule_%ld", (long) i);
+		oscap_assert(oscap_htable_add(h, key, (void *) i));
+	}
+	oscap_assert(h->itemcount == HTABLE_LARGE_LEN);
+	for (intptr_t i = 0; i < HTABLE_LARGE_LEN; i++) {
+		snprintf(key, sizeof(key), "xccdf_org.example_rule_%ld", (long) i);
+		oscap_assert(oscap_htable_get(h, key) == (void *) i);
+	}
+	oscap_assert(oscap_htable_get(h, "xccdf_org.example_rule_") == NULL);
+
+	struct oscap_htable *c = oscap_htable_clone(h, (oscap_clone_func) _htable_clone_value);
+	oscap_assert(c->itemcount == HTABLE_LARGE_LEN);
+	oscap_assert(oscap_htable_get(c, "xccdf_org.example_rule_4242") == (void *) 4242);
+	oscap_htable_free0(c);
+	oscap_htable_free0(h);
+}
+
 static bool _test_list_remove_ptreq(void *a, void *b)
 {
 	return a == b;
@@ -327,6 +411,9 @@ int main(int argc, char *argv[])
 	_test_hit_empty1();
 	_test_hit_single_item1();
 	_test_hit_multiple_items1();
+	_test_htable_order();
+	_test_htable_detach();
+	_test_htable_large();
 
 	_test_list_remove();
 
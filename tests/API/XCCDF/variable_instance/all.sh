@@ -666,6 +666,58 @@ function xccdf_eval_1_multiset_syschar(){
 	done
 }
 
+#
+# Evaluate XCCDF where a changed value creates a new variable instance of
+# a definition with two objects. Only the object which depends on the
+# variable is collected again, the other one stays cached.
+#
+function xccdf_eval_dependent_only(){
+	local oval_result="dependent_only-oval.xml.result.xml"
+	local xccdf_result=$(mktemp -t ${FUNCNAME}.xml.XXXXXX)
+	local stderr=$(mktemp -t ${FUNCNAME}.err.XXXXXX)
+	local log=$(mktemp -t ${FUNCNAME}.log.XXXXXX)
+	local profile="xccdf_moc.elpmaxe.www_profile_12"
+	local file300="testing_file_300x.xml"
+	local file600="testing_file_600x.xml"
+	local tested_file="testing_file.xml"
+	echo "Stderr file = $stderr"
+
+	cp $srcdir/testing_file_300.xml $file300
+	cp $srcdir/testing_file_600.xml $file600
+	cp $srcdir/testing_file_300.xml $tested_file
+	[ ! -f $oval_result ] || rm $oval_result
+
+	$OSCAP --verbose INFO --verbose-log-file $log xccdf eval --profile $profile \
+		--oval-results --results $xccdf_result \
+		$srcdir/test_xccdf_variable_instance.xccdf.xml 2> $stderr
+	[ -f $stderr ]; [ ! -s $stderr ]
+	$OSCAP oval validate --schematron $oval_result
+	local result="$xccdf_result"
+	assert_exists 2 '/Benchmark/TestResult/rule-result/result[text()="pass"]'
+	result="$oval_result"
+	assert_exists 3 '/oval_results/results/system/oval_system_characteristics/system_data/ind-sys:xmlfilecontent_item'
+	assert_exists 1 '/oval_results/results/system/oval_system_characteristics/system_data/ind-sys:xmlfilecontent_item/ind-sys:filename[text()="'$file300'"]'
+	assert_exists 1 '/oval_results/results/system/oval_system_characteristics/system_data/ind-sys:xmlfilecontent_item/ind-sys:filename[text()="'$file600'"]'
+	assert_exists 1 '/oval_results/results/system/oval_system_characteristics/system_data/ind-sys:xmlfilecontent_item/ind-sys:filename[text()="'$tested_file'"]'
+	assert_exists 2 '/oval_results/results/system/oval_system_characteristics/collected_objects/object[@id="oval:com.example.www:obj:1"]'
+	assert_exists 1 '/oval_results/results/system/oval_system_characteristics/collected_objects/object[@id="oval:com.example.www:obj:1" and @variable_instance="1"]'
+	assert_exists 1 '/oval_results/results/system/oval_system_characteristics/collected_objects/object[@id="oval:com.example.www:obj:1" and @variable_instance="2"]'
+	assert_exists 1 '/oval_results/results/system/oval_system_characteristics/collected_objects/object[@id="oval:com.example.www:obj:2"]'
+	assert_exists 2 '/oval_results/results/system/definitions/definition[@definition_id="oval:com.example.www:def:1" and @result="true"]'
+	# The unrelated object is collected once and then taken from the cache
+	[ $(grep -c "Creating new syschar for xmlfilecontent_object 'oval:com.example.www:obj:2'" $log) -eq 1 ]
+	grep -q "System characteristics for xmlfilecontent_object 'oval:com.example.www:obj:2' already exist" $log
+	[ $(grep -c "Creating new syschar for xmlfilecontent_object 'oval:com.example.www:obj:1'" $log) -eq 1 ]
+	[ $(grep -c "Creating another syschar for variable_instance=2" $log) -eq 1 ]
+	rm $stderr
+	rm $log
+	rm $xccdf_result
+	rm $oval_result
+	for f in $file300 $file600 $tested_file; do
+		chmod u+w $f ; rm $f
+	done
+}
+
 test_init test_api_xccdf_variable_instance.log
 
 test_run "Export from XCCDF to variables: 1x2 values (multival)" xccdf_export_1_multival
@@ -681,5 +733,6 @@ test_run "Export from XCCDF to variables: 3x3 the last is subset (multiset,multi
 
 test_run "Evaluate XCCDF: 2x1 values (multiset)" xccdf_eval_2_multiset
 test_run "Evaluate XCCDF: 2x1 values (multiset) in syschar" xccdf_eval_1_multiset_syschar
+test_run "Evaluate XCCDF: new variable instance collects only dependent objects" xccdf_eval_dependent_only
 
 test_exit
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/*
+ * Add, get and delete items in the probe result cache. Every call takes
+ * the lock of the tree, so a path which doesn't release it makes the next
+ * call hang; the alarm turns that into a failure.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <seap.h>
+#include "rcache.h"
+
+#define FAIL(...)                                             \
+        do {                                                  \
+                fprintf (stderr, "FAIL: " __VA_ARGS__);       \
+                exit (1);                                     \
+        } while (0)
+
+#define TEST_ID_COUNT 1000
+#define TEST_TIMEOUT  60
+
+static void test_id(char *buf, size_t size, int i)
+{
+	snprintf(buf, size, "oval:org.open-scap.test:obj:%d", i);
+}
+
+static void test_check(probe_rcache_t *cache, const bool *present)
+{
+	char id[64];
+
+	for (int i = 0; i < TEST_ID_COUNT; ++i) {
+		SEXP_t *item;
+
+		test_id(id, sizeof id, i);
+		item = probe_rcache_cstr_get(cache, id);
+
+		if (!present[i]) {
+			if (item != NULL)
+				FAIL("%s: deleted item found\n", id);
+			continue;
+		}
+
+		if (item == NULL)
+			FAIL("%s: item not found\n", id);
+		if (SEXP_number_geti_32(item) != i)
+			FAIL("%s: wrong item %d\n", id, SEXP_number_geti_32(item));
+		SEXP_free(item);
+	}
+}
+
+int main(void)
+{
+	probe_rcache_t *cache;
+	bool present[TEST_ID_COUNT];
+	char id[64];
+	int i;
+
+	alarm(TEST_TIMEOUT);
+
+	cache = probe_rcache_new();
+	if (cache == NULL)
+		FAIL("probe_rcache_new\n");
+
+	if (probe_rcache_cstr_del(cache, "missing") != -1)
+		FAIL("deleted a missing item from an empty cache\n");
+
+	for (i = 0; i < TEST_ID_COUNT; ++i) {
+		SEXP_t *sid, *item;
+
+		test_id(id, sizeof id, i);
+		sid  = SEXP_string_new(id, strlen(id));
+		item = SEXP_number_newi_32(i);
+
+		if (probe_rcache_sexp_add(cache, sid, item) != 0)
+			FAIL("%s: add\n", id);
+		if (probe_rcache_sexp_add(cache, sid, item) == 0)
+			FAIL("%s: added twice\n", id);
+
+		SEXP_free(item);
+		SEXP_free(sid);
+		present[i] = true;
+	}
+	test_check(cache, present);
+
+	/* Delete every third item, the S-exp and C string ids alternately */
+	for (i = 0; i < TEST_ID_COUNT; i += 3) {
+		int r;
+
+		test_id(id, sizeof id, i);
+		if (i % 2) {
+			SEXP_t *sid = SEXP_string_new(id, strlen(id));
+
+			r = probe_rcache_sexp_del(cache, sid);
+			SEXP_free(sid);
+		} else {
+			r = probe_rcache_cstr_del(cache, id);
+		}
+
+		if (r != 0)
+			FAIL("%s: del\n", id);
+		if (probe_rcache_cstr_del(cache, id) != -1)
+			FAIL("%s: deleted twice\n", id);
+		present[i] = false;
+	}
+	test_check(cache, present);
+
+	/* The deleted ids can be added again */
+	for (i = 0; i < TEST_ID_COUNT; i += 3) {
+		SEXP_t *sid, *item;
+
+		test_id(id, sizeof id, i);
+		sid  = SEXP_string_new(id, strlen(id));
+		item = SEXP_number_newi_32(i);
+
+		if (probe_rcache_sexp_add(cache, sid, item) != 0)
+			FAIL("%s: add after del\n", id);
+
+		SEXP_free(item);
+		SEXP_free(sid);
+		present[i] = true;
+	}
+	test_check(cache, present);
+
+	/* Empty the cache from the other end */
+	for (i = TEST_ID_COUNT - 1; i >= 0; --i) {
+		test_id(id, sizeof id, i);
+		if (probe_rcache_cstr_del(cache, id) != 0)
+			FAIL("%s: del all\n", id);
+		present[i] = false;
+	}
+	test_check(cache, present);
+
+	if (probe_rcache_cstr_del(cache, "missing") != -1)
+		FAIL("deleted a missing item from an emptied cache\n");
+
+	probe_rcache_free(cache);
+
+	return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2018 Red Hat Inc., Durham, North Carolina.
+ * All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/*
+ * Write items to a spill segment and read them back. The items have to come
+ * back with the same values, datatypes and number types.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <seap.h>
+#include <probe-api.h>
+#include "oval_spill.h"
+
+#define FAIL(...)                                             \
+        do {                                                  \
+                fprintf (stderr, "FAIL: " __VA_ARGS__);       \
+                exit (1);                                     \
+        } while (0)
+
+#define TEST_ITEM_COUNT 10000
+
+static bool sexp_same(const SEXP_t *a, const SEXP_t *b)
+{
+	const char *da, *db;
+
+	if (SEXP_typeof(a) != SEXP_typeof(b))
+		return false;
+
+	da = SEXP_datatype(a);
+	db = SEXP_datatype(b);
+	if ((da == NULL) != (db == NULL) || (da != NULL && strcmp(da, db) != 0))
+		return false;
+
+	switch (SEXP_typeof(a)) {
+	case SEXP_TYPE_STRING:
+		return SEXP_string_cmp(a, b) == 0;
+	case SEXP_TYPE_NUMBER:
+		if (SEXP_number_type(a) != SEXP_number_type(b))
+			return false;
+		if (SEXP_number_type(a) == SEXP_NUM_DOUBLE)
+			return SEXP_number_getf(a) == SEXP_number_getf(b);
+		if (SEXP_number_type(a) == SEXP_NUM_UINT64)
+			return SEXP_number_getu_64(a) == SEXP_number_getu_64(b);
+		return SEXP_number_geti_64(a) == SEXP_number_geti_64(b);
+	case SEXP_TYPE_LIST: {
+		uint32_t i, len = SEXP_list_length(a);
+		bool same = true;
+
+		if (len != SEXP_list_length(b))
+			return false;
+
+		for (i = 1; same && i <= len; ++i) {
+			SEXP_t *ma = SEXP_list_nth(a, i);
+			SEXP_t *mb = SEXP_list_nth(b, i);
+
+			same = sexp_same(ma, mb);
+			SEXP_free(ma);
+			SEXP_free(mb);
+		}
+		return same;
+	}
+	default:
+		return false;
+	}
+}
+
+/* An item with an entity of every datatype the probes use */
+static SEXP_t *create_item(int i)
+{
+	char path[64];
+
+	snprintf(path, sizeof path, "/spill/file%d", i);
+
+	return probe_item_create(OVAL_UNIX_FILE, NULL,
+	                         "filepath", OVAL_DATATYPE_STRING, path,
+	                         "path", OVAL_DATATYPE_STRING, "",
+	                         "size", OVAL_DATATYPE_INTEGER, (int64_t)-i,
+	                         "uread", OVAL_DATATYPE_BOOLEAN, i % 2,
+	                         "ratio", OVAL_DATATYPE_FLOAT, (double)i / 3,
+	                         "version", OVAL_DATATYPE_VERSION, "1.2.3",
+	                         "evr", OVAL_DATATYPE_EVR_STRING, "0:1.2-3",
+	                         "address", OVAL_DATATYPE_IPV6ADDR, "::1",
+	                         NULL);
+}
+
+/* A list with a number of every number type */
+static SEXP_t *create_numbers(void)
+{
+	SEXP_t *list, *nested;
+
+	nested = SEXP_list_new(NULL);
+	SEXP_datatype_set(nested, "record");
+	list = SEXP_list_new(SEXP_number_newb(true),
+	                     SEXP_number_newi_8(INT8_MIN),
+	                     SEXP_number_newu_8(UINT8_MAX),
+	                     SEXP_number_newi_16(INT16_MIN),
+	                     SEXP_number_newu_16(UINT16_MAX),
+	                     SEXP_number_newi_32(INT32_MIN),
+	                     SEXP_number_newu_32(UINT32_MAX),
+	                     SEXP_number_newi_64(INT64_MIN),
+	                     SEXP_number_newu_64(UINT64_MAX),
+	                     SEXP_number_newf(-0.125),
+	                     nested,
+	                     NULL);
+	SEXP_free(nested);
+
+	return list;
+}
+
+int main(void)
+{
+	char dir[] = "/tmp/test_api_probes_spill.XXXXXX";
+	OVAL_SPILL *spill;
+	OVAL_SPILL_READER *reader;
+	SEXP_t *numbers, *item, *expected;
+	char *path;
+	int i;
+
+	if (mkdtemp(dir) == NULL)
+		FAIL("mkdtemp: %s\n", strerror(errno));
+
+	/* Spilling is disabled unless the directory is set */
+	unsetenv("OSCAP_PROBE_SPILL_DIR");
+	if (oval_spill_new() != NULL)
+		FAIL("oval_spill_new() without OSCAP_PROBE_SPILL_DIR\n");
+
+	setenv("OSCAP_PROBE_SPILL_DIR", dir, 1);
+	spill = oval_spill_new();
+	if (spill == NULL)
+		FAIL("oval_spill_new: %s\n", strerror(errno));
+
+	numbers = create_numbers();
+	if (oval_spill_append(spill, numbers) != 0)
+		FAIL("oval_spill_append: %s\n", strerror(errno));
+
+	for (i = 0; i < TEST_ITEM_COUNT; ++i) {
+		item = create_item(i);
+		if (oval_spill_append(spill, item) != 0)
+			FAIL("oval_spill_append: %s\n", strerror(errno));
+		SEXP_free(item);
+	}
+
+	if (oval_spill_count(spill) != TEST_ITEM_COUNT + 1)
+		FAIL("oval_spill_count: %zu\n", oval_spill_count(spill));
+
+	path = strdup(oval_spill_path(spill));
+	if (oval_spill_close(spill) != 0)
+		FAIL("oval_spill_close\n");
+
+	reader = oval_spill_reader_open(path);
+	if (reader == NULL)
+		FAIL("oval_spill_reader_open: %s\n", strerror(errno));
+
+	if (oval_spill_reader_next(reader, &item) != 1)
+		FAIL("oval_spill_reader_next: numbers\n");
+	if (!sexp_same(numbers, item))
+		FAIL("the numbers differ\n");
+	SEXP_free(item);
+
+	for (i = 0; i < TEST_ITEM_COUNT; ++i) {
+		if (oval_spill_reader_next(reader, &item) != 1)
+			FAIL("oval_spill_reader_next: item %d\n", i);
+
+		expected = create_item(i);
+		if (!sexp_same(expected, item))
+			FAIL("item %d differs\n", i);
+		SEXP_free(expected);
+		SEXP_free(item);
+	}
+
+	if (oval_spill_reader_next(reader, &item) != 0)
+		FAIL("oval_spill_reader_next: no end of the segment\n");
+	oval_spill_reader_close(reader);
+
+	/* A truncated segment is reported as damaged */
+	if (truncate(path, 64) != 0)
+		FAIL("truncate: %s\n", strerror(errno));
+
+	reader = oval_spill_reader_open(path);
+	if (reader == NULL)
+		FAIL("oval_spill_reader_open: %s\n", strerror(errno));
+
+	if (oval_spill_reader_next(reader, &item) != -1)
+		FAIL("oval_spill_reader_next: truncated segment\n");
+	oval_spill_reader_close(reader);
+
+	/* The segments and their directory are removed */
+	oval_spill_cleanup();
+	if (access(path, F_OK) == 0)
+		FAIL("the segment wasn't removed\n");
+	if (rmdir(dir) != 0)
+		FAIL("the spill directory wasn't removed: %s\n", strerror(errno));
+
+	SEXP_free(numbers);
+	free(path);
+
+	return 0;
+}
@@ -120,6 +120,43 @@ function test_probes_file_invalid_utf8 {
 	return $ret_val
 }
 
+function test_probes_file_spill {
+
+	probecheck "file" || return 255
+
+	local ret_val=0
+	local DF="$srcdir/test_probes_file_spill.xml"
+	result="results.xml"
+	files_dir=$(mktemp -d)
+	spill_dir=$(mktemp -d)
+	DF_INJECTED=$(mktemp)
+
+	echo "Files dir:	${files_dir}"
+	echo "Spill dir:	${spill_dir}"
+	echo "Content file:	${DF_INJECTED}"
+
+	# more items than the 32768 which are always kept in memory
+	(cd "$files_dir" && seq -f "spill_%g" 40000 | xargs touch) || ret_val=1
+
+	sed "s;<!--injected-path -->;${files_dir};" "$DF" > $DF_INJECTED
+
+	OSCAP_PROBE_MEMORY_LIMIT=1 OSCAP_PROBE_SPILL_DIR="$spill_dir" \
+		$OSCAP oval eval --results $result $DF_INJECTED || ret_val=1
+
+	# the spilled items are read back, the object is complete
+	assert_exists 40000 '//unix-sys:file_item' || ret_val=1
+	assert_exists 1 '//collected_objects/object[@id="oval:1:obj:1"][@flag="complete"]' || ret_val=1
+	# the set operations can't use the spilled items
+	assert_exists 1 '//collected_objects/object[@id="oval:1:obj:2"][@flag="incomplete"]' || ret_val=1
+	# the segments are removed when the scan ends
+	[ -z "$(ls -A "$spill_dir")" ] || ret_val=1
+
+	rm $DF_INJECTED
+	rm -rf "$files_dir" "$spill_dir"
+
+	return $ret_val
+}
+
 # Testing.
 
 test_init
@@ -128,5 +165,6 @@ test_run "test_probes_file with verbose mode" test_probes_file verbose
 test_run "test_probes_file" test_probes_file
 test_run "test_probes_file_filenames" test_probes_file_filenames
 test_run "test_probes_file_invalid_utf8" test_probes_file_invalid_utf8
+test_run "test_probes_file_spill" test_probes_file_spill
 
 test_exit
@@ -0,0 +1,23 @@
+#!/bin/bash
+
+. $builddir/tests/test_common.sh
+
+set -e -o pipefail
+
+function perform_test {
+probecheck "sysctl" || return 255
+
+result=`mktemp`
+stderr=`mktemp`
+$OSCAP oval eval --results $result $srcdir/test_sysctl_probe_invalid_name.oval.xml 2>$stderr
+
+[ ! -s $stderr ]
+assert_exists 0 "/oval_results/results/system/oval_system_characteristics/system_data/unix-sys:sysctl_item"
+assert_exists 3 "/oval_results/results/system/oval_system_characteristics/collected_objects/object[@flag='does not exist']"
+assert_exists 1 "/oval_results/results/system/definitions/definition[@definition_id='oval:oscap:def:1' and @result='true']"
+
+rm $result
+rm $stderr
+}
+
+perform_test
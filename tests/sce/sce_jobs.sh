@@ -0,0 +1,14 @@
+#!/bin/bash
+
+# Record how many scripts run at the same time, the running scripts have
+# a file in sce_jobs.running in the working directory of oscap
+name=$(basename $0)
+touch sce_jobs.running/$name.$$
+ls sce_jobs.running | wc -l >> sce_jobs.count
+
+sleep $XCCDF_VALUE_SLEEP
+
+rm sce_jobs.running/$name.$$
+echo "$name $XCCDF_VALUE_SLEEP $XCCDF_VALUE_RESULT"
+
+eval "exit \$XCCDF_RESULT_$XCCDF_VALUE_RESULT"
@@ -0,0 +1,63 @@
+#!/bin/bash
+
+# Test that the SCE scripts run in parallel with OSCAP_SCE_JOBS give the
+# same results in the same order as when they run one by one.
+
+. $builddir/tests/test_common.sh
+
+set -e -o pipefail
+
+# Evaluate the benchmark in the given directory.
+function sce_jobs_eval {
+    local dir=$1 jobs=$2 ret=0
+
+    mkdir $dir $dir/sce_jobs.running
+    pushd $dir > /dev/null
+    OSCAP_SCE_JOBS=$jobs $OSCAP xccdf eval --check-engine-results --results results.xml \
+        ../test_sce_jobs.xccdf.xml 2> stderr || ret=$?
+    popd > /dev/null
+    [ $ret -eq 2 ]
+    [ ! -s $dir/stderr ]
+    # nothing is left running
+    [ -z "$(ls $dir/sce_jobs.running)" ]
+}
+
+function test_sce_jobs {
+    local workdir=$(mktemp -d -t ${FUNCNAME}.XXXXXX)
+    local xpath
+
+    cp $srcdir/test_sce_jobs.xccdf.xml $workdir
+    # the rules share the scripts, so the check engine result of each
+    # script is the one of the last rule in the session
+    for i in 1 2 3 4; do
+        cp $srcdir/sce_jobs.sh $workdir/sce_job_$i.sh
+    done
+
+    sce_jobs_eval $workdir/serial 1
+    sce_jobs_eval $workdir/parallel 4
+
+    [ $(sort -n $workdir/serial/sce_jobs.count | tail -1) -eq 1 ]
+    [ $(sort -n $workdir/parallel/sce_jobs.count | tail -1) -ge 2 ]
+    [ $(sort -n $workdir/parallel/sce_jobs.count | tail -1) -le 4 ]
+
+    for i in 1 2 3 4 5 6 7 8; do
+        for xpath in "rule-result[$i]/@idref" "rule-result[$i]/result" "rule-result[$i]/check/check-import"; do
+            [ "$($XPATH $workdir/serial/results.xml "string(/Benchmark/TestResult/$xpath)")" = \
+              "$($XPATH $workdir/parallel/results.xml "string(/Benchmark/TestResult/$xpath)")" ]
+        done
+    done
+
+    for i in 1 2 3 4; do
+        cmp $workdir/serial/sce_job_$i.sh.result.xml $workdir/parallel/sce_job_$i.sh.result.xml
+    done
+    # rule 5 finishes before rule 1 when the scripts run in parallel
+    grep -q "sce_job_1.sh 0.1 FAIL" $workdir/parallel/sce_job_1.sh.result.xml
+
+    rm -rf $workdir
+}
+
+test_init
+
+test_run "SCE scripts run in parallel" test_sce_jobs
+
+test_exit